@@ -1,18 +1,26 @@
 #include "util/http/http.h"
 #include "output/webrtc/webrtc.h"
+#include "output/record/record.h"
+#include "output/timelapse/timelapse.h"
+#include "output/motion/motion.h"
+#include "output/bitrate/bitrate.h"
 #include "device/camera/camera.h"
 #include "output/output.h"
 
+#include <ctype.h>
+#include <limits.h>
+
 extern unsigned char html_index_html[];
 extern unsigned int html_index_html_len;
 extern unsigned char html_webrtc_html[];
 extern unsigned int html_webrtc_html_len;
 extern unsigned char html_control_html[];
 extern unsigned int html_control_html_len;
-extern camera_t *camera;
 
 extern void camera_status_json(http_worker_t *worker, FILE *stream);
 
+#define HTTP_CONFIG_TIMEOUT_MS 5000
+
 static void http_once(FILE *stream, void (*fn)(FILE *stream, const char *data), void *headersp)
 {
   bool *headers = headersp;
@@ -36,8 +44,15 @@ static void camera_post_option(http_worker_t *worker, FILE *stream)
   }
 
   bool found = false;
+  output_locks_t *locks = http_output_locks(worker);
+  camera_t *camera = output_locks_camera_get(locks);
+
+  // the devices are not re-opened meanwhile
+  if (camera) {
+    pthread_mutex_lock(&camera->reconfigure.lock);
+  }
 
-  for (int i = 0; i < MAX_DEVICES; i++) {
+  for (int i = 0; camera && i < MAX_DEVICES; i++) {
     device_t *dev = camera->devices[i];
     if (!dev) {
       continue;
@@ -57,6 +72,11 @@ static void camera_post_option(http_worker_t *worker, FILE *stream)
     }
   }
 
+  if (camera) {
+    pthread_mutex_unlock(&camera->reconfigure.lock);
+    output_locks_camera_put(locks, camera);
+  }
+
   if (!found) {
     http_once(stream, http_404, &found);
     fprintf(stream, "The option was not found for device='%s', key='%s', value='%s'.\r\n",
@@ -69,6 +89,134 @@ cleanup:
   free(value);
 }
 
+static bool http_get_param_uint(http_worker_t *worker, const char *key, unsigned *value)
+{
+  char *param = http_get_param(worker, key);
+  if (!param) {
+    return false;
+  }
+
+  // anything but a plain number is stored as 0, which is rejected by the callers
+  char *end = NULL;
+  unsigned long parsed = strtoul(param, &end, 10);
+  *value = (isdigit((unsigned char)*param) && end && !*end && parsed <= UINT_MAX) ? parsed : 0;
+  free(param);
+  return true;
+}
+
+static void camera_post_config(http_worker_t *worker, FILE *stream)
+{
+  output_locks_t *locks = http_output_locks(worker);
+  camera_t *camera = output_locks_camera_get(locks);
+  camera_options_t *options = NULL;
+  unsigned bitrate = 0;
+  bool has_bitrate = http_get_param_uint(worker, "video.bitrate", &bitrate);
+  char bitrate_value[16] = "";
+
+  if (!camera) {
+    http_404(stream, "The camera is not running.\r\n");
+    goto cleanup;
+  }
+
+  options = malloc(sizeof(camera_options_t));
+  camera_get_options(camera, options);
+
+  http_get_param_uint(worker, "fps", &options->fps);
+  http_get_param_uint(worker, "snapshot.height", &options->snapshot.height);
+  http_get_param_uint(worker, "stream.height", &options->stream.height);
+  http_get_param_uint(worker, "video.height", &options->video.height);
+
+  if (!options->fps || !options->snapshot.height || !options->stream.height || !options->video.height) {
+    http_400(stream, "");
+    fprintf(stream, "The fps and height have to be greater than zero.\r\n");
+    goto cleanup;
+  }
+
+  if (has_bitrate && !bitrate) {
+    http_400(stream, "");
+    fprintf(stream, "The video.bitrate has to be a number greater than zero.\r\n");
+    goto cleanup;
+  }
+
+  // kept in the encoder options, so it survives the encoder re-open
+  if (has_bitrate) {
+    snprintf(bitrate_value, sizeof(bitrate_value), "%u", bitrate);
+  }
+  if (has_bitrate && camera_set_output_option(&options->video, "video_bitrate", bitrate_value) < 0) {
+    http_400(stream, "");
+    fprintf(stream, "Cannot set 'video.bitrate' to '%s'.\r\n", bitrate_value);
+    goto cleanup;
+  }
+  if (has_bitrate && locks == &output_locks) {
+    bitrate_set_limit(bitrate);
+  }
+
+  if (camera_reconfigure(camera, options, HTTP_CONFIG_TIMEOUT_MS) < 0) {
+    http_500(stream, "");
+    fprintf(stream, "Cannot reconfigure the camera.\r\n");
+    goto cleanup;
+  }
+
+  camera_get_options(camera, options);
+  http_200(stream, "");
+  fprintf(stream, "fps=%u snapshot.height=%u stream.height=%u video.height=%u%s%s\r\n",
+    options->fps, options->snapshot.height,
+    options->stream.height, options->video.height,
+    has_bitrate ? " video.bitrate=" : "", bitrate_value);
+
+cleanup:
+  output_locks_camera_put(locks, camera);
+  free(options);
+}
+
+// Serves `/cam/<name>/<path>` as `/<path>` of the given camera
+static void http_camera_dispatch(http_worker_t *worker, FILE *stream)
+{
+  char *name = worker->request_uri + strlen("/cam/");
+  char *path = strchr(name, '/');
+
+  if (!path) {
+    fprintf(stream, "HTTP/1.1 301 Moved Permanently\r\n");
+    fprintf(stream, "Location: %s/\r\n", worker->request_uri);
+    fprintf(stream, "\r\n");
+    return;
+  }
+
+  *path = 0;
+  output_locks_t *locks = output_locks_find(name);
+  *path = '/';
+
+  if (!locks) {
+    http_404(stream, "Camera not found.");
+    return;
+  }
+
+  // not dispatched again, like `/cam/<name>/cam/<name>/snapshot`
+  if (!strncmp(path, "/cam/", strlen("/cam/"))) {
+    http_404(stream, "Not found.");
+    return;
+  }
+
+  // the WebRTC server streams the first camera only
+  if (locks != &output_locks && !strcmp(path, "/webrtc")) {
+    http_404(stream, "The WebRTC is available for the first camera only.");
+    return;
+  }
+
+  // rewrite `/cam/<name>/<path>` into `/<path>` in place
+  char *request_uri = worker->request_uri;
+  void *context = worker->context;
+  worker->request_uri = path;
+  worker->context = locks;
+
+  if (!http_dispatch(worker, stream)) {
+    http_404(stream, "Not found.");
+  }
+
+  worker->request_uri = request_uri;
+  worker->context = context;
+}
+
 static void http_cors_options(http_worker_t *worker, FILE *stream)
 {
   fprintf(stream, "HTTP/1.1 204 No Data\r\n");
@@ -86,16 +234,28 @@ http_method_t http_methods[] = {
   { "GET",  "/?action=stream", http_stream },
   { "GET",  "/video", http_detect_video },
   { "GET",  "/video.m3u8", http_m3u8_video },
+  { "GET",  "/video.hls", http_hls_video },
   { "GET",  "/video.h264", http_h264_video },
   { "GET",  "/video.mkv", http_mkv_video },
   { "GET",  "/video.mp4", http_mp4_video },
+  { "GET",  "/record", http_record },
+  { "GET",  "/clip.mp4", http_clip },
+  { "GET",  "/timelapse", http_timelapse },
+  { "POST", "/timelapse", http_timelapse },
+  { "GET",  "/timelapse.zip", http_timelapse_zip },
+  { "GET",  "/motion", http_motion_events },
   { "GET",  "/webrtc", http_content, "text/html", html_webrtc_html, 0, &html_webrtc_html_len },
   { "POST", "/webrtc", http_webrtc_offer },
   { "GET",  "/control", http_content, "text/html", html_control_html, 0, &html_control_html_len },
   { "GET",  "/option", camera_post_option },
   { "POST", "/option", camera_post_option },
+  { "GET",  "/config", camera_post_config },
+  { "POST", "/config", camera_post_config },
   { "GET",  "/status", camera_status_json },
   { "GET",  "/", http_content, "text/html", html_index_html, 0, &html_index_html_len },
+  { "GET",  "*/cam/", http_camera_dispatch },
+  { "POST", "*/cam/", http_camera_dispatch },
+  { "GET",  "*/", http_output },
   { "OPTIONS", "*/", http_cors_options },
   { }
 };
@@ -2,50 +2,120 @@
 #include "util/opts/opts.h"
 #include "util/opts/log.h"
 #include "device/camera/camera.h"
+#include "device/buffer_copy.h"
 #include "output/rtsp/rtsp.h"
 #include "output/webrtc/webrtc.h"
+#include "output/record/record.h"
+#include "output/timelapse/timelapse.h"
+#include "output/motion/motion.h"
+#include "output/bitrate/bitrate.h"
+#include "output/output.h"
 #include "version.h"
 
 #include <signal.h>
 #include <unistd.h>
+#include <pthread.h>
 
 extern option_t all_options[];
 extern camera_options_t camera_options;
+extern camera_options_t *extra_camera_options[];
 extern http_server_options_t http_options;
 extern http_method_t http_methods[];
 extern rtsp_options_t rtsp_options;
 extern webrtc_options_t webrtc_options;
+extern record_options_t record_options;
+extern timelapse_options_t timelapse_options;
+extern motion_options_t motion_options;
+extern bitrate_options_t bitrate_options;
 
-camera_t *camera;
-
-void deprecations()
+void deprecations(camera_options_t *options)
 {
-  if (camera_options.high_res_factor > 0) {
+  if (options->high_res_factor > 0) {
     printf("Using deprecated `-camera-high_res_factor`. Use `-camera-snapshot.height` instead.");
 
-    if (!camera_options.snapshot.height)
-      camera_options.snapshot.height = camera_options.height / camera_options.high_res_factor;
+    if (!options->snapshot.height)
+      options->snapshot.height = options->height / options->high_res_factor;
   }
-  if (camera_options.low_res_factor > 0) {
+  if (options->low_res_factor > 0) {
     printf("Using deprecated `-camera-low_res_factor`. Use `-camera-stream.height` or `-camera-video.height` instead.");
 
-    if (!camera_options.stream.height)
-      camera_options.stream.height = camera_options.height / camera_options.low_res_factor;
-    if (!camera_options.video.height)
-      camera_options.video.height = camera_options.height / camera_options.low_res_factor;
+    if (!options->stream.height)
+      options->stream.height = options->height / options->low_res_factor;
+    if (!options->video.height)
+      options->video.height = options->height / options->low_res_factor;
   }
 }
 
-void inherit()
+void inherit(camera_options_t *options)
 {
-  if (!camera_options.snapshot.height || camera_options.snapshot.height > camera_options.height)
-    camera_options.snapshot.height = camera_options.height;
+  if (!options->snapshot.height || options->snapshot.height > options->height)
+    options->snapshot.height = options->height;
 
-  if (!camera_options.video.height || camera_options.video.height > camera_options.snapshot.height)
-    camera_options.video.height = camera_options.snapshot.height;
+  if (!options->video.height || options->video.height > options->snapshot.height)
+    options->video.height = options->snapshot.height;
 
-  if (!camera_options.stream.height || camera_options.stream.height > camera_options.video.height)
-    camera_options.stream.height = camera_options.video.height;
+  if (!options->stream.height || options->stream.height > options->video.height)
+    options->stream.height = options->video.height;
+}
+
+static int camera_loop(camera_options_t *options, output_locks_t *locks)
+{
+  int ret = -1;
+
+  while (true) {
+    camera_t *camera = camera_open(options, locks);
+    if (camera) {
+      output_locks_set_camera(locks, camera);
+      ret = camera_run(camera);
+      output_locks_set_camera(locks, NULL);
+      camera_close(&camera);
+    }
+
+    if (options->auto_reconnect > 0) {
+      LOG_INFO(NULL, "Automatically reconnecting in %d seconds...", options->auto_reconnect);
+      sleep(options->auto_reconnect);
+    } else {
+      break;
+    }
+  }
+
+  return ret;
+}
+
+static void *camera_thread(void *opaque)
+{
+  camera_options_t *options = opaque;
+
+  camera_loop(options, output_locks_find(options->name));
+  return NULL;
+}
+
+static int start_extra_cameras()
+{
+  for (int i = 0; extra_camera_options[i]; i++) {
+    camera_options_t *options = extra_camera_options[i];
+    pthread_t thread;
+
+    if (!options->path[0])
+      continue;
+
+    deprecations(options);
+    inherit(options);
+    strcpy(options->probe_cache, camera_options.probe_cache);
+
+    if (!output_locks_new(options->name)) {
+      return -1;
+    }
+
+    if (pthread_create(&thread, NULL, camera_thread, options) != 0) {
+      LOG_INFO(NULL, "Cannot start the camera '%s'.", options->name);
+      return -1;
+    }
+
+    pthread_detach(thread);
+  }
+
+  return 0;
 }
 
 int main(int argc, char *argv[])
@@ -59,11 +129,15 @@ int main(int argc, char *argv[])
 
   printf("%s Version: %s (%s)\n", argv[0], GIT_VERSION, GIT_REVISION);
 
-  deprecations();
-  inherit();
+  deprecations(&camera_options);
+  inherit(&camera_options);
+
+  if (camera_options.name[0]) {
+    output_locks.name = camera_options.name;
+  }
 
   if (camera_options.list_options) {
-    camera = camera_open(&camera_options);
+    camera_t *camera = camera_open(&camera_options, &output_locks);
     if (camera) {
       printf("\n");
       for (int i = 0; i < MAX_DEVICES; i++) {
@@ -74,6 +148,17 @@ int main(int argc, char *argv[])
     return -1;
   }
 
+  if (camera_options.dry_run) {
+    camera_t *camera = camera_open(&camera_options, &output_locks);
+    if (!camera) {
+      return -1;
+    }
+    camera_close(&camera);
+    return 0;
+  }
+
+  buffer_copy_set_threads(camera_options.copy_threads);
+
   http_fd = http_server(&http_options, http_methods);
   if (http_fd < 0) {
     goto error;
@@ -87,21 +172,28 @@ int main(int argc, char *argv[])
     goto error;
   }
 
-  while (true) {
-    camera = camera_open(&camera_options);
-    if (camera) {
-      ret = camera_run(camera);
-      camera_close(&camera);
-    }
+  if (bitrate_server(&bitrate_options) < 0) {
+    goto error;
+  }
 
-    if (camera_options.auto_reconnect > 0) {
-      LOG_INFO(NULL, "Automatically reconnecting in %d seconds...", camera_options.auto_reconnect);
-      sleep(camera_options.auto_reconnect);
-    } else {
-      break;
-    }
+  if (start_extra_cameras() < 0) {
+    goto error;
+  }
+
+  if (motion_server(&motion_options) < 0) {
+    goto error;
   }
 
+  if (record_server(&record_options) < 0) {
+    goto error;
+  }
+
+  if (timelapse_server(&timelapse_options) < 0) {
+    goto error;
+  }
+
+  ret = camera_loop(&camera_options, &output_locks);
+
 error:
   close(http_fd);
   return ret;
@@ -5,44 +5,80 @@
 #include "device/camera/camera.h"
 #include "output/rtsp/rtsp.h"
 #include "output/webrtc/webrtc.h"
+#include "output/record/record.h"
+#include "output/timelapse/timelapse.h"
+#include "output/motion/motion.h"
+#include "output/bitrate/bitrate.h"
 #include "output/output.h"
 
-camera_options_t camera_options = {
-  .path = "",
-  .width = 1920,
-  .height = 1080,
-  .format = 0,
-  .nbufs = 3,
-  .fps = 30,
-  .allow_dma = true,
-  .high_res_factor = 0.0,
-  .low_res_factor = 0.0,
-  .auto_reconnect = 0,
-  .auto_focus = true,
-  .options = "",
-  .list_options = false,
-  .snapshot = {
-    .options = "compression_quality=80"
-  },
-  .stream = {
-    .options = "compression_quality=80"
-  },
-  .video = {
 #ifdef USE_HW_H264
-    .disabled = 0,
+#define CAMERA_VIDEO_DISABLED 0
 #else // USE_HW_H264
-    .disabled = 1,
-#endif
-    .options =
-      "video_bitrate_mode=0" OPTION_VALUE_LIST_SEP
-      "video_bitrate=2000000" OPTION_VALUE_LIST_SEP
-      "repeat_sequence_header=5000000" OPTION_VALUE_LIST_SEP
-      "h264_i_frame_period=30" OPTION_VALUE_LIST_SEP
-      "h264_level=4" OPTION_VALUE_LIST_SEP
-      "h264_profile=high" OPTION_VALUE_LIST_SEP
-      "h264_minimum_qp_value=16" OPTION_VALUE_LIST_SEP
-      "h264_maximum_qp_value=32"
+#define CAMERA_VIDEO_DISABLED 1
+#endif // USE_HW_H264
+
+#define CAMERA_OPTIONS_DEFAULTS \
+  .path = "", \
+  .width = 1920, \
+  .height = 1080, \
+  .format = 0, \
+  .nbufs = 3, \
+  .fps = 30, \
+  .allow_dma = true, \
+  .high_res_factor = 0.0, \
+  .low_res_factor = 0.0, \
+  .auto_reconnect = 0, \
+  .auto_focus = true, \
+  .options = "", \
+  .list_options = false, \
+  .snapshot = { \
+    .options = "compression_quality=80" \
+  }, \
+  .stream = { \
+    .options = "compression_quality=80" \
+  }, \
+  .video = { \
+    .disabled = CAMERA_VIDEO_DISABLED, \
+    .options = \
+      "video_bitrate_mode=0" OPTION_VALUE_LIST_SEP \
+      "video_bitrate=2000000" OPTION_VALUE_LIST_SEP \
+      "repeat_sequence_header=5000000" OPTION_VALUE_LIST_SEP \
+      "h264_i_frame_period=30" OPTION_VALUE_LIST_SEP \
+      "h264_level=4" OPTION_VALUE_LIST_SEP \
+      "h264_profile=high" OPTION_VALUE_LIST_SEP \
+      "h264_minimum_qp_value=16" OPTION_VALUE_LIST_SEP \
+      "h264_maximum_qp_value=32" \
+  }, \
+  .motion = { \
+    .disabled = true, \
+    .height = 240 \
   }
+
+camera_options_t camera_options = {
+  CAMERA_OPTIONS_DEFAULTS
+};
+
+camera_options_t camera1_options = {
+  .name = "camera1",
+  CAMERA_OPTIONS_DEFAULTS
+};
+
+camera_options_t camera2_options = {
+  .name = "camera2",
+  CAMERA_OPTIONS_DEFAULTS
+};
+
+camera_options_t camera3_options = {
+  .name = "camera3",
+  CAMERA_OPTIONS_DEFAULTS
+};
+
+// Additional cameras, enabled when `-cameraN-path` is set
+camera_options_t *extra_camera_options[] = {
+  &camera1_options,
+  &camera2_options,
+  &camera3_options,
+  NULL
 };
 
 http_server_options_t http_options = {
@@ -64,6 +100,30 @@ rtsp_options_t rtsp_options = {
 webrtc_options_t webrtc_options = {
 };
 
+record_options_t record_options = {
+  .segment_s = 60,
+  .preroll_s = 10,
+  .max_mb = 1024,
+  .memory_mb = 64,
+  .direct_io = true
+};
+
+bitrate_options_t bitrate_options = {
+  .min = 250000,
+};
+
+motion_options_t motion_options = {
+  .fps = 5,
+  .threshold = 12,
+  .min_score = 1.0,
+  .hold_s = 5
+};
+
+timelapse_options_t timelapse_options = {
+  .interval_s = 10,
+  .memory_mb = 256
+};
+
 option_value_t camera_formats[] = {
   { "DEFAULT", 0 },
   { "YUYV", V4L2_PIX_FMT_YUYV },
@@ -94,38 +154,57 @@ option_value_t camera_type[] = {
   {}
 };
 
+#define CAMERA_OPTIONS(_section) \
+  DEFINE_OPTION_PTR(_section, name, string, "Set the camera name used in the `/cam/<name>/` URLs."), \
+  DEFINE_OPTION_PTR(_section, path, string, "Chooses the camera to use. If empty connect to default."), \
+  DEFINE_OPTION_VALUES(_section, type, camera_type, "Select camera type."), \
+  DEFINE_OPTION(_section, width, uint, "Set the camera capture width."), \
+  DEFINE_OPTION(_section, height, uint, "Set the camera capture height."), \
+  DEFINE_OPTION_VALUES(_section, format, camera_formats, "Set the camera capture format."), \
+  DEFINE_OPTION(_section, nbufs, uint, "Set number of capture buffers. Preferred 2 or 3."), \
+  DEFINE_OPTION(_section, fps, uint, "Set the desired capture framerate."), \
+  DEFINE_OPTION_DEFAULT(_section, allow_dma, bool, "1", "Prefer to use DMA access to reduce memory copy."), \
+  DEFINE_OPTION_PTR(_section, options, list, "Set the camera options. List all available options with `-camera-list_options`."), \
+  DEFINE_OPTION(_section, auto_reconnect, uint, "Set the camera auto-reconnect delay in seconds."), \
+  DEFINE_OPTION(_section, idle_timeout, uint, "Close the unused outputs after the given seconds and re-open them for the first client. Set to 0 to keep them open."), \
+  DEFINE_OPTION_DEFAULT(_section, auto_focus, bool, "1", "Do auto-focus on start-up (does not work with all camera)."), \
+  DEFINE_OPTION_DEFAULT(_section, force_active, bool, "1", "Force camera to be always active."), \
+  DEFINE_OPTION_DEFAULT(_section, vflip, bool, "1", "Do vertical image flip (does not work with all camera)."), \
+  DEFINE_OPTION_DEFAULT(_section, hflip, bool, "1", "Do horizontal image flip (does not work with all camera)."), \
+  \
+  DEFINE_OPTION_PTR(_section, isp.options, list, "Set the ISP processing options. List all available options with `-camera-list_options`."), \
+  DEFINE_OPTION_PTR(_section, dummy.options, list, "Set the emulated M2M processing options for `-camera-type=dummy`: delay_ms, jitter_ms, max_inflight."), \
+  \
+  DEFINE_OPTION_PTR(_section, snapshot.options, list, "Set the JPEG compression options. List all available options with `-camera-list_options`."), \
+  DEFINE_OPTION(_section, snapshot.height, uint, "Override the snapshot height and maintain aspect ratio."), \
+  \
+  DEFINE_OPTION_DEFAULT(_section, stream.disabled, bool, "1", "Disable stream."), \
+  DEFINE_OPTION_PTR(_section, stream.options, list, "Set the JPEG compression options. List all available options with `-camera-list_options`."), \
+  DEFINE_OPTION(_section, stream.height, uint, "Override the stream height and maintain aspect ratio."), \
+  DEFINE_OPTION(_section, stream.keepalive_ms, uint, "Skip encoding the unchanged frames, sending one at least every given ms (max 2000). Set to 0 to encode all."), \
+  \
+  DEFINE_OPTION_DEFAULT(_section, video.disabled, bool, "1", "Disable video."), \
+  DEFINE_OPTION_PTR(_section, video.options, list, "Set the H264 encoding options. List all available options with `-camera-list_options`."), \
+  DEFINE_OPTION(_section, video.height, uint, "Override the video height and maintain aspect ratio."), \
+  DEFINE_OPTION_PTR(_section, video.renditions, list, "Add the lower resolution H264 encoder as `<height>:<bitrate>`, selected with `?res=<height>|low`. Up to 2."), \
+  \
+  DEFINE_OPTION_PTR(_section, outputs, list, "Add the output as `<name>:<jpeg|mjpeg|h264>:<height>[:<fps>[:<path>[:<options>]]]`, served at `/<name>` or the given path. Up to 4."), \
+  \
+  DEFINE_OPTION_DEFAULT(_section, motion.disabled, bool, "1", "Disable motion detection."), \
+  DEFINE_OPTION(_section, motion.height, uint, "Set the height of the YUV used for motion detection, rescaled if possible.")
+
 option_t all_options[] = {
-  DEFINE_OPTION_PTR(camera, path, string, "Chooses the camera to use. If empty connect to default."),
-  DEFINE_OPTION_VALUES(camera, type, camera_type, "Select camera type."),
-  DEFINE_OPTION(camera, width, uint, "Set the camera capture width."),
-  DEFINE_OPTION(camera, height, uint, "Set the camera capture height."),
-  DEFINE_OPTION_VALUES(camera, format, camera_formats, "Set the camera capture format."),
-  DEFINE_OPTION(camera, nbufs, uint, "Set number of capture buffers. Preferred 2 or 3."),
-  DEFINE_OPTION(camera, fps, uint, "Set the desired capture framerate."),
-  DEFINE_OPTION_DEFAULT(camera, allow_dma, bool, "1", "Prefer to use DMA access to reduce memory copy."),
+  CAMERA_OPTIONS(camera),
   DEFINE_OPTION(camera, high_res_factor, float, "Set the desired high resolution output scale factor."),
   DEFINE_OPTION(camera, low_res_factor, float, "Set the desired low resolution output scale factor."),
-  DEFINE_OPTION_PTR(camera, options, list, "Set the camera options. List all available options with `-camera-list_options`."),
-  DEFINE_OPTION(camera, auto_reconnect, uint, "Set the camera auto-reconnect delay in seconds."),
-  DEFINE_OPTION_DEFAULT(camera, auto_focus, bool, "1", "Do auto-focus on start-up (does not work with all camera)."),
-  DEFINE_OPTION_DEFAULT(camera, force_active, bool, "1", "Force camera to be always active."),
-  DEFINE_OPTION_DEFAULT(camera, vflip, bool, "1", "Do vertical image flip (does not work with all camera)."),
-  DEFINE_OPTION_DEFAULT(camera, hflip, bool, "1", "Do horizontal image flip (does not work with all camera)."),
-
-  DEFINE_OPTION_PTR(camera, isp.options, list, "Set the ISP processing options. List all available options with `-camera-list_options`."),
-
-  DEFINE_OPTION_PTR(camera, snapshot.options, list, "Set the JPEG compression options. List all available options with `-camera-list_options`."),
-  DEFINE_OPTION(camera, snapshot.height, uint, "Override the snapshot height and maintain aspect ratio."),
-
-  DEFINE_OPTION_DEFAULT(camera, stream.disabled, bool, "1", "Disable stream."),
-  DEFINE_OPTION_PTR(camera, stream.options, list, "Set the JPEG compression options. List all available options with `-camera-list_options`."),
-  DEFINE_OPTION(camera, stream.height, uint, "Override the stream height and maintain aspect ratio."),
-
-  DEFINE_OPTION_DEFAULT(camera, video.disabled, bool, "1", "Disable video."),
-  DEFINE_OPTION_PTR(camera, video.options, list, "Set the H264 encoding options. List all available options with `-camera-list_options`."),
-  DEFINE_OPTION(camera, video.height, uint, "Override the video height and maintain aspect ratio."),
-
   DEFINE_OPTION_DEFAULT(camera, list_options, bool, "1", "List all available options and exit."),
+  DEFINE_OPTION_PTR(camera, probe_cache, string, "Cache the probed V4L2 devices in the given file to speed up the start-up."),
+  DEFINE_OPTION(camera, copy_threads, uint, "Set the number of threads copying the frames when DMA is not possible. Set to 0 to use all CPUs."),
+  DEFINE_OPTION_DEFAULT(camera, dry_run, bool, "1", "Print the planned pipeline with the estimated cost of each output and exit."),
+
+  CAMERA_OPTIONS(camera1),
+  CAMERA_OPTIONS(camera2),
+  CAMERA_OPTIONS(camera3),
 
   DEFINE_OPTION_PTR(http, listen, string, "Set the IP address the HTTP web-server will bind to. Set to 0.0.0.0 to listen on all interfaces."),
   DEFINE_OPTION(http, port, uint, "Set the HTTP web-server port."),
@@ -137,6 +216,33 @@ option_t all_options[] = {
   DEFINE_OPTION_DEFAULT(webrtc, disable_client_ice, bool, "1", "Ignore ICE servers provided in '/webrtc' request."),
   DEFINE_OPTION_DEFAULT(webrtc, timeout_s, ulong, "3600", "Set how long to keep a WebRTC stream alive before disconnecting by default."),
 
+  DEFINE_OPTION_DEFAULT(bitrate, disabled, bool, "1", "Disable adapting the H264 bitrate to the WebRTC and RTSP receiver feedback."),
+  DEFINE_OPTION(bitrate, min, uint, "Set the lowest adapted H264 bitrate."),
+  DEFINE_OPTION(bitrate, max, uint, "Set the highest adapted H264 bitrate. Defaults to the `video_bitrate` of `-camera-video.options`."),
+
+  DEFINE_OPTION_PTR(record, path, string, "Record the H264 stream into the MP4 segments in the given directory."),
+  DEFINE_OPTION(record, segment_s, uint, "Set the duration of the recorded segment."),
+  DEFINE_OPTION(record, preroll_s, uint, "Set how much of the stream before the recording is resumed to include."),
+  DEFINE_OPTION(record, max_mb, uint, "Remove the oldest segments over the given size. Set to 0 to keep all."),
+  DEFINE_OPTION(record, clip_s, uint, "Keep the given duration in memory for '/clip.mp4?last=30s'."),
+  DEFINE_OPTION(record, memory_mb, uint, "Set the memory limit of the pre-roll and the clips."),
+  DEFINE_OPTION_DEFAULT(record, direct_io, bool, "1", "Write the segments with O_DIRECT, bypassing the page cache."),
+  DEFINE_OPTION_DEFAULT(record, paused, bool, "1", "Start with the recording paused, resume it with '/record?active=1'."),
+  DEFINE_OPTION_DEFAULT(record, motion, bool, "1", "Record only during the motion, with the pre-roll. Requires `-camera-motion.disabled=0`."),
+
+  DEFINE_OPTION(motion, fps, uint, "Set how many frames per second are analysed."),
+  DEFINE_OPTION(motion, threshold, uint, "Set the luma difference of the changed cell."),
+  DEFINE_OPTION(motion, min_score, float, "Set the percent of the changed cells that starts the motion."),
+  DEFINE_OPTION(motion, hold_s, uint, "Set how long the motion lasts after the last change."),
+  DEFINE_OPTION(motion, bitrate, uint, "Set the H264 bitrate during the motion, used with `-motion-idle_bitrate`."),
+  DEFINE_OPTION(motion, idle_bitrate, uint, "Set the H264 bitrate without the motion, used with `-motion-bitrate`."),
+
+  DEFINE_OPTION_PTR(timelapse, path, string, "Write the timelapse shots into the session directories in the given directory."),
+  DEFINE_OPTION(timelapse, interval_s, uint, "Set the interval between the shots. Set to 0 to take them only with '/timelapse?shot=1'."),
+  DEFINE_OPTION_DEFAULT(timelapse, zip, bool, "1", "Keep the shots in memory, served as '/timelapse.zip'."),
+  DEFINE_OPTION(timelapse, memory_mb, uint, "Set the memory limit of the shots kept for the ZIP."),
+  DEFINE_OPTION_DEFAULT(timelapse, mjpeg, bool, "1", "Assemble the shots into the '<session>.mjpeg' when stopped."),
+
   DEFINE_OPTION_DEFAULT(log, debug, bool, "1", "Enable debug logging."),
   DEFINE_OPTION_DEFAULT(log, verbose, bool, "1", "Enable verbose logging."),
   DEFINE_OPTION_DEFAULT(log, stats, uint, "1", "Print statistics every duration."),
@@ -3,15 +3,16 @@ extern "C" {
 #include "util/http/http.h"
 #include "util/opts/fourcc.h"
 #include "util/opts/control.h"
+#include "util/opts/log.h"
 #include "device/buffer_list.h"
 #include "device/buffer_lock.h"
 #include "device/camera/camera.h"
 #include "output/rtsp/rtsp.h"
 #include "output/webrtc/webrtc.h"
+#include "output/bitrate/bitrate.h"
 #include "output/output.h"
 #include "version.h"
 
-extern camera_t *camera;
 extern http_server_options_t http_options;
 extern rtsp_options_t rtsp_options;
 extern webrtc_options_t webrtc_options;
@@ -52,6 +53,10 @@ static nlohmann::json serialize_buf_lock(buffer_lock_t *buf_lock)
     output["frames"] = buf_lock->counter;
     output["refs"] = buf_lock->refs;
     output["dropped"] = buf_lock->dropped;
+    output["latency"]["samples"] = buf_lock->latency_samples;
+    output["latency"]["p50_ms"] = buffer_lock_latency_percentile_ms(buf_lock, 0.50f);
+    output["latency"]["p99_ms"] = buffer_lock_latency_percentile_ms(buf_lock, 0.99f);
+    output["latency"]["max_ms"] = buf_lock->latency_max_us / 1000;
   }
   return output;
 }
@@ -98,11 +103,11 @@ static int device_options_callback(device_option_t *option, void *opaque)
   return 0;
 }
 
-static nlohmann::json devices_status_json()
+static nlohmann::json devices_status_json(camera_t *camera)
 {
   nlohmann::json devices;
 
-  for (int i = 0; i < MAX_DEVICES; i++) {
+  for (int i = 0; camera && i < MAX_DEVICES; i++) {
     if (!camera->devices[i])
       continue;
 
@@ -111,6 +116,8 @@ static nlohmann::json devices_status_json()
     device_json["name"] = device->name;
     device_json["path"] = device->path;
     device_json["allow_dma"] = device->opts.allow_dma;
+    device_json["force_key"]["requested"] = device->force_key_requested;
+    device_json["force_key"]["coalesced"] = device->force_key_coalesced;
     device_json["output"] = serialize_buf_list(device->output_list);
     for (int j = 0; j < device->n_capture_list; j++) {
       device_json["captures"][j] = serialize_buf_list(device->capture_lists[j]);
@@ -123,17 +130,36 @@ static nlohmann::json devices_status_json()
   return devices;
 }
 
-static nlohmann::json links_status_json()
+static nlohmann::json links_status_json(camera_t *camera)
 {
   nlohmann::json links;
 
-  for (int i = 0; i < camera->nlinks; i++) {
+  for (int i = 0; camera && i < camera->nlinks; i++) {
     link_t *link = &camera->links[i];
 
     nlohmann::json link_json;
     link_json["source"] = link->capture_list->name;
     for (int j = 0; j < link->n_output_lists; j++) {
-      link_json["sinks"][j] = link->output_lists[j]->name;
+      buffer_list_t *output_list = link->output_lists[j];
+      char reason[256];
+
+      link_json["sinks"][j] = output_list->name;
+
+      nlohmann::json copy_json;
+      copy_json["sink"] = output_list->name;
+      copy_json["copied_bytes"] = output_list->stats.copied_bytes;
+      copy_json["dma_bytes"] = output_list->stats.dma_bytes;
+      if (output_list->stats.copy_time_us) {
+        copy_json["copy_mib_per_s"] = output_list->stats.copied_bytes / 1024.0 / 1024.0 *
+          1000.0 * 1000.0 / output_list->stats.copy_time_us;
+      }
+      if (links_copy_reason(link->capture_list, output_list, reason, sizeof(reason))) {
+        copy_json["zero_copy"] = false;
+        copy_json["reason"] = reason;
+      } else {
+        copy_json["zero_copy"] = true;
+      }
+      link_json["copies"][j] = copy_json;
     }
     for (int j = 0; j < link->n_callbacks; j++) {
       link_json["callbacks"][j] = link->callbacks[j].name;
@@ -165,6 +191,37 @@ static nlohmann::json get_url(bool running, const char *output, const char *prot
   return endpoint;
 }
 
+static nlohmann::json serialize_bitrate(bitrate_status_t *bitrate)
+{
+  nlohmann::json output;
+  uint64_t now_us = get_monotonic_time_us(NULL, NULL);
+
+  output["current"] = bitrate->current;
+  output["target"] = bitrate->target;
+  output["limit"] = bitrate->limit;
+
+  for (int i = 0; i < bitrate->n_peers; i++) {
+    nlohmann::json peer;
+    peer["name"] = bitrate->peers[i].name;
+    peer["estimate"] = bitrate->peers[i].estimate;
+    peer["loss"] = bitrate->peers[i].loss;
+    peer["jitter"] = bitrate->peers[i].jitter;
+    peer["age_ms"] = (now_us - bitrate->peers[i].updated_us) / 1000;
+    output["peers"] += peer;
+  }
+
+  for (int i = 0; i < bitrate->n_decisions; i++) {
+    nlohmann::json decision;
+    decision["age_ms"] = (now_us - bitrate->decisions[i].time_us) / 1000;
+    decision["from"] = bitrate->decisions[i].from;
+    decision["to"] = bitrate->decisions[i].to;
+    decision["reason"] = bitrate->decisions[i].reason;
+    output["decisions"] += decision;
+  }
+
+  return output;
+}
+
 extern "C" void camera_status_json(http_worker_t *worker, FILE *stream)
 {
   nlohmann::json message;
@@ -172,18 +229,71 @@ extern "C" void camera_status_json(http_worker_t *worker, FILE *stream)
   message["version"] = GIT_VERSION;
   message["revision"] = GIT_REVISION;
 
-  message["outputs"]["snapshot"] = serialize_buf_lock(&snapshot_lock);
-  message["outputs"]["stream"] = serialize_buf_lock(&stream_lock);
-  message["outputs"]["video"] = serialize_buf_lock(&video_lock);
+  output_locks_t *locks = http_output_locks(worker);
+  std::string prefix = locks->name ? std::string("/cam/") + locks->name : "";
+
+  message["outputs"]["snapshot"] = serialize_buf_lock(locks->snapshot);
+  message["outputs"]["stream"] = serialize_buf_lock(locks->stream);
+  message["outputs"]["video"] = serialize_buf_lock(locks->video);
+
+  camera_t *camera = output_locks_camera_get(locks);
+  camera_options_t *options = camera ? (camera_options_t *)malloc(sizeof(camera_options_t)) : NULL;
+
+  if (camera) {
+    camera_get_options(camera, options);
+
+    // the devices and links are not re-configured meanwhile
+    pthread_mutex_lock(&camera->reconfigure.lock);
+    message["devices"] = devices_status_json(camera);
+    message["links"] = links_status_json(camera);
+    pthread_mutex_unlock(&camera->reconfigure.lock);
+    output_locks_camera_put(locks, camera);
+  } else {
+    message["devices"] = devices_status_json(NULL);
+    message["links"] = links_status_json(NULL);
+  }
+
+  for (int i = 0; options && i < MAX_OUTPUT_RENDITIONS; i++) {
+    if (!options->renditions[i].height)
+      continue;
+
+    auto rendition = serialize_buf_lock(locks->renditions[i]);
+    rendition["bitrate"] = camera_output_bitrate(&options->renditions[i]);
+    rendition["res"] = options->renditions[i].height;
+    message["outputs"]["renditions"] += rendition;
+  }
+
+  for (int i = 0; options && i < MAX_OUTPUT_EXTRA; i++) {
+    camera_output_options_t *extra = &options->extra[i];
+    if (!extra->name[0] || !locks->extra[i])
+      continue;
+
+    auto output = serialize_buf_lock(locks->extra[i]);
+    output["res"] = extra->height;
+    output["fps"] = extra->fps;
+    output["path"] = prefix + extra->path;
+    message["outputs"]["extra"][extra->name] = output;
+  }
+
+  free(options);
 
-  message["devices"] = devices_status_json();
-  message["links"] = links_status_json();
+  message["endpoints"]["rtsp"] = get_url(locks == &output_locks && video_lock.buf_list != NULL && rtsp_options.running, "video", "rtsp", worker->host, rtsp_options.port, "/stream.h264");
+  message["endpoints"]["webrtc"] = get_url(locks == &output_locks && video_lock.buf_list != NULL && webrtc_options.running, "video", "http", worker->host, http_options.port, "/webrtc");
+  message["endpoints"]["video"] = get_url(locks->video->buf_list != NULL, "video", "http", worker->host, http_options.port, (prefix + "/video").c_str());
+  message["endpoints"]["stream"] = get_url(locks->stream->buf_list != NULL, "stream", "http", worker->host, http_options.port, (prefix + "/stream").c_str());
+  message["endpoints"]["snapshot"] = get_url(locks->snapshot->buf_list != NULL, "snapshot", "http", worker->host, http_options.port, (prefix + "/snapshot").c_str());
 
-  message["endpoints"]["rtsp"] = get_url(video_lock.buf_list != NULL && rtsp_options.running, "video", "rtsp", worker->host, rtsp_options.port, "/stream.h264");
-  message["endpoints"]["webrtc"] = get_url(video_lock.buf_list != NULL && webrtc_options.running, "video", "http", worker->host, http_options.port, "/webrtc");
-  message["endpoints"]["video"] = get_url(video_lock.buf_list != NULL, "video", "http", worker->host, http_options.port, "/video");
-  message["endpoints"]["stream"] = get_url(stream_lock.buf_list != NULL, "stream", "http", worker->host, http_options.port, "/stream");
-  message["endpoints"]["snapshot"] = get_url(snapshot_lock.buf_list != NULL, "snapshot", "http", worker->host, http_options.port, "/snapshot");
+  for (int i = 0; output_locks_get(i); i++) {
+    output_locks_t *camera_locks = output_locks_get(i);
+    if (!camera_locks->name)
+      continue;
+
+    nlohmann::json camera_json;
+    camera_json["name"] = camera_locks->name;
+    camera_json["running"] = camera_locks->camera != NULL;
+    camera_json["uri"] = std::string("/cam/") + camera_locks->name + "/";
+    message["cameras"] += camera_json;
+  }
 
   if (rtsp_options.running) {
     message["endpoints"]["rtsp"]["clients"] = rtsp_options.clients;
@@ -192,5 +302,10 @@ extern "C" void camera_status_json(http_worker_t *worker, FILE *stream)
     message["endpoints"]["rtsp"]["dropped"] = rtsp_options.dropped;
   }
 
+  bitrate_status_t bitrate;
+  if (locks == &output_locks && bitrate_status(&bitrate)) {
+    message["bitrate"] = serialize_bitrate(&bitrate);
+  }
+
   http_write_response(stream, "200 OK", "application/json", message.dump().c_str(), 0);
 }
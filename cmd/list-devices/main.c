@@ -26,7 +26,7 @@ void print_formats(const char *type, device_info_formats_t *formats)
 
 int main(int argc, const char *argv[])
 {
-  device_list_t *list = device_list_v4l2();
+  device_list_t *list = device_list_v4l2(NULL);
 
   printf("Found %d devices\n", list->ndevices);
 
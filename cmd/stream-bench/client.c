@@ -0,0 +1,378 @@
+#include "stream-bench.h"
+#include "util/opts/log.h"
+
+#include <netdb.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <strings.h>
+#include <ctype.h>
+
+#define BENCH_RECV_TIMEOUT_MS 200
+
+const unsigned bench_gap_buckets_ms[BENCH_GAP_BUCKETS] = {
+  5, 10, 20, 34, 50, 67, 100, 200, 500, 0 // last is everything above
+};
+
+int bench_url_parse(bench_url_t *url, const char *str)
+{
+  const char *host = str;
+  const char *prefix = "http://";
+
+  if (!strncmp(host, prefix, strlen(prefix))) {
+    host += strlen(prefix);
+  }
+
+  const char *path = strchr(host, '/');
+  if (!path) {
+    path = host + strlen(host);
+  }
+
+  const char *port = memchr(host, ':', path - host);
+  if (port) {
+    snprintf(url->host, sizeof(url->host), "%.*s", (int)(port - host), host);
+    snprintf(url->port, sizeof(url->port), "%.*s", (int)(path - port - 1), port + 1);
+  } else {
+    snprintf(url->host, sizeof(url->host), "%.*s", (int)(path - host), host);
+    strcpy(url->port, "80");
+  }
+
+  snprintf(url->path, sizeof(url->path), "%s", *path ? path : "/");
+  return url->host[0] ? 0 : -1;
+}
+
+static int bench_client_connect(bench_client_t *client)
+{
+  struct addrinfo hints = { .ai_family = AF_UNSPEC, .ai_socktype = SOCK_STREAM };
+  struct addrinfo *res = NULL;
+  int fd = -1;
+
+  if (getaddrinfo(client->url->host, client->url->port, &hints, &res) != 0) {
+    LOG_ERROR(client, "Cannot resolve %s:%s", client->url->host, client->url->port);
+  }
+
+  fd = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
+  if (fd < 0) {
+    LOG_ERROR(client, "Cannot create socket.");
+  }
+
+  struct timeval tv = { .tv_usec = BENCH_RECV_TIMEOUT_MS * 1000 };
+  setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+  if (connect(fd, res->ai_addr, res->ai_addrlen) < 0) {
+    LOG_ERROR(client, "Cannot connect to %s:%s", client->url->host, client->url->port);
+  }
+
+  dprintf(fd, "GET %s HTTP/1.0\r\nHost: %s\r\nUser-Agent: stream-bench\r\n\r\n",
+    client->url->path, client->url->host);
+
+  freeaddrinfo(res);
+  client->fd = fd;
+  client->buf_start = client->buf_end = 0;
+  client->stats.requests++;
+  return 0;
+
+error:
+  if (fd >= 0)
+    close(fd);
+  if (res)
+    freeaddrinfo(res);
+  return -1;
+}
+
+static void bench_client_close(bench_client_t *client)
+{
+  if (client->fd >= 0) {
+    close(client->fd);
+    client->fd = -1;
+  }
+}
+
+// returns the number of buffered bytes, 0 on EOF or deadline, -1 on error
+int bench_client_fill(bench_client_t *client)
+{
+  if (client->buf_start < client->buf_end) {
+    return client->buf_end - client->buf_start;
+  }
+
+  client->buf_start = client->buf_end = 0;
+
+  while (get_monotonic_time_us(NULL, NULL) < client->deadline_us) {
+    int n = recv(client->fd, client->buf, sizeof(client->buf), 0);
+    if (n > 0) {
+      client->buf_end = n;
+      client->stats.bytes += n;
+      return n;
+    } else if (n == 0) {
+      return 0;
+    } else if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+      return -1;
+    }
+  }
+
+  return 0;
+}
+
+// reads exactly `size` bytes, or discards them if `data` is NULL
+int bench_client_read(bench_client_t *client, void *data, unsigned size)
+{
+  while (size > 0) {
+    int n = bench_client_fill(client);
+    if (n <= 0) {
+      return -1;
+    }
+
+    n = MIN((unsigned)n, size);
+    if (data) {
+      memcpy(data, client->buf + client->buf_start, n);
+      data = (uint8_t *)data + n;
+    }
+    client->buf_start += n;
+    size -= n;
+  }
+
+  return 0;
+}
+
+static int bench_client_read_line(bench_client_t *client, char *line, unsigned size)
+{
+  unsigned len = 0;
+
+  while (bench_client_fill(client) > 0) {
+    char ch = client->buf[client->buf_start++];
+    if (ch == '\n') {
+      if (len > 0 && line[len - 1] == '\r')
+        len--;
+      line[len] = 0;
+      return len;
+    }
+    if (len < size - 1) {
+      line[len++] = ch;
+    }
+  }
+
+  return -1;
+}
+
+static uint64_t bench_parse_timestamp(const char *value)
+{
+  char *end = NULL;
+  uint64_t sec = strtoull(value, &end, 10);
+  uint64_t usec = 0;
+
+  if (end && *end == '.') {
+    const char *frac = end + 1;
+    for (int i = 0; i < 6; i++) {
+      usec = usec * 10 + (isdigit(*frac) ? *frac++ - '0' : 0);
+    }
+  }
+
+  return sec * 1000 * 1000 + usec;
+}
+
+// Reads the response, or the multipart part, headers.
+// Leading empty lines and `--boundary` lines are skipped.
+static int bench_client_read_headers(bench_client_t *client, bench_headers_t *headers)
+{
+  char line[BENCH_LINE_LENGTH];
+  bool has_headers = false;
+
+  *headers = (bench_headers_t){ .content_length = -1, .seq = -1 };
+
+  while (true) {
+    int len = bench_client_read_line(client, line, sizeof(line));
+    if (len < 0) {
+      return -1;
+    } else if (len == 0) {
+      if (has_headers)
+        return 0;
+      continue;
+    } else if (!strncmp(line, "--", 2) && !has_headers) {
+      continue;
+    }
+
+    has_headers = true;
+
+    char *value = strchr(line, ':');
+    if (!strncmp(line, "HTTP/", 5)) {
+      const char *code = strchr(line, ' ');
+      headers->status = code ? atoi(code + 1) : 0;
+      continue;
+    } else if (!value) {
+      continue;
+    }
+
+    *value++ = 0;
+    value = trim(value);
+
+    if (!strcasecmp(line, "Content-Type")) {
+      snprintf(headers->content_type, sizeof(headers->content_type), "%s", value);
+    } else if (!strcasecmp(line, "Content-Length")) {
+      headers->content_length = atol(value);
+    } else if (!strcasecmp(line, "X-Timestamp")) {
+      headers->timestamp_us = bench_parse_timestamp(value);
+    } else if (!strcasecmp(line, "X-Frame-Seq")) {
+      headers->seq = atoll(value);
+    }
+  }
+}
+
+void bench_client_frame(bench_client_t *client, uint64_t size, bench_headers_t *headers)
+{
+  bench_stats_t *stats = &client->stats;
+  uint64_t now_us = get_monotonic_time_us(NULL, NULL);
+
+  if (stats->last_frame_us) {
+    unsigned gap_ms = (now_us - stats->last_frame_us) / 1000;
+    int bucket = 0;
+    while (bucket < BENCH_GAP_BUCKETS - 1 && gap_ms >= bench_gap_buckets_ms[bucket])
+      bucket++;
+    stats->gaps[bucket]++;
+  } else {
+    stats->first_frame_us = now_us;
+  }
+
+  stats->frames++;
+  stats->frame_bytes += size;
+  stats->last_frame_us = now_us;
+
+  if (headers && headers->timestamp_us) {
+    int64_t latency_us = get_time_us(CLOCK_REALTIME, NULL, NULL, 0) - headers->timestamp_us;
+    stats->latency_ms[MIN(MAX(latency_us, 0) / 1000, BENCH_LATENCY_MAX_MS)]++;
+    stats->latency_samples++;
+  }
+
+  // snapshots are not expected to be consecutive
+  if (headers && headers->seq >= 0 && client->format == BENCH_FORMAT_MULTIPART) {
+    if (client->last_seq >= 0 && headers->seq > client->last_seq + 1) {
+      stats->missed += headers->seq - client->last_seq - 1;
+    }
+    client->last_seq = headers->seq;
+  }
+}
+
+static int bench_client_read_part(bench_client_t *client, bench_headers_t *headers)
+{
+  if (headers->content_length < 0) {
+    snprintf(client->error, sizeof(client->error), "Missing Content-Length.");
+    return -1;
+  }
+  if (bench_client_read(client, NULL, headers->content_length) < 0) {
+    return -1;
+  }
+
+  bench_client_frame(client, headers->content_length, headers);
+  return 0;
+}
+
+static bench_format_t bench_client_detect_format(bench_client_t *client, bench_headers_t *headers)
+{
+  const char *ext = strrchr(client->url->path, '.');
+
+  if (ext && !strncmp(ext, ".mkv", 4)) {
+    return BENCH_FORMAT_MKV;
+  } else if (ext && !strncmp(ext, ".mp4", 4)) {
+    return BENCH_FORMAT_MP4;
+  } else if (strstr(headers->content_type, "multipart/")) {
+    return BENCH_FORMAT_MULTIPART;
+  } else if (strstr(headers->content_type, "image/")) {
+    return BENCH_FORMAT_SNAPSHOT;
+  } else if (strstr(headers->content_type, "octet-stream") || strstr(headers->content_type, "h264")) {
+    return BENCH_FORMAT_H264;
+  } else if (strstr(headers->content_type, "matroska")) {
+    return BENCH_FORMAT_MKV;
+  } else if (strstr(headers->content_type, "mp4")) {
+    return BENCH_FORMAT_MP4;
+  }
+
+  return BENCH_FORMAT_NONE;
+}
+
+static int bench_client_request(bench_client_t *client)
+{
+  bench_headers_t headers;
+  int ret = -1;
+
+  if (bench_client_connect(client) < 0) {
+    snprintf(client->error, sizeof(client->error), "Cannot connect.");
+    return -1;
+  }
+
+  if (bench_client_read_headers(client, &headers) < 0) {
+    snprintf(client->error, sizeof(client->error), "Cannot read response.");
+    goto error;
+  }
+
+  if (headers.status != 200) {
+    snprintf(client->error, sizeof(client->error), "Received HTTP %d.", headers.status);
+    goto error;
+  }
+
+  client->format = bench_client_detect_format(client, &headers);
+
+  switch (client->format) {
+  case BENCH_FORMAT_SNAPSHOT:
+    ret = bench_client_read_part(client, &headers);
+    break;
+
+  case BENCH_FORMAT_MULTIPART:
+    while (bench_client_read_headers(client, &headers) == 0) {
+      if (bench_client_read_part(client, &headers) < 0)
+        break;
+    }
+    ret = 0;
+    break;
+
+  case BENCH_FORMAT_H264:
+    ret = bench_parse_h264(client);
+    break;
+
+  case BENCH_FORMAT_MP4:
+    ret = bench_parse_mp4(client);
+    break;
+
+  case BENCH_FORMAT_MKV:
+    ret = bench_parse_mkv(client);
+    break;
+
+  default:
+    snprintf(client->error, sizeof(client->error), "Unsupported Content-Type: %.64s", headers.content_type);
+    break;
+  }
+
+error:
+  bench_client_close(client);
+  return ret;
+}
+
+void *bench_client_thread(void *opaque)
+{
+  bench_client_t *client = opaque;
+
+  client->fd = -1;
+  client->last_seq = -1;
+
+  while (get_monotonic_time_us(NULL, NULL) < client->deadline_us) {
+    if (bench_client_request(client) < 0) {
+      client->stats.errors++;
+      LOG_DEBUG(client, "Request failed: %s", client->error);
+      usleep(100 * 1000);
+      continue;
+    }
+
+    // streams are expected to run until the deadline
+    if (client->format != BENCH_FORMAT_SNAPSHOT) {
+      if (get_monotonic_time_us(NULL, NULL) < client->deadline_us) {
+        client->stats.errors++;
+        LOG_DEBUG(client, "Stream ended before the deadline. Reconnecting...");
+      }
+      continue;
+    }
+
+    if (client->options->snapshot_interval_ms) {
+      usleep(client->options->snapshot_interval_ms * 1000);
+    }
+  }
+
+  return NULL;
+}
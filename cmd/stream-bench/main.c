@@ -0,0 +1,96 @@
+#include "stream-bench.h"
+#include "util/opts/opts.h"
+#include "util/opts/log.h"
+
+#include <signal.h>
+#include <unistd.h>
+
+bench_options_t bench_options = {
+  .url = "http://127.0.0.1:8080/stream",
+  .clients = 1,
+  .duration = 10,
+  .snapshot_interval_ms = 0,
+  .json = false
+};
+
+log_options_t log_options = {
+  .debug = false,
+  .verbose = false
+};
+
+option_t all_options[] = {
+  DEFINE_OPTION_PTR(bench, url, string, "Set the URL to benchmark: `/stream`, `/snapshot`, `/video.h264`, `/video.mkv` or `/video.mp4`."),
+  DEFINE_OPTION(bench, clients, uint, "Set the number of concurrent connections."),
+  DEFINE_OPTION(bench, duration, uint, "Set the duration of the benchmark in seconds."),
+  DEFINE_OPTION(bench, snapshot_interval_ms, uint, "Set the delay between the consecutive `/snapshot` requests."),
+  DEFINE_OPTION_DEFAULT(bench, json, bool, "1", "Print the results as JSON."),
+
+  DEFINE_OPTION_DEFAULT(log, debug, bool, "1", "Enable debug logging."),
+  DEFINE_OPTION_PTR(log, filter, list, "Enable debug logging from the given files. Ex.: `-log-filter=client.c`"),
+  {}
+};
+
+int main(int argc, char *argv[])
+{
+  bench_url_t url;
+  bench_client_t *clients = NULL;
+  int ret = -1;
+
+  if (parse_opts(all_options, argc, argv) < 0) {
+    return -1;
+  }
+
+  if (bench_url_parse(&url, bench_options.url) < 0) {
+    LOG_ERROR(NULL, "Invalid URL: %s", bench_options.url);
+  }
+
+  if (!bench_options.clients) {
+    LOG_ERROR(NULL, "At least one client is required.");
+  }
+
+  // ignore SIGPIPE of closed connections
+  signal(SIGPIPE, SIG_IGN);
+
+  clients = calloc(bench_options.clients, sizeof(bench_client_t));
+  if (!clients) {
+    LOG_ERROR(NULL, "Cannot allocate %u clients.", bench_options.clients);
+  }
+
+  uint64_t start_us = get_monotonic_time_us(NULL, NULL);
+
+  LOG_INFO(NULL, "Starting %u client(s) of %s:%s%s for %us...",
+    bench_options.clients, url.host, url.port, url.path, bench_options.duration);
+
+  for (unsigned i = 0; i < bench_options.clients; i++) {
+    bench_client_t *client = &clients[i];
+
+    snprintf(client->name_buf, sizeof(client->name_buf), "client/%u", i);
+    client->name = client->name_buf;
+    client->url = &url;
+    client->options = &bench_options;
+    client->start_us = start_us;
+    client->deadline_us = start_us + bench_options.duration * 1000LL * 1000LL;
+
+    if (pthread_create(&client->thread, NULL, bench_client_thread, client) != 0) {
+      LOG_ERROR(NULL, "Cannot start client %u.", i);
+    }
+  }
+
+  for (unsigned i = 0; i < bench_options.clients; i++) {
+    pthread_join(clients[i].thread, NULL);
+  }
+
+  uint64_t elapsed_us = get_monotonic_time_us(NULL, NULL) - start_us;
+
+  if (bench_options.json) {
+    bench_report_json(stdout, clients, bench_options.clients, elapsed_us);
+  } else {
+    bench_report_text(stdout, clients, bench_options.clients, elapsed_us);
+  }
+
+  ret = 0;
+
+error:
+  free(clients);
+  return ret;
+}
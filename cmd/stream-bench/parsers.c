@@ -0,0 +1,184 @@
+#include "stream-bench.h"
+#include "util/opts/log.h"
+
+#include <inttypes.h>
+
+#define H264_NAL_SLICE 1
+#define H264_NAL_IDR 5
+#define H264_NAL_SEI 6
+#define H264_NAL_SPS 7
+#define H264_NAL_PPS 8
+#define H264_NAL_AUD 9
+
+#define MKV_ID_SEGMENT 0x18538067
+#define MKV_ID_CLUSTER 0x1F43B675
+#define MKV_ID_BLOCK_GROUP 0xA0
+#define MKV_ID_BLOCK 0xA1
+#define MKV_ID_SIMPLE_BLOCK 0xA3
+
+// Splits the Annex-B stream into access units (7.4.1.2.3):
+// - AUD, SEI, SPS or PPS after a slice starts a new one
+// - a slice with `first_mb_in_slice == 0` after a slice starts a new one
+int bench_parse_h264(bench_client_t *client)
+{
+  unsigned zeros = 0;
+  int nal_type = -1; // waiting for the NAL header
+  bool waiting_slice = false; // waiting for the first slice byte
+  bool has_slice = false;
+  uint64_t au_bytes = 0;
+
+  while (bench_client_fill(client) > 0) {
+    uint8_t *data = client->buf + client->buf_start;
+    unsigned n = client->buf_end - client->buf_start;
+
+    for (unsigned i = 0; i < n; i++) {
+      uint8_t byte = data[i];
+      bool au_start = false;
+
+      au_bytes++;
+
+      if (nal_type == 0) {
+        nal_type = byte & 0x1F;
+
+        if (nal_type == H264_NAL_SLICE || nal_type == H264_NAL_IDR) {
+          waiting_slice = true;
+        } else if (nal_type >= H264_NAL_SEI && nal_type <= H264_NAL_AUD) {
+          au_start = has_slice;
+        }
+      } else if (waiting_slice) {
+        // ue(v) of `first_mb_in_slice` is `0` if the first bit is set
+        au_start = has_slice && (byte & 0x80);
+        waiting_slice = false;
+        has_slice = true;
+      }
+
+      if (au_start) {
+        bench_client_frame(client, au_bytes, NULL);
+        has_slice = false;
+        au_bytes = 0;
+      }
+
+      if (byte == 0) {
+        zeros++;
+      } else {
+        if (byte == 1 && zeros >= 2) {
+          nal_type = 0;
+        }
+        zeros = 0;
+      }
+    }
+
+    client->buf_start = client->buf_end;
+  }
+
+  return 0;
+}
+
+static uint32_t bench_read_be32(uint8_t *data)
+{
+  return (data[0] << 24) | (data[1] << 16) | (data[2] << 8) | data[3];
+}
+
+// Counts samples of the `trun` boxes of each `moof` fragment.
+int bench_parse_mp4(bench_client_t *client)
+{
+  uint8_t header[16];
+
+  while (bench_client_read(client, header, 8) == 0) {
+    uint64_t size = bench_read_be32(header);
+    const char *type = (const char *)header + 4;
+    unsigned header_size = 8;
+
+    if (size == 1) {
+      if (bench_client_read(client, header + 8, 8) < 0)
+        break;
+      size = ((uint64_t)bench_read_be32(header + 8) << 32) | bench_read_be32(header + 12);
+      header_size = 16;
+    } else if (size == 0) {
+      break; // until the end of stream
+    }
+
+    if (size < header_size) {
+      snprintf(client->error, sizeof(client->error), "Invalid MP4 box size: %" PRIu64, size);
+      return -1;
+    }
+
+    if (!memcmp(type, "moof", 4) || !memcmp(type, "traf", 4)) {
+      continue; // descend into the children
+    }
+
+    if (!memcmp(type, "trun", 4) && size >= header_size + 8) {
+      uint8_t trun[8];
+      if (bench_client_read(client, trun, sizeof(trun)) < 0)
+        break;
+
+      for (uint32_t i = bench_read_be32(trun + 4); i-- > 0; ) {
+        bench_client_frame(client, 0, NULL);
+      }
+      header_size += sizeof(trun);
+    }
+
+    if (bench_client_read(client, NULL, size - header_size) < 0)
+      break;
+  }
+
+  return 0;
+}
+
+static int bench_read_ebml_vint(bench_client_t *client, uint64_t *value, bool keep_marker, bool *unknown)
+{
+  uint8_t first;
+  if (bench_client_read(client, &first, 1) < 0)
+    return -1;
+
+  int len = 1;
+  while (len <= 8 && !(first & (0x80 >> (len - 1))))
+    len++;
+  if (len > 8)
+    return -1;
+
+  uint64_t result = keep_marker ? first : (first & (0xFF >> len));
+  bool all_ones = result == (uint64_t)(0xFF >> len);
+
+  for (int i = 1; i < len; i++) {
+    uint8_t byte;
+    if (bench_client_read(client, &byte, 1) < 0)
+      return -1;
+    result = (result << 8) | byte;
+    all_ones = all_ones && byte == 0xFF;
+  }
+
+  if (unknown)
+    *unknown = all_ones;
+  *value = result;
+  return 0;
+}
+
+// Counts `SimpleBlock` and `Block` elements of the Matroska stream.
+int bench_parse_mkv(bench_client_t *client)
+{
+  uint64_t id, size;
+  bool unknown_size;
+
+  while (bench_read_ebml_vint(client, &id, true, NULL) == 0 &&
+    bench_read_ebml_vint(client, &size, false, &unknown_size) == 0) {
+
+    if (id == MKV_ID_SEGMENT || id == MKV_ID_CLUSTER || id == MKV_ID_BLOCK_GROUP) {
+      continue; // descend into the children
+    }
+
+    if (unknown_size) {
+      snprintf(client->error, sizeof(client->error), "Unknown size of EBML element: %" PRIx64, id);
+      return -1;
+    }
+
+    if (id == MKV_ID_SIMPLE_BLOCK || id == MKV_ID_BLOCK) {
+      bench_client_frame(client, size, NULL);
+    }
+
+    if (bench_client_read(client, NULL, size) < 0)
+      break;
+  }
+
+  return 0;
+}
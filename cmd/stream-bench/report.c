@@ -0,0 +1,140 @@
+#include "stream-bench.h"
+#include "util/opts/log.h"
+
+#include <inttypes.h>
+
+void bench_stats_add(bench_stats_t *total, bench_stats_t *stats)
+{
+  total->frames += stats->frames;
+  total->frame_bytes += stats->frame_bytes;
+  total->bytes += stats->bytes;
+  total->missed += stats->missed;
+  total->requests += stats->requests;
+  total->errors += stats->errors;
+
+  for (int i = 0; i < BENCH_GAP_BUCKETS; i++) {
+    total->gaps[i] += stats->gaps[i];
+  }
+  for (int i = 0; i <= BENCH_LATENCY_MAX_MS; i++) {
+    total->latency_ms[i] += stats->latency_ms[i];
+  }
+  total->latency_samples += stats->latency_samples;
+}
+
+unsigned bench_stats_latency_percentile_ms(bench_stats_t *stats, float percentile)
+{
+  unsigned target = stats->latency_samples * percentile;
+  unsigned count = 0;
+
+  if (!stats->latency_samples) {
+    return 0;
+  }
+
+  for (unsigned latency_ms = 0; latency_ms < BENCH_LATENCY_MAX_MS; latency_ms++) {
+    count += stats->latency_ms[latency_ms];
+    if (count > target) {
+      return latency_ms;
+    }
+  }
+
+  return BENCH_LATENCY_MAX_MS;
+}
+
+static const char *bench_gap_bucket_name(int bucket, char *buf, size_t size)
+{
+  if (bucket == BENCH_GAP_BUCKETS - 1) {
+    snprintf(buf, size, ">=%u", bench_gap_buckets_ms[bucket - 1]);
+  } else {
+    snprintf(buf, size, "<%u", bench_gap_buckets_ms[bucket]);
+  }
+  return buf;
+}
+
+static void bench_report_stats_text(FILE *stream, const char *name, bench_stats_t *stats, float elapsed_s)
+{
+  char bucket_name[16];
+
+  fprintf(stream, "%-10s %8.1f fps %10.1f kB/s %6" PRIu64 " frames %5" PRIu64 " missed %4" PRIu64 " errors",
+    name,
+    stats->frames / elapsed_s,
+    stats->bytes / elapsed_s / 1024.0f,
+    stats->frames,
+    stats->missed,
+    stats->errors);
+
+  if (stats->latency_samples) {
+    fprintf(stream, "  latency p50=%ums p99=%ums",
+      bench_stats_latency_percentile_ms(stats, 0.50f),
+      bench_stats_latency_percentile_ms(stats, 0.99f));
+  }
+
+  fprintf(stream, "  gaps");
+  for (int i = 0; i < BENCH_GAP_BUCKETS; i++) {
+    if (stats->gaps[i]) {
+      fprintf(stream, " %sms:%u", bench_gap_bucket_name(i, bucket_name, sizeof(bucket_name)), stats->gaps[i]);
+    }
+  }
+  fprintf(stream, "\n");
+}
+
+void bench_report_text(FILE *stream, bench_client_t *clients, unsigned n, uint64_t elapsed_us)
+{
+  bench_stats_t total = {0};
+  float elapsed_s = elapsed_us / 1000000.0f;
+
+  for (unsigned i = 0; i < n; i++) {
+    bench_report_stats_text(stream, clients[i].name, &clients[i].stats, elapsed_s);
+    bench_stats_add(&total, &clients[i].stats);
+
+    if (clients[i].error[0]) {
+      fprintf(stream, "%-10s last error: %s\n", "", clients[i].error);
+    }
+  }
+
+  bench_report_stats_text(stream, "total", &total, elapsed_s);
+}
+
+static void bench_report_stats_json(FILE *stream, bench_stats_t *stats, float elapsed_s)
+{
+  char bucket_name[16];
+
+  fprintf(stream, "{\"frames\":%" PRIu64 ",\"fps\":%.2f,\"bytes\":%" PRIu64 ",\"bytes_per_s\":%.0f,"
+    "\"avg_frame_bytes\":%" PRIu64 ",\"missed\":%" PRIu64 ",\"requests\":%" PRIu64 ",\"errors\":%" PRIu64,
+    stats->frames,
+    stats->frames / elapsed_s,
+    stats->bytes,
+    stats->bytes / elapsed_s,
+    stats->frames ? stats->frame_bytes / stats->frames : 0,
+    stats->missed,
+    stats->requests,
+    stats->errors);
+
+  if (stats->latency_samples) {
+    fprintf(stream, ",\"latency_p50_ms\":%u,\"latency_p99_ms\":%u",
+      bench_stats_latency_percentile_ms(stats, 0.50f),
+      bench_stats_latency_percentile_ms(stats, 0.99f));
+  }
+
+  fprintf(stream, ",\"gaps_ms\":{");
+  for (int i = 0; i < BENCH_GAP_BUCKETS; i++) {
+    fprintf(stream, "%s\"%s\":%u", i ? "," : "",
+      bench_gap_bucket_name(i, bucket_name, sizeof(bucket_name)), stats->gaps[i]);
+  }
+  fprintf(stream, "}}");
+}
+
+void bench_report_json(FILE *stream, bench_client_t *clients, unsigned n, uint64_t elapsed_us)
+{
+  bench_stats_t total = {0};
+  float elapsed_s = elapsed_us / 1000000.0f;
+
+  fprintf(stream, "{\"duration_s\":%.3f,\"clients\":[", elapsed_s);
+  for (unsigned i = 0; i < n; i++) {
+    fprintf(stream, "%s", i ? "," : "");
+    bench_report_stats_json(stream, &clients[i].stats, elapsed_s);
+    bench_stats_add(&total, &clients[i].stats);
+  }
+  fprintf(stream, "],\"total\":");
+  bench_report_stats_json(stream, &total, elapsed_s);
+  fprintf(stream, "}\n");
+}
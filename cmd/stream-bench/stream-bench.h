@@ -0,0 +1,96 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <pthread.h>
+
+#define BENCH_READ_BUFFER (64 * 1024)
+#define BENCH_LINE_LENGTH 1024
+#define BENCH_LATENCY_MAX_MS 1000
+#define BENCH_GAP_BUCKETS 10
+
+typedef struct bench_options_s {
+  char url[256];
+  unsigned clients;
+  unsigned duration;
+  unsigned snapshot_interval_ms;
+  bool json;
+} bench_options_t;
+
+typedef struct bench_url_s {
+  char host[128];
+  char port[16];
+  char path[256];
+} bench_url_t;
+
+typedef enum {
+  BENCH_FORMAT_NONE = 0,
+  BENCH_FORMAT_MULTIPART,
+  BENCH_FORMAT_SNAPSHOT,
+  BENCH_FORMAT_H264,
+  BENCH_FORMAT_MP4,
+  BENCH_FORMAT_MKV
+} bench_format_t;
+
+typedef struct bench_headers_s {
+  int status;
+  char content_type[128];
+  long content_length;
+  uint64_t timestamp_us; // X-Timestamp, realtime clock
+  int64_t seq; // X-Frame-Seq
+} bench_headers_t;
+
+typedef struct bench_stats_s {
+  uint64_t frames;
+  uint64_t frame_bytes;
+  uint64_t bytes;
+  uint64_t missed;
+  uint64_t requests;
+  uint64_t errors;
+  uint64_t first_frame_us;
+  uint64_t last_frame_us;
+  unsigned gaps[BENCH_GAP_BUCKETS];
+  unsigned latency_ms[BENCH_LATENCY_MAX_MS + 1];
+  unsigned latency_samples;
+} bench_stats_t;
+
+typedef struct bench_client_s {
+  const char *name;
+  char name_buf[32];
+  bench_url_t *url;
+  bench_options_t *options;
+  pthread_t thread;
+
+  int fd;
+  bench_format_t format;
+  uint64_t start_us;
+  uint64_t deadline_us;
+  int64_t last_seq;
+
+  uint8_t buf[BENCH_READ_BUFFER];
+  unsigned buf_start, buf_end;
+
+  bench_stats_t stats;
+  char error[128];
+} bench_client_t;
+
+extern const unsigned bench_gap_buckets_ms[BENCH_GAP_BUCKETS];
+
+// client.c
+int bench_url_parse(bench_url_t *url, const char *str);
+void *bench_client_thread(void *opaque);
+int bench_client_fill(bench_client_t *client);
+int bench_client_read(bench_client_t *client, void *data, unsigned size);
+void bench_client_frame(bench_client_t *client, uint64_t size, bench_headers_t *headers);
+
+// parsers.c
+int bench_parse_h264(bench_client_t *client);
+int bench_parse_mp4(bench_client_t *client);
+int bench_parse_mkv(bench_client_t *client);
+
+// report.c
+void bench_stats_add(bench_stats_t *total, bench_stats_t *stats);
+unsigned bench_stats_latency_percentile_ms(bench_stats_t *stats, float percentile);
+void bench_report_text(FILE *stream, bench_client_t *clients, unsigned n, uint64_t elapsed_us);
+void bench_report_json(FILE *stream, bench_client_t *clients, unsigned n, uint64_t elapsed_us);
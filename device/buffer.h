@@ -7,6 +7,15 @@
 typedef struct buffer_s buffer_t;
 typedef struct buffer_list_s buffer_list_t;
 
+#define BUFFER_MAX_NALS 128
+
+// The NAL of the H264 frame, after the start code
+typedef struct buffer_nal_s {
+  uint32_t offset;
+  uint32_t size;
+  uint8_t type;
+} buffer_nal_t;
+
 typedef struct buffer_s {
   char *name;
   struct buffer_list_s *buf_list;
@@ -22,6 +31,7 @@ typedef struct buffer_s {
     bool is_keyed : 1;
     bool is_keyframe : 1;
     bool is_last : 1;
+    bool needs_h264_params : 1; // the IDR without the SPS/PPS
   } flags;
 
   union {
@@ -35,6 +45,11 @@ typedef struct buffer_s {
   buffer_t *dma_source;
   bool enqueued;
   uint64_t enqueue_time_us, captured_time_us;
+  unsigned frame_seq;
+
+  // indexed on dequeue, see `buffer_h264_nals`
+  buffer_nal_t nals[BUFFER_MAX_NALS];
+  int n_nals;
 } buffer_t;
 
 buffer_t *buffer_open(const char *name, buffer_list_t *buf_list, int buffer);
@@ -0,0 +1,186 @@
+#include "device/buffer_copy.h"
+#include "device/buffer.h"
+#include "util/opts/log.h"
+
+#include <pthread.h>
+#include <sys/ioctl.h>
+#include <linux/dma-buf.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// smaller frames are not worth waking up the threads
+#define BUFFER_COPY_MIN_CHUNK (256 * 1024)
+#define BUFFER_COPY_ALIGN 64
+
+typedef struct buffer_copy_chunk_s {
+  uint8_t *dst;
+  const uint8_t *src;
+  size_t size;
+} buffer_copy_chunk_t;
+
+static struct {
+  pthread_mutex_t busy; // a single frame at a time, other cameras copy inline
+  pthread_mutex_t lock;
+  pthread_cond_t start_cond, done_cond;
+  pthread_t threads[BUFFER_COPY_MAX_THREADS];
+  unsigned nthreads;
+  unsigned generation;
+  unsigned pending;
+  buffer_copy_chunk_t chunks[BUFFER_COPY_MAX_THREADS];
+} buffer_copy_pool = {
+  .busy = PTHREAD_MUTEX_INITIALIZER,
+  .lock = PTHREAD_MUTEX_INITIALIZER,
+  .start_cond = PTHREAD_COND_INITIALIZER,
+  .done_cond = PTHREAD_COND_INITIALIZER,
+};
+
+// The destination is consumed by the device, not by CPU,
+// so the non-temporal stores do not pollute the cache.
+static void buffer_copy_stream(uint8_t *dst, const uint8_t *src, size_t size)
+{
+#if defined(__SSE2__)
+  size_t head = (16 - ((uintptr_t)dst & 15)) & 15;
+
+  if (size < head + BUFFER_COPY_ALIGN) {
+    memcpy(dst, src, size);
+    return;
+  }
+
+  memcpy(dst, src, head);
+  dst += head;
+  src += head;
+  size -= head;
+
+  for ( ; size >= BUFFER_COPY_ALIGN; size -= BUFFER_COPY_ALIGN) {
+    __m128i a = _mm_loadu_si128((const __m128i *)src + 0);
+    __m128i b = _mm_loadu_si128((const __m128i *)src + 1);
+    __m128i c = _mm_loadu_si128((const __m128i *)src + 2);
+    __m128i d = _mm_loadu_si128((const __m128i *)src + 3);
+    _mm_stream_si128((__m128i *)dst + 0, a);
+    _mm_stream_si128((__m128i *)dst + 1, b);
+    _mm_stream_si128((__m128i *)dst + 2, c);
+    _mm_stream_si128((__m128i *)dst + 3, d);
+    dst += BUFFER_COPY_ALIGN;
+    src += BUFFER_COPY_ALIGN;
+  }
+
+  _mm_sfence();
+#endif
+
+  memcpy(dst, src, size);
+}
+
+static void *buffer_copy_thread(void *opaque)
+{
+  unsigned index = (uintptr_t)opaque;
+  unsigned generation = 0;
+
+  pthread_mutex_lock(&buffer_copy_pool.lock);
+
+  while (true) {
+    while (buffer_copy_pool.generation == generation) {
+      pthread_cond_wait(&buffer_copy_pool.start_cond, &buffer_copy_pool.lock);
+    }
+    generation = buffer_copy_pool.generation;
+
+    buffer_copy_chunk_t chunk = buffer_copy_pool.chunks[index];
+    pthread_mutex_unlock(&buffer_copy_pool.lock);
+
+    if (chunk.size > 0) {
+      buffer_copy_stream(chunk.dst, chunk.src, chunk.size);
+    }
+
+    pthread_mutex_lock(&buffer_copy_pool.lock);
+    if (--buffer_copy_pool.pending == 0) {
+      pthread_cond_signal(&buffer_copy_pool.done_cond);
+    }
+  }
+
+  return NULL;
+}
+
+void buffer_copy_set_threads(unsigned nthreads)
+{
+  if (!nthreads) {
+    nthreads = sysconf(_SC_NPROCESSORS_ONLN);
+  }
+  nthreads = MIN(MAX(nthreads, 1), BUFFER_COPY_MAX_THREADS);
+
+  // the calling thread copies the first chunk
+  for (unsigned i = buffer_copy_pool.nthreads + 1; i < nthreads; i++) {
+    if (pthread_create(&buffer_copy_pool.threads[i], NULL, buffer_copy_thread, (void *)(uintptr_t)i) != 0) {
+      LOG_INFO(NULL, "Cannot start the copy thread %u.", i);
+      break;
+    }
+    pthread_detach(buffer_copy_pool.threads[i]);
+    buffer_copy_pool.nthreads = i;
+  }
+
+  LOG_VERBOSE(NULL, "Using %u thread(s) to copy the frames.", buffer_copy_pool.nthreads + 1);
+}
+
+static void buffer_copy_parallel(uint8_t *dst, const uint8_t *src, size_t size)
+{
+  unsigned nchunks = MIN(buffer_copy_pool.nthreads + 1, size / BUFFER_COPY_MIN_CHUNK);
+
+  if (nchunks <= 1 || pthread_mutex_trylock(&buffer_copy_pool.busy) != 0) {
+    buffer_copy_stream(dst, src, size);
+    return;
+  }
+
+  // split at the cache line boundaries
+  size_t chunk_size = (size / nchunks) & ~(size_t)(BUFFER_COPY_ALIGN - 1);
+
+  pthread_mutex_lock(&buffer_copy_pool.lock);
+  for (unsigned i = 1; i < nchunks; i++) {
+    buffer_copy_pool.chunks[i] = (buffer_copy_chunk_t){
+      .dst = dst + i * chunk_size,
+      .src = src + i * chunk_size,
+      .size = i == nchunks - 1 ? size - i * chunk_size : chunk_size
+    };
+  }
+  // the threads without the chunk copy nothing
+  for (unsigned i = nchunks; i <= buffer_copy_pool.nthreads; i++) {
+    buffer_copy_pool.chunks[i] = (buffer_copy_chunk_t){0};
+  }
+  buffer_copy_pool.pending = buffer_copy_pool.nthreads;
+  buffer_copy_pool.generation++;
+  pthread_cond_broadcast(&buffer_copy_pool.start_cond);
+  pthread_mutex_unlock(&buffer_copy_pool.lock);
+
+  buffer_copy_stream(dst, src, chunk_size);
+
+  pthread_mutex_lock(&buffer_copy_pool.lock);
+  while (buffer_copy_pool.pending > 0) {
+    pthread_cond_wait(&buffer_copy_pool.done_cond, &buffer_copy_pool.lock);
+  }
+  pthread_mutex_unlock(&buffer_copy_pool.lock);
+
+  pthread_mutex_unlock(&buffer_copy_pool.busy);
+}
+
+static void buffer_copy_sync(buffer_t *buf, uint64_t flags)
+{
+  struct dma_buf_sync sync = { .flags = flags };
+
+  if (buf->dma_fd < 0)
+    return;
+
+  if (ioctl(buf->dma_fd, DMA_BUF_IOCTL_SYNC, &sync) < 0) {
+    LOG_DEBUG(buf, "Cannot sync dma_fd=%d: %s", buf->dma_fd, strerror(errno));
+  }
+}
+
+// Copies the `src` into the mmap `dst`, keeping the CPU caches coherent with the devices
+void buffer_copy(buffer_t *dst, buffer_t *src, size_t size)
+{
+  buffer_copy_sync(src, DMA_BUF_SYNC_START | DMA_BUF_SYNC_READ);
+  buffer_copy_sync(dst, DMA_BUF_SYNC_START | DMA_BUF_SYNC_WRITE);
+
+  buffer_copy_parallel(dst->start, src->start, size);
+
+  buffer_copy_sync(dst, DMA_BUF_SYNC_END | DMA_BUF_SYNC_WRITE);
+  buffer_copy_sync(src, DMA_BUF_SYNC_END | DMA_BUF_SYNC_READ);
+}
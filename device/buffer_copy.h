@@ -0,0 +1,10 @@
+#pragma once
+
+#include <stddef.h>
+
+typedef struct buffer_s buffer_t;
+
+#define BUFFER_COPY_MAX_THREADS 4
+
+void buffer_copy_set_threads(unsigned nthreads);
+void buffer_copy(buffer_t *dst, buffer_t *src, size_t size);
@@ -0,0 +1,79 @@
+#include "device/buffer_h264.h"
+#include "device/buffer_list.h"
+#include "util/opts/log.h"
+
+_Static_assert(BUFFER_MAX_NALS + 2 <= MUX_H264_MAX_NALS, "no room for the re-inserted SPS/PPS");
+
+// Indexes the NALs of the dequeued frame once for all outputs,
+// and remembers the parameter sets for the IDRs sent without them
+void buffer_h264_index(buffer_t *buf)
+{
+  buffer_list_t *buf_list = buf->buf_list;
+  mux_h264_nal_t nals[BUFFER_MAX_NALS];
+  bool has_idr = false, has_sps = false;
+
+  int n_nals = mux_h264_split(buf->start, buf->used, nals, BUFFER_MAX_NALS);
+  bool overflow = n_nals > BUFFER_MAX_NALS;
+
+  // a truncated frame would not decode, so only the Annex-B outputs get it
+  if (overflow) {
+    if (!buf_list->h264_nals_overflow) {
+      LOG_INFO(buf, "The frame has %d NALs, over %d: it is skipped by the muxers.", n_nals, BUFFER_MAX_NALS);
+      buf_list->h264_nals_overflow = true;
+    }
+    n_nals = BUFFER_MAX_NALS;
+  }
+
+  for (int i = 0; i < n_nals; i++) {
+    buf->nals[i] = (buffer_nal_t){
+      .offset = nals[i].data - (uint8_t*)buf->start,
+      .size = nals[i].size,
+      .type = nals[i].type,
+    };
+
+    has_idr |= nals[i].type == MUX_H264_NAL_IDR;
+    has_sps |= nals[i].type == MUX_H264_NAL_SPS;
+  }
+  buf->n_nals = overflow ? 0 : n_nals;
+
+  if (has_sps && mux_h264_params(&buf_list->h264_params, nals, n_nals)) {
+    buf_list->has_h264_params = true;
+  }
+
+  if (buf->flags.is_keyframe) {
+    LOG_DEBUG(buf, "Got key frame (from V4L2)!: nals=%d", n_nals);
+  } else if (has_idr || has_sps) {
+    LOG_DEBUG(buf, "Got key frame (from buffer)!: nals=%d", n_nals);
+    buf->flags.is_keyframe = true;
+  }
+
+  buf->flags.needs_h264_params = has_idr && !has_sps && buf_list->has_h264_params;
+}
+
+// Returns the NALs of the indexed frame, starting with the cached
+// parameter sets when the frame is an IDR without them,
+// or 0 when the frame could not be indexed
+int buffer_h264_nals(buffer_t *buf, mux_h264_nal_t *nals, int max_nals)
+{
+  mux_h264_params_t *params = &buf->buf_list->h264_params;
+  int n_nals = 0;
+
+  if (!buf->n_nals) {
+    return 0;
+  }
+
+  if (buf->flags.needs_h264_params && max_nals >= 2) {
+    nals[n_nals++] = (mux_h264_nal_t){ params->sps, params->sps_size, MUX_H264_NAL_SPS };
+    nals[n_nals++] = (mux_h264_nal_t){ params->pps, params->pps_size, MUX_H264_NAL_PPS };
+  }
+
+  for (int i = 0; i < buf->n_nals && n_nals < max_nals; i++) {
+    nals[n_nals++] = (mux_h264_nal_t){
+      (uint8_t*)buf->start + buf->nals[i].offset,
+      buf->nals[i].size,
+      buf->nals[i].type
+    };
+  }
+
+  return n_nals;
+}
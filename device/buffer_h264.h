@@ -0,0 +1,7 @@
+#pragma once
+
+#include "device/buffer.h"
+#include "util/mux/mux.h"
+
+void buffer_h264_index(buffer_t *buf);
+int buffer_h264_nals(buffer_t *buf, mux_h264_nal_t *nals, int max_nals);
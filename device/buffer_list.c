@@ -125,6 +125,8 @@ void buffer_list_close(buffer_list_t *buf_list)
   buffer_list_free_buffers(buf_list);
 
   buf_list->dev->hw->buffer_list_close(buf_list);
+  free(buf_list->unchanged.reference);
+  free(buf_list->unchanged.current);
   free(buf_list->name);
   free(buf_list);
 }
@@ -146,6 +148,7 @@ int buffer_list_set_stream(buffer_list_t *buf_list, bool do_on)
 
   if (do_on) {
     buf_list->last_enqueued_us = get_monotonic_time_us(NULL, NULL);
+    buf_list->stream_start_us = buf_list->last_enqueued_us;
   } else {
     buffer_list_clear_queue(buf_list);
   }
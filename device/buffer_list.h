@@ -3,6 +3,8 @@
 #include <stdbool.h>
 #include <stdint.h>
 
+#include "util/mux/mux.h"
+
 typedef struct buffer_s buffer_t;
 typedef struct device_s device_t;
 struct pollfd;
@@ -29,6 +31,9 @@ typedef struct buffer_stats_s {
   uint64_t max_dequeued_us;
   float avg_dequeued_us;
   float stddev_dequeued_us;
+
+  uint64_t copied_bytes, dma_bytes; // enqueued by `memcpy` or shared by DMA
+  uint64_t copy_time_us;
 } buffer_stats_t;
 
 #define MAX_BUFFER_QUEUE 4
@@ -54,9 +59,25 @@ typedef struct buffer_list_s {
   int n_queued_bufs;
 
   uint64_t last_enqueued_us, last_dequeued_us;
+  uint64_t stream_start_us; // cleared on the first frame
   int last_capture_time_us, last_in_queue_time_us;
   bool streaming;
+  int readers; // keep the device open without holding the buffers, see `buffer_list_use()`
   buffer_stats_t stats, stats_last;
+
+  // the last parameter sets of the H264 stream
+  mux_h264_params_t h264_params;
+  bool has_h264_params;
+  bool h264_nals_overflow; // logged once
+
+  // the output skips the frames equal to the last queued one,
+  // but queues one at least every `keepalive_ms`
+  struct {
+    unsigned keepalive_ms;
+    uint64_t queued_us;
+    struct buffer_luma_s *reference, *current;
+    unsigned skipped;
+  } unchanged;
 } buffer_list_t;
 
 buffer_list_t *buffer_list_open(const char *name, int index, struct device_s *dev, const char *path, buffer_format_t fmt, bool do_capture, bool do_mmap);
@@ -74,3 +95,5 @@ int buffer_list_enqueue(buffer_list_t *buf_list, buffer_t *dma_buf);
 void buffer_list_clear_queue(buffer_list_t *buf_list);
 bool buffer_list_push_to_queue(buffer_list_t *buf_list, buffer_t *dma_buf, int max_bufs);
 buffer_t *buffer_list_pop_from_queue(buffer_list_t *buf_list);
+void buffer_list_use(buffer_list_t *buf_list);
+void buffer_list_consumed(buffer_list_t *buf_list, const char *who);
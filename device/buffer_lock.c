@@ -3,6 +3,17 @@
 #include "device/buffer.h"
 #include "util/opts/log.h"
 
+// Runtime equivalent of `DEFINE_BUFFER_LOCK()`
+void buffer_lock_init(buffer_lock_t *buf_lock, const char *name, int timeout_ms)
+{
+  *buf_lock = (buffer_lock_t){
+    .name = name,
+    .timeout_us = MAX(timeout_ms, DEFAULT_BUFFER_LOCK_TIMEOUT) * 1000LL,
+  };
+  pthread_mutex_init(&buf_lock->lock, NULL);
+  pthread_cond_init(&buf_lock->cond_wait, NULL);
+}
+
 bool buffer_lock_is_used(buffer_lock_t *buf_lock)
 {
   int refs = 0;
@@ -42,8 +53,60 @@ bool buffer_lock_needs_buffer(buffer_lock_t *buf_lock)
   return needs_buffer;
 }
 
+static void buffer_lock_release_frame(buffer_lock_frame_t *frame)
+{
+  if (frame && --frame->refs == 0) {
+    free(frame);
+  }
+}
+
+static void buffer_lock_clear_gop(buffer_lock_t *buf_lock)
+{
+  for (int i = 0; i < buf_lock->n_gop; i++) {
+    buffer_lock_release_frame(buf_lock->gop[i]);
+    buf_lock->gop[i] = NULL;
+  }
+  buf_lock->n_gop = 0;
+  buf_lock->gop_bytes = 0;
+}
+
+static void buffer_lock_cache_frame(buffer_lock_t *buf_lock, buffer_t *buf)
+{
+  if (buf->flags.is_keyframe) {
+    buffer_lock_clear_gop(buf_lock);
+  } else if (!buf_lock->n_gop) {
+    return;
+  }
+
+  if (buf_lock->n_gop >= BUFFER_LOCK_GOP_MAX_FRAMES || buf_lock->gop_bytes + buf->used > BUFFER_LOCK_GOP_MAX_BYTES) {
+    LOG_DEBUG(buf_lock, "The GOP is too long: frames=%d, bytes=%zu", buf_lock->n_gop, buf_lock->gop_bytes);
+    buffer_lock_clear_gop(buf_lock);
+    return;
+  }
+
+  buffer_lock_frame_t *frame = malloc(sizeof(buffer_lock_frame_t) + buf->used);
+  if (!frame) {
+    buffer_lock_clear_gop(buf_lock);
+    return;
+  }
+
+  frame->refs = 1;
+  frame->counter = buf_lock->counter;
+  frame->frame_seq = buf->frame_seq;
+  frame->captured_time_us = buf->captured_time_us;
+  frame->needs_h264_params = buf->flags.needs_h264_params;
+  memcpy(frame->nals, buf->nals, sizeof(frame->nals));
+  frame->n_nals = buf->n_nals;
+  frame->used = buf->used;
+  memcpy(frame->data, buf->start, buf->used);
+
+  buf_lock->gop[buf_lock->n_gop++] = frame;
+  buf_lock->gop_bytes += buf->used;
+}
+
 static void buffer_lock_clear_buffers(buffer_lock_t *buf_lock, uint64_t now)
 {
+  buffer_lock_clear_gop(buf_lock);
   buffer_consumed(buf_lock->buf, buf_lock->name);
   buf_lock->buf = NULL;
   buf_lock->buf_time_us = now;
@@ -57,6 +120,10 @@ static void buffer_lock_set_buffer(buffer_lock_t *buf_lock, buffer_t *buf, uint6
   buf_lock->buf_time_us = now;
   buf_lock->counter++;
 
+  if (buf_lock->gop_cache) {
+    buffer_lock_cache_frame(buf_lock, buf);
+  }
+
   LOG_DEBUG(buf_lock, "Captured buffer %s (refs=%d), frame=%d/%d, processing_ms=%.1f, frame_ms=%.1f",
     dev_name(buf), buf ? buf->mmap_reflinks : 0,
     buf_lock->counter, buf_lock->dropped,
@@ -122,6 +189,98 @@ ret:
   return buf;
 }
 
+static void buffer_lock_record_latency(buffer_lock_t *buf_lock, buffer_t *buf)
+{
+  uint64_t latency_us = get_monotonic_time_us(NULL, NULL) - buf->captured_time_us;
+
+  pthread_mutex_lock(&buf_lock->lock);
+  buf_lock->latency_ms[MIN(latency_us / 1000, BUFFER_LOCK_LATENCY_MAX_MS)]++;
+  buf_lock->latency_samples++;
+  buf_lock->latency_max_us = MAX(buf_lock->latency_max_us, latency_us);
+  pthread_mutex_unlock(&buf_lock->lock);
+}
+
+unsigned buffer_lock_latency_percentile_ms(buffer_lock_t *buf_lock, float percentile)
+{
+  unsigned latency_ms = 0;
+  unsigned count = 0;
+
+  pthread_mutex_lock(&buf_lock->lock);
+  unsigned target = buf_lock->latency_samples * percentile;
+  for (latency_ms = 0; buf_lock->latency_samples && latency_ms < BUFFER_LOCK_LATENCY_MAX_MS; latency_ms++) {
+    count += buf_lock->latency_ms[latency_ms];
+    if (count > target) {
+      break;
+    }
+  }
+  pthread_mutex_unlock(&buf_lock->lock);
+
+  return latency_ms;
+}
+
+// Writes the cached frames since the last key frame, so the reader starts
+// without waiting for (or forcing) the next one
+static int buffer_lock_write_gop(buffer_lock_t *buf_lock, int *counter, int *frames, buffer_write_fn fn, void *data)
+{
+  buffer_lock_frame_t *gop[BUFFER_LOCK_GOP_MAX_FRAMES];
+  buffer_list_t *buf_list;
+  int n_gop = 0;
+  int ret = 0;
+
+  // the replayed frames read the list, kept open if the output is closed meanwhile
+  pthread_mutex_lock(&buf_lock->lock);
+  buf_list = buf_lock->buf_list;
+  if (buf_list) {
+    buffer_list_use(buf_list);
+    for (n_gop = 0; n_gop < buf_lock->n_gop; n_gop++) {
+      gop[n_gop] = buf_lock->gop[n_gop];
+      gop[n_gop]->refs++;
+    }
+  }
+  pthread_mutex_unlock(&buf_lock->lock);
+
+  for (int i = 0; i < n_gop; i++) {
+    buffer_t buf = {
+      .name = "gop",
+      .buf_list = buf_list,
+      .start = gop[i]->data,
+      .used = gop[i]->used,
+      .length = gop[i]->used,
+      .dma_fd = -1,
+      .flags.is_keyframe = i == 0,
+      .flags.needs_h264_params = gop[i]->needs_h264_params,
+      .captured_time_us = gop[i]->captured_time_us,
+      .frame_seq = gop[i]->frame_seq,
+      .n_nals = gop[i]->n_nals,
+    };
+    memcpy(buf.nals, gop[i]->nals, sizeof(buf.nals));
+
+    ret = fn(buf_lock, &buf, *frames, data);
+    *counter = gop[i]->counter;
+
+    if (ret < 0) {
+      break;
+    } else if (ret > 0) {
+      (*frames)++;
+    }
+  }
+
+  pthread_mutex_lock(&buf_lock->lock);
+  for (int i = 0; i < n_gop; i++) {
+    buffer_lock_release_frame(gop[i]);
+  }
+  pthread_mutex_unlock(&buf_lock->lock);
+
+  if (buf_list) {
+    buffer_list_consumed(buf_list, "gop");
+  }
+
+  if (n_gop > 0) {
+    LOG_DEBUG(buf_lock, "Replayed %d cached frames.", n_gop);
+  }
+  return ret < 0 ? -1 : 0;
+}
+
 int buffer_lock_write_loop(buffer_lock_t *buf_lock, int nframes, unsigned timeout_ms, buffer_write_fn fn, void *data)
 {
   int counter = 0;
@@ -131,6 +290,12 @@ int buffer_lock_write_loop(buffer_lock_t *buf_lock, int nframes, unsigned timeou
 
   buffer_lock_use(buf_lock, 1);
 
+  if (buf_lock->gop_cache && nframes == 0) {
+    if (buffer_lock_write_gop(buf_lock, &counter, &frames, fn, data) < 0) {
+      goto error;
+    }
+  }
+
   while (nframes == 0 || frames < nframes) {
     if (timeout_ms && frame_stop_ms < get_monotonic_time_us(NULL, NULL)) {
       break;
@@ -142,6 +307,9 @@ int buffer_lock_write_loop(buffer_lock_t *buf_lock, int nframes, unsigned timeou
     }
 
     int ret = fn(buf_lock, buf, frames, data);
+    if (ret > 0) {
+      buffer_lock_record_latency(buf_lock, buf);
+    }
     buffer_consumed(buf, "write-loop");
 
     if (ret > 0) {
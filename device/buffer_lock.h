@@ -4,7 +4,8 @@
 #include <stdint.h>
 #include <pthread.h>
 
-typedef struct buffer_s buffer_t;
+#include "device/buffer.h"
+
 typedef struct buffer_list_s buffer_list_t;
 typedef struct buffer_lock_s buffer_lock_t;
 
@@ -12,6 +13,22 @@ typedef bool (*buffer_lock_check_streaming)(buffer_lock_t *buf_lock);
 typedef void (*buffer_lock_notify_buffer)(buffer_lock_t *buf_lock, buffer_t *buf);
 
 #define BUFFER_LOCK_MAX_CALLBACKS 10
+#define BUFFER_LOCK_LATENCY_MAX_MS 1000
+#define BUFFER_LOCK_GOP_MAX_FRAMES 150
+#define BUFFER_LOCK_GOP_MAX_BYTES (8 * 1024 * 1024)
+
+// A copy of the captured frame, shared by the readers
+typedef struct buffer_lock_frame_s {
+  int refs;
+  int counter;
+  unsigned frame_seq;
+  uint64_t captured_time_us;
+  bool needs_h264_params;
+  buffer_nal_t nals[BUFFER_MAX_NALS];
+  int n_nals;
+  size_t used;
+  char data[];
+} buffer_lock_frame_t;
 
 typedef struct buffer_lock_s {
   const char *name;
@@ -30,28 +47,44 @@ typedef struct buffer_lock_s {
   int dropped;
   uint64_t timeout_us;
 
+  // capture-to-send latency of written frames, in 1ms buckets
+  unsigned latency_ms[BUFFER_LOCK_LATENCY_MAX_MS + 1];
+  unsigned latency_samples;
+  uint64_t latency_max_us;
+
   int frame_interval_ms;
+
+  // the frames since the last key frame, replayed to the new readers
+  bool gop_cache;
+  buffer_lock_frame_t *gop[BUFFER_LOCK_GOP_MAX_FRAMES];
+  int n_gop;
+  size_t gop_bytes;
 } buffer_lock_t;
 
 #define DEFAULT_BUFFER_LOCK_TIMEOUT 16 // ~60fps
 #define DEFAULT_BUFFER_LOCK_GET_TIMEOUT 3000 // 3s
 
-#define DEFINE_BUFFER_LOCK(_name, _timeout_ms) buffer_lock_t _name = { \
+#define DEFINE_BUFFER_LOCK(_name, _timeout_ms) DEFINE_BUFFER_LOCK2(_name, _timeout_ms, false)
+
+#define DEFINE_BUFFER_LOCK2(_name, _timeout_ms, _gop_cache) buffer_lock_t _name = { \
     .name = #_name, \
     .lock = PTHREAD_MUTEX_INITIALIZER, \
     .cond_wait = PTHREAD_COND_INITIALIZER, \
     .timeout_us = (_timeout_ms > DEFAULT_BUFFER_LOCK_TIMEOUT ? _timeout_ms : DEFAULT_BUFFER_LOCK_TIMEOUT) * 1000LL, \
+    .gop_cache = _gop_cache, \
   };
 
 #define DECLARE_BUFFER_LOCK(_name) extern buffer_lock_t _name;
 
 typedef int (*buffer_write_fn)(buffer_lock_t *buf_lock, buffer_t *buf, int frame, void *data);
 
+void buffer_lock_init(buffer_lock_t *buf_lock, const char *name, int timeout_ms);
 void buffer_lock_capture(buffer_lock_t *buf_lock, buffer_t *buf);
 buffer_t *buffer_lock_get(buffer_lock_t *buf_lock, int timeout_ms, int *counter);
 bool buffer_lock_needs_buffer(buffer_lock_t *buf_lock);
 void buffer_lock_use(buffer_lock_t *buf_lock, int ref);
 bool buffer_lock_is_used(buffer_lock_t *buf_lock);
 int buffer_lock_write_loop(buffer_lock_t *buf_lock, int nframes, unsigned timeout_ms, buffer_write_fn fn, void *data);
+unsigned buffer_lock_latency_percentile_ms(buffer_lock_t *buf_lock, float percentile);
 bool buffer_lock_register_check_streaming(buffer_lock_t *buf_lock, buffer_lock_check_streaming check_streaming);
 bool buffer_lock_register_notify_buffer(buffer_lock_t *buf_lock, buffer_lock_notify_buffer notify_buffer);
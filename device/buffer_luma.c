@@ -0,0 +1,234 @@
+#include "device/buffer_luma.h"
+#include "device/buffer_list.h"
+#include "util/opts/log.h"
+
+#include <stdlib.h>
+#include <linux/videodev2.h>
+
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#define BUFFER_LUMA_GROUP_SIZE 8 // the pixels summed at once
+#define BUFFER_LUMA_MAX_GROUPS 256
+#define BUFFER_LUMA_SAMPLE_ROWS 2 // the rows sampled in each cell
+
+// Adds the luma of `n_groups` groups of 8 pixels into `sums`,
+// the `step` is 2 for the packed YUYV
+static void buffer_luma_sum_row(const uint8_t *row, int step, int n_groups, uint32_t *sums)
+{
+  int i = 0;
+
+#if defined(__ARM_NEON)
+  if (step == 1) {
+    for (; i < n_groups; i++) {
+      uint8x8_t luma = vld1_u8(row + i * 8);
+      sums[i] += vget_lane_u64(vpaddl_u32(vpaddl_u16(vpaddl_u8(luma))), 0);
+    }
+  } else {
+    for (; i < n_groups; i++) {
+      uint8x8x2_t yuyv = vld2_u8(row + i * 16);
+      sums[i] += vget_lane_u64(vpaddl_u32(vpaddl_u16(vpaddl_u8(yuyv.val[0]))), 0);
+    }
+  }
+#elif defined(__SSE2__)
+  const __m128i zero = _mm_setzero_si128();
+
+  if (step == 1) {
+    for (; i + 1 < n_groups; i += 2) {
+      __m128i sad = _mm_sad_epu8(_mm_loadu_si128((const __m128i*)(row + i * 8)), zero);
+      sums[i] += _mm_cvtsi128_si32(sad);
+      sums[i + 1] += _mm_extract_epi16(sad, 4);
+    }
+  } else {
+    const __m128i luma = _mm_set1_epi16(0x00FF);
+
+    for (; i < n_groups; i++) {
+      __m128i yuyv = _mm_loadu_si128((const __m128i*)(row + i * 16));
+      __m128i sad = _mm_sad_epu8(_mm_and_si128(yuyv, luma), zero);
+      sums[i] += _mm_cvtsi128_si32(sad) + _mm_extract_epi16(sad, 4);
+    }
+  }
+#endif
+
+  for (; i < n_groups; i++) {
+    for (int x = 0; x < BUFFER_LUMA_GROUP_SIZE; x++) {
+      sums[i] += row[(i * BUFFER_LUMA_GROUP_SIZE + x) * step];
+    }
+  }
+}
+
+// Marks the cells that changed over the `threshold` into the optional `changed`,
+// and returns their count
+static int buffer_luma_diff_cells(const uint8_t *current, const uint8_t *previous, int n_cells, uint8_t threshold, uint8_t *changed)
+{
+  int i = 0, count = 0;
+
+#if defined(__ARM_NEON)
+  const uint8x16_t limit = vdupq_n_u8(threshold);
+
+  for (; i + 16 <= n_cells; i += 16) {
+    uint8x16_t diff = vabdq_u8(vld1q_u8(current + i), vld1q_u8(previous + i));
+    uint8x16_t mask = vcgtq_u8(diff, limit);
+    if (changed) {
+      vst1q_u8(changed + i, mask);
+    }
+    uint64x2_t sum = vpaddlq_u32(vpaddlq_u16(vpaddlq_u8(vshrq_n_u8(mask, 7))));
+    count += vgetq_lane_u64(sum, 0) + vgetq_lane_u64(sum, 1);
+  }
+#elif defined(__SSE2__)
+  const __m128i limit = _mm_set1_epi8(threshold);
+  const __m128i zero = _mm_setzero_si128();
+
+  for (; i + 16 <= n_cells; i += 16) {
+    __m128i a = _mm_loadu_si128((const __m128i*)(current + i));
+    __m128i b = _mm_loadu_si128((const __m128i*)(previous + i));
+    __m128i diff = _mm_or_si128(_mm_subs_epu8(a, b), _mm_subs_epu8(b, a));
+    __m128i mask = _mm_xor_si128(_mm_cmpeq_epi8(_mm_subs_epu8(diff, limit), zero), _mm_set1_epi8(-1));
+    if (changed) {
+      _mm_storeu_si128((__m128i*)(changed + i), mask);
+    }
+    count += __builtin_popcount(_mm_movemask_epi8(mask));
+  }
+#endif
+
+  for (; i < n_cells; i++) {
+    bool cell_changed = abs(current[i] - previous[i]) > threshold;
+    if (changed) {
+      changed[i] = cell_changed ? 0xFF : 0;
+    }
+    count += cell_changed;
+  }
+
+  return count;
+}
+
+// Returns the distance of the luma pixels, or 0 for the unsupported formats
+static int buffer_luma_step(unsigned format)
+{
+  switch (format) {
+  case V4L2_PIX_FMT_YUYV:
+    return 2;
+
+  case V4L2_PIX_FMT_YUV420:
+  case V4L2_PIX_FMT_YVU420:
+  case V4L2_PIX_FMT_NV12:
+  case V4L2_PIX_FMT_NV21:
+  case V4L2_PIX_FMT_GREY:
+    return 1;
+
+  default:
+    return 0;
+  }
+}
+
+// Sets up the at most 80x80 cells of the `frame`, returns the `scale` in groups
+static int buffer_luma_cells(buffer_t *buf, unsigned stride, buffer_luma_t *frame)
+{
+  buffer_format_t *fmt = &buf->buf_list->fmt;
+  unsigned height = MIN(fmt->height, buf->used / stride);
+  int n_groups = fmt->width / BUFFER_LUMA_GROUP_SIZE;
+  int scale = MAX((n_groups + BUFFER_LUMA_MAX_CELLS_X - 1) / BUFFER_LUMA_MAX_CELLS_X, 1);
+
+  frame->width = fmt->width;
+  frame->height = fmt->height;
+  frame->cell_size = scale * BUFFER_LUMA_GROUP_SIZE;
+  frame->cells_x = n_groups / scale;
+  frame->cells_y = MIN(height / frame->cell_size, BUFFER_LUMA_MAX_CELLS_Y);
+  return scale;
+}
+
+// Downsamples the luma of the YUV buffer into at most 80x80 cells,
+// returns false for the unsupported formats
+bool buffer_luma_downsample(buffer_t *buf, buffer_luma_t *frame)
+{
+  buffer_format_t *fmt = &buf->buf_list->fmt;
+  uint32_t sums[BUFFER_LUMA_MAX_GROUPS];
+  uint32_t cell_sums[BUFFER_LUMA_MAX_CELLS_X];
+  int step = buffer_luma_step(fmt->format);
+
+  if (!step) {
+    return false;
+  }
+
+  unsigned stride = fmt->bytesperline ? fmt->bytesperline : fmt->width * step;
+  int scale = buffer_luma_cells(buf, stride, frame);
+
+  // the groups of the row are summed in chunks, then added to their cells
+  int used_groups = frame->cells_x * scale;
+
+  for (int cy = 0; cy < frame->cells_y; cy++) {
+    memset(cell_sums, 0, sizeof(cell_sums));
+
+    for (unsigned y = 0; y < frame->cell_size; y++) {
+      const uint8_t *row = (const uint8_t *)buf->start + (cy * frame->cell_size + y) * stride;
+
+      for (int g = 0; g < used_groups; g += BUFFER_LUMA_MAX_GROUPS) {
+        int n = MIN(BUFFER_LUMA_MAX_GROUPS, used_groups - g);
+
+        memset(sums, 0, n * sizeof(uint32_t));
+        buffer_luma_sum_row(row + g * BUFFER_LUMA_GROUP_SIZE * step, step, n, sums);
+
+        for (int i = 0; i < n; i++) {
+          cell_sums[(g + i) / scale] += sums[i];
+        }
+      }
+    }
+
+    for (int cx = 0; cx < frame->cells_x; cx++) {
+      frame->cells[cy * frame->cells_x + cx] = cell_sums[cx] / (frame->cell_size * frame->cell_size);
+    }
+  }
+
+  return frame->cells_x > 0 && frame->cells_y > 0;
+}
+
+// Samples a group of pixels on the `BUFFER_LUMA_SAMPLE_ROWS` rows in the middle
+// of each cell, reading only a fraction of the frame unlike `buffer_luma_downsample()`
+bool buffer_luma_sample(buffer_t *buf, buffer_luma_t *frame)
+{
+  buffer_format_t *fmt = &buf->buf_list->fmt;
+  int step = buffer_luma_step(fmt->format);
+
+  if (!step) {
+    return false;
+  }
+
+  unsigned stride = fmt->bytesperline ? fmt->bytesperline : fmt->width * step;
+  int scale = buffer_luma_cells(buf, stride, frame);
+  unsigned row_step = frame->cell_size / (BUFFER_LUMA_SAMPLE_ROWS + 1);
+
+  for (int cy = 0; cy < frame->cells_y; cy++) {
+    for (int cx = 0; cx < frame->cells_x; cx++) {
+      const uint8_t *start = (const uint8_t *)buf->start + cy * frame->cell_size * stride +
+        (cx * scale + scale / 2) * BUFFER_LUMA_GROUP_SIZE * step;
+      uint32_t sum = 0;
+
+      for (int y = 1; y <= BUFFER_LUMA_SAMPLE_ROWS; y++) {
+        const uint8_t *row = start + y * row_step * stride;
+
+        for (int x = 0; x < BUFFER_LUMA_GROUP_SIZE; x++) {
+          sum += row[x * step];
+        }
+      }
+
+      frame->cells[cy * frame->cells_x + cx] = sum / (BUFFER_LUMA_SAMPLE_ROWS * BUFFER_LUMA_GROUP_SIZE);
+    }
+  }
+
+  return frame->cells_x > 0 && frame->cells_y > 0;
+}
+
+// Returns the count of the cells that changed over the `threshold`,
+// or -1 if the resolutions differ
+int buffer_luma_diff(buffer_luma_t *current, buffer_luma_t *previous, uint8_t threshold, uint8_t *changed)
+{
+  if (current->cells_x != previous->cells_x || current->cells_y != previous->cells_y) {
+    return -1;
+  }
+
+  return buffer_luma_diff_cells(current->cells, previous->cells,
+    current->cells_x * current->cells_y, threshold, changed);
+}
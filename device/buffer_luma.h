@@ -0,0 +1,21 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "device/buffer.h"
+
+#define BUFFER_LUMA_MAX_CELLS_X 80
+#define BUFFER_LUMA_MAX_CELLS_Y 80
+#define BUFFER_LUMA_MAX_CELLS (BUFFER_LUMA_MAX_CELLS_X * BUFFER_LUMA_MAX_CELLS_Y)
+
+// The average luma of the cells of `cell_size` pixels
+typedef struct buffer_luma_s {
+  unsigned width, height, cell_size;
+  int cells_x, cells_y;
+  uint8_t cells[BUFFER_LUMA_MAX_CELLS];
+} buffer_luma_t;
+
+bool buffer_luma_downsample(buffer_t *buf, buffer_luma_t *luma);
+bool buffer_luma_sample(buffer_t *buf, buffer_luma_t *luma);
+int buffer_luma_diff(buffer_luma_t *current, buffer_luma_t *previous, uint8_t threshold, uint8_t *changed);
@@ -1,5 +1,7 @@
 #include "device/buffer.h"
 #include "device/buffer_list.h"
+#include "device/buffer_copy.h"
+#include "device/buffer_h264.h"
 #include "device/device.h"
 #include "util/opts/log.h"
 #include "util/opts/fourcc.h"
@@ -26,8 +28,82 @@ bool buffer_use(buffer_t *buf)
   return true;
 }
 
+// The buffers held by the consumers, the free ones hold a single reference
+static bool buffer_list_is_used(buffer_list_t *buf_list)
+{
+  if (buf_list && buf_list->readers > 0) {
+    return true;
+  }
+
+  for (int i = 0; buf_list && i < buf_list->nbufs; i++) {
+    if (!buf_list->bufs[i]->enqueued && buf_list->bufs[i]->mmap_reflinks > 1)
+      return true;
+  }
+
+  return false;
+}
+
+static bool device_is_used(device_t *dev)
+{
+  for (int i = 0; i < dev->n_capture_list; i++) {
+    if (buffer_list_is_used(dev->capture_lists[i]))
+      return true;
+  }
+
+  return buffer_list_is_used(dev->output_list);
+}
+
+// Closes the device, or defers it to the last `buffer_consumed()`
+// as the consumers still read the mapped memory
+void device_release(device_t *dev)
+{
+  if (!dev) {
+    return;
+  }
+
+  pthread_mutex_lock(&buffer_lock);
+  dev->released = device_is_used(dev);
+  pthread_mutex_unlock(&buffer_lock);
+
+  if (dev->released) {
+    LOG_INFO(dev, "Buffers are still in use, closing when released.");
+    return;
+  }
+
+  device_close(dev);
+}
+
+// Keeps the device of the list open while its data is read
+// without holding a buffer, like the `buf_list->h264_params`
+void buffer_list_use(buffer_list_t *buf_list)
+{
+  pthread_mutex_lock(&buffer_lock);
+  buf_list->readers++;
+  pthread_mutex_unlock(&buffer_lock);
+}
+
+void buffer_list_consumed(buffer_list_t *buf_list, const char *who)
+{
+  device_t *released = NULL;
+
+  pthread_mutex_lock(&buffer_lock);
+  buf_list->readers--;
+  if (buf_list->dev->released && !device_is_used(buf_list->dev)) {
+    released = buf_list->dev;
+    released->released = false;
+  }
+  pthread_mutex_unlock(&buffer_lock);
+
+  if (released) {
+    LOG_INFO(released, "Closing as the buffers were released by %s.", who);
+    device_close(released);
+  }
+}
+
 bool buffer_consumed(buffer_t *buf, const char *who)
 {
+  device_t *released = NULL;
+
   if (!buf) {
     return false;
   }
@@ -39,7 +115,12 @@ bool buffer_consumed(buffer_t *buf, const char *who)
 
   buf->mmap_reflinks--;
 
-  if (!buf->enqueued && buf->mmap_reflinks == 0) {
+  if (buf->buf_list->dev->released) {
+    if (!device_is_used(buf->buf_list->dev)) {
+      released = buf->buf_list->dev;
+      released->released = false;
+    }
+  } else if (!buf->enqueued && buf->mmap_reflinks == 0) {
     LOG_DEBUG(buf, "Queuing buffer... used=%zu length=%zu (linked=%s) by %s",
       buf->used,
       buf->length,
@@ -60,6 +141,11 @@ bool buffer_consumed(buffer_t *buf, const char *who)
   }
 
   pthread_mutex_unlock(&buffer_lock);
+
+  if (released) {
+    LOG_INFO(released, "Closing as the buffers were released by %s.", who);
+    device_close(released);
+  }
   return true;
 
 error:
@@ -117,6 +203,7 @@ int buffer_list_enqueue(buffer_list_t *buf_list, buffer_t *dma_buf)
 
   buf->flags = dma_buf->flags;
   buf->captured_time_us = dma_buf->captured_time_us;
+  buf->frame_seq = dma_buf->frame_seq;
 
   if (buf_list->do_mmap) {
     if (dma_buf->used > buf->length) {
@@ -126,8 +213,10 @@ int buffer_list_enqueue(buffer_list_t *buf_list, buffer_t *dma_buf)
     }
 
     uint64_t before = get_monotonic_time_us(NULL, NULL);
-    memcpy(buf->start, dma_buf->start, dma_buf->used);
+    buffer_copy(buf, dma_buf, dma_buf->used);
     uint64_t after = get_monotonic_time_us(NULL, NULL);
+    buf_list->stats.copied_bytes += dma_buf->used;
+    buf_list->stats.copy_time_us += after - before;
 
     LOG_DEBUG(buf, "mmap copy: dest=%p, src=%p (%s), size=%zu, space=%zu, time=%" PRIu64 "us",
       buf->start, dma_buf->start, dma_buf->name, dma_buf->used, buf->length, after-before);
@@ -135,6 +224,7 @@ int buffer_list_enqueue(buffer_list_t *buf_list, buffer_t *dma_buf)
     LOG_DEBUG(buf, "dmabuf copy: dest=%p, src=%p (%s, dma_fd=%d), size=%zu",
       buf->start, dma_buf->start, dma_buf->name, dma_buf->dma_fd, dma_buf->used);
 
+    buf_list->stats.dma_bytes += dma_buf->used;
     buf->dma_source = dma_buf;
     buf->length = dma_buf->length;
     dma_buf->mmap_reflinks++;
@@ -145,22 +235,23 @@ int buffer_list_enqueue(buffer_list_t *buf_list, buffer_t *dma_buf)
   return 1;
 }
 
-static void buffer_update_h264_key_frame(buffer_t *buf)
+// The camera numbers its frames, the M2M capture gets the number of
+// the output frame of the same timestamp, since the V4L2 copies it
+static unsigned buffer_list_frame_seq(buffer_list_t *buf_list, buffer_t *buf)
 {
-  unsigned char *data = buf->start;
-
-  static const int N = 8;
-  char buffer [3*N+1];
-  buffer[sizeof(buffer)-1] = 0;
-  for(int j = 0; j < N; j++)
-    sprintf(&buffer[sizeof(buffer)/N*j], "%02X ", data[j]);
-
-  if (buf->flags.is_keyframe) {
-    LOG_DEBUG(buf, "Got key frame (from V4L2)!: %s", buffer);
-  } else if (buf->used >= 5 && (data[4] & 0x1F) == 0x07) {
-    LOG_DEBUG(buf, "Got key frame (from buffer)!: %s", buffer);
-    buf->flags.is_keyframe = true;
+  buffer_list_t *output_list = buf_list->dev->output_list;
+
+  if (!output_list) {
+    return buf_list->stats.frames;
+  }
+
+  for (int i = 0; i < output_list->nbufs; i++) {
+    if (output_list->bufs[i]->captured_time_us == buf->captured_time_us) {
+      return output_list->bufs[i]->frame_seq;
+    }
   }
+
+  return 0;
 }
 
 buffer_t *buffer_list_dequeue(buffer_list_t *buf_list)
@@ -186,6 +277,12 @@ buffer_t *buffer_list_dequeue(buffer_list_t *buf_list)
   buf->enqueued = false;
   buf->mmap_reflinks = 1;
 
+  if (buf_list->stream_start_us) {
+    LOG_INFO(buf_list, "First frame in %.1fms since the stream start.",
+      (buf_list->last_dequeued_us - buf_list->stream_start_us) / 1000.0f);
+    buf_list->stream_start_us = 0;
+  }
+
 	LOG_DEBUG(buf_list, "Grabbed mmap buffer=%u, bytes=%zu, used=%zu, frame=%d, linked=%s",
     buf->index,
     buf->length,
@@ -200,13 +297,18 @@ buffer_t *buffer_list_dequeue(buffer_list_t *buf_list)
   }
 
   if (buf_list->fmt.format == V4L2_PIX_FMT_H264) {
-    buffer_update_h264_key_frame(buf);
+    buffer_h264_index(buf);
     buf->flags.is_keyed = true;
   } else {
     buf->flags.is_keyed = false;
+    buf->flags.needs_h264_params = false;
+    buf->n_nals = 0;
   }
 
   buf_list->stats.frames++;
+  if (buf_list->do_capture) {
+    buf->frame_seq = buffer_list_frame_seq(buf_list, buf);
+  }
 
   float old_average = buf_list->stats.avg_dequeued_us;
   float old_sum = buf_list->stats.avg_dequeued_us * buf_list->stats.frames_since_reset;
@@ -7,23 +7,39 @@
 #include "device/links.h"
 #include "util/opts/log.h"
 #include "util/opts/fourcc.h"
+#include "output/output.h"
 
-camera_t *camera_open(camera_options_t *options)
+camera_t *camera_open(camera_options_t *options, output_locks_t *locks)
 {
   camera_t *camera = calloc(1, sizeof(camera_t));
-  camera->name = "CAMERA";
+  camera->name = options->name[0] ? options->name : "CAMERA";
   camera->options = *options;
-  camera->device_list = device_list_v4l2();
+  camera->locks = locks;
+  camera_parse_renditions(camera);
+  camera_parse_outputs(camera);
+  pthread_mutex_init(&camera->reconfigure.lock, NULL);
+  pthread_cond_init(&camera->reconfigure.cond, NULL);
 
+  uint64_t start_us = get_monotonic_time_us(NULL, NULL);
+  camera->device_list = device_list_v4l2(options->probe_cache);
+
+  uint64_t probe_us = get_monotonic_time_us(NULL, NULL);
   if (camera_configure_input(camera) < 0) {
     goto error;
   }
 
-  if (camera_set_params(camera) < 0) {
+  uint64_t input_us = get_monotonic_time_us(NULL, NULL);
+  if (!options->dry_run && camera_set_params(camera) < 0) {
     goto error;
   }
 
+  uint64_t params_us = get_monotonic_time_us(NULL, NULL);
   links_dump(camera->links);
+  links_dump_copies(camera->links);
+
+  LOG_INFO(camera, "Opened in %.1fms: probe=%.1fms, pipeline=%.1fms, params=%.1fms.",
+    (params_us - start_us) / 1000.0f, (probe_us - start_us) / 1000.0f,
+    (input_us - probe_us) / 1000.0f, (params_us - input_us) / 1000.0f);
 
   return camera;
 
@@ -49,7 +65,11 @@ void camera_close(camera_t **camerap)
         link->callbacks[j].on_buffer = NULL;
       }
       if (link->callbacks[j].buf_lock) {
-        buffer_lock_capture(link->callbacks[j].buf_lock, NULL);
+        buffer_lock_t *buf_lock = link->callbacks[j].buf_lock;
+        buffer_lock_capture(buf_lock, NULL);
+        pthread_mutex_lock(&buf_lock->lock);
+        buf_lock->buf_list = NULL;
+        pthread_mutex_unlock(&buf_lock->lock);
         link->callbacks[j].buf_lock = NULL;
       }
     }
@@ -57,7 +77,7 @@ void camera_close(camera_t **camerap)
 
   for (int i = MAX_DEVICES; i-- > 0; ) {
     if (camera->devices[i]) {
-      device_close(camera->devices[i]);
+      device_release(camera->devices[i]);
       camera->devices[i] = NULL;
     }
   }
@@ -110,6 +130,13 @@ int camera_set_params(camera_t *camera)
 
   device_set_option_list(camera->isp, camera->options.isp.options);
 
+  if (camera->options.type == CAMERA_DUMMY) {
+    for (int i = 0; i < MAX_DEVICES; i++) {
+      if (camera->devices[i] && camera->devices[i] != camera->camera)
+        device_set_option_list(camera->devices[i], camera->options.dummy.options);
+    }
+  }
+
   if (camera->options.auto_focus) {
     device_set_option_string(camera->camera, "AfTrigger", "1");
   }
@@ -119,11 +146,38 @@ int camera_set_params(camera_t *camera)
   device_set_option_list(camera->codec_stream, camera->options.stream.options);
   device_set_option_string(camera->codec_video, "repeat_sequence_header", "1"); // required for force key support
   device_set_option_list(camera->codec_video, camera->options.video.options);
+
+  for (int i = 0; i < CAMERA_MAX_RENDITIONS; i++) {
+    device_set_option_string(camera->codec_renditions[i], "repeat_sequence_header", "1");
+    device_set_option_list(camera->codec_renditions[i], camera->options.renditions[i].options);
+  }
+
+  for (int i = 0; i < CAMERA_MAX_OUTPUTS; i++) {
+    if (camera->options.extra[i].format == V4L2_PIX_FMT_H264) {
+      device_set_option_string(camera->codec_extra[i], "repeat_sequence_header", "1");
+    }
+    device_set_option_list(camera->codec_extra[i], camera->options.extra[i].options);
+  }
   return 0;
 }
 
+static void camera_step(void *opaque)
+{
+  camera_apply_reconfigure(opaque, false);
+}
+
 int camera_run(camera_t *camera)
 {
-  bool running = false;
-  return links_loop(camera->links, camera->options.force_active, &running);
+  int ret;
+
+  camera_idle_start(camera);
+
+  // the `links_loop()` is stopped only to apply the reconfigure,
+  // it fails otherwise, even when no longer pending due to timeout
+  while ((ret = links_loop(camera->links, camera->options.force_active, &camera->running, camera_step, camera)) == 0) {
+    camera_apply_reconfigure(camera, true);
+  }
+
+  camera_idle_stop(camera);
+  return ret;
 }
@@ -1,17 +1,26 @@
 #pragma once
 
+#include <pthread.h>
+
 #include "device/links.h"
 #include "device/device.h"
 
 #define MAX_DEVICES 20
-#define MAX_RESCALLERS 4
+#define MAX_RESCALLERS 6
 #define MAX_HTTP_METHODS 20
 
 #define CAMERA_DEVICE_CAMERA 0
 #define CAMERA_OPTIONS_LENGTH 4096
 
+#define CAMERA_MAX_RENDITIONS 2 // `MAX_OUTPUT_RENDITIONS`
+#define CAMERA_MAX_OUTPUTS 4 // `MAX_OUTPUT_EXTRA`
+#define CAMERA_PIPELINE_OUTPUTS (3 + CAMERA_MAX_RENDITIONS + CAMERA_MAX_OUTPUTS)
+#define CAMERA_RENDITIONS_LENGTH 256
+#define CAMERA_OUTPUTS_LENGTH 1024
+
 #define MAX_RESCALLER_SIZE 1920
 #define RESCALLER_BLOCK_SIZE 32
+#define CAMERA_MAX_KEEPALIVE_MS 2000 // below `DEFAULT_BUFFER_LOCK_GET_TIMEOUT`
 
 typedef enum {
   CAMERA_V4L2 = 0,
@@ -19,13 +28,45 @@ typedef enum {
   CAMERA_DUMMY
 } camera_type_t;
 
+typedef enum {
+  CAMERA_PLAN_USE_CAPTURE = 0, // use the existing capture as is
+  CAMERA_PLAN_ENCODE, // encode the existing capture
+  CAMERA_PLAN_RESCALE_ENCODE, // rescale the existing capture, then encode
+  CAMERA_PLAN_DECODE_ENCODE, // decode the camera capture, then encode
+  CAMERA_PLAN_DECODE_RESCALE_ENCODE, // decode the camera capture, rescale, then encode
+} camera_plan_type_t;
+
+// A candidate chain of devices producing a single output
+typedef struct camera_plan_s {
+  camera_plan_type_t type;
+  buffer_list_t *source;
+  unsigned source_format, source_width, source_height;
+  unsigned rescale_height;
+  unsigned format;
+
+  unsigned hops;
+  uint64_t memcpy_bytes;
+  uint64_t memory_bytes;
+  float latency_ms;
+  float cost;
+} camera_plan_t;
+
 typedef struct camera_output_options_s {
   bool disabled;
   unsigned height;
+  unsigned keepalive_ms;
   char options[CAMERA_OPTIONS_LENGTH];
+  char renditions[CAMERA_RENDITIONS_LENGTH]; // VIDEO only, `<height>:<bitrate>` each
+
+  // the declared outputs only
+  char name[32];
+  char path[64];
+  unsigned format; // JPEG for the snapshot, MJPEG for the stream, or H264
+  unsigned fps;
 } camera_output_options_t;
 
 typedef struct camera_options_s {
+  char name[32];
   char path[256];
   unsigned width, height, format;
   unsigned nbufs, fps;
@@ -35,6 +76,7 @@ typedef struct camera_options_s {
   float low_res_factor;
   bool auto_focus;
   unsigned auto_reconnect;
+  unsigned idle_timeout;
   bool force_active;
   union {
     bool vflip;
@@ -47,20 +89,33 @@ typedef struct camera_options_s {
 
   char options[CAMERA_OPTIONS_LENGTH];
   bool list_options;
+  char probe_cache[256];
+  bool dry_run;
+  unsigned copy_threads;
 
   struct {
     char options[CAMERA_OPTIONS_LENGTH];
   } isp;
 
+  struct {
+    char options[CAMERA_OPTIONS_LENGTH];
+  } dummy;
+
   camera_output_options_t snapshot;
   camera_output_options_t stream;
   camera_output_options_t video;
+  camera_output_options_t motion;
+  camera_output_options_t renditions[CAMERA_MAX_RENDITIONS]; // parsed from `video.renditions`
+
+  char outputs[CAMERA_OUTPUTS_LENGTH]; // `<name>:<format>:<height>[:<fps>[:<path>[:<options>]]]` each
+  camera_output_options_t extra[CAMERA_MAX_OUTPUTS]; // parsed from `outputs`
 } camera_options_t;
 
 typedef struct camera_s {
   const char *name;
 
   camera_options_t options;
+  struct output_locks_s *locks;
 
   union {
     device_t *devices[MAX_DEVICES];
@@ -68,25 +123,54 @@ typedef struct camera_s {
       device_t *camera;
       device_t *decoder; // decode JPEG/H264 into YUVU
       device_t *isp;
-      device_t *rescallers[3];
+      device_t *rescallers[MAX_RESCALLERS];
       device_t *codec_snapshot;
       device_t *codec_stream;
       device_t *codec_video;
+      device_t *codec_renditions[CAMERA_MAX_RENDITIONS];
+      device_t *codec_extra[CAMERA_MAX_OUTPUTS];
     };
   };
 
   struct device_list_s *device_list;
 
+  buffer_list_t *camera_capture;
+
   link_t links[MAX_DEVICES];
   int nlinks;
+  bool running;
+
+  // Changes applied by `camera_run()` between the `links_loop()` runs,
+  // or between its steps if only the device options change
+  struct {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    bool pending;
+    bool restart; // stops the `links_loop()`
+    int result;
+    camera_options_t options;
+  } reconfigure;
+
+  // Outputs closed by the idle thread when unused
+  struct {
+    pthread_t thread;
+    bool running;
+    bool closed[CAMERA_PIPELINE_OUTPUTS];
+    uint64_t used_us[CAMERA_PIPELINE_OUTPUTS];
+  } idle;
 } camera_t;
 
 #define CAMERA(DEVICE) camera->devices[DEVICE]
 
-camera_t *camera_open(camera_options_t *camera);
+camera_t *camera_open(camera_options_t *options, struct output_locks_s *locks);
 int camera_set_params(camera_t *camera);
 void camera_close(camera_t **camera);
 int camera_run(camera_t *camera);
+void camera_get_options(camera_t *camera, camera_options_t *options);
+int camera_reconfigure(camera_t *camera, camera_options_t *options, int timeout_ms);
+bool camera_apply_reconfigure(camera_t *camera, bool stopped);
+void camera_idle_start(camera_t *camera);
+void camera_idle_stop(camera_t *camera);
 
 link_t *camera_ensure_capture(camera_t *camera, buffer_list_t *capture);
 void camera_capture_add_output(camera_t *camera, buffer_list_t *capture, buffer_list_t *output);
@@ -94,10 +178,23 @@ void camera_capture_add_callbacks(camera_t *camera, buffer_list_t *capture, link
 
 int camera_configure_input(camera_t *camera);
 int camera_configure_pipeline(camera_t *camera, buffer_list_t *camera_capture);
+int camera_configure_pipeline_motion(camera_t *camera);
+camera_output_options_t *camera_pipeline_output_options(camera_options_t *options, int index);
+void camera_parse_renditions(camera_t *camera);
+void camera_parse_outputs(camera_t *camera);
+unsigned camera_output_bitrate(camera_output_options_t *options);
+int camera_set_output_option(camera_output_options_t *output, const char *key, const char *value);
+int camera_configure_pipeline_output(camera_t *camera, int index);
+const char *camera_get_pipeline_output(camera_t *camera, int index, camera_output_options_t **options, struct buffer_lock_s **buf_lock, device_t ***device);
 void camera_debug_capture(camera_t *camera, buffer_list_t *capture);
 
 buffer_list_t *camera_configure_isp(camera_t *camera, buffer_list_t *src_capture);
 buffer_list_t *camera_configure_decoder(camera_t *camera, buffer_list_t *src_capture);
 buffer_list_t *camera_configure_rescaller(camera_t *camera, buffer_list_t *src_capture, const char *name, unsigned target_height, unsigned formats[]);
 int camera_configure_output(camera_t *camera, buffer_list_t *camera_capture, const char *name, camera_output_options_t *options, unsigned formats[], link_callbacks_t callbacks, device_t **device);
+extern unsigned camera_decoder_formats[];
+extern unsigned camera_rescalled_formats[];
+
+int camera_plan_output(camera_t *camera, buffer_list_t *camera_capture, const char *name, camera_output_options_t *options, unsigned formats[], camera_plan_t *plan);
+void camera_plan_print(camera_t *camera, const char *name, camera_plan_t *plan, FILE *stream);
 bool camera_get_scaled_resolution(buffer_format_t capture_format, camera_output_options_t *options, buffer_format_t *format, int align_size);
@@ -12,7 +12,7 @@
 #include "output/rtsp/rtsp.h"
 #include "output/output.h"
 
-static unsigned decoder_formats[] =
+unsigned camera_decoder_formats[] =
 {
   // best quality
   V4L2_PIX_FMT_YUYV,
@@ -30,7 +30,7 @@ static unsigned decoder_formats[] =
 buffer_list_t *camera_configure_decoder(camera_t *camera, buffer_list_t *src_capture)
 {
   unsigned chosen_format = 0;
-  device_info_t *device = device_list_find_m2m_formats(camera->device_list, src_capture->fmt.format, decoder_formats, &chosen_format);
+  device_info_t *device = device_list_find_m2m_formats(camera->device_list, src_capture->fmt.format, camera_decoder_formats, &chosen_format);
 
   if (!device) {
     LOG_INFO(camera, "Cannot find '%s' decoder", fourcc_to_string(src_capture->fmt.format).buf);
@@ -39,7 +39,7 @@ buffer_list_t *camera_configure_decoder(camera_t *camera, buffer_list_t *src_cap
 
   device_video_force_key(camera->camera);
 
-  camera->decoder = device_v4l2_open("DECODER", device->path);
+  camera->decoder = device->device_open("DECODER", device->path);
 
   buffer_list_t *decoder_output = device_open_buffer_list_output(
     camera->decoder, src_capture);
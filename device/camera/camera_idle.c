@@ -0,0 +1,117 @@
+#include "camera.h"
+
+#include "device/buffer_lock.h"
+#include "device/device.h"
+#include "util/opts/log.h"
+
+#define IDLE_RECONFIGURE_TIMEOUT_MS 3000
+
+// The outputs of the pipeline, as changed by the camera thread
+typedef struct camera_idle_output_s {
+  const char *name;
+  buffer_lock_t *buf_lock;
+  bool has_device;
+} camera_idle_output_t;
+
+static void camera_idle_snapshot(camera_t *camera, camera_options_t *options, camera_idle_output_t outputs[])
+{
+  pthread_mutex_lock(&camera->reconfigure.lock);
+  *options = camera->options;
+
+  for (int i = 0; i < CAMERA_PIPELINE_OUTPUTS; i++) {
+    camera_output_options_t *output;
+    device_t **device;
+
+    outputs[i].name = camera_get_pipeline_output(camera, i, &output, &outputs[i].buf_lock, &device);
+    outputs[i].has_device = outputs[i].name && *device;
+  }
+  pthread_mutex_unlock(&camera->reconfigure.lock);
+}
+
+static void camera_idle_step(camera_t *camera, camera_options_t *options)
+{
+  uint64_t now_us = get_monotonic_time_us(NULL, NULL);
+  camera_idle_output_t outputs[CAMERA_PIPELINE_OUTPUTS];
+  bool closed[CAMERA_PIPELINE_OUTPUTS];
+  bool changed = false;
+
+  camera_idle_snapshot(camera, options, outputs);
+  uint64_t timeout_us = options->idle_timeout * 1000LL * 1000LL;
+
+  for (int i = 0; i < CAMERA_PIPELINE_OUTPUTS; i++) {
+    camera_output_options_t *output = camera_pipeline_output_options(options, i);
+    const char *name = outputs[i].name;
+    closed[i] = camera->idle.closed[i];
+
+    if (!name) {
+      continue;
+    }
+
+    if (buffer_lock_needs_buffer(outputs[i].buf_lock)) {
+      camera->idle.used_us[i] = now_us;
+    }
+
+    if (camera->idle.closed[i] && camera->idle.used_us[i] == now_us) {
+      LOG_INFO(camera, "Opening '%s' for the first client.", name);
+      closed[i] = false;
+    } else if (!camera->idle.closed[i] && !output->disabled && outputs[i].has_device &&
+      now_us - camera->idle.used_us[i] > timeout_us) {
+      LOG_INFO(camera, "Closing '%s' as unused.", name);
+      closed[i] = true;
+    } else {
+      continue;
+    }
+
+    output->disabled = closed[i];
+    changed = true;
+  }
+
+  if (!changed) {
+    return;
+  }
+
+  if (camera_reconfigure(camera, options, IDLE_RECONFIGURE_TIMEOUT_MS) < 0) {
+    LOG_INFO(camera, "Cannot open or close the unused outputs.");
+    return;
+  }
+
+  memcpy(camera->idle.closed, closed, sizeof(closed));
+}
+
+static void *camera_idle_thread(void *opaque)
+{
+  camera_t *camera = opaque;
+  camera_options_t *options = malloc(sizeof(camera_options_t));
+
+  while (camera->idle.running) {
+    camera_idle_step(camera, options);
+    usleep(LINKS_LOOP_INTERVAL * 1000);
+  }
+
+  free(options);
+  return NULL;
+}
+
+// The outputs having own devices are closed, and their buffers freed,
+// after `idle_timeout`. The outputs unused on start-up are closed at once.
+void camera_idle_start(camera_t *camera)
+{
+  if (!camera->options.idle_timeout || camera->options.force_active || camera->idle.running) {
+    return;
+  }
+
+  camera->idle.running = true;
+  if (pthread_create(&camera->idle.thread, NULL, camera_idle_thread, camera) != 0) {
+    camera->idle.running = false;
+  }
+}
+
+void camera_idle_stop(camera_t *camera)
+{
+  if (!camera->idle.running) {
+    return;
+  }
+
+  camera->idle.running = false;
+  pthread_join(camera->idle.thread, NULL);
+}
@@ -26,10 +26,12 @@ static int camera_configure_input_v4l2(camera_t *camera)
   device_set_rotation(camera->camera, camera->options.vflip, camera->options.hflip);
 
   camera->camera->opts.allow_dma = camera->options.allow_dma;
+  camera->camera->opts.no_dma_reason = "disabled with `-camera-allow_dma=0`";
 
   if (strstr(camera->camera->bus_info, "usb")) {
     LOG_INFO(camera, "Disabling DMA since device uses USB (which is likely not working properly).");
     camera->camera->opts.allow_dma = false;
+    camera->camera->opts.no_dma_reason = "USB device";
   }
 
   buffer_format_t fmt = {
@@ -57,6 +59,7 @@ static int camera_configure_input_libcamera(camera_t *camera)
   device_set_rotation(camera->camera, camera->options.vflip, camera->options.hflip);
 
   camera->camera->opts.allow_dma = camera->options.allow_dma;
+  camera->camera->opts.no_dma_reason = "disabled with `-camera-allow_dma=0`";
 
   buffer_format_t capture_fmt = {
     .width = camera->options.width,
@@ -108,6 +111,9 @@ static int camera_configure_input_dummy(camera_t *camera)
     return -1;
   }
 
+  // emulate M2M devices to exercise the full pipeline without hardware
+  camera->device_list = device_list_dummy(camera->device_list, camera->options.path);
+
   buffer_format_t fmt = {
     .width = camera->options.width,
     .height = camera->options.height,
@@ -123,8 +129,63 @@ static int camera_configure_input_dummy(camera_t *camera)
   return camera_configure_pipeline(camera, camera_capture);
 }
 
+// Plans the pipeline from the probed `device_list` capabilities:
+// all devices are replaced with `device_dry_open()` so nothing is opened.
+static int camera_configure_input_dry(camera_t *camera)
+{
+  const char *path = camera->options.path;
+
+  if (camera->options.type == CAMERA_DUMMY) {
+    camera->device_list = device_list_dummy(camera->device_list, path);
+  } else if (!*path && camera->options.type == CAMERA_V4L2) {
+    path = "/dev/video0";
+  }
+
+  for (int i = 0; camera->device_list && i < camera->device_list->ndevices; i++) {
+    camera->device_list->devices[i].device_open = device_dry_open;
+  }
+
+  buffer_format_t fmt = {
+    .width = camera->options.width,
+    .height = camera->options.height,
+    .format = camera->options.format,
+    .nbufs = camera->options.nbufs
+  };
+
+  for (int i = 0; !fmt.format && camera->device_list && i < camera->device_list->ndevices; i++) {
+    device_info_t *info = &camera->device_list->devices[i];
+    if (info->camera && !strcmp(info->path, path) && info->capture_formats.n > 0)
+      fmt.format = info->capture_formats.formats[0];
+  }
+
+  if (!fmt.format) {
+    fmt.format = V4L2_PIX_FMT_YUYV;
+    LOG_INFO(camera, "Cannot find the probed format of '%s', assuming %s.", path, fourcc_to_string(fmt.format).buf);
+  }
+
+  camera->camera = device_dry_open(camera->name, path);
+  camera->camera->opts.allow_dma = camera->options.allow_dma;
+  camera->camera->opts.no_dma_reason = "disabled with `-camera-allow_dma=0`";
+
+  if (camera->options.type == CAMERA_DUMMY) {
+    camera->camera->opts.allow_dma = false;
+    camera->camera->opts.no_dma_reason = "emulated device";
+  }
+
+  buffer_list_t *camera_capture = device_open_buffer_list(camera->camera, true, fmt, true);
+  if (!camera_capture) {
+    return -1;
+  }
+
+  return camera_configure_pipeline(camera, camera_capture);
+}
+
 int camera_configure_input(camera_t *camera)
 {
+  if (camera->options.dry_run) {
+    return camera_configure_input_dry(camera);
+  }
+
   switch (camera->options.type) {
   case CAMERA_V4L2:
     return camera_configure_input_v4l2(camera);
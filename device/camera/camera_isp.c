@@ -12,7 +12,11 @@
 
 buffer_list_t *camera_configure_isp(camera_t *camera, buffer_list_t *src_capture)
 {
-  camera->isp = device_v4l2_open("ISP", "/dev/video13");
+  if (camera->options.dry_run) {
+    camera->isp = device_dry_open("ISP", "/dev/video13");
+  } else {
+    camera->isp = device_v4l2_open("ISP", "/dev/video13");
+  }
 
   buffer_list_t *isp_output = device_open_buffer_list_output(
     camera->isp, src_capture);
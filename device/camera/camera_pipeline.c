@@ -2,11 +2,13 @@
 
 #include "device/buffer.h"
 #include "device/buffer_list.h"
+#include "device/buffer_lock.h"
 #include "device/device.h"
 #include "device/device_list.h"
 #include "device/links.h"
 #include "util/opts/log.h"
 #include "util/opts/fourcc.h"
+#include "util/opts/opts.h"
 #include "device/buffer_list.h"
 #include "util/http/http.h"
 #include "output/output.h"
@@ -18,50 +20,394 @@ static unsigned snapshot_formats[] =
   0
 };
 
-static link_callbacks_t snapshot_callbacks =
+static unsigned video_formats[] =
 {
-  .name = "SNAPSHOT-CAPTURE",
-  .buf_lock = &snapshot_lock
+  V4L2_PIX_FMT_H264,
+  0
 };
 
-static link_callbacks_t stream_callbacks =
-{
-  .name = "STREAM-CAPTURE",
-  .buf_lock = &stream_lock
+_Static_assert(CAMERA_MAX_RENDITIONS == MAX_OUTPUT_RENDITIONS, "the renditions need the buffer locks");
+_Static_assert(CAMERA_MAX_OUTPUTS == MAX_OUTPUT_EXTRA, "the declared outputs need the buffer locks");
+
+// The declared outputs follow the fixed ones
+#define CAMERA_PIPELINE_EXTRA (3 + CAMERA_MAX_RENDITIONS)
+
+static const char *camera_pipeline_outputs[CAMERA_PIPELINE_EXTRA] = {
+  "SNAPSHOT", "STREAM", "VIDEO", "VIDEO1", "VIDEO2"
 };
 
-static unsigned video_formats[] =
-{
-  V4L2_PIX_FMT_H264,
-  0
+static const char *camera_pipeline_captures[CAMERA_PIPELINE_EXTRA] = {
+  "SNAPSHOT-CAPTURE", "STREAM-CAPTURE", "VIDEO-CAPTURE", "VIDEO1-CAPTURE", "VIDEO2-CAPTURE"
 };
 
-static link_callbacks_t video_callbacks =
+camera_output_options_t *camera_pipeline_output_options(camera_options_t *options, int index)
 {
-  .name = "VIDEO-CAPTURE",
-  .buf_lock = &video_lock
-};
+  camera_output_options_t *outputs[CAMERA_PIPELINE_EXTRA] = {
+    &options->snapshot, &options->stream, &options->video,
+    &options->renditions[0], &options->renditions[1]
+  };
+
+  if (index >= CAMERA_PIPELINE_EXTRA) {
+    return &options->extra[index - CAMERA_PIPELINE_EXTRA];
+  }
+
+  return outputs[index];
+}
+
+// Returns the name of the output, or NULL when the declared output is not used
+const char *camera_get_pipeline_output(camera_t *camera, int index, camera_output_options_t **options, buffer_lock_t **buf_lock, device_t ***device)
+{
+  output_locks_t *locks = camera->locks;
+
+  *options = camera_pipeline_output_options(&camera->options, index);
+
+  switch (index) {
+  case 0:
+    *buf_lock = locks->snapshot;
+    *device = &camera->codec_snapshot;
+    break;
+
+  case 1:
+    *buf_lock = locks->stream;
+    *device = &camera->codec_stream;
+    break;
+
+  case 2:
+    *buf_lock = locks->video;
+    *device = &camera->codec_video;
+    break;
+
+  case 3 ... CAMERA_PIPELINE_EXTRA - 1:
+    *buf_lock = locks->renditions[index - 3];
+    *device = &camera->codec_renditions[index - 3];
+    break;
+
+  default:
+    if (!(*options)->name[0]) {
+      return NULL;
+    }
+
+    *buf_lock = locks->extra[index - CAMERA_PIPELINE_EXTRA];
+    *device = &camera->codec_extra[index - CAMERA_PIPELINE_EXTRA];
+    return (*options)->name;
+  }
+
+  return camera_pipeline_outputs[index];
+}
+
+static bool camera_is_video_output(int index, camera_output_options_t *options)
+{
+  if (index >= CAMERA_PIPELINE_EXTRA) {
+    return options->format == V4L2_PIX_FMT_H264;
+  }
+
+  return index >= 2;
+}
+
+// The declared outputs skip the frames above their `fps`, in the encoder when they have own
+int camera_configure_pipeline_output(camera_t *camera, int index)
+{
+  camera_output_options_t *options;
+  buffer_lock_t *buf_lock;
+  device_t **device;
+
+  const char *name = camera_get_pipeline_output(camera, index, &options, &buf_lock, &device);
+  if (!name) {
+    return 0;
+  }
+
+  link_callbacks_t callbacks = {
+    .name = index < CAMERA_PIPELINE_EXTRA ? camera_pipeline_captures[index] : name,
+    .buf_lock = buf_lock
+  };
+  unsigned *formats = camera_is_video_output(index, options) ? video_formats : snapshot_formats;
+
+  if (camera_configure_output(camera, camera->camera_capture, name, options,
+    formats, callbacks, device) < 0) {
+    return -1;
+  }
+
+  if (!options->fps) {
+    return 0;
+  } else if (*device) {
+    (*device)->capture_lists[0]->fmt.interval_us = 1000 * 1000 / options->fps;
+  } else if (formats == snapshot_formats) {
+    buf_lock->frame_interval_ms = 1000 / options->fps;
+  }
+
+  return 0;
+}
+
+static bool camera_is_motion_format(unsigned format)
+{
+  switch (format) {
+  case V4L2_PIX_FMT_YUYV:
+  case V4L2_PIX_FMT_YUV420:
+  case V4L2_PIX_FMT_YVU420:
+  case V4L2_PIX_FMT_NV12:
+  case V4L2_PIX_FMT_NV21:
+  case V4L2_PIX_FMT_GREY:
+    return true;
+  }
+
+  return false;
+}
+
+// Attaches the motion lock to the smallest YUV capture of the pipeline,
+// rescaled further if it is much larger than requested
+int camera_configure_pipeline_motion(camera_t *camera)
+{
+  camera_output_options_t *options = &camera->options.motion;
+  buffer_list_t *src_capture = NULL;
+
+  if (options->disabled || !camera->locks->motion) {
+    return 0;
+  }
+
+  for (int i = 0; i < camera->nlinks; i++) {
+    buffer_list_t *capture = camera->links[i].capture_list;
+
+    if (camera_is_motion_format(capture->fmt.format) &&
+      (!src_capture || capture->fmt.height < src_capture->fmt.height)) {
+      src_capture = capture;
+    }
+  }
+
+  if (!src_capture) {
+    LOG_INFO(camera, "Cannot find the YUV capture for the motion detection.");
+    return 0;
+  }
+
+  if (options->height && src_capture->fmt.height > options->height * 3 / 2) {
+    buffer_list_t *rescaller_capture = camera_configure_rescaller(camera, src_capture, "MOTION",
+      options->height, camera_rescalled_formats);
+    if (rescaller_capture && camera_is_motion_format(rescaller_capture->fmt.format)) {
+      src_capture = rescaller_capture;
+    }
+  }
+
+  link_callbacks_t callbacks = {
+    .name = "MOTION-CAPTURE",
+    .buf_lock = camera->locks->motion
+  };
+
+  LOG_INFO(camera, "Detecting motion on '%s': %s %ux%u.", src_capture->name,
+    fourcc_to_string(src_capture->fmt.format).buf, src_capture->fmt.width, src_capture->fmt.height);
+  camera_capture_add_callbacks(camera, src_capture, callbacks);
+  return 0;
+}
 
 int camera_configure_pipeline(camera_t *camera, buffer_list_t *camera_capture)
 {
   camera_capture->do_timestamps = true;
+  camera->camera_capture = camera_capture;
 
   camera_debug_capture(camera, camera_capture);
 
-  if (camera_configure_output(camera, camera_capture, "SNAPSHOT", &camera->options.snapshot,
-    snapshot_formats, snapshot_callbacks, &camera->codec_snapshot) < 0) {
-    return -1;
+  for (int i = 0; i < CAMERA_PIPELINE_OUTPUTS; i++) {
+    if (camera_configure_pipeline_output(camera, i) < 0) {
+      return -1;
+    }
   }
 
-  if (camera_configure_output(camera, camera_capture, "STREAM", &camera->options.stream,
-    snapshot_formats, stream_callbacks, &camera->codec_stream) < 0) {
-    return -1;
+  return camera_configure_pipeline_motion(camera);
+}
+
+// Fills the `renditions` from the `video.renditions`, encoded
+// with the `video.options` and their own `video_bitrate`
+void camera_parse_renditions(camera_t *camera)
+{
+  camera_options_t *options = &camera->options;
+  char list[CAMERA_RENDITIONS_LENGTH];
+  char *string = list, *token;
+  int n = 0;
+
+  strcpy(list, options->video.renditions);
+
+  for (int i = 0; i < CAMERA_MAX_RENDITIONS; i++) {
+    memset(&options->renditions[i], 0, sizeof(options->renditions[i]));
+    options->renditions[i].disabled = true;
   }
 
-  if (camera_configure_output(camera, camera_capture, "VIDEO", &camera->options.video,
-    video_formats, video_callbacks, &camera->codec_video) < 0) {
-    return -1;
+  // the renditions are configured only with the video
+  if (options->video.disabled) {
+    return;
+  }
+
+  while ((token = strsep(&string, OPTION_VALUE_LIST_SEP)) != NULL) {
+    unsigned height = 0, bitrate = 0;
+
+    if (!*token) {
+      continue;
+    } else if (sscanf(token, "%u:%u", &height, &bitrate) < 1 || !height) {
+      LOG_INFO(camera, "The rendition '%s' is not '<height>:<bitrate>'.", token);
+      continue;
+    } else if (n >= CAMERA_MAX_RENDITIONS) {
+      LOG_INFO(camera, "Too many renditions. Maximum is %d.", CAMERA_MAX_RENDITIONS);
+      break;
+    }
+
+    camera_output_options_t *rendition = &options->renditions[n];
+    const char *sep = options->video.options[0] ? OPTION_VALUE_LIST_SEP : "";
+    int len = bitrate
+      ? snprintf(rendition->options, sizeof(rendition->options), "%s%svideo_bitrate=%u", options->video.options, sep, bitrate)
+      : snprintf(rendition->options, sizeof(rendition->options), "%s", options->video.options);
+
+    if (len >= sizeof(rendition->options)) {
+      LOG_INFO(camera, "The options of the rendition '%s' are too long.", token);
+      continue;
+    }
+
+    rendition->disabled = false;
+    rendition->height = height;
+    n++;
+  }
+}
+
+static unsigned camera_parse_output_format(const char *format)
+{
+  if (!strcasecmp(format, "jpeg")) {
+    return V4L2_PIX_FMT_JPEG;
+  } else if (!strcasecmp(format, "mjpeg")) {
+    return V4L2_PIX_FMT_MJPEG;
+  } else if (!strcasecmp(format, "h264")) {
+    return V4L2_PIX_FMT_H264;
   }
 
   return 0;
 }
+
+static bool camera_is_output_name_used(camera_options_t *options, const char *name, int n)
+{
+  for (int i = 0; i < CAMERA_PIPELINE_EXTRA; i++) {
+    if (!strcasecmp(name, camera_pipeline_outputs[i]))
+      return true;
+  }
+
+  for (int i = 0; i < n; i++) {
+    if (!strcasecmp(name, options->extra[i].name))
+      return true;
+  }
+
+  return !strcasecmp(name, "MOTION");
+}
+
+// Fills the `extra` from the `outputs`, encoded with the `stream.options`
+// or the `video.options`, followed by their own options separated by `,`
+void camera_parse_outputs(camera_t *camera)
+{
+  camera_options_t *options = &camera->options;
+  char list[CAMERA_OUTPUTS_LENGTH];
+  char *string = list, *token;
+  int n = 0;
+
+  strcpy(list, options->outputs);
+  memset(options->extra, 0, sizeof(options->extra));
+
+  while ((token = strsep(&string, OPTION_VALUE_LIST_SEP)) != NULL) {
+    char *fields[6] = { NULL };
+    char *declaration = token;
+
+    if (!*token) {
+      continue;
+    }
+
+    for (int i = 0; i < 6 && token; i++) {
+      fields[i] = strsep(&token, ":");
+    }
+
+    camera_output_options_t *output = &options->extra[n];
+    const char *name = fields[0], *path = fields[4];
+    char *own_options = fields[5];
+    unsigned format = fields[1] ? camera_parse_output_format(fields[1]) : 0;
+    unsigned height = fields[2] ? strtoul(fields[2], NULL, 10) : 0;
+
+    if (!*name || !format || !height) {
+      LOG_INFO(camera, "The output '%s' is not '<name>:<jpeg|mjpeg|h264>:<height>[:<fps>[:<path>[:<options>]]]'.", declaration);
+      continue;
+    } else if (strlen(name) >= sizeof(output->name) || camera_is_output_name_used(options, name, n)) {
+      LOG_INFO(camera, "The output name '%s' is too long or already used.", name);
+      continue;
+    } else if (path && *path && (*path != '/' || strlen(path) >= sizeof(output->path))) {
+      LOG_INFO(camera, "The output path '%s' has to start with '/' and be shorter than %zu.", path, sizeof(output->path));
+      continue;
+    } else if (n >= CAMERA_MAX_OUTPUTS) {
+      LOG_INFO(camera, "Too many outputs. Maximum is %d.", CAMERA_MAX_OUTPUTS);
+      break;
+    }
+
+    for (char *ptr = own_options; ptr && (ptr = strchr(ptr, ',')) != NULL; ) {
+      *ptr = OPTION_VALUE_LIST_SEP_CHAR;
+    }
+
+    const char *base_options = format == V4L2_PIX_FMT_H264 ? options->video.options : options->stream.options;
+    const char *sep = base_options[0] && own_options && own_options[0] ? OPTION_VALUE_LIST_SEP : "";
+    int len = snprintf(output->options, sizeof(output->options), "%s%s%s",
+      base_options, sep, own_options ? own_options : "");
+
+    if (len >= sizeof(output->options)) {
+      LOG_INFO(camera, "The options of the output '%s' are too long.", name);
+      memset(output, 0, sizeof(*output));
+      continue;
+    }
+
+    strcpy(output->name, name);
+    if (path && *path) {
+      strcpy(output->path, path);
+    } else {
+      snprintf(output->path, sizeof(output->path), "/%s", name);
+    }
+    output->format = format;
+    output->height = height;
+    output->fps = fields[3] ? strtoul(fields[3], NULL, 10) : 0;
+    output_locks_extra(camera->locks, n, output->name, format == V4L2_PIX_FMT_H264);
+    n++;
+  }
+}
+
+// The last `video_bitrate` of the options, as applied to the encoder
+unsigned camera_output_bitrate(camera_output_options_t *options)
+{
+  static const char key[] = "video_bitrate=";
+  unsigned bitrate = 0;
+
+  for (const char *ptr = options->options; (ptr = strstr(ptr, key)) != NULL; ptr++) {
+    if (ptr == options->options || ptr[-1] == OPTION_VALUE_LIST_SEP_CHAR) {
+      bitrate = strtoul(ptr + sizeof(key) - 1, NULL, 10);
+    }
+  }
+
+  return bitrate;
+}
+
+// Sets the `key=value` last in the device options of the output,
+// returns 0 if already set, or -1 if it does not fit
+int camera_set_output_option(camera_output_options_t *output, const char *key, const char *value)
+{
+  char current[CAMERA_OPTIONS_LENGTH];
+  char options[CAMERA_OPTIONS_LENGTH];
+  char *string = current;
+  char *option;
+  size_t key_len = strlen(key);
+  int len = 0;
+
+  strcpy(current, output->options);
+
+  while ((option = strsep(&string, OPTION_VALUE_LIST_SEP)) != NULL && len < (int)sizeof(options)) {
+    if (!option[0] || (!strncmp(option, key, key_len) && option[key_len] == '='))
+      continue;
+    len += snprintf(options + len, sizeof(options) - len, "%s%s", len ? OPTION_VALUE_LIST_SEP : "", option);
+  }
+
+  if (len < (int)sizeof(options)) {
+    len += snprintf(options + len, sizeof(options) - len, "%s%s=%s", len ? OPTION_VALUE_LIST_SEP : "", key, value);
+  }
+  if (len >= (int)sizeof(options)) {
+    return -1;
+  } else if (!strcmp(options, output->options)) {
+    return 0;
+  }
+
+  strcpy(output->options, options);
+  return 1;
+}
@@ -0,0 +1,366 @@
+#include "camera.h"
+
+#include "device/buffer.h"
+#include "device/buffer_list.h"
+#include "device/device.h"
+#include "device/device_list.h"
+#include "util/opts/log.h"
+#include "util/opts/fourcc.h"
+
+#define MATCH_ALIGN_SIZE 32
+#define MAX_PLANS 32
+
+// The cost of a plan is the weighted sum of:
+// - the MiB copied by CPU per frame (no DMA between the devices),
+// - the number of M2M devices,
+// - the MiB of the allocated buffers,
+// - the estimated latency in ms.
+#define PLAN_COST_MEMCPY_MB 4.0f
+#define PLAN_COST_HOP 2.0f
+#define PLAN_COST_MEMORY_MB 0.5f
+#define PLAN_COST_LATENCY_MS 1.0f
+
+#define PLAN_HOP_LATENCY_MS 2.0f
+#define PLAN_HOP_MB_PER_MS 0.5f
+#define PLAN_MEMCPY_MB_PER_MS 1.0f
+
+#define MiB (1024.0f * 1024.0f)
+
+unsigned camera_rescalled_formats[] =
+{
+  // best quality
+  V4L2_PIX_FMT_YUYV,
+
+  // medium quality
+  V4L2_PIX_FMT_YUV420,
+  V4L2_PIX_FMT_NV12,
+
+  // low quality
+  V4L2_PIX_FMT_NV21,
+  V4L2_PIX_FMT_YVU420,
+
+  0
+};
+
+static const char *camera_plan_type_names[] = {
+  [CAMERA_PLAN_USE_CAPTURE] = "USE",
+  [CAMERA_PLAN_ENCODE] = "ENCODE",
+  [CAMERA_PLAN_RESCALE_ENCODE] = "RESCALE+ENCODE",
+  [CAMERA_PLAN_DECODE_ENCODE] = "DECODE+ENCODE",
+  [CAMERA_PLAN_DECODE_RESCALE_ENCODE] = "DECODE+RESCALE+ENCODE",
+};
+
+// Estimates the size of the frame, the compressed formats at ~1/8 of the pixels
+static uint64_t camera_plan_frame_bytes(unsigned format, unsigned width, unsigned height)
+{
+  uint64_t pixels = (uint64_t)width * height;
+
+  switch (format) {
+  case V4L2_PIX_FMT_MJPEG:
+  case V4L2_PIX_FMT_JPEG:
+  case V4L2_PIX_FMT_H264:
+    return pixels / 8;
+
+  case V4L2_PIX_FMT_YUYV:
+  case V4L2_PIX_FMT_RGB565:
+  case V4L2_PIX_FMT_SRGGB10:
+  case V4L2_PIX_FMT_SGRBG10:
+    return pixels * 2;
+
+  case V4L2_PIX_FMT_RGB24:
+  case V4L2_PIX_FMT_BGR24:
+    return pixels * 3;
+
+  case V4L2_PIX_FMT_SRGGB10P:
+  case V4L2_PIX_FMT_SGRBG10P:
+  case V4L2_PIX_FMT_SBGGR10P:
+    return pixels * 5 / 4;
+
+  default:
+    return pixels * 3 / 2;
+  }
+}
+
+static bool camera_plan_has_format(unsigned formats[], unsigned format)
+{
+  for (int i = 0; formats[i]; i++) {
+    if (formats[i] == format)
+      return true;
+  }
+  return false;
+}
+
+static bool camera_plan_matches_height(unsigned height, unsigned target_height)
+{
+  return !target_height || abs((int)height - (int)target_height) <= MATCH_ALIGN_SIZE;
+}
+
+static void camera_plan_add_hop(camera_t *camera, camera_plan_t *plan, bool allow_dma,
+  unsigned in_format, unsigned in_width, unsigned in_height,
+  unsigned out_format, unsigned out_width, unsigned out_height)
+{
+  uint64_t in_bytes = camera_plan_frame_bytes(in_format, in_width, in_height);
+  uint64_t out_bytes = camera_plan_frame_bytes(out_format, out_width, out_height);
+  unsigned nbufs = MAX(camera->options.nbufs, 1);
+
+  plan->hops++;
+  plan->memory_bytes += out_bytes * nbufs;
+  plan->latency_ms += PLAN_HOP_LATENCY_MS + in_bytes / MiB / PLAN_HOP_MB_PER_MS;
+
+  if (!allow_dma) {
+    plan->memcpy_bytes += in_bytes;
+    plan->memory_bytes += in_bytes * nbufs;
+    plan->latency_ms += in_bytes / MiB / PLAN_MEMCPY_MB_PER_MS;
+  }
+}
+
+static void camera_plan_score(camera_plan_t *plan)
+{
+  plan->cost =
+    plan->memcpy_bytes / MiB * PLAN_COST_MEMCPY_MB +
+    plan->hops * PLAN_COST_HOP +
+    plan->memory_bytes / MiB * PLAN_COST_MEMORY_MB +
+    plan->latency_ms * PLAN_COST_LATENCY_MS;
+}
+
+static bool camera_plan_has_free_rescaller(camera_t *camera)
+{
+  for (int i = 0; i < MAX_RESCALLERS; i++) {
+    if (!camera->rescallers[i])
+      return true;
+  }
+  return false;
+}
+
+static bool camera_plan_can_rescale(camera_t *camera, unsigned source_format, unsigned format, unsigned formats[])
+{
+  return device_list_find_m2m_format(camera->device_list, source_format, format) &&
+    device_list_find_m2m_formats(camera->device_list, format, formats, NULL);
+}
+
+// Finds the format the source can be rescaled to, and then encoded,
+// in the order of `camera_configure_rescaller()`
+static unsigned camera_plan_rescalled_format(camera_t *camera, unsigned source_format, unsigned formats[])
+{
+  if (camera_plan_can_rescale(camera, source_format, source_format, formats))
+    return source_format;
+
+  for (int i = 0; camera_rescalled_formats[i]; i++) {
+    if (camera_plan_can_rescale(camera, source_format, camera_rescalled_formats[i], formats))
+      return camera_rescalled_formats[i];
+  }
+
+  return 0;
+}
+
+static void camera_plan_append(camera_plan_t *plans, int *nplans, camera_plan_t *plan)
+{
+  if (*nplans < MAX_PLANS) {
+    camera_plan_score(plan);
+    plans[(*nplans)++] = *plan;
+  }
+}
+
+// Adds the plans encoding (and rescaling) the raw frames of the given source
+static void camera_plan_encode(camera_t *camera, camera_plan_t *base, bool allow_dma,
+  buffer_format_t *selected_format, buffer_format_t *rescalled_format, unsigned formats[],
+  camera_plan_t *plans, int *nplans)
+{
+  unsigned chosen_format = 0;
+
+  if (!camera_plan_has_format(camera_rescalled_formats, base->source_format))
+    return;
+
+  if (camera_plan_matches_height(base->source_height, selected_format->height) ||
+    camera_plan_matches_height(base->source_height, rescalled_format->height)) {
+    if (device_list_find_m2m_formats(camera->device_list, base->source_format, formats, &chosen_format)) {
+      camera_plan_t plan = *base;
+      plan.format = chosen_format;
+      camera_plan_add_hop(camera, &plan, allow_dma,
+        base->source_format, base->source_width, base->source_height,
+        chosen_format, base->source_width, base->source_height);
+      camera_plan_append(plans, nplans, &plan);
+    }
+    return;
+  }
+
+  // do not upscale the already downscaled captures
+  if (!camera_plan_has_free_rescaller(camera) || base->source_height < rescalled_format->height)
+    return;
+
+  unsigned rescaled_format = camera_plan_rescalled_format(camera, base->source_format, formats);
+  if (!rescaled_format)
+    return;
+
+  device_list_find_m2m_formats(camera->device_list, rescaled_format, formats, &chosen_format);
+
+  camera_plan_t plan = *base;
+  unsigned width = rescalled_format->height * base->source_width / base->source_height;
+
+  plan.type = base->type == CAMERA_PLAN_DECODE_ENCODE ? CAMERA_PLAN_DECODE_RESCALE_ENCODE : CAMERA_PLAN_RESCALE_ENCODE;
+  plan.rescale_height = rescalled_format->height;
+  plan.format = chosen_format;
+  camera_plan_add_hop(camera, &plan, allow_dma,
+    base->source_format, base->source_width, base->source_height,
+    rescaled_format, width, rescalled_format->height);
+  camera_plan_add_hop(camera, &plan, camera->camera->opts.allow_dma,
+    rescaled_format, width, rescalled_format->height,
+    chosen_format, width, rescalled_format->height);
+  camera_plan_append(plans, nplans, &plan);
+}
+
+// The captures of the other outputs are shared only when encoded the same way
+static bool camera_plan_can_share(camera_t *camera, buffer_list_t *capture, camera_output_options_t *options)
+{
+  for (int i = 0; i < CAMERA_PIPELINE_OUTPUTS; i++) {
+    camera_output_options_t *other;
+    struct buffer_lock_s *buf_lock;
+    device_t **device;
+
+    if (!camera_get_pipeline_output(camera, i, &other, &buf_lock, &device) || *device != capture->dev)
+      continue;
+
+    return !strcmp(other->options, options->options) &&
+      other->fps == options->fps && other->keepalive_ms == options->keepalive_ms;
+  }
+
+  return true;
+}
+
+static void camera_plan_from_capture(camera_t *camera, buffer_list_t *capture, camera_output_options_t *options,
+  buffer_format_t *selected_format, buffer_format_t *rescalled_format, unsigned formats[],
+  camera_plan_t *plans, int *nplans)
+{
+  camera_plan_t base = {
+    .type = CAMERA_PLAN_ENCODE,
+    .source = capture,
+    .source_format = capture->fmt.format,
+    .source_width = capture->fmt.width,
+    .source_height = capture->fmt.height,
+  };
+
+  if (camera_plan_has_format(formats, capture->fmt.format) &&
+    camera_plan_matches_height(capture->fmt.height, selected_format->height) &&
+    camera_plan_can_share(camera, capture, options)) {
+    camera_plan_t plan = base;
+    plan.type = CAMERA_PLAN_USE_CAPTURE;
+    plan.format = capture->fmt.format;
+    camera_plan_append(plans, nplans, &plan);
+  }
+
+  camera_plan_encode(camera, &base, capture->dev->opts.allow_dma,
+    selected_format, rescalled_format, formats, plans, nplans);
+}
+
+static void camera_plan_from_decoder(camera_t *camera, buffer_list_t *camera_capture,
+  buffer_format_t *selected_format, buffer_format_t *rescalled_format, unsigned formats[],
+  camera_plan_t *plans, int *nplans)
+{
+  unsigned decoded_format = 0;
+
+  if (camera->decoder || camera->isp)
+    return;
+
+  switch (camera_capture->fmt.format) {
+  case V4L2_PIX_FMT_SRGGB10P:
+  case V4L2_PIX_FMT_SGRBG10P:
+  case V4L2_PIX_FMT_SBGGR10P:
+  case V4L2_PIX_FMT_SRGGB10:
+  case V4L2_PIX_FMT_SGRBG10:
+    decoded_format = V4L2_PIX_FMT_YUYV;
+    break;
+
+  case V4L2_PIX_FMT_MJPEG:
+  case V4L2_PIX_FMT_H264:
+    device_list_find_m2m_formats(camera->device_list, camera_capture->fmt.format, camera_decoder_formats, &decoded_format);
+    break;
+  }
+
+  if (!decoded_format)
+    return;
+
+  camera_plan_t base = {
+    .type = CAMERA_PLAN_DECODE_ENCODE,
+    .source = camera_capture,
+    .source_format = decoded_format,
+    .source_width = camera_capture->fmt.width,
+    .source_height = camera_capture->fmt.height,
+  };
+
+  camera_plan_add_hop(camera, &base, camera_capture->dev->opts.allow_dma,
+    camera_capture->fmt.format, camera_capture->fmt.width, camera_capture->fmt.height,
+    decoded_format, camera_capture->fmt.width, camera_capture->fmt.height);
+
+  camera_plan_encode(camera, &base, camera->camera->opts.allow_dma,
+    selected_format, rescalled_format, formats, plans, nplans);
+}
+
+void camera_plan_print(camera_t *camera, const char *name, camera_plan_t *plan, FILE *stream)
+{
+  fprintf(stream, "%s: %s from %s (%s %ux%u)",
+    name, camera_plan_type_names[plan->type], plan->source->name,
+    fourcc_to_string(plan->source_format).buf, plan->source_width, plan->source_height);
+
+  if (plan->rescale_height) {
+    fprintf(stream, " to %up", plan->rescale_height);
+  }
+
+  fprintf(stream, " as %s: hops=%u, memcpy=%.2fMiB, memory=%.2fMiB, latency=%.1fms, cost=%.1f\n",
+    fourcc_to_string(plan->format).buf, plan->hops,
+    plan->memcpy_bytes / MiB, plan->memory_bytes / MiB, plan->latency_ms, plan->cost);
+}
+
+// Returns 1 when the `plan` was found, 0 when the output is disabled
+int camera_plan_output(camera_t *camera, buffer_list_t *camera_capture, const char *name, camera_output_options_t *options, unsigned formats[], camera_plan_t *plan)
+{
+  buffer_format_t selected_format = {0};
+  buffer_format_t rescalled_format = {0};
+  camera_plan_t plans[MAX_PLANS];
+  int nplans = 0;
+
+  if (!camera_get_scaled_resolution(camera_capture->fmt, options, &selected_format, 1)) {
+    return 0;
+  }
+
+  if (!camera_get_scaled_resolution(camera_capture->fmt, options, &rescalled_format, RESCALLER_BLOCK_SIZE)) {
+    return 0;
+  }
+
+  for (int i = 0; i < MAX_DEVICES; i++) {
+    device_t *device = camera->devices[i];
+    if (!device)
+      continue;
+
+    for (int j = 0; j < device->n_capture_list; j++) {
+      camera_plan_from_capture(camera, device->capture_lists[j], options,
+        &selected_format, &rescalled_format, formats, plans, &nplans);
+    }
+  }
+
+  camera_plan_from_decoder(camera, camera_capture,
+    &selected_format, &rescalled_format, formats, plans, &nplans);
+
+  if (!nplans) {
+    LOG_INFO(camera, "Cannot find source for '%s' for one of the formats '%s'.", name, many_fourcc_to_string(formats).buf);
+    return -1;
+  }
+
+  int best = 0;
+  for (int i = 0; i < nplans; i++) {
+    if (plans[i].cost < plans[best].cost)
+      best = i;
+
+    if (camera->options.dry_run) {
+      printf("  ");
+      camera_plan_print(camera, name, &plans[i], stdout);
+    }
+  }
+
+  *plan = plans[best];
+
+  if (camera->options.dry_run) {
+    printf("* ");
+    camera_plan_print(camera, name, plan, stdout);
+  }
+  return 1;
+}
@@ -0,0 +1,410 @@
+#include "camera.h"
+
+#include "device/buffer.h"
+#include "device/buffer_list.h"
+#include "device/buffer_lock.h"
+#include "device/device.h"
+#include "device/links.h"
+#include "util/opts/log.h"
+#include "util/opts/fourcc.h"
+#include "output/output.h"
+
+#define RECONFIGURE_WAIT_BUFFERS_MS 1000
+
+static link_t *camera_find_link(camera_t *camera, buffer_list_t *capture)
+{
+  for (int i = 0; i < camera->nlinks; i++) {
+    if (camera->links[i].capture_list == capture) {
+      return &camera->links[i];
+    }
+  }
+
+  return NULL;
+}
+
+static void camera_remove_link(camera_t *camera, link_t *link)
+{
+  int index = link - camera->links;
+
+  memmove(link, link + 1, (camera->nlinks - index - 1) * sizeof(link_t));
+  camera->nlinks--;
+  memset(&camera->links[camera->nlinks], 0, sizeof(link_t));
+}
+
+static void camera_remove_output(camera_t *camera, buffer_list_t *output)
+{
+  for (int i = 0; i < camera->nlinks; i++) {
+    link_t *link = &camera->links[i];
+
+    for (int j = 0; j < link->n_output_lists; j++) {
+      if (link->output_lists[j] != output)
+        continue;
+
+      memmove(&link->output_lists[j], &link->output_lists[j + 1],
+        (link->n_output_lists - j - 1) * sizeof(buffer_list_t *));
+      link->n_output_lists--;
+      return;
+    }
+  }
+}
+
+static void camera_remove_callbacks(camera_t *camera, buffer_lock_t *buf_lock)
+{
+  for (int i = 0; i < camera->nlinks; i++) {
+    link_t *link = &camera->links[i];
+
+    for (int j = 0; j < link->n_callbacks; ) {
+      if (link->callbacks[j].buf_lock != buf_lock) {
+        j++;
+        continue;
+      }
+
+      memmove(&link->callbacks[j], &link->callbacks[j + 1],
+        (link->n_callbacks - j - 1) * sizeof(link_callbacks_t));
+      link->n_callbacks--;
+    }
+  }
+
+  // release the last frame, the consumers wait for the new one
+  buffer_lock_capture(buf_lock, NULL);
+  pthread_mutex_lock(&buf_lock->lock);
+  buf_lock->buf_list = NULL;
+  pthread_mutex_unlock(&buf_lock->lock);
+}
+
+// Gives the consumers a moment to release the buffers, the free ones hold a single reference
+static bool camera_wait_buffers(buffer_list_t *buf_list)
+{
+  uint64_t deadline_us = get_monotonic_time_us(NULL, NULL) + RECONFIGURE_WAIT_BUFFERS_MS * 1000LL;
+
+  while (get_monotonic_time_us(NULL, NULL) < deadline_us) {
+    bool used = false;
+
+    for (int i = 0; i < buf_list->nbufs; i++) {
+      buffer_t *buf = buf_list->bufs[i];
+      used = used || (!buf->enqueued && buf->mmap_reflinks > 1);
+    }
+
+    if (!used)
+      return true;
+
+    usleep(10 * 1000);
+  }
+
+  return false;
+}
+
+static void camera_close_device(camera_t *camera, device_t *device)
+{
+  for (int i = 0; i < device->n_capture_list; i++) {
+    link_t *link = camera_find_link(camera, device->capture_lists[i]);
+    if (link) {
+      camera_remove_link(camera, link);
+    }
+    camera_wait_buffers(device->capture_lists[i]);
+    buffer_list_set_stream(device->capture_lists[i], false);
+  }
+
+  if (device->output_list) {
+    buffer_list_t *output_list = device->output_list;
+
+    camera_remove_output(camera, output_list);
+    buffer_list_set_stream(output_list, false);
+
+    // give back the source buffers that are still held by the device
+    for (int i = 0; i < output_list->nbufs; i++) {
+      buffer_t *buf = output_list->bufs[i];
+      if (buf->dma_source) {
+        buffer_consumed(buf->dma_source, "reconfigure");
+        buf->dma_source = NULL;
+      }
+    }
+  }
+
+  for (int i = 0; i < MAX_DEVICES; i++) {
+    if (camera->devices[i] == device) {
+      camera->devices[i] = NULL;
+    }
+  }
+
+  LOG_INFO(camera, "Closing '%s' for reconfiguration.", device->name);
+  device_release(device);
+}
+
+static void camera_close_unused_rescallers(camera_t *camera)
+{
+  for (int i = 0; i < MAX_RESCALLERS; i++) {
+    device_t *rescaller = camera->rescallers[i];
+
+    if (!rescaller || !rescaller->n_capture_list)
+      continue;
+
+    link_t *link = camera_find_link(camera, rescaller->capture_lists[0]);
+    if (link && (link->n_output_lists > 0 || link->n_callbacks > 0))
+      continue;
+
+    camera_close_device(camera, rescaller);
+  }
+}
+
+static bool camera_output_changed(camera_output_options_t *current, camera_output_options_t *options)
+{
+  return current->height != options->height || current->disabled != options->disabled;
+}
+
+static bool camera_output_options_changed(camera_output_options_t *current, camera_output_options_t *options)
+{
+  return strcmp(current->options, options->options) != 0;
+}
+
+// Marks the outputs that reuse the capture of the reconfigured output
+static void camera_mark_dependent_outputs(camera_t *camera, bool changed[])
+{
+  for (int i = 0; i < CAMERA_PIPELINE_OUTPUTS; i++) {
+    camera_output_options_t *options;
+    buffer_lock_t *buf_lock;
+    device_t **device;
+
+    if (!camera_get_pipeline_output(camera, i, &options, &buf_lock, &device))
+      continue;
+    if (!changed[i] || !*device || !(*device)->n_capture_list)
+      continue;
+
+    link_t *link = camera_find_link(camera, (*device)->capture_lists[0]);
+    if (!link)
+      continue;
+
+    for (int j = 0; j < CAMERA_PIPELINE_OUTPUTS; j++) {
+      camera_output_options_t *other_options;
+      buffer_lock_t *other_buf_lock;
+      device_t **other_device;
+
+      if (!camera_get_pipeline_output(camera, j, &other_options, &other_buf_lock, &other_device))
+        continue;
+
+      for (int k = 0; k < link->n_callbacks; k++) {
+        if (link->callbacks[k].buf_lock == other_buf_lock && !changed[j]) {
+          changed[j] = true;
+          i = -1; // start again
+        }
+      }
+    }
+  }
+}
+
+static int camera_reconfigure_outputs(camera_t *camera, camera_options_t *new_options)
+{
+  bool changed[CAMERA_PIPELINE_OUTPUTS] = {0};
+  bool any_changed = false;
+  int ret = 0;
+
+  for (int i = 0; i < CAMERA_PIPELINE_OUTPUTS; i++) {
+    camera_output_options_t *options;
+    buffer_lock_t *buf_lock;
+    device_t **device;
+
+    const char *name = camera_get_pipeline_output(camera, i, &options, &buf_lock, &device);
+    if (!name)
+      continue;
+    changed[i] = camera_output_changed(options, camera_pipeline_output_options(new_options, i));
+    any_changed = any_changed || changed[i];
+  }
+
+  // the devices accept the options while streaming, the reopened ones get them below
+  for (int i = 0; i < CAMERA_PIPELINE_OUTPUTS; i++) {
+    camera_output_options_t *options;
+    buffer_lock_t *buf_lock;
+    device_t **device;
+
+    const char *name = camera_get_pipeline_output(camera, i, &options, &buf_lock, &device);
+    camera_output_options_t *change = camera_pipeline_output_options(new_options, i);
+    if (!name || !camera_output_options_changed(options, change))
+      continue;
+
+    LOG_INFO(camera, "Reconfiguring '%s' options to '%s'.", name, change->options);
+    strcpy(options->options, change->options);
+    if (!changed[i] && device_set_option_list(*device, options->options) < 0) {
+      ret = -1;
+    }
+  }
+
+  if (!any_changed) {
+    return ret;
+  }
+
+  camera_mark_dependent_outputs(camera, changed);
+
+  // detach the affected outputs, the rest keeps its devices
+  for (int i = 0; i < CAMERA_PIPELINE_OUTPUTS; i++) {
+    camera_output_options_t *options;
+    buffer_lock_t *buf_lock;
+    device_t **device;
+
+    const char *name = camera_get_pipeline_output(camera, i, &options, &buf_lock, &device);
+    if (!name)
+      continue;
+    if (!changed[i])
+      continue;
+
+    camera_output_options_t *change = camera_pipeline_output_options(new_options, i);
+    LOG_INFO(camera, "Reconfiguring '%s' from %dp to %dp.", name,
+      options->disabled ? 0 : options->height, change->disabled ? 0 : change->height);
+
+    camera_remove_callbacks(camera, buf_lock);
+    if (*device) {
+      camera_close_device(camera, *device);
+    }
+  }
+
+  camera_close_unused_rescallers(camera);
+
+  for (int i = 0; i < CAMERA_PIPELINE_OUTPUTS; i++) {
+    camera_output_options_t *options;
+    buffer_lock_t *buf_lock;
+    device_t **device;
+
+    const char *name = camera_get_pipeline_output(camera, i, &options, &buf_lock, &device);
+    if (!name)
+      continue;
+    if (!changed[i])
+      continue;
+
+    camera_output_options_t *change = camera_pipeline_output_options(new_options, i);
+    options->height = change->height;
+    options->disabled = change->disabled;
+
+    if (camera_configure_pipeline_output(camera, i) < 0) {
+      return -1;
+    }
+
+    if (*device && (*device)->capture_lists[0]->fmt.format == V4L2_PIX_FMT_H264) {
+      device_set_option_string(*device, "repeat_sequence_header", "1"); // required for force key support
+    }
+    if (camera->options.type == CAMERA_DUMMY) {
+      device_set_option_list(*device, camera->options.dummy.options);
+    }
+    device_set_option_list(*device, options->options);
+  }
+
+  return ret;
+}
+
+static int camera_reconfigure_fps(camera_t *camera, unsigned fps)
+{
+  if (camera->options.fps == fps) {
+    return 0;
+  }
+
+  LOG_INFO(camera, "Reconfiguring FPS from %d to %d.", camera->options.fps, fps);
+
+  // V4L2 does not allow to change `S_PARM` while streaming
+  // it is started again by the `links_loop()`
+  if (camera->options.type == CAMERA_V4L2) {
+    for (int i = 0; i < camera->camera->n_capture_list; i++) {
+      buffer_list_set_stream(camera->camera->capture_lists[i], false);
+    }
+  }
+
+  camera->options.fps = fps;
+  return device_set_fps(camera->camera, fps);
+}
+
+// Applies the pending changes, called by the `camera_run()` between
+// the `links_loop()` steps, or once stopped if the devices are re-opened
+bool camera_apply_reconfigure(camera_t *camera, bool stopped)
+{
+  int ret = 0;
+
+  pthread_mutex_lock(&camera->reconfigure.lock);
+  if (!camera->reconfigure.pending || (camera->reconfigure.restart && !stopped)) {
+    pthread_mutex_unlock(&camera->reconfigure.lock);
+    return false;
+  }
+
+  if (camera_reconfigure_fps(camera, camera->reconfigure.options.fps) < 0) {
+    ret = -1;
+  }
+  if (camera_reconfigure_outputs(camera, &camera->reconfigure.options) < 0) {
+    ret = -1;
+  }
+  output_locks_set_videos(camera->locks, &camera->options);
+
+  if (camera->reconfigure.restart) {
+    links_dump(camera->links);
+    links_dump_copies(camera->links);
+  }
+
+  camera->reconfigure.pending = false;
+  camera->reconfigure.result = ret;
+  pthread_cond_broadcast(&camera->reconfigure.cond);
+  pthread_mutex_unlock(&camera->reconfigure.lock);
+  return true;
+}
+
+static void camera_wait_reconfigure(camera_t *camera, uint64_t deadline_us)
+{
+  while (camera->reconfigure.pending && get_monotonic_time_us(NULL, NULL) < deadline_us) {
+    struct timespec timeout;
+
+    // stop the `links_loop()`, repeated as it might be just starting
+    if (camera->reconfigure.restart) {
+      camera->running = false;
+    }
+
+    get_time_us(CLOCK_REALTIME, &timeout, NULL, LINKS_LOOP_INTERVAL * 1000LL);
+    pthread_cond_timedwait(&camera->reconfigure.cond, &camera->reconfigure.lock, &timeout);
+  }
+}
+
+// Copies the options, as they are changed by the camera thread
+void camera_get_options(camera_t *camera, camera_options_t *options)
+{
+  pthread_mutex_lock(&camera->reconfigure.lock);
+  *options = camera->options;
+  pthread_mutex_unlock(&camera->reconfigure.lock);
+}
+
+// Schedules the changes of the fps, the output heights and the device
+// options, and waits for the camera thread to apply them. Other changes are ignored.
+int camera_reconfigure(camera_t *camera, camera_options_t *options, int timeout_ms)
+{
+  uint64_t deadline_us = get_monotonic_time_us(NULL, NULL) + timeout_ms * 1000LL;
+  int ret = 0;
+
+  pthread_mutex_lock(&camera->reconfigure.lock);
+
+  // wait for the other request
+  camera_wait_reconfigure(camera, deadline_us);
+  if (camera->reconfigure.pending) {
+    ret = -1;
+    goto unlock;
+  }
+
+  bool restart = camera->options.fps != options->fps;
+  bool changed = false;
+  for (int i = 0; i < CAMERA_PIPELINE_OUTPUTS; i++) {
+    restart = restart || camera_output_changed(camera_pipeline_output_options(&camera->options, i),
+      camera_pipeline_output_options(options, i));
+    changed = changed || camera_output_options_changed(camera_pipeline_output_options(&camera->options, i),
+      camera_pipeline_output_options(options, i));
+  }
+  if (!restart && !changed) {
+    goto unlock;
+  }
+
+  camera->reconfigure.options = *options;
+  camera->reconfigure.restart = restart;
+  camera->reconfigure.pending = true;
+  camera_wait_reconfigure(camera, deadline_us);
+
+  if (camera->reconfigure.pending) {
+    camera->reconfigure.pending = false;
+    ret = -1;
+  } else {
+    ret = camera->reconfigure.result;
+  }
+
+unlock:
+  pthread_mutex_unlock(&camera->reconfigure.lock);
+  return ret;
+}
@@ -69,7 +69,7 @@ buffer_list_t *camera_try_rescaller(camera_t *camera, buffer_list_t *src_capture
   char name2[256];
   sprintf(name2, "RESCALLER:%s", name);
 
-  device_t *device = device_v4l2_open(name2, device_info->path);
+  device_t *device = device_info->device_open(name2, device_info->path);
 
   buffer_list_t *rescaller_output = device_open_buffer_list_output(
     device, src_capture);
@@ -97,8 +97,57 @@ buffer_list_t *camera_try_rescaller(camera_t *camera, buffer_list_t *src_capture
   return rescaller_capture;
 }
 
+// Finds the rescaller already fed from the source at the same resolution
+static buffer_list_t *camera_find_rescaller(camera_t *camera, buffer_list_t *src_capture, unsigned target_height, unsigned formats[])
+{
+  buffer_format_t target_fmt = {0};
+
+  camera_get_scaled_resolution2(
+    src_capture->fmt.width, src_capture->fmt.height,
+    target_height,
+    &target_fmt.width, &target_fmt.height,
+    RESCALLER_BLOCK_SIZE
+  );
+
+  for (int i = 0; i < camera->nlinks; i++) {
+    link_t *link = &camera->links[i];
+
+    if (link->capture_list != src_capture)
+      continue;
+
+    for (int j = 0; j < link->n_output_lists; j++) {
+      device_t *device = link->output_lists[j]->dev;
+      buffer_list_t *capture = device->n_capture_list ? device->capture_lists[0] : NULL;
+
+      if (!capture || capture->fmt.width != target_fmt.width || capture->fmt.height != target_fmt.height)
+        continue;
+
+      for (int k = 0; k < MAX_RESCALLERS; k++) {
+        if (camera->rescallers[k] != device)
+          continue;
+
+        bool format_ok = capture->fmt.format == src_capture->fmt.format;
+        for (int f = 0; !format_ok && formats[f]; f++) {
+          format_ok = capture->fmt.format == formats[f];
+        }
+
+        if (format_ok)
+          return capture;
+      }
+    }
+  }
+
+  return NULL;
+}
+
 buffer_list_t *camera_configure_rescaller(camera_t *camera, buffer_list_t *src_capture, const char *name, unsigned target_height, unsigned formats[])
 {
+  buffer_list_t *shared_capture = camera_find_rescaller(camera, src_capture, target_height, formats);
+  if (shared_capture) {
+    LOG_INFO(src_capture, "Sharing '%s' for '%s'.", shared_capture->dev->name, name);
+    return shared_capture;
+  }
+
   int rescallers = 0;
   for ( ; rescallers < MAX_RESCALLERS && camera->rescallers[rescallers]; rescallers++);
   if (rescallers == MAX_RESCALLERS) {
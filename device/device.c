@@ -179,12 +179,27 @@ int device_set_stream(device_t *dev, bool do_on)
   return 0;
 }
 
+// Coalesces the requests of the joining clients into a single key frame
 int device_video_force_key(device_t *dev)
 {
-  if (dev && dev->hw->device_video_force_key)
-    return dev->hw->device_video_force_key(dev);
+  uint64_t now_us = get_monotonic_time_us(NULL, NULL);
 
-  return -1;
+  if (!dev || !dev->hw->device_video_force_key)
+    return -1;
+
+  dev->force_key_requested++;
+
+  if (dev->force_key_us && now_us - dev->force_key_us < DEVICE_FORCE_KEY_INTERVAL_MS * 1000LL) {
+    dev->force_key_coalesced++;
+    LOG_DEBUG(dev, "Key frame was forced %.1fms ago.", (now_us - dev->force_key_us) / 1000.0f);
+    return -1;
+  }
+
+  int ret = dev->hw->device_video_force_key(dev);
+  if (ret == 0) {
+    dev->force_key_us = now_us;
+  }
+  return ret;
 }
 
 void device_dump_options(device_t *dev, FILE *stream)
@@ -48,6 +48,7 @@ typedef struct device_s {
 
   struct {
     bool allow_dma;
+    const char *no_dma_reason; // why `allow_dma` is false
   } opts;
 
   union {
@@ -57,6 +58,10 @@ typedef struct device_s {
   };
 
   bool paused;
+  bool released; // closed by the last `buffer_consumed()`, see `device_release()`
+  uint64_t force_key_us;
+  unsigned force_key_requested; // the joining clients, see `device_video_force_key()`
+  unsigned force_key_coalesced; // served by the key frame forced before
 } device_t;
 
 typedef enum device_option_type_s {
@@ -71,6 +76,7 @@ typedef enum device_option_type_s {
 } device_option_type_t;
 
 #define MAX_DEVICE_OPTION_MENU 20
+#define DEVICE_FORCE_KEY_INTERVAL_MS 1000
 
 typedef struct device_option_menu_s {
   int id;
@@ -97,6 +103,7 @@ typedef struct device_option_s {
 
 device_t *device_open(const char *name, const char *path, device_hw_t *hw);
 void device_close(device_t *dev);
+void device_release(device_t *dev);
 
 buffer_list_t *device_open_buffer_list(device_t *dev, bool do_capture, buffer_format_t fmt, bool do_mmap);
 buffer_list_t *device_open_buffer_list2(device_t *dev, const char *path, bool do_capture, buffer_format_t fmt, bool do_mmap);
@@ -120,3 +127,4 @@ int device_capture_enqueued(device_t *dev, int *max);
 device_t *device_v4l2_open(const char *name, const char *path);
 device_t *device_libcamera_open(const char *name, const char *path);
 device_t *device_dummy_open(const char *name, const char *path);
+device_t *device_dry_open(const char *name, const char *path);
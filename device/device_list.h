@@ -2,6 +2,8 @@
 
 #include <stdbool.h>
 
+typedef struct device_s device_t;
+
 typedef struct device_info_formats_s {
   unsigned *formats;
   unsigned n;
@@ -14,6 +16,8 @@ typedef struct device_info_s {
   bool camera;
   bool m2m;
 
+  device_t *(*device_open)(const char *name, const char *path);
+
   device_info_formats_t output_formats;
   device_info_formats_t capture_formats;
 } device_info_t;
@@ -23,7 +27,8 @@ typedef struct device_list_s {
   int ndevices;
 } device_list_t;
 
-device_list_t *device_list_v4l2();
+device_list_t *device_list_v4l2(const char *cache_path);
+device_list_t *device_list_dummy(device_list_t *list, const char *path);
 bool device_info_has_format(device_info_t *info, bool capture, unsigned format);
 device_info_t *device_list_find_m2m_format(device_list_t *list, unsigned output, unsigned capture);
 device_info_t *device_list_find_m2m_formats(device_list_t *list, unsigned output, unsigned capture_formats[], unsigned *found_format);
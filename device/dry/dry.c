@@ -0,0 +1,95 @@
+#include "device/device.h"
+#include "device/buffer.h"
+#include "device/buffer_list.h"
+#include "util/opts/log.h"
+#include "util/opts/fourcc.h"
+
+// The device used by `--camera-dry_run` to plan the pipeline
+// from the probed capabilities without touching the hardware:
+// formats are accepted as requested and no memory is allocated.
+
+static int dry_device_open(device_t *dev)
+{
+  return 0;
+}
+
+static void dry_device_close(device_t *dev)
+{
+}
+
+static int dry_device_set_option(device_t *dev, const char *key, const char *value)
+{
+  return 0;
+}
+
+static int dry_buffer_open(buffer_t *buf)
+{
+  buf->start = NULL;
+  buf->length = buf->buf_list->fmt.sizeimage;
+  return 0;
+}
+
+static void dry_buffer_close(buffer_t *buf)
+{
+}
+
+static int dry_buffer_enqueue(buffer_t *buf, const char *who)
+{
+  return -1;
+}
+
+static int dry_buffer_list_dequeue(buffer_list_t *buf_list, buffer_t **bufp)
+{
+  return -1;
+}
+
+static int dry_buffer_list_pollfd(buffer_list_t *buf_list, struct pollfd *pollfd, bool can_dequeue)
+{
+  return -1;
+}
+
+static int dry_buffer_list_open(buffer_list_t *buf_list)
+{
+  buffer_format_t *fmt = &buf_list->fmt;
+
+  if (!fmt->bytesperline && fmt->format != V4L2_PIX_FMT_MJPEG &&
+    fmt->format != V4L2_PIX_FMT_JPEG && fmt->format != V4L2_PIX_FMT_H264) {
+    fmt->bytesperline = fmt->width * 2;
+  }
+  if (!fmt->sizeimage) {
+    fmt->sizeimage = fmt->bytesperline ? fmt->bytesperline * fmt->height : fmt->width * fmt->height / 2;
+  }
+
+  LOG_VERBOSE(buf_list, "Planned %s %ux%u.", fourcc_to_string(fmt->format).buf, fmt->width, fmt->height);
+  return MAX(fmt->nbufs, 1);
+}
+
+static void dry_buffer_list_close(buffer_list_t *buf_list)
+{
+}
+
+static int dry_buffer_list_set_stream(buffer_list_t *buf_list, bool do_on)
+{
+  return 0;
+}
+
+device_hw_t dry_device_hw = {
+  .device_open = dry_device_open,
+  .device_close = dry_device_close,
+  .device_set_option = dry_device_set_option,
+
+  .buffer_open = dry_buffer_open,
+  .buffer_close = dry_buffer_close,
+  .buffer_enqueue = dry_buffer_enqueue,
+
+  .buffer_list_dequeue = dry_buffer_list_dequeue,
+  .buffer_list_pollfd = dry_buffer_list_pollfd,
+  .buffer_list_open = dry_buffer_list_open,
+  .buffer_list_close = dry_buffer_list_close,
+  .buffer_list_set_stream = dry_buffer_list_set_stream
+};
+
+device_t *device_dry_open(const char *name, const char *path)
+{
+  return device_open(name, path, &dry_device_hw);
+}
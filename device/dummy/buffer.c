@@ -1,6 +1,7 @@
 #include "dummy.h"
 #include "device/buffer.h"
 #include "device/buffer_list.h"
+#include "device/device.h"
 #include "util/opts/log.h"
 
 #include <stdlib.h>
@@ -9,22 +10,46 @@
 
 int dummy_buffer_open(buffer_t *buf)
 {
+  buffer_list_t *buf_list = buf->buf_list;
+
   buf->dummy = calloc(1, sizeof(buffer_dummy_t));
-  buf->start = buf->buf_list->dummy->data;
-  buf->used = buf->buf_list->dummy->length;
-  buf->length = buf->buf_list->dummy->length;
+
+  // M2M output and pass-through capture require its own memory
+  if (!buf_list->dummy->data) {
+    buf->dummy->data = calloc(1, buf_list->dummy->length);
+    buf->start = buf->dummy->data;
+    buf->used = 0;
+  } else {
+    buf->start = buf_list->dummy->data;
+    buf->used = buf_list->dummy->length;
+  }
+
+  buf->length = buf_list->dummy->length;
   return 0;
 }
 
 void dummy_buffer_close(buffer_t *buf)
 {
+  if (buf->dummy) {
+    free(buf->dummy->data);
+  }
   free(buf->dummy);
 }
 
 int dummy_buffer_enqueue(buffer_t *buf, const char *who)
 {
+  device_t *dev = buf->buf_list->dev;
   unsigned index = buf->index;
-  if (write(buf->buf_list->dummy->fds[1], &index, sizeof(index)) != sizeof(index)) {
+  int fd = buf->buf_list->dummy->fds[1];
+
+  // M2M: the buffer is finished by `dummy_m2m_thread`
+  if (!buf->buf_list->do_capture) {
+    fd = dev->dummy->queued_fds[1];
+  } else if (dev->output_list) {
+    fd = dev->dummy->free_fds[1];
+  }
+
+  if (write(fd, &index, sizeof(index)) != sizeof(index)) {
     return -1;
   }
   return 0;
@@ -51,7 +76,9 @@ int dummy_buffer_list_dequeue(buffer_list_t *buf_list, buffer_t **bufp)
 int dummy_buffer_list_pollfd(buffer_list_t *buf_list, struct pollfd *pollfd, bool can_dequeue)
 {
   int count_enqueued = buffer_list_count_enqueued(buf_list);
-  pollfd->fd = buf_list->dummy->fds[0]; // write end
+  pollfd->fd = buf_list->dummy->fds[0]; // read end
+
+  // Both capture and output report finished buffers via `POLLIN` of the pipe
   pollfd->events = POLLHUP;
   if (can_dequeue && count_enqueued > 0) {
     pollfd->events |= POLLIN;
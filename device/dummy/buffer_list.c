@@ -2,59 +2,134 @@
 #include "device/buffer_list.h"
 #include "device/device.h"
 #include "util/opts/log.h"
+#include "util/opts/fourcc.h"
 
 #include <stdlib.h>
 #include <inttypes.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 
-int dummy_buffer_list_open(buffer_list_t *buf_list)
+static int dummy_buffer_list_read_file(buffer_list_t *buf_list, const char *path)
 {
-  int fd = -1;
-
-  buf_list->dummy = calloc(1, sizeof(buffer_list_dummy_t));
-  buf_list->dummy->fds[0] = -1;
-  buf_list->dummy->fds[1] = -1;
-
-  if (!buf_list->do_capture) {
-    LOG_ERROR(buf_list, "Only capture mode supported");
-  }
-
-  if (pipe2(buf_list->dummy->fds, O_DIRECT|O_CLOEXEC) < 0) {
-    LOG_INFO(buf_list, "Cannot open `pipe2`.");
-    return -1;
-  }
-
-  fd = open(buf_list->dev->path, O_RDWR|O_NONBLOCK);
+  int fd = open(path, O_RDWR|O_NONBLOCK);
   if (fd < 0) {
-		LOG_ERROR(buf_list, "Can't open device: %s", buf_list->dev->path);
+		LOG_ERROR(buf_list, "Can't open device: %s", path);
   }
 
   struct stat st;
   if (fstat(fd, &st) < 0) {
-		LOG_ERROR(buf_list, "Can't get fstat: %s", buf_list->dev->path);
+		LOG_ERROR(buf_list, "Can't get fstat: %s", path);
   }
 
   buf_list->dummy->data = malloc(st.st_size);
   if (!buf_list->dummy->data) {
-		LOG_ERROR(buf_list, "Can't allocate %" PRId64 " bytes for %s", (off64_t)st.st_size, buf_list->dev->path);
+		LOG_ERROR(buf_list, "Can't allocate %" PRId64 " bytes for %s", (off64_t)st.st_size, path);
   }
 
   buf_list->dummy->length = read(fd, buf_list->dummy->data, st.st_size);
   if (!buf_list->dummy->data) {
-		LOG_ERROR(buf_list, "Can't read %" PRId64 " bytes for %s. Only read %zu.", (off64_t)st.st_size, buf_list->dev->path, buf_list->dummy->length);
+		LOG_ERROR(buf_list, "Can't read %" PRId64 " bytes for %s. Only read %zu.", (off64_t)st.st_size, path, buf_list->dummy->length);
   }
 
   close(fd);
-  return buf_list->fmt.nbufs;
+  return 0;
 
 error:
   close(fd);
   return -1;
 }
 
+static const char *dummy_sample_extension(unsigned format)
+{
+  switch (format) {
+  case V4L2_PIX_FMT_JPEG:
+  case V4L2_PIX_FMT_MJPEG:
+    return "jpeg";
+  case V4L2_PIX_FMT_H264:
+    return "h264";
+  case V4L2_PIX_FMT_YUV420:
+    return "yuv420";
+  case V4L2_PIX_FMT_YUYV:
+    return "yuyv";
+  case V4L2_PIX_FMT_NV12:
+    return "nv12";
+  default:
+    return NULL;
+  }
+}
+
+// The M2M capture is "transformed" into the sample of the same format
+// found next to the camera input (ex.: `tests/capture.h264`),
+// otherwise the output data is passed through as-is.
+static int dummy_buffer_list_open_m2m_capture(buffer_list_t *buf_list)
+{
+  const char *ext = dummy_sample_extension(buf_list->fmt.format);
+  const char *sep = strrchr(buf_list->dev->path, '.');
+  char path[512];
+
+  if (ext && sep) {
+    snprintf(path, sizeof(path), "%.*s.%s", (int)(sep - buf_list->dev->path), buf_list->dev->path, ext);
+
+    if (!strcmp(path, buf_list->dev->path) || access(path, R_OK) < 0) {
+      ext = NULL;
+    }
+  } else {
+    ext = NULL;
+  }
+
+  if (ext && dummy_buffer_list_read_file(buf_list, path) == 0) {
+    LOG_INFO(buf_list, "Using '%s' as %s sample.", path, fourcc_to_string(buf_list->fmt.format).buf);
+    return 0;
+  }
+
+  LOG_INFO(buf_list, "Passing through data as %s.", fourcc_to_string(buf_list->fmt.format).buf);
+  buf_list->dummy->length = buf_list->dev->output_list->fmt.sizeimage;
+  return 0;
+}
+
+int dummy_buffer_list_open(buffer_list_t *buf_list)
+{
+  buf_list->dummy = calloc(1, sizeof(buffer_list_dummy_t));
+  buf_list->dummy->fds[0] = -1;
+  buf_list->dummy->fds[1] = -1;
+
+  if (pipe2(buf_list->dummy->fds, O_DIRECT|O_CLOEXEC) < 0) {
+    LOG_INFO(buf_list, "Cannot open `pipe2`.");
+    return -1;
+  }
+
+  if (!buf_list->do_capture) {
+    buf_list->dummy->length = buf_list->fmt.sizeimage;
+
+    if (!buf_list->dummy->length) {
+      LOG_ERROR(buf_list, "The M2M output requires `sizeimage` to be set.");
+    }
+    if (dummy_m2m_start(buf_list->dev) < 0) {
+      goto error;
+    }
+  } else if (buf_list->dev->output_list) {
+    if (dummy_buffer_list_open_m2m_capture(buf_list) < 0) {
+      goto error;
+    }
+  } else {
+    if (dummy_buffer_list_read_file(buf_list, buf_list->dev->path) < 0) {
+      goto error;
+    }
+  }
+
+  buf_list->fmt.bytesperline = 0;
+  buf_list->fmt.sizeimage = buf_list->dummy->length;
+  return buf_list->fmt.nbufs;
+
+error:
+  return -1;
+}
+
 void dummy_buffer_list_close(buffer_list_t *buf_list)
 {
+  // the M2M thread accesses all buffer lists of the device
+  dummy_m2m_stop(buf_list->dev);
+
   if (buf_list->dummy) {
     close(buf_list->dummy->fds[0]);
     close(buf_list->dummy->fds[1]);
@@ -1,17 +1,24 @@
 #include "dummy.h"
 #include "device/device.h"
+#include "util/opts/log.h"
+#include "util/opts/control.h"
 
 #include <stdlib.h>
 
 int dummy_device_open(device_t *dev)
 {
   dev->opts.allow_dma = false;
+  dev->opts.no_dma_reason = "emulated device";
   dev->dummy = calloc(1, sizeof(device_dummy_t));
+  dev->dummy->max_inflight = 1;
+  dev->dummy->queued_fds[0] = dev->dummy->queued_fds[1] = -1;
+  dev->dummy->free_fds[0] = dev->dummy->free_fds[1] = -1;
   return 0;
 }
 
 void dummy_device_close(device_t *dev)
 {
+  dummy_m2m_stop(dev);
   free(dev->dummy);
 }
 
@@ -27,5 +34,16 @@ int dummy_device_set_fps(device_t *dev, int desired_fps)
 
 int dummy_device_set_option(device_t *dev, const char *key, const char *value)
 {
-  return -1;
+  if (device_option_is_equal(key, "delay_ms")) {
+    dev->dummy->delay_us = atof(value) * 1000;
+  } else if (device_option_is_equal(key, "jitter_ms")) {
+    dev->dummy->jitter_us = atof(value) * 1000;
+  } else if (device_option_is_equal(key, "max_inflight")) {
+    dev->dummy->max_inflight = MIN(MAX(atoi(value), 1), DUMMY_MAX_INFLIGHT);
+  } else {
+    return 0;
+  }
+
+  LOG_INFO(dev, "Configuring option '%s' = %s", key, value);
+  return 1;
 }
@@ -0,0 +1,62 @@
+#include "dummy.h"
+#include "device/device.h"
+#include "device/device_list.h"
+#include "util/opts/fourcc.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+static unsigned dummy_output_formats[] =
+{
+  V4L2_PIX_FMT_JPEG,
+  V4L2_PIX_FMT_MJPEG,
+  V4L2_PIX_FMT_H264,
+  V4L2_PIX_FMT_YUYV,
+  V4L2_PIX_FMT_YUV420,
+  V4L2_PIX_FMT_NV12,
+  V4L2_PIX_FMT_NV21,
+  V4L2_PIX_FMT_YVU420,
+  0
+};
+
+static unsigned dummy_capture_formats[] =
+{
+  V4L2_PIX_FMT_JPEG,
+  V4L2_PIX_FMT_MJPEG,
+  V4L2_PIX_FMT_H264,
+  V4L2_PIX_FMT_YUYV,
+  V4L2_PIX_FMT_YUV420,
+  V4L2_PIX_FMT_NV12,
+  0
+};
+
+static void device_list_dummy_formats(device_info_formats_t *formats, unsigned *list)
+{
+  for (formats->n = 0; list[formats->n]; formats->n++);
+  formats->formats = calloc(formats->n, sizeof(formats->formats[0]));
+  memcpy(formats->formats, list, formats->n * sizeof(formats->formats[0]));
+}
+
+// Appends the emulated M2M device after all real devices,
+// so that it is used only if there's no hardware to handle a format.
+device_list_t *device_list_dummy(device_list_t *list, const char *path)
+{
+  if (!list) {
+    list = calloc(1, sizeof(device_list_t));
+  }
+
+  device_info_t info = {
+    .name = strdup("dummy-m2m"),
+    .path = strdup(path),
+    .m2m = true,
+    .device_open = device_dummy_open
+  };
+
+  device_list_dummy_formats(&info.output_formats, dummy_output_formats);
+  device_list_dummy_formats(&info.capture_formats, dummy_capture_formats);
+
+  list->ndevices++;
+  list->devices = realloc(list->devices, sizeof(info) * list->ndevices);
+  list->devices[list->ndevices-1] = info;
+  return list;
+}
@@ -3,13 +3,32 @@
 #include <stdbool.h>
 #include <stdint.h>
 #include <unistd.h>
+#include <pthread.h>
 
 typedef struct buffer_s buffer_t;
 typedef struct buffer_list_s buffer_list_t;
 typedef struct device_s device_t;
 struct pollfd;
 
+#define DUMMY_MAX_INFLIGHT 16
+
+typedef struct dummy_inflight_s {
+  unsigned index;
+  uint64_t deadline_us;
+} dummy_inflight_t;
+
 typedef struct device_dummy_s {
+  // M2M processing
+  unsigned delay_us;
+  unsigned jitter_us;
+  unsigned max_inflight;
+
+  bool m2m_running;
+  pthread_t m2m_thread;
+  int queued_fds[2]; // output buffers waiting to be processed
+  int free_fds[2]; // capture buffers waiting to be filled
+  dummy_inflight_t inflight[DUMMY_MAX_INFLIGHT];
+  int n_inflight;
 } device_dummy_t;
 
 typedef struct buffer_list_dummy_s {
@@ -19,6 +38,7 @@ typedef struct buffer_list_dummy_s {
 } buffer_list_dummy_t;
 
 typedef struct buffer_dummy_s {
+  void *data;
 } buffer_dummy_t;
 
 int dummy_device_open(device_t *dev);
@@ -36,3 +56,6 @@ int dummy_buffer_list_pollfd(buffer_list_t *buf_list, struct pollfd *pollfd, boo
 int dummy_buffer_list_open(buffer_list_t *buf_list);
 void dummy_buffer_list_close(buffer_list_t *buf_list);
 int dummy_buffer_list_set_stream(buffer_list_t *buf_list, bool do_on);
+
+int dummy_m2m_start(device_t *dev);
+void dummy_m2m_stop(device_t *dev);
@@ -0,0 +1,177 @@
+#include "dummy.h"
+#include "device/buffer.h"
+#include "device/buffer_list.h"
+#include "device/device.h"
+#include "util/opts/log.h"
+
+#include <stdlib.h>
+
+// Emulates the M2M device (decoder, encoder, rescaller):
+// - the output buffer is queued into `queued_fds`
+// - it stays in-flight for `delay_us +/- jitter_us`, at most `max_inflight` at once
+// - once done a capture buffer is taken from `free_fds` and filled
+// - both buffers are returned via `fds` of their buffer lists
+
+static uint64_t dummy_m2m_deadline(device_dummy_t *dummy, uint64_t now_us)
+{
+  int64_t delay_us = dummy->delay_us;
+
+  if (dummy->jitter_us > 0) {
+    delay_us += (int64_t)(rand() % (2 * dummy->jitter_us + 1)) - dummy->jitter_us;
+  }
+
+  return now_us + MAX(delay_us, 0);
+}
+
+static void dummy_m2m_process(device_t *dev, buffer_t *output_buf, buffer_t *capture_buf)
+{
+  // pass-through, or use the sample data
+  if (capture_buf->buf_list->dummy->data) {
+    capture_buf->used = capture_buf->buf_list->dummy->length;
+  } else {
+    capture_buf->used = MIN(output_buf->used, capture_buf->length);
+    memcpy(capture_buf->start, output_buf->start, capture_buf->used);
+  }
+
+  capture_buf->flags.is_keyframe = output_buf->flags.is_keyframe;
+  capture_buf->flags.is_last = false;
+  capture_buf->captured_time_us = output_buf->captured_time_us;
+}
+
+static bool dummy_m2m_wait_capture(device_t *dev, unsigned *index)
+{
+  device_dummy_t *dummy = dev->dummy;
+
+  struct pollfd fds[2] = {
+    { .fd = dummy->free_fds[0], .events = POLLIN },
+    { .fd = dummy->queued_fds[0], .events = 0 }, // POLLHUP on stop
+  };
+
+  while (poll(fds, 2, -1) >= 0 || errno == EINTR) {
+    if (fds[0].revents & POLLIN) {
+      return read(dummy->free_fds[0], index, sizeof(*index)) == sizeof(*index);
+    }
+    if (fds[1].revents & (POLLHUP | POLLERR)) {
+      break;
+    }
+  }
+
+  return false;
+}
+
+static void *dummy_m2m_thread(void *opaque)
+{
+  device_t *dev = opaque;
+  device_dummy_t *dummy = dev->dummy;
+
+  while (true) {
+    uint64_t now_us = get_monotonic_time_us(NULL, NULL);
+    int timeout_ms = -1;
+
+    if (dummy->n_inflight > 0) {
+      timeout_ms = dummy->inflight[0].deadline_us > now_us ?
+        (dummy->inflight[0].deadline_us - now_us + 999) / 1000 : 0;
+    }
+
+    // do not accept new frames if `max_inflight` is reached
+    struct pollfd fd = {
+      .fd = dummy->queued_fds[0],
+      .events = dummy->n_inflight < MIN(MAX(dummy->max_inflight, 1), DUMMY_MAX_INFLIGHT) ? POLLIN : 0
+    };
+
+    if (poll(&fd, 1, timeout_ms) < 0 && errno != EINTR) {
+      break;
+    }
+
+    now_us = get_monotonic_time_us(NULL, NULL);
+
+    if (fd.revents & POLLIN) {
+      unsigned index = 0;
+      if (read(dummy->queued_fds[0], &index, sizeof(index)) != sizeof(index)) {
+        break;
+      }
+
+      dummy->inflight[dummy->n_inflight].index = index;
+      dummy->inflight[dummy->n_inflight].deadline_us = dummy_m2m_deadline(dummy, now_us);
+      dummy->n_inflight++;
+    } else if (fd.revents & (POLLHUP | POLLERR)) {
+      break;
+    }
+
+    // frames are finished in order, as the hardware would do
+    while (dummy->n_inflight > 0 && dummy->inflight[0].deadline_us <= now_us) {
+      buffer_list_t *output_list = dev->output_list;
+      buffer_list_t *capture_list = dev->capture_lists[0];
+      unsigned output_index = dummy->inflight[0].index;
+      unsigned capture_index = 0;
+
+      if (!dummy_m2m_wait_capture(dev, &capture_index)) {
+        goto stopped;
+      }
+
+      if (output_index < output_list->nbufs && capture_index < capture_list->nbufs) {
+        dummy_m2m_process(dev, output_list->bufs[output_index], capture_list->bufs[capture_index]);
+      }
+
+      if (write(capture_list->dummy->fds[1], &capture_index, sizeof(capture_index)) != sizeof(capture_index) ||
+        write(output_list->dummy->fds[1], &output_index, sizeof(output_index)) != sizeof(output_index)) {
+        goto stopped;
+      }
+
+      dummy->n_inflight--;
+      memmove(&dummy->inflight[0], &dummy->inflight[1], dummy->n_inflight * sizeof(dummy->inflight[0]));
+    }
+  }
+
+stopped:
+  LOG_DEBUG(dev, "M2M processing stopped.");
+  return NULL;
+}
+
+int dummy_m2m_start(device_t *dev)
+{
+  device_dummy_t *dummy = dev->dummy;
+
+  if (dummy->m2m_running) {
+    return 0;
+  }
+
+  if (pipe2(dummy->queued_fds, O_DIRECT|O_CLOEXEC) < 0) {
+    LOG_ERROR(dev, "Cannot open `pipe2`.");
+  }
+  if (pipe2(dummy->free_fds, O_DIRECT|O_CLOEXEC) < 0) {
+    LOG_ERROR(dev, "Cannot open `pipe2`.");
+  }
+
+  if (pthread_create(&dummy->m2m_thread, NULL, dummy_m2m_thread, dev) != 0) {
+    LOG_ERROR(dev, "Cannot start M2M thread.");
+  }
+
+  dummy->m2m_running = true;
+  LOG_INFO(dev, "Emulating M2M device.");
+  return 0;
+
+error:
+  return -1;
+}
+
+void dummy_m2m_stop(device_t *dev)
+{
+  device_dummy_t *dummy = dev->dummy;
+
+  if (!dummy->m2m_running) {
+    return;
+  }
+
+  // closing the write end wakes up the thread with POLLHUP
+  close(dummy->queued_fds[1]);
+  dummy->queued_fds[1] = -1;
+  pthread_join(dummy->m2m_thread, NULL);
+  dummy->m2m_running = false;
+
+  close(dummy->queued_fds[0]);
+  close(dummy->free_fds[0]);
+  close(dummy->free_fds[1]);
+  dummy->queued_fds[0] = dummy->free_fds[0] = dummy->free_fds[1] = -1;
+  dummy->n_inflight = 0;
+}
@@ -3,6 +3,7 @@
 #include "device/buffer.h"
 #include "device/buffer_list.h"
 #include "device/buffer_lock.h"
+#include "device/buffer_luma.h"
 #include "util/opts/log.h"
 #include "util/opts/fourcc.h"
 
@@ -16,6 +17,7 @@
 #define MAX_QUEUED_ON_NON_KEYED 1
 #define MAX_CAPTURED_ON_CAMERA 2
 #define MAX_CAPTURED_ON_M2M 2
+#define UNCHANGED_THRESHOLD 3
 
 typedef struct link_pool_s
 {
@@ -233,6 +235,39 @@ static int links_build_fds(link_t *all_links, link_pool_t *link_pool)
   return n;
 }
 
+// Skips the frame of the change-gated output, if it equals the last queued one
+static bool links_is_unchanged(buffer_list_t *output_list, buffer_t *buf)
+{
+  uint64_t now_us = get_monotonic_time_us(NULL, NULL);
+
+  if (!output_list->unchanged.keepalive_ms) {
+    return false;
+  }
+
+  if (!output_list->unchanged.reference) {
+    output_list->unchanged.reference = calloc(1, sizeof(buffer_luma_t));
+    output_list->unchanged.current = calloc(1, sizeof(buffer_luma_t));
+  }
+
+  // the sparse sampling keeps the links thread from reading the whole frame
+  if (!buffer_luma_sample(buf, output_list->unchanged.current)) {
+    return false;
+  }
+
+  if (now_us - output_list->unchanged.queued_us < output_list->unchanged.keepalive_ms * 1000LL &&
+    buffer_luma_diff(output_list->unchanged.current, output_list->unchanged.reference, UNCHANGED_THRESHOLD, NULL) == 0) {
+    output_list->unchanged.skipped++;
+    return true;
+  }
+
+  // compared with the last queued, so the slow changes add up
+  buffer_luma_t *reference = output_list->unchanged.reference;
+  output_list->unchanged.reference = output_list->unchanged.current;
+  output_list->unchanged.current = reference;
+  output_list->unchanged.queued_us = now_us;
+  return false;
+}
+
 static int links_enqueue_from_capture_list(buffer_list_t *capture_list, link_t *link)
 {
   if (!link) {
@@ -266,6 +301,9 @@ static int links_enqueue_from_capture_list(buffer_list_t *capture_list, link_t *
     if (link->output_lists[j]->dev->paused) {
       continue;
     }
+    if (links_is_unchanged(link->output_lists[j], buf)) {
+      continue;
+    }
     if (buf->flags.is_keyframe) {
       buffer_list_clear_queue(link->output_lists[j]);
     }
@@ -359,14 +397,15 @@ static int links_step(link_t *all_links, bool force_active, int timeout_now_ms,
       buf_list->nbufs,
       buf_list->dev->paused);
 
-    if (pool.fds[i].revents & POLLIN) {
+    if (capture_list && (pool.fds[i].revents & POLLIN)) {
       if (links_enqueue_from_capture_list(capture_list, link) < 0) {
         return -1;
       }
     }
 
     // Dequeue buffers that were processed
-    if (pool.fds[i].revents & POLLOUT) {
+    // V4L2 signals it with POLLOUT, the pipe based devices with POLLIN
+    if (output_list && (pool.fds[i].revents & (POLLOUT | POLLIN))) {
       if (links_dequeue_from_output_list(output_list) < 0) {
         return -1;
       }
@@ -425,7 +464,15 @@ static void links_refresh_stats(link_t *all_links, uint64_t *last_refresh_us)
       buffer_stats_t *now = &capture_list->stats;
       buffer_stats_t *prev = &capture_list->stats_last;
 
-      printf(" [%8s %2d FPS/%2d D/%3dms/%3dms/Dev%3.fms/%c/Q%d:O%d:C%d]",
+      uint64_t copied_bytes = 0, copy_time_us = 0;
+      for (int j = 0; j < all_links[i].n_output_lists; j++) {
+        buffer_stats_t *output_now = &all_links[i].output_lists[j]->stats;
+        buffer_stats_t *output_prev = &all_links[i].output_lists[j]->stats_last;
+        copied_bytes += output_now->copied_bytes - output_prev->copied_bytes;
+        copy_time_us += output_now->copy_time_us - output_prev->copy_time_us;
+      }
+
+      printf(" [%8s %2d FPS/%2d D/%3dms/%3dms/Dev%3.fms/%c/Q%d:O%d:C%d/M%.1fMiB@%.0fMiB/s]",
         capture_list->dev->name,
         (now->frames - prev->frames) / log_options.stats,
         (now->dropped - prev->dropped) / log_options.stats,
@@ -437,7 +484,9 @@ static void links_refresh_stats(link_t *all_links, uint64_t *last_refresh_us)
         capture_list->streaming ? (capture_list->dev->paused ? 'P' : 'S') : 'X',
         capture_list->dev->output_list ? capture_list->dev->output_list->n_queued_bufs : 0,
         capture_list->dev->output_list ? buffer_list_count_enqueued(capture_list->dev->output_list) : 0,
-        buffer_list_count_enqueued(capture_list)
+        buffer_list_count_enqueued(capture_list),
+        copied_bytes / 1024.0f / 1024.0f / log_options.stats,
+        copy_time_us ? copied_bytes / 1024.0f / 1024.0f * 1000.0f * 1000.0f / copy_time_us : 0.0f
       );
     }
 
@@ -449,6 +498,10 @@ static void links_refresh_stats(link_t *all_links, uint64_t *last_refresh_us)
     buffer_list_t *capture_list = all_links[i].capture_list;
     capture_list->stats_last = capture_list->stats;
 
+    for (int j = 0; j < all_links[i].n_output_lists; j++) {
+      all_links[i].output_lists[j]->stats_last = all_links[i].output_lists[j]->stats;
+    }
+
     capture_list->stats.max_dequeued_us = 0;
     capture_list->stats.avg_dequeued_us = 0;
     capture_list->stats.stddev_dequeued_us = 0;
@@ -461,7 +514,8 @@ static void links_refresh_stats(link_t *all_links, uint64_t *last_refresh_us)
   }
 }
 
-int links_loop(link_t *all_links, bool force_active, bool *running)
+// The `on_step` runs between the steps, on the same thread
+int links_loop(link_t *all_links, bool force_active, bool *running, link_on_step on_step, void *opaque)
 {
   *running = true;
 
@@ -479,6 +533,10 @@ int links_loop(link_t *all_links, bool force_active, bool *running)
 
     ret = links_step(all_links, force_active, timeout_now_ms, &timeout_ms);
     links_refresh_stats(all_links, &last_refresh_us);
+
+    if (on_step) {
+      on_step(opaque);
+    }
   }
 
   links_stream(all_links, false);
@@ -518,3 +576,44 @@ void links_dump(link_t *all_links)
     LOG_INFO(NULL, "Link %d: %s", n, line);
   }
 }
+
+// Returns NULL when the `output_list` shares the buffers of `capture_list` by DMA
+const char *links_copy_reason(buffer_list_t *capture_list, buffer_list_t *output_list, char *buf, int size)
+{
+  if (!output_list->do_mmap) {
+    return NULL;
+  } else if (!output_list->dev->opts.allow_dma) {
+    snprintf(buf, size, "'%s' has DMA disabled: %s", output_list->dev->name,
+      output_list->dev->opts.no_dma_reason ? output_list->dev->opts.no_dma_reason : "unknown");
+  } else if (!capture_list->dev->opts.allow_dma) {
+    snprintf(buf, size, "'%s' has DMA disabled: %s", capture_list->dev->name,
+      capture_list->dev->opts.no_dma_reason ? capture_list->dev->opts.no_dma_reason : "unknown");
+  } else if (!capture_list->do_mmap) {
+    snprintf(buf, size, "'%s' does not own its buffers to export them", capture_list->name);
+  } else {
+    snprintf(buf, size, "'%s' requires the mmap buffers", output_list->name);
+  }
+
+  return buf;
+}
+
+void links_dump_copies(link_t *all_links)
+{
+  char reason[256];
+
+  for (int n = 0; all_links[n].capture_list; n++) {
+    link_t *link = &all_links[n];
+
+    for (int j = 0; j < link->n_output_lists; j++) {
+      if (!links_copy_reason(link->capture_list, link->output_lists[j], reason, sizeof(reason))) {
+        LOG_VERBOSE(NULL, "Link %d: %s => %s: zero-copy", n,
+          link->capture_list->name, link->output_lists[j]->name);
+        continue;
+      }
+
+      LOG_INFO(NULL, "Link %d: %s => %s: memcpy of %s, since %s", n,
+        link->capture_list->name, link->output_lists[j]->name,
+        fourcc_to_string(link->capture_list->fmt.format).buf, reason);
+    }
+  }
+}
@@ -14,6 +14,7 @@ typedef struct link_s link_t;
 
 typedef void (*link_on_buffer)(buffer_t *buf);
 typedef bool (*link_check_streaming)();
+typedef void (*link_on_step)(void *opaque);
 
 typedef struct link_callbacks_s {
   const char *name;
@@ -30,5 +31,7 @@ typedef struct link_s {
   int n_callbacks;
 } link_t;
 
-int links_loop(link_t *all_links, bool force_active, bool *running);
+int links_loop(link_t *all_links, bool force_active, bool *running, link_on_step on_step, void *opaque);
 void links_dump(link_t *all_links);
+void links_dump_copies(link_t *all_links);
+const char *links_copy_reason(buffer_list_t *capture_list, buffer_list_t *output_list, char *buf, int size);
@@ -1,4 +1,5 @@
 #include "v4l2.h"
+#include "device/device.h"
 #include "device/device_list.h"
 #include "util/opts/log.h"
 
@@ -6,6 +7,7 @@
 #include <stdlib.h>
 #include <unistd.h>
 #include <dirent.h>
+#include <pthread.h>
 
 static void device_list_read_formats(int fd, device_info_formats_t *formats, enum v4l2_buf_type buf_type)
 {
@@ -25,73 +27,302 @@ static void device_list_read_formats(int fd, device_info_formats_t *formats, enu
   }
 }
 
-static bool device_list_read_dev(device_info_t *info, const char *name)
+#define DEVICE_LIST_MAX_DEVICES 64
+
+// The formats of a device, keyed by the path and `QUERYCAP` identity
+typedef struct device_list_cache_s {
+  char path[64];
+  char driver[16];
+  char bus_info[32];
+  unsigned version;
+  device_info_formats_t capture_formats;
+  device_info_formats_t output_formats;
+} device_list_cache_t;
+
+typedef struct device_list_probe_s {
+  int fd;
+  device_info_t info;
+  struct v4l2_capability cap;
+  pthread_t thread;
+  bool probing;
+} device_list_probe_t;
+
+static pthread_mutex_t device_list_cache_lock = PTHREAD_MUTEX_INITIALIZER;
+static device_list_cache_t device_list_cache[DEVICE_LIST_MAX_DEVICES];
+static int device_list_ncache;
+static bool device_list_cache_loaded;
+
+static void device_list_copy_formats(device_info_formats_t *dst, device_info_formats_t *src)
+{
+  dst->n = src->n;
+  dst->formats = src->n ? malloc(sizeof(dst->formats[0]) * src->n) : NULL;
+  if (src->n) {
+    memcpy(dst->formats, src->formats, sizeof(dst->formats[0]) * src->n);
+  }
+}
+
+static bool device_list_cache_matches(device_list_cache_t *entry, const char *path, struct v4l2_capability *cap)
+{
+  return !strcmp(entry->path, path) &&
+    !strncmp(entry->driver, (const char *)cap->driver, sizeof(entry->driver)) &&
+    !strncmp(entry->bus_info, (const char *)cap->bus_info, sizeof(entry->bus_info)) &&
+    entry->version == cap->version;
+}
+
+static device_list_cache_t *device_list_cache_find(const char *path, struct v4l2_capability *cap)
+{
+  for (int i = 0; i < device_list_ncache; i++) {
+    if (device_list_cache_matches(&device_list_cache[i], path, cap)) {
+      return &device_list_cache[i];
+    }
+  }
+
+  return NULL;
+}
+
+static void device_list_cache_store(device_info_t *info, struct v4l2_capability *cap)
+{
+  device_list_cache_t *entry = NULL;
+
+  for (int i = 0; i < device_list_ncache && !entry; i++) {
+    if (!strcmp(device_list_cache[i].path, info->path)) {
+      entry = &device_list_cache[i];
+      free(entry->capture_formats.formats);
+      free(entry->output_formats.formats);
+    }
+  }
+
+  if (!entry && device_list_ncache < DEVICE_LIST_MAX_DEVICES) {
+    entry = &device_list_cache[device_list_ncache++];
+  }
+  if (!entry) {
+    return;
+  }
+
+  snprintf(entry->path, sizeof(entry->path), "%s", info->path);
+  snprintf(entry->driver, sizeof(entry->driver), "%s", cap->driver);
+  snprintf(entry->bus_info, sizeof(entry->bus_info), "%s", cap->bus_info);
+  entry->version = cap->version;
+  device_list_copy_formats(&entry->capture_formats, &info->capture_formats);
+  device_list_copy_formats(&entry->output_formats, &info->output_formats);
+}
+
+static void device_list_cache_write_formats(FILE *fp, device_info_formats_t *formats)
+{
+  fprintf(fp, "\t");
+  for (int i = 0; i < formats->n; i++) {
+    fprintf(fp, "%s%08x", i ? "," : "", formats->formats[i]);
+  }
+  if (!formats->n) {
+    fprintf(fp, "-");
+  }
+}
+
+static void device_list_cache_read_formats(char *str, device_info_formats_t *formats)
+{
+  char *saveptr = NULL;
+
+  for (char *token = strtok_r(str, ",", &saveptr); token; token = strtok_r(NULL, ",", &saveptr)) {
+    if (!strcmp(token, "-"))
+      continue;
+
+    formats->n++;
+    formats->formats = realloc(formats->formats, sizeof(formats->formats[0]) * formats->n);
+    formats->formats[formats->n - 1] = strtoul(token, NULL, 16);
+  }
+}
+
+// Format: path, driver, bus_info, version, capture formats and output formats separated by tabs
+static void device_list_cache_load(const char *cache_path)
+{
+  char line[1024];
+
+  FILE *fp = fopen(cache_path, "r");
+  if (!fp) {
+    return;
+  }
+
+  while (fgets(line, sizeof(line), fp) && device_list_ncache < DEVICE_LIST_MAX_DEVICES) {
+    char *fields[6] = {NULL};
+    char *saveptr = NULL;
+    int n = 0;
+
+    line[strcspn(line, "\n")] = 0;
+    for (char *token = strtok_r(line, "\t", &saveptr); token && n < 6; token = strtok_r(NULL, "\t", &saveptr)) {
+      fields[n++] = token;
+    }
+    if (n != 6) {
+      continue;
+    }
+
+    device_list_cache_t *entry = &device_list_cache[device_list_ncache++];
+    memset(entry, 0, sizeof(*entry));
+    snprintf(entry->path, sizeof(entry->path), "%s", fields[0]);
+    snprintf(entry->driver, sizeof(entry->driver), "%s", fields[1]);
+    snprintf(entry->bus_info, sizeof(entry->bus_info), "%s", fields[2]);
+    entry->version = strtoul(fields[3], NULL, 16);
+    device_list_cache_read_formats(fields[4], &entry->capture_formats);
+    device_list_cache_read_formats(fields[5], &entry->output_formats);
+  }
+
+  fclose(fp);
+  LOG_VERBOSE(NULL, "Loaded %d devices from the probe cache: %s", device_list_ncache, cache_path);
+}
+
+static void device_list_cache_save(const char *cache_path)
 {
-  asprintf(&info->path, "/dev/%s", name);
+  FILE *fp = fopen(cache_path, "w");
+  if (!fp) {
+    LOG_INFO(NULL, "Cannot write the probe cache: %s", cache_path);
+    return;
+  }
+
+  for (int i = 0; i < device_list_ncache; i++) {
+    device_list_cache_t *entry = &device_list_cache[i];
+    fprintf(fp, "%s\t%s\t%s\t%08x", entry->path, entry->driver, entry->bus_info, entry->version);
+    device_list_cache_write_formats(fp, &entry->capture_formats);
+    device_list_cache_write_formats(fp, &entry->output_formats);
+    fprintf(fp, "\n");
+  }
 
-  int fd = open(info->path, O_RDWR|O_NONBLOCK);
-  if (fd < 0) {
+  fclose(fp);
+}
+
+static bool device_list_read_caps(device_list_probe_t *probe)
+{
+  device_info_t *info = &probe->info;
+  struct v4l2_capability *v4l2_cap = &probe->cap;
+
+  probe->fd = open(info->path, O_RDWR|O_NONBLOCK);
+  if (probe->fd < 0) {
     LOG_ERROR(NULL, "Can't open device: %s", info->path);
   }
 
-  struct v4l2_capability v4l2_cap;
-  ERR_IOCTL(info, fd, VIDIOC_QUERYCAP, &v4l2_cap, "Can't query device capabilities");
-  info->name = strdup((const char *)v4l2_cap.card);
+  ERR_IOCTL(info, probe->fd, VIDIOC_QUERYCAP, v4l2_cap, "Can't query device capabilities");
+  info->name = strdup((const char *)v4l2_cap->card);
+  info->device_open = device_v4l2_open;
 
-  if (!(v4l2_cap.capabilities & V4L2_CAP_STREAMING)) {
+  if (!(v4l2_cap->capabilities & V4L2_CAP_STREAMING)) {
     LOG_VERBOSE(info, "Device (%s) does not support streaming (skipping)", info->path);
     goto error;
-  } else if ((v4l2_cap.capabilities & V4L2_CAP_VIDEO_CAPTURE) && !(v4l2_cap.capabilities & V4L2_CAP_VIDEO_OUTPUT)) {
+  } else if ((v4l2_cap->capabilities & V4L2_CAP_VIDEO_CAPTURE) && !(v4l2_cap->capabilities & V4L2_CAP_VIDEO_OUTPUT)) {
     info->camera = true;
-  } else if (!(v4l2_cap.capabilities & (V4L2_CAP_VIDEO_CAPTURE | V4L2_CAP_VIDEO_CAPTURE_MPLANE | V4L2_CAP_VIDEO_M2M_MPLANE))) {
+  } else if (!(v4l2_cap->capabilities & (V4L2_CAP_VIDEO_CAPTURE | V4L2_CAP_VIDEO_CAPTURE_MPLANE | V4L2_CAP_VIDEO_M2M_MPLANE))) {
     LOG_VERBOSE(info, "Device (%s) does not support capture (skipping)", info->path);
     goto error;
-  } else if (!(v4l2_cap.capabilities & (V4L2_CAP_VIDEO_OUTPUT | V4L2_CAP_VIDEO_OUTPUT_MPLANE | V4L2_CAP_VIDEO_M2M_MPLANE))) {
+  } else if (!(v4l2_cap->capabilities & (V4L2_CAP_VIDEO_OUTPUT | V4L2_CAP_VIDEO_OUTPUT_MPLANE | V4L2_CAP_VIDEO_M2M_MPLANE))) {
     LOG_VERBOSE(info, "Device (%s) does not support output (skipping)", info->path);
     goto error;
-  } else if ((v4l2_cap.capabilities & V4L2_CAP_VIDEO_M2M) || (v4l2_cap.capabilities & V4L2_CAP_VIDEO_M2M_MPLANE)) {
+  } else if ((v4l2_cap->capabilities & V4L2_CAP_VIDEO_M2M) || (v4l2_cap->capabilities & V4L2_CAP_VIDEO_M2M_MPLANE)) {
     info->m2m = true;
   }
 
-  device_list_read_formats(fd, &info->capture_formats, V4L2_BUF_TYPE_VIDEO_CAPTURE);
-  device_list_read_formats(fd, &info->capture_formats, V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE);
-  device_list_read_formats(fd, &info->output_formats, V4L2_BUF_TYPE_VIDEO_OUTPUT);
-  device_list_read_formats(fd, &info->output_formats, V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE);
-  close(fd);
-
   return true;
 
 error:
   free(info->name);
-  free(info->path);
-  close(fd);
+  info->name = NULL;
+  if (probe->fd >= 0)
+    close(probe->fd);
+  probe->fd = -1;
   return false;
 }
 
-device_list_t *device_list_v4l2()
+static void *device_list_read_dev_formats(void *opaque)
 {
+  device_list_probe_t *probe = opaque;
+  device_info_t *info = &probe->info;
+
+  device_list_read_formats(probe->fd, &info->capture_formats, V4L2_BUF_TYPE_VIDEO_CAPTURE);
+  device_list_read_formats(probe->fd, &info->capture_formats, V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE);
+  device_list_read_formats(probe->fd, &info->output_formats, V4L2_BUF_TYPE_VIDEO_OUTPUT);
+  device_list_read_formats(probe->fd, &info->output_formats, V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE);
+  return NULL;
+}
+
+// The `QUERYCAP` is run for all devices to validate the cache,
+// the `ENUM_FMT` only for the missing ones, each in its own thread.
+device_list_t *device_list_v4l2(const char *cache_path)
+{
+  device_list_probe_t *probes = NULL;
+  int nprobes = 0, ncached = 0;
+  uint64_t start_us = get_monotonic_time_us(NULL, NULL);
+
   DIR *dev = opendir("/dev");
   if (!dev) {
     return NULL;
   }
 
+  pthread_mutex_lock(&device_list_cache_lock);
+  if (cache_path && cache_path[0] && !device_list_cache_loaded) {
+    device_list_cache_load(cache_path);
+    device_list_cache_loaded = true;
+  }
+
   device_list_t *list = calloc(1, sizeof(device_list_t));
   struct dirent *ent;
 
-  while ((ent = readdir(dev)) != NULL) {
+  probes = calloc(DEVICE_LIST_MAX_DEVICES, sizeof(device_list_probe_t));
+
+  while ((ent = readdir(dev)) != NULL && nprobes < DEVICE_LIST_MAX_DEVICES) {
     if (strstr(ent->d_name, "video") != ent->d_name) {
       continue;
     }
 
-    device_info_t info = {NULL};
-    if (device_list_read_dev(&info, ent->d_name)) {
-      list->ndevices++;
-      list->devices = realloc(list->devices, sizeof(info) * list->ndevices);
-      list->devices[list->ndevices-1] = info;
+    device_list_probe_t *probe = &probes[nprobes];
+    asprintf(&probe->info.path, "/dev/%s", ent->d_name);
+
+    if (!device_list_read_caps(probe)) {
+      free(probe->info.path);
+      memset(probe, 0, sizeof(*probe));
+      continue;
+    }
+
+    device_list_cache_t *entry = device_list_cache_find(probe->info.path, &probe->cap);
+    if (entry) {
+      device_list_copy_formats(&probe->info.capture_formats, &entry->capture_formats);
+      device_list_copy_formats(&probe->info.output_formats, &entry->output_formats);
+      ncached++;
+    } else if (pthread_create(&probe->thread, NULL, device_list_read_dev_formats, probe) == 0) {
+      probe->probing = true;
+    } else {
+      device_list_read_dev_formats(probe);
     }
+
+    nprobes++;
   }
 
   closedir(dev);
 
+  uint64_t caps_us = get_monotonic_time_us(NULL, NULL);
+
+  for (int i = 0; i < nprobes; i++) {
+    device_list_probe_t *probe = &probes[i];
+
+    if (probe->probing) {
+      pthread_join(probe->thread, NULL);
+    }
+    if (probe->probing || !device_list_cache_find(probe->info.path, &probe->cap)) {
+      device_list_cache_store(&probe->info, &probe->cap);
+    }
+    close(probe->fd);
+
+    list->ndevices++;
+    list->devices = realloc(list->devices, sizeof(device_info_t) * list->ndevices);
+    list->devices[list->ndevices-1] = probe->info;
+  }
+
+  if (cache_path && cache_path[0] && ncached < nprobes) {
+    device_list_cache_save(cache_path);
+  }
+  pthread_mutex_unlock(&device_list_cache_lock);
+
+  free(probes);
+
+  uint64_t end_us = get_monotonic_time_us(NULL, NULL);
+  LOG_INFO(NULL, "Probed %d devices in %.1fms (querycap=%.1fms, enum_fmt=%.1fms, cached=%d).",
+    nprobes, (end_us - start_us) / 1000.0f, (caps_us - start_us) / 1000.0f,
+    (end_us - caps_us) / 1000.0f, ncached);
+
   return list;
 }
@@ -0,0 +1,250 @@
+unsigned char html_index_html[] = {
+  0x3c, 0x21, 0x44, 0x4f, 0x43, 0x54, 0x59, 0x50, 0x45, 0x20, 0x68, 0x74,
+  0x6d, 0x6c, 0x3e, 0x0a, 0x0a, 0x3c, 0x68, 0x74, 0x6d, 0x6c, 0x3e, 0x0a,
+  0x3c, 0x68, 0x65, 0x61, 0x64, 0x3e, 0x0a, 0x09, 0x3c, 0x6d, 0x65, 0x74,
+  0x61, 0x20, 0x63, 0x68, 0x61, 0x72, 0x73, 0x65, 0x74, 0x3d, 0x22, 0x75,
+  0x74, 0x66, 0x2d, 0x38, 0x22, 0x20, 0x2f, 0x3e, 0x0a, 0x09, 0x3c, 0x73,
+  0x74, 0x79, 0x6c, 0x65, 0x3e, 0x62, 0x6f, 0x64, 0x79, 0x20, 0x7b, 0x20,
+  0x66, 0x6f, 0x6e, 0x74, 0x2d, 0x66, 0x61, 0x6d, 0x69, 0x6c, 0x79, 0x3a,
+  0x20, 0x6d, 0x6f, 0x6e, 0x6f, 0x73, 0x70, 0x61, 0x63, 0x65, 0x3b, 0x20,
+  0x7d, 0x3c, 0x2f, 0x73, 0x74, 0x79, 0x6c, 0x65, 0x3e, 0x0a, 0x3c, 0x2f,
+  0x68, 0x65, 0x61, 0x64, 0x3e, 0x0a, 0x0a, 0x3c, 0x62, 0x6f, 0x64, 0x79,
+  0x3e, 0x0a, 0x09, 0x3c, 0x68, 0x72, 0x3e, 0x0a, 0x09, 0x3c, 0x75, 0x6c,
+  0x3e, 0x0a, 0x09, 0x09, 0x3c, 0x62, 0x72, 0x3e, 0x0a, 0x09, 0x09, 0x3c,
+  0x6c, 0x69, 0x3e, 0x0a, 0x09, 0x09, 0x09, 0x3c, 0x61, 0x20, 0x68, 0x72,
+  0x65, 0x66, 0x3d, 0x22, 0x73, 0x6e, 0x61, 0x70, 0x73, 0x68, 0x6f, 0x74,
+  0x22, 0x3e, 0x3c, 0x62, 0x3e, 0x2f, 0x73, 0x6e, 0x61, 0x70, 0x73, 0x68,
+  0x6f, 0x74, 0x3c, 0x2f, 0x62, 0x3e, 0x3c, 0x2f, 0x61, 0x3e, 0x20, 0x28,
+  0x4a, 0x50, 0x45, 0x47, 0x20, 0x69, 0x6d, 0x61, 0x67, 0x65, 0x29, 0x3c,
+  0x62, 0x72, 0x3e, 0x0a, 0x09, 0x09, 0x09, 0x3c, 0x62, 0x72, 0x3e, 0x0a,
+  0x09, 0x09, 0x09, 0x3c, 0x75, 0x6c, 0x3e, 0x0a, 0x09, 0x09, 0x09, 0x09,
+  0x3c, 0x6c, 0x69, 0x3e, 0x47, 0x65, 0x74, 0x20, 0x61, 0x20, 0x68, 0x69,
+  0x67, 0x68, 0x2d, 0x72, 0x65, 0x73, 0x6f, 0x6c, 0x75, 0x74, 0x69, 0x6f,
+  0x6e, 0x20, 0x73, 0x6e, 0x61, 0x70, 0x73, 0x68, 0x6f, 0x74, 0x20, 0x69,
+  0x6d, 0x61, 0x67, 0x65, 0x20, 0x66, 0x72, 0x6f, 0x6d, 0x20, 0x74, 0x68,
+  0x65, 0x20, 0x73, 0x65, 0x72, 0x76, 0x65, 0x72, 0x2e, 0x3c, 0x2f, 0x6c,
+  0x69, 0x3e, 0x0a, 0x09, 0x09, 0x09, 0x09, 0x3c, 0x6c, 0x69, 0x3e, 0x55,
+  0x73, 0x65, 0x73, 0x20, 0x72, 0x65, 0x73, 0x6f, 0x6c, 0x75, 0x74, 0x69,
+  0x6f, 0x6e, 0x20, 0x73, 0x70, 0x65, 0x63, 0x69, 0x66, 0x69, 0x65, 0x64,
+  0x20, 0x62, 0x79, 0x20, 0x3c, 0x69, 0x3e, 0x2d, 0x63, 0x61, 0x6d, 0x65,
+  0x72, 0x61, 0x2d, 0x73, 0x6e, 0x61, 0x70, 0x73, 0x68, 0x6f, 0x74, 0x2e,
+  0x68, 0x65, 0x69, 0x67, 0x68, 0x74, 0x3d, 0x3c, 0x2f, 0x69, 0x3e, 0x2e,
+  0x3c, 0x2f, 0x6c, 0x69, 0x3e, 0x0a, 0x09, 0x09, 0x09, 0x09, 0x3c, 0x62,
+  0x72, 0x3e, 0x0a, 0x09, 0x09, 0x09, 0x09, 0x3c, 0x6c, 0x69, 0x3e, 0x3c,
+  0x61, 0x20, 0x68, 0x72, 0x65, 0x66, 0x3d, 0x22, 0x73, 0x6e, 0x61, 0x70,
+  0x73, 0x68, 0x6f, 0x74, 0x3f, 0x6d, 0x61, 0x78, 0x5f, 0x64, 0x65, 0x6c,
+  0x61, 0x79, 0x3d, 0x30, 0x22, 0x3e, 0x2f, 0x73, 0x6e, 0x61, 0x70, 0x73,
+  0x68, 0x6f, 0x74, 0x3f, 0x6d, 0x61, 0x78, 0x5f, 0x64, 0x65, 0x6c, 0x61,
+  0x79, 0x3d, 0x30, 0x3c, 0x2f, 0x61, 0x3e, 0x20, 0x74, 0x6f, 0x20, 0x67,
+  0x65, 0x74, 0x20, 0x61, 0x20, 0x73, 0x6e, 0x61, 0x70, 0x73, 0x68, 0x6f,
+  0x74, 0x20, 0x63, 0x61, 0x70, 0x74, 0x75, 0x72, 0x65, 0x64, 0x20, 0x65,
+  0x78, 0x61, 0x63, 0x74, 0x6c, 0x79, 0x20, 0x6e, 0x6f, 0x77, 0x2e, 0x3c,
+  0x2f, 0x6c, 0x69, 0x3e, 0x0a, 0x09, 0x09, 0x09, 0x09, 0x3c, 0x6c, 0x69,
+  0x3e, 0x3c, 0x61, 0x20, 0x68, 0x72, 0x65, 0x66, 0x3d, 0x22, 0x73, 0x6e,
+  0x61, 0x70, 0x73, 0x68, 0x6f, 0x74, 0x3f, 0x6d, 0x61, 0x78, 0x5f, 0x64,
+  0x65, 0x6c, 0x61, 0x79, 0x3d, 0x33, 0x30, 0x30, 0x22, 0x3e, 0x2f, 0x73,
+  0x6e, 0x61, 0x70, 0x73, 0x68, 0x6f, 0x74, 0x3f, 0x6d, 0x61, 0x78, 0x5f,
+  0x64, 0x65, 0x6c, 0x61, 0x79, 0x3d, 0x33, 0x30, 0x30, 0x3c, 0x2f, 0x61,
+  0x3e, 0x20, 0x28, 0x64, 0x65, 0x66, 0x61, 0x75, 0x6c, 0x74, 0x29, 0x20,
+  0x74, 0x6f, 0x20, 0x67, 0x65, 0x74, 0x20, 0x61, 0x20, 0x63, 0x61, 0x63,
+  0x68, 0x65, 0x64, 0x20, 0x73, 0x6e, 0x61, 0x70, 0x73, 0x68, 0x6f, 0x74,
+  0x20, 0x63, 0x61, 0x70, 0x74, 0x75, 0x72, 0x65, 0x64, 0x20, 0x75, 0x70,
+  0x2d, 0x74, 0x6f, 0x20, 0x33, 0x30, 0x30, 0x20, 0x6d, 0x73, 0x20, 0x69,
+  0x6e, 0x20, 0x74, 0x68, 0x65, 0x20, 0x70, 0x61, 0x73, 0x74, 0x2e, 0x3c,
+  0x2f, 0x6c, 0x69, 0x3e, 0x0a, 0x09, 0x09, 0x09, 0x3c, 0x2f, 0x75, 0x6c,
+  0x3e, 0x0a, 0x09, 0x09, 0x3c, 0x2f, 0x6c, 0x69, 0x3e, 0x0a, 0x09, 0x09,
+  0x3c, 0x62, 0x72, 0x3e, 0x0a, 0x09, 0x09, 0x3c, 0x6c, 0x69, 0x3e, 0x0a,
+  0x09, 0x09, 0x09, 0x3c, 0x61, 0x20, 0x68, 0x72, 0x65, 0x66, 0x3d, 0x22,
+  0x73, 0x74, 0x72, 0x65, 0x61, 0x6d, 0x22, 0x3e, 0x3c, 0x62, 0x3e, 0x2f,
+  0x73, 0x74, 0x72, 0x65, 0x61, 0x6d, 0x3c, 0x2f, 0x62, 0x3e, 0x3c, 0x2f,
+  0x61, 0x3e, 0x20, 0x28, 0x4d, 0x4a, 0x50, 0x45, 0x47, 0x20, 0x73, 0x74,
+  0x72, 0x65, 0x61, 0x6d, 0x29, 0x3c, 0x2f, 0x62, 0x3e, 0x3c, 0x62, 0x72,
+  0x3e, 0x0a, 0x09, 0x09, 0x09, 0x3c, 0x62, 0x72, 0x3e, 0x0a, 0x09, 0x09,
+  0x09, 0x3c, 0x75, 0x6c, 0x3e, 0x0a, 0x09, 0x09, 0x09, 0x09, 0x3c, 0x6c,
+  0x69, 0x3e, 0x47, 0x65, 0x74, 0x20, 0x61, 0x20, 0x6c, 0x69, 0x76, 0x65,
+  0x20, 0x73, 0x74, 0x72, 0x65, 0x61, 0x6d, 0x2e, 0x20, 0x57, 0x6f, 0x72,
+  0x6b, 0x73, 0x20, 0x65, 0x76, 0x65, 0x72, 0x79, 0x77, 0x68, 0x65, 0x72,
+  0x65, 0x2c, 0x20, 0x62, 0x75, 0x74, 0x20, 0x63, 0x6f, 0x6e, 0x73, 0x75,
+  0x6d, 0x65, 0x73, 0x20, 0x61, 0x20, 0x74, 0x6f, 0x6e, 0x20, 0x6f, 0x66,
+  0x20, 0x62, 0x61, 0x6e, 0x64, 0x77, 0x69, 0x64, 0x74, 0x68, 0x2e, 0x3c,
+  0x2f, 0x6c, 0x69, 0x3e, 0x0a, 0x09, 0x09, 0x09, 0x09, 0x3c, 0x6c, 0x69,
+  0x3e, 0x55, 0x73, 0x65, 0x73, 0x20, 0x72, 0x65, 0x73, 0x6f, 0x6c, 0x75,
+  0x74, 0x69, 0x6f, 0x6e, 0x20, 0x73, 0x70, 0x65, 0x63, 0x69, 0x66, 0x69,
+  0x65, 0x64, 0x20, 0x62, 0x79, 0x20, 0x3c, 0x69, 0x3e, 0x2d, 0x63, 0x61,
+  0x6d, 0x65, 0x72, 0x61, 0x2d, 0x73, 0x74, 0x72, 0x65, 0x61, 0x6d, 0x2e,
+  0x68, 0x65, 0x69, 0x67, 0x68, 0x74, 0x3d, 0x3c, 0x2f, 0x69, 0x3e, 0x2e,
+  0x3c, 0x2f, 0x6c, 0x69, 0x3e, 0x0a, 0x09, 0x09, 0x09, 0x3c, 0x2f, 0x75,
+  0x6c, 0x3e, 0x0a, 0x09, 0x09, 0x3c, 0x2f, 0x6c, 0x69, 0x3e, 0x0a, 0x09,
+  0x09, 0x3c, 0x62, 0x72, 0x3e, 0x0a, 0x09, 0x09, 0x3c, 0x6c, 0x69, 0x3e,
+  0x0a, 0x09, 0x09, 0x09, 0x3c, 0x61, 0x20, 0x68, 0x72, 0x65, 0x66, 0x3d,
+  0x22, 0x77, 0x65, 0x62, 0x72, 0x74, 0x63, 0x22, 0x3e, 0x3c, 0x62, 0x3e,
+  0x2f, 0x77, 0x65, 0x62, 0x72, 0x74, 0x63, 0x3c, 0x2f, 0x62, 0x3e, 0x3c,
+  0x2f, 0x61, 0x3e, 0x20, 0x28, 0x48, 0x54, 0x54, 0x50, 0x20, 0x70, 0x61,
+  0x67, 0x65, 0x20, 0x2f, 0x20, 0x69, 0x66, 0x72, 0x61, 0x6d, 0x65, 0x29,
+  0x3c, 0x62, 0x72, 0x3e, 0x0a, 0x09, 0x09, 0x09, 0x3c, 0x62, 0x72, 0x3e,
+  0x0a, 0x09, 0x09, 0x09, 0x3c, 0x75, 0x6c, 0x3e, 0x0a, 0x09, 0x09, 0x09,
+  0x09, 0x3c, 0x6c, 0x69, 0x3e, 0x47, 0x65, 0x74, 0x20, 0x61, 0x20, 0x6c,
+  0x69, 0x76, 0x65, 0x20, 0x76, 0x69, 0x64, 0x65, 0x6f, 0x20, 0x75, 0x73,
+  0x69, 0x6e, 0x67, 0x20, 0x57, 0x65, 0x62, 0x52, 0x54, 0x43, 0x20, 0x28,
+  0x6c, 0x6f, 0x77, 0x2d, 0x6c, 0x61, 0x74, 0x65, 0x6e, 0x63, 0x79, 0x20,
+  0x73, 0x74, 0x72, 0x65, 0x61, 0x6d, 0x69, 0x6e, 0x67, 0x20, 0x77, 0x69,
+  0x74, 0x68, 0x20, 0x6c, 0x61, 0x74, 0x65, 0x6e, 0x63, 0x79, 0x20, 0x6f,
+  0x66, 0x20, 0x61, 0x72, 0x6f, 0x75, 0x6e, 0x64, 0x20, 0x31, 0x30, 0x30,
+  0x6d, 0x73, 0x29, 0x2e, 0x3c, 0x2f, 0x6c, 0x69, 0x3e, 0x0a, 0x09, 0x09,
+  0x09, 0x09, 0x3c, 0x6c, 0x69, 0x3e, 0x55, 0x73, 0x65, 0x73, 0x20, 0x72,
+  0x65, 0x73, 0x6f, 0x6c, 0x75, 0x74, 0x69, 0x6f, 0x6e, 0x20, 0x73, 0x70,
+  0x65, 0x63, 0x69, 0x66, 0x69, 0x65, 0x64, 0x20, 0x62, 0x79, 0x20, 0x3c,
+  0x69, 0x3e, 0x2d, 0x63, 0x61, 0x6d, 0x65, 0x72, 0x61, 0x2d, 0x76, 0x69,
+  0x64, 0x65, 0x6f, 0x2e, 0x68, 0x65, 0x69, 0x67, 0x68, 0x74, 0x3d, 0x3c,
+  0x2f, 0x69, 0x3e, 0x2e, 0x3c, 0x2f, 0x6c, 0x69, 0x3e, 0x0a, 0x09, 0x09,
+  0x09, 0x09, 0x3c, 0x6c, 0x69, 0x3e, 0x55, 0x73, 0x65, 0x73, 0x20, 0x61,
+  0x20, 0x64, 0x65, 0x66, 0x61, 0x75, 0x6c, 0x74, 0x20, 0x74, 0x69, 0x6d,
+  0x65, 0x6f, 0x75, 0x74, 0x20, 0x73, 0x70, 0x65, 0x63, 0x69, 0x66, 0x69,
+  0x65, 0x64, 0x20, 0x62, 0x79, 0x20, 0x3c, 0x69, 0x3e, 0x2d, 0x2d, 0x77,
+  0x65, 0x62, 0x72, 0x74, 0x63, 0x2d, 0x74, 0x69, 0x6d, 0x65, 0x6f, 0x75,
+  0x74, 0x5f, 0x73, 0x3c, 0x2f, 0x69, 0x3e, 0x20, 0x6f, 0x72, 0x20, 0x33,
+  0x36, 0x30, 0x30, 0x20, 0x73, 0x65, 0x63, 0x6f, 0x6e, 0x64, 0x73, 0x20,
+  0x28, 0x31, 0x20, 0x68, 0x6f, 0x75, 0x72, 0x29, 0x20, 0x61, 0x66, 0x74,
+  0x65, 0x72, 0x20, 0x77, 0x68, 0x69, 0x63, 0x68, 0x20, 0x74, 0x68, 0x65,
+  0x20, 0x73, 0x74, 0x72, 0x65, 0x61, 0x6d, 0x20, 0x64, 0x69, 0x73, 0x63,
+  0x6f, 0x6e, 0x6e, 0x65, 0x63, 0x74, 0x73, 0x2e, 0x3c, 0x2f, 0x6c, 0x69,
+  0x3e, 0x0a, 0x09, 0x09, 0x09, 0x09, 0x3c, 0x6c, 0x69, 0x3e, 0x43, 0x68,
+  0x61, 0x6e, 0x67, 0x65, 0x20, 0x74, 0x68, 0x65, 0x20, 0x74, 0x69, 0x6d,
+  0x65, 0x6f, 0x75, 0x74, 0x20, 0x77, 0x69, 0x74, 0x68, 0x20, 0x3c, 0x61,
+  0x20, 0x68, 0x72, 0x65, 0x66, 0x3d, 0x22, 0x77, 0x65, 0x62, 0x72, 0x74,
+  0x63, 0x3f, 0x74, 0x69, 0x6d, 0x65, 0x6f, 0x75, 0x74, 0x5f, 0x73, 0x3d,
+  0x33, 0x36, 0x30, 0x30, 0x22, 0x3e, 0x2f, 0x77, 0x65, 0x62, 0x72, 0x74,
+  0x63, 0x3f, 0x74, 0x69, 0x6d, 0x65, 0x6f, 0x75, 0x74, 0x5f, 0x73, 0x3d,
+  0x33, 0x36, 0x30, 0x30, 0x3c, 0x2f, 0x61, 0x3e, 0x20, 0x66, 0x6f, 0x72,
+  0x20, 0x74, 0x68, 0x69, 0x73, 0x20, 0x73, 0x74, 0x72, 0x65, 0x61, 0x6d,
+  0x2e, 0x3c, 0x2f, 0x6c, 0x69, 0x3e, 0x0a, 0x09, 0x09, 0x09, 0x3c, 0x2f,
+  0x75, 0x6c, 0x3e, 0x0a, 0x09, 0x09, 0x3c, 0x2f, 0x6c, 0x69, 0x3e, 0x0a,
+  0x09, 0x09, 0x3c, 0x62, 0x72, 0x3e, 0x0a, 0x09, 0x09, 0x3c, 0x6c, 0x69,
+  0x3e, 0x0a, 0x09, 0x09, 0x09, 0x3c, 0x61, 0x20, 0x68, 0x72, 0x65, 0x66,
+  0x3d, 0x22, 0x76, 0x69, 0x64, 0x65, 0x6f, 0x22, 0x3e, 0x3c, 0x62, 0x3e,
+  0x2f, 0x76, 0x69, 0x64, 0x65, 0x6f, 0x3c, 0x2f, 0x62, 0x3e, 0x3c, 0x2f,
+  0x61, 0x3e, 0x20, 0x28, 0x49, 0x50, 0x20, 0x43, 0x61, 0x6d, 0x65, 0x72,
+  0x61, 0x29, 0x3c, 0x62, 0x72, 0x3e, 0x0a, 0x09, 0x09, 0x09, 0x3c, 0x62,
+  0x72, 0x3e, 0x0a, 0x09, 0x09, 0x09, 0x3c, 0x75, 0x6c, 0x3e, 0x0a, 0x09,
+  0x09, 0x09, 0x09, 0x3c, 0x6c, 0x69, 0x3e, 0x47, 0x65, 0x74, 0x20, 0x61,
+  0x20, 0x6c, 0x69, 0x76, 0x65, 0x20, 0x28, 0x48, 0x32, 0x36, 0x34, 0x29,
+  0x20, 0x76, 0x69, 0x64, 0x65, 0x6f, 0x20, 0x73, 0x74, 0x72, 0x65, 0x61,
+  0x6d, 0x20, 0x62, 0x65, 0x73, 0x74, 0x20, 0x73, 0x75, 0x69, 0x74, 0x65,
+  0x64, 0x20, 0x74, 0x6f, 0x20, 0x63, 0x75, 0x72, 0x72, 0x65, 0x6e, 0x74,
+  0x20, 0x62, 0x72, 0x6f, 0x77, 0x73, 0x65, 0x72, 0x20, 0x69, 0x6e, 0x20,
+  0x61, 0x20, 0x6d, 0x61, 0x78, 0x69, 0x6d, 0x75, 0x6d, 0x20, 0x63, 0x6f,
+  0x6d, 0x70, 0x61, 0x74, 0x69, 0x62, 0x69, 0x6c, 0x69, 0x74, 0x79, 0x20,
+  0x6d, 0x6f, 0x64, 0x65, 0x20, 0x63, 0x68, 0x6f, 0x6f, 0x73, 0x69, 0x6e,
+  0x67, 0x20, 0x61, 0x75, 0x74, 0x6f, 0x6d, 0x61, 0x74, 0x69, 0x63, 0x61,
+  0x6c, 0x6c, 0x79, 0x20, 0x62, 0x65, 0x74, 0x77, 0x65, 0x65, 0x6e, 0x20,
+  0x6f, 0x6e, 0x65, 0x20, 0x6f, 0x66, 0x20, 0x74, 0x68, 0x65, 0x20, 0x62,
+  0x65, 0x6c, 0x6f, 0x77, 0x20, 0x66, 0x6f, 0x72, 0x6d, 0x61, 0x74, 0x73,
+  0x2e, 0x3c, 0x2f, 0x6c, 0x69, 0x3e, 0x0a, 0x09, 0x09, 0x09, 0x09, 0x3c,
+  0x6c, 0x69, 0x3e, 0x55, 0x73, 0x65, 0x73, 0x20, 0x72, 0x65, 0x73, 0x6f,
+  0x6c, 0x75, 0x74, 0x69, 0x6f, 0x6e, 0x20, 0x73, 0x70, 0x65, 0x63, 0x69,
+  0x66, 0x69, 0x65, 0x64, 0x20, 0x62, 0x79, 0x20, 0x3c, 0x69, 0x3e, 0x2d,
+  0x63, 0x61, 0x6d, 0x65, 0x72, 0x61, 0x2d, 0x76, 0x69, 0x64, 0x65, 0x6f,
+  0x2e, 0x68, 0x65, 0x69, 0x67, 0x68, 0x74, 0x3d, 0x3c, 0x2f, 0x69, 0x3e,
+  0x2e, 0x3c, 0x2f, 0x6c, 0x69, 0x3e, 0x0a, 0x09, 0x09, 0x09, 0x09, 0x3c,
+  0x62, 0x72, 0x3e, 0x0a, 0x09, 0x09, 0x09, 0x09, 0x3c, 0x6c, 0x69, 0x3e,
+  0x3c, 0x61, 0x20, 0x68, 0x72, 0x65, 0x66, 0x3d, 0x22, 0x76, 0x69, 0x64,
+  0x65, 0x6f, 0x2e, 0x6d, 0x70, 0x34, 0x22, 0x3e, 0x3c, 0x62, 0x3e, 0x2f,
+  0x76, 0x69, 0x64, 0x65, 0x6f, 0x2e, 0x6d, 0x70, 0x34, 0x3c, 0x2f, 0x62,
+  0x3e, 0x3c, 0x2f, 0x61, 0x3e, 0x3c, 0x62, 0x72, 0x3e, 0x20, 0x67, 0x65,
+  0x74, 0x20, 0x61, 0x20, 0x6c, 0x69, 0x76, 0x65, 0x20, 0x76, 0x69, 0x64,
+  0x65, 0x6f, 0x20, 0x73, 0x74, 0x72, 0x65, 0x61, 0x6d, 0x20, 0x69, 0x6e,
+  0x20, 0x66, 0x72, 0x61, 0x67, 0x6d, 0x65, 0x6e, 0x74, 0x65, 0x64, 0x20,
+  0x4d, 0x50, 0x34, 0x20, 0x66, 0x6f, 0x72, 0x6d, 0x61, 0x74, 0x20, 0x28,
+  0x46, 0x69, 0x72, 0x65, 0x66, 0x6f, 0x78, 0x2c, 0x20, 0x77, 0x69, 0x74,
+  0x68, 0x20, 0x61, 0x20, 0x66, 0x72, 0x61, 0x67, 0x6d, 0x65, 0x6e, 0x74,
+  0x20, 0x70, 0x65, 0x72, 0x20, 0x66, 0x72, 0x61, 0x6d, 0x65, 0x29, 0x2e,
+  0x3c, 0x2f, 0x6c, 0x69, 0x3e, 0x0a, 0x09, 0x09, 0x09, 0x09, 0x3c, 0x62,
+  0x72, 0x3e, 0x0a, 0x09, 0x09, 0x09, 0x09, 0x3c, 0x6c, 0x69, 0x3e, 0x3c,
+  0x61, 0x20, 0x68, 0x72, 0x65, 0x66, 0x3d, 0x22, 0x76, 0x69, 0x64, 0x65,
+  0x6f, 0x2e, 0x6d, 0x6b, 0x76, 0x22, 0x3e, 0x3c, 0x62, 0x3e, 0x2f, 0x76,
+  0x69, 0x64, 0x65, 0x6f, 0x2e, 0x6d, 0x6b, 0x76, 0x3c, 0x2f, 0x62, 0x3e,
+  0x3c, 0x2f, 0x61, 0x3e, 0x3c, 0x62, 0x72, 0x3e, 0x20, 0x67, 0x65, 0x74,
+  0x20, 0x61, 0x20, 0x6c, 0x69, 0x76, 0x65, 0x20, 0x76, 0x69, 0x64, 0x65,
+  0x6f, 0x20, 0x73, 0x74, 0x72, 0x65, 0x61, 0x6d, 0x20, 0x69, 0x6e, 0x20,
+  0x4d, 0x4b, 0x56, 0x20, 0x66, 0x6f, 0x72, 0x6d, 0x61, 0x74, 0x20, 0x28,
+  0x43, 0x68, 0x72, 0x6f, 0x6d, 0x65, 0x2c, 0x20, 0x77, 0x69, 0x74, 0x68,
+  0x20, 0x61, 0x20, 0x62, 0x6c, 0x6f, 0x63, 0x6b, 0x20, 0x70, 0x65, 0x72,
+  0x20, 0x66, 0x72, 0x61, 0x6d, 0x65, 0x29, 0x2e, 0x3c, 0x2f, 0x6c, 0x69,
+  0x3e, 0x0a, 0x09, 0x09, 0x09, 0x09, 0x3c, 0x62, 0x72, 0x3e, 0x0a, 0x09,
+  0x09, 0x09, 0x09, 0x3c, 0x6c, 0x69, 0x3e, 0x3c, 0x61, 0x20, 0x68, 0x72,
+  0x65, 0x66, 0x3d, 0x22, 0x76, 0x69, 0x64, 0x65, 0x6f, 0x2e, 0x6d, 0x33,
+  0x75, 0x38, 0x22, 0x3e, 0x3c, 0x62, 0x3e, 0x2f, 0x76, 0x69, 0x64, 0x65,
+  0x6f, 0x2e, 0x6d, 0x33, 0x75, 0x38, 0x3c, 0x2f, 0x62, 0x3e, 0x3c, 0x2f,
+  0x61, 0x3e, 0x3c, 0x62, 0x72, 0x3e, 0x20, 0x67, 0x65, 0x74, 0x20, 0x61,
+  0x20, 0x6c, 0x69, 0x76, 0x65, 0x20, 0x76, 0x69, 0x64, 0x65, 0x6f, 0x20,
+  0x73, 0x74, 0x72, 0x65, 0x61, 0x6d, 0x20, 0x69, 0x6e, 0x20, 0x48, 0x4c,
+  0x53, 0x20, 0x66, 0x6f, 0x72, 0x6d, 0x61, 0x74, 0x20, 0x28, 0x53, 0x61,
+  0x66, 0x61, 0x72, 0x69, 0x2c, 0x20, 0x77, 0x69, 0x74, 0x68, 0x20, 0x6c,
+  0x61, 0x74, 0x65, 0x6e, 0x63, 0x79, 0x20, 0x6f, 0x66, 0x20, 0x61, 0x72,
+  0x6f, 0x75, 0x6e, 0x64, 0x20, 0x31, 0x73, 0x29, 0x2e, 0x3c, 0x2f, 0x6c,
+  0x69, 0x3e, 0x0a, 0x09, 0x09, 0x09, 0x3c, 0x2f, 0x75, 0x6c, 0x3e, 0x0a,
+  0x09, 0x09, 0x3c, 0x2f, 0x6c, 0x69, 0x3e, 0x0a, 0x09, 0x09, 0x3c, 0x62,
+  0x72, 0x3e, 0x0a, 0x09, 0x09, 0x3c, 0x6c, 0x69, 0x3e, 0x0a, 0x09, 0x09,
+  0x09, 0x3c, 0x61, 0x20, 0x68, 0x72, 0x65, 0x66, 0x3d, 0x22, 0x63, 0x6f,
+  0x6e, 0x74, 0x72, 0x6f, 0x6c, 0x22, 0x3e, 0x3c, 0x62, 0x3e, 0x2f, 0x63,
+  0x6f, 0x6e, 0x74, 0x72, 0x6f, 0x6c, 0x3c, 0x2f, 0x62, 0x3e, 0x3c, 0x2f,
+  0x61, 0x3e, 0x3c, 0x62, 0x72, 0x3e, 0x0a, 0x09, 0x09, 0x09, 0x3c, 0x62,
+  0x72, 0x3e, 0x0a, 0x09, 0x09, 0x09, 0x3c, 0x75, 0x6c, 0x3e, 0x0a, 0x09,
+  0x09, 0x09, 0x09, 0x3c, 0x6c, 0x69, 0x3e, 0x53, 0x65, 0x65, 0x20, 0x61,
+  0x6c, 0x6c, 0x20, 0x63, 0x6f, 0x6e, 0x66, 0x69, 0x67, 0x75, 0x72, 0x61,
+  0x62, 0x6c, 0x65, 0x20, 0x63, 0x61, 0x6d, 0x65, 0x72, 0x61, 0x20, 0x6f,
+  0x70, 0x74, 0x69, 0x6f, 0x6e, 0x73, 0x2e, 0x3c, 0x2f, 0x6c, 0x69, 0x3e,
+  0x0a, 0x09, 0x09, 0x09, 0x09, 0x3c, 0x62, 0x72, 0x3e, 0x0a, 0x09, 0x09,
+  0x09, 0x09, 0x3c, 0x6c, 0x69, 0x3e, 0x2f, 0x6f, 0x70, 0x74, 0x69, 0x6f,
+  0x6e, 0x3f, 0x64, 0x65, 0x76, 0x69, 0x63, 0x65, 0x3d, 0x43, 0x41, 0x4d,
+  0x45, 0x52, 0x41, 0x26, 0x6b, 0x65, 0x79, 0x3d, 0x41, 0x66, 0x4d, 0x6f,
+  0x64, 0x65, 0x26, 0x76, 0x61, 0x6c, 0x75, 0x65, 0x3d, 0x61, 0x75, 0x74,
+  0x6f, 0x3c, 0x2f, 0x61, 0x3e, 0x20, 0x74, 0x6f, 0x20, 0x73, 0x65, 0x74,
+  0x20, 0x3c, 0x69, 0x3e, 0x41, 0x66, 0x4d, 0x6f, 0x64, 0x65, 0x3c, 0x2f,
+  0x69, 0x3e, 0x20, 0x6f, 0x6e, 0x20, 0x3c, 0x69, 0x3e, 0x43, 0x41, 0x4d,
+  0x45, 0x52, 0x41, 0x3c, 0x2f, 0x69, 0x3e, 0x2e, 0x3c, 0x2f, 0x6c, 0x69,
+  0x3e, 0x0a, 0x09, 0x09, 0x09, 0x3c, 0x2f, 0x75, 0x6c, 0x3e, 0x0a, 0x09,
+  0x09, 0x3c, 0x2f, 0x6c, 0x69, 0x3e, 0x0a, 0x09, 0x09, 0x3c, 0x62, 0x72,
+  0x3e, 0x0a, 0x09, 0x09, 0x3c, 0x6c, 0x69, 0x3e, 0x0a, 0x09, 0x09, 0x09,
+  0x3c, 0x61, 0x20, 0x68, 0x72, 0x65, 0x66, 0x3d, 0x22, 0x73, 0x74, 0x61,
+  0x74, 0x75, 0x73, 0x22, 0x3e, 0x3c, 0x62, 0x3e, 0x2f, 0x73, 0x74, 0x61,
+  0x74, 0x75, 0x73, 0x3c, 0x2f, 0x62, 0x3e, 0x3c, 0x2f, 0x61, 0x3e, 0x3c,
+  0x62, 0x72, 0x3e, 0x0a, 0x09, 0x09, 0x09, 0x3c, 0x62, 0x72, 0x3e, 0x0a,
+  0x09, 0x09, 0x09, 0x3c, 0x75, 0x6c, 0x3e, 0x0a, 0x09, 0x09, 0x09, 0x09,
+  0x3c, 0x6c, 0x69, 0x3e, 0x53, 0x65, 0x65, 0x20, 0x74, 0x68, 0x65, 0x20,
+  0x4a, 0x53, 0x4f, 0x4e, 0x20, 0x73, 0x74, 0x61, 0x74, 0x75, 0x73, 0x20,
+  0x6f, 0x66, 0x20, 0x63, 0x61, 0x6d, 0x65, 0x72, 0x61, 0x2d, 0x73, 0x74,
+  0x72, 0x65, 0x61, 0x6d, 0x65, 0x72, 0x2e, 0x3c, 0x2f, 0x6c, 0x69, 0x3e,
+  0x0a, 0x09, 0x09, 0x09, 0x3c, 0x2f, 0x75, 0x6c, 0x3e, 0x0a, 0x09, 0x09,
+  0x3c, 0x2f, 0x6c, 0x69, 0x3e, 0x0a, 0x09, 0x09, 0x3c, 0x62, 0x72, 0x3e,
+  0x0a, 0x09, 0x09, 0x3c, 0x6c, 0x69, 0x3e, 0x0a, 0x09, 0x09, 0x09, 0x54,
+  0x68, 0x65, 0x20, 0x6d, 0x6a, 0x70, 0x67, 0x2d, 0x73, 0x74, 0x72, 0x65,
+  0x61, 0x6d, 0x65, 0x72, 0x20, 0x63, 0x6f, 0x6d, 0x70, 0x61, 0x74, 0x69,
+  0x62, 0x69, 0x6c, 0x69, 0x74, 0x79, 0x20, 0x6c, 0x61, 0x79, 0x65, 0x72,
+  0x3a, 0x3c, 0x62, 0x72, 0x3e, 0x0a, 0x09, 0x09, 0x09, 0x3c, 0x62, 0x72,
+  0x3e, 0x0a, 0x09, 0x09, 0x09, 0x3c, 0x75, 0x6c, 0x3e, 0x0a, 0x09, 0x09,
+  0x09, 0x09, 0x3c, 0x6c, 0x69, 0x3e, 0x3c, 0x61, 0x20, 0x68, 0x72, 0x65,
+  0x66, 0x3d, 0x22, 0x3f, 0x61, 0x63, 0x74, 0x69, 0x6f, 0x6e, 0x3d, 0x73,
+  0x6e, 0x61, 0x70, 0x73, 0x68, 0x6f, 0x74, 0x22, 0x3e, 0x2f, 0x3f, 0x61,
+  0x63, 0x74, 0x69, 0x6f, 0x6e, 0x3d, 0x73, 0x6e, 0x61, 0x70, 0x73, 0x68,
+  0x6f, 0x74, 0x3c, 0x2f, 0x61, 0x3e, 0x20, 0x61, 0x73, 0x20, 0x61, 0x6c,
+  0x69, 0x61, 0x73, 0x20, 0x74, 0x6f, 0x20, 0x74, 0x68, 0x65, 0x20, 0x3c,
+  0x61, 0x20, 0x68, 0x72, 0x65, 0x66, 0x3d, 0x22, 0x73, 0x6e, 0x61, 0x70,
+  0x73, 0x68, 0x6f, 0x74, 0x22, 0x3e, 0x2f, 0x73, 0x6e, 0x61, 0x70, 0x73,
+  0x68, 0x6f, 0x74, 0x3c, 0x2f, 0x61, 0x3e, 0x2e, 0x3c, 0x2f, 0x6c, 0x69,
+  0x3e, 0x0a, 0x09, 0x09, 0x09, 0x09, 0x3c, 0x6c, 0x69, 0x3e, 0x3c, 0x61,
+  0x20, 0x68, 0x72, 0x65, 0x66, 0x3d, 0x22, 0x3f, 0x61, 0x63, 0x74, 0x69,
+  0x6f, 0x6e, 0x3d, 0x73, 0x74, 0x72, 0x65, 0x61, 0x6d, 0x22, 0x3e, 0x2f,
+  0x3f, 0x61, 0x63, 0x74, 0x69, 0x6f, 0x6e, 0x3d, 0x73, 0x74, 0x72, 0x65,
+  0x61, 0x6d, 0x3c, 0x2f, 0x61, 0x3e, 0x20, 0x61, 0x73, 0x20, 0x61, 0x6c,
+  0x69, 0x61, 0x73, 0x20, 0x74, 0x6f, 0x20, 0x74, 0x68, 0x65, 0x20, 0x3c,
+  0x61, 0x20, 0x68, 0x72, 0x65, 0x66, 0x3d, 0x22, 0x73, 0x74, 0x72, 0x65,
+  0x61, 0x6d, 0x22, 0x3e, 0x2f, 0x73, 0x74, 0x72, 0x65, 0x61, 0x6d, 0x3c,
+  0x2f, 0x61, 0x3e, 0x2e, 0x3c, 0x2f, 0x6c, 0x69, 0x3e, 0x0a, 0x09, 0x09,
+  0x09, 0x3c, 0x2f, 0x75, 0x6c, 0x3e, 0x0a, 0x09, 0x09, 0x3c, 0x2f, 0x6c,
+  0x69, 0x3e, 0x0a, 0x09, 0x3c, 0x2f, 0x75, 0x6c, 0x3e, 0x0a, 0x09, 0x3c,
+  0x62, 0x72, 0x3e, 0x0a, 0x09, 0x3c, 0x68, 0x72, 0x3e, 0x0a, 0x3c, 0x2f,
+  0x62, 0x6f, 0x64, 0x79, 0x3e, 0x0a, 0x3c, 0x2f, 0x68, 0x74, 0x6d, 0x6c,
+  0x3e, 0x0a
+};
+unsigned int html_index_html_len = 2954;
@@ -0,0 +1,275 @@
+#include "output/bitrate/bitrate.h"
+#include "util/http/http.h"
+#include "output/output.h"
+#include "device/camera/camera.h"
+#include "device/device.h"
+#include "util/opts/log.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#define BITRATE_INTERVAL_US (1000 * 1000)
+#define BITRATE_PEER_TIMEOUT_US (5 * 1000 * 1000)
+#define BITRATE_DECREASE_HOLD_US (1000 * 1000)
+#define BITRATE_INCREASE_HOLD_US (5 * 1000 * 1000)
+#define BITRATE_HIGH_LOSS 0.10f
+#define BITRATE_LOW_LOSS 0.02f
+#define BITRATE_MAX_DECREASE 0.50f
+#define BITRATE_HYSTERESIS 0.10f
+#define BITRATE_HEADROOM 0.90f
+#define BITRATE_INCREASE_STEP 1.15f
+#define BITRATE_RECONFIGURE_TIMEOUT_MS 1000
+
+static bitrate_options_t *bitrate_options;
+static pthread_mutex_t bitrate_lock = PTHREAD_MUTEX_INITIALIZER;
+static bitrate_status_t bitrate;
+static uint64_t bitrate_changed_us;
+static bool bitrate_restore; // adapted or the limit changed, so it returns to the limit without peers
+
+static bitrate_peer_t *bitrate_find_peer(const char *name, uint64_t now_us)
+{
+  bitrate_peer_t *oldest = &bitrate.peers[0];
+
+  for (int i = 0; i < bitrate.n_peers; i++) {
+    if (!strcmp(bitrate.peers[i].name, name)) {
+      return &bitrate.peers[i];
+    } else if (bitrate.peers[i].updated_us < oldest->updated_us) {
+      oldest = &bitrate.peers[i];
+    }
+  }
+
+  // the peers are never removed, the stale ones are reused instead
+  bitrate_peer_t *peer = bitrate.n_peers < BITRATE_MAX_PEERS ? &bitrate.peers[bitrate.n_peers++] : oldest;
+  memset(peer, 0, sizeof(*peer));
+  snprintf(peer->name, sizeof(peer->name), "%s", name);
+  return peer;
+}
+
+void bitrate_report_estimate(const char *name, unsigned bps)
+{
+  if (!bitrate_options || !bitrate_options->running) {
+    return;
+  }
+
+  uint64_t now_us = get_monotonic_time_us(NULL, NULL);
+
+  pthread_mutex_lock(&bitrate_lock);
+  bitrate_peer_t *peer = bitrate_find_peer(name, now_us);
+  peer->estimate = bps;
+  peer->estimated_us = peer->updated_us = now_us;
+  pthread_mutex_unlock(&bitrate_lock);
+}
+
+void bitrate_report_loss(const char *name, float loss, unsigned jitter)
+{
+  if (!bitrate_options || !bitrate_options->running) {
+    return;
+  }
+
+  uint64_t now_us = get_monotonic_time_us(NULL, NULL);
+
+  pthread_mutex_lock(&bitrate_lock);
+  bitrate_peer_t *peer = bitrate_find_peer(name, now_us);
+  peer->loss = loss;
+  peer->jitter = jitter;
+  peer->updated_us = now_us;
+  pthread_mutex_unlock(&bitrate_lock);
+}
+
+// Replaces the `-bitrate-max` while running, as the motion bitrate does
+bool bitrate_set_limit(unsigned bps)
+{
+  if (!bitrate_options || !bitrate_options->running) {
+    return false;
+  }
+
+  pthread_mutex_lock(&bitrate_lock);
+  bitrate.limit = bps;
+  bitrate_restore = true;
+  pthread_mutex_unlock(&bitrate_lock);
+  return true;
+}
+
+bool bitrate_status(bitrate_status_t *status)
+{
+  if (!bitrate_options || !bitrate_options->running) {
+    return false;
+  }
+
+  pthread_mutex_lock(&bitrate_lock);
+  *status = bitrate;
+  pthread_mutex_unlock(&bitrate_lock);
+  return true;
+}
+
+// The lowest bitrate any receiver can take, or -1 without the recent feedback
+static int bitrate_target(uint64_t now_us, char *reason, size_t reason_size)
+{
+  unsigned target = bitrate.limit;
+  int n_peers = 0;
+
+  snprintf(reason, reason_size, "limit");
+
+  for (int i = 0; i < bitrate.n_peers; i++) {
+    bitrate_peer_t *peer = &bitrate.peers[i];
+    if (now_us - peer->updated_us > BITRATE_PEER_TIMEOUT_US) {
+      continue;
+    }
+
+    n_peers++;
+
+    if (now_us - peer->estimated_us <= BITRATE_PEER_TIMEOUT_US &&
+      peer->estimate * BITRATE_HEADROOM < target) {
+      target = peer->estimate * BITRATE_HEADROOM;
+      snprintf(reason, reason_size, "estimate %s %ukbps", peer->name, peer->estimate / 1000);
+    }
+
+    float decrease = peer->loss < BITRATE_MAX_DECREASE ? peer->loss : BITRATE_MAX_DECREASE;
+
+    if (peer->loss > BITRATE_HIGH_LOSS && bitrate.current * (1 - decrease) < target) {
+      target = bitrate.current * (1 - decrease);
+      snprintf(reason, reason_size, "loss %s %.0f%%", peer->name, peer->loss * 100);
+    } else if (peer->loss > BITRATE_LOW_LOSS && bitrate.current < target) {
+      target = bitrate.current;
+      snprintf(reason, reason_size, "loss %s %.0f%%", peer->name, peer->loss * 100);
+    }
+  }
+
+  if (target < bitrate_options->min) {
+    target = bitrate_options->min;
+  }
+
+  bitrate.target = target;
+  return n_peers ? (int)target : -1;
+}
+
+// Decreases follow the feedback within a second, while increases wait for
+// the stable feedback and go in steps, so the bitrate does not oscillate
+static unsigned bitrate_decide(uint64_t now_us, char *reason, size_t reason_size)
+{
+  int target = bitrate_target(now_us, reason, reason_size);
+  unsigned current = bitrate.current;
+
+  if (target < 0) {
+    // nothing to adapt to: the configured bitrate is kept, unless it was adapted before
+    if (!bitrate_restore) {
+      return current;
+    }
+    bitrate_restore = false;
+    snprintf(reason, reason_size, "no receivers");
+    return bitrate.target;
+  } else if (target <= current * (1 - BITRATE_HYSTERESIS)) {
+    if (now_us - bitrate_changed_us >= BITRATE_DECREASE_HOLD_US) {
+      bitrate_restore = true;
+      return target;
+    }
+  } else if (target > current * (1 + BITRATE_HYSTERESIS)) {
+    if (now_us - bitrate_changed_us >= BITRATE_INCREASE_HOLD_US) {
+      snprintf(reason, reason_size, "stable, towards %ukbps", target / 1000);
+      bitrate_restore = true;
+      return target < current * BITRATE_INCREASE_STEP ? (unsigned)target : current * BITRATE_INCREASE_STEP;
+    }
+  }
+
+  return current;
+}
+
+static void bitrate_update(camera_options_t *options)
+{
+  char reason[BITRATE_REASON_LENGTH];
+  char value[32];
+  uint64_t now_us = get_monotonic_time_us(NULL, NULL);
+  camera_t *camera = output_locks_camera_get(&output_locks);
+
+  if (!camera) {
+    return;
+  }
+
+  camera_get_options(camera, options);
+
+  pthread_mutex_lock(&bitrate_lock);
+  // the encoder options hold the applied bitrate, as also the re-opened encoder uses them
+  if (camera_output_bitrate(&options->video)) {
+    bitrate.current = camera_output_bitrate(&options->video);
+  }
+  // without `-bitrate-max` the configured `video_bitrate` is the highest
+  if (!bitrate.limit) {
+    bitrate.limit = bitrate.target = bitrate.current;
+  }
+  unsigned from = bitrate.current;
+  unsigned to = bitrate.limit ? bitrate_decide(now_us, reason, sizeof(reason)) : from;
+  pthread_mutex_unlock(&bitrate_lock);
+
+  if (from == to) {
+    goto put;
+  }
+
+  // applied by the camera thread, without re-opening the encoder
+  snprintf(value, sizeof(value), "%u", to);
+  if (camera_set_output_option(&options->video, "video_bitrate", value) < 0 ||
+    camera_reconfigure(camera, options, BITRATE_RECONFIGURE_TIMEOUT_MS) < 0) {
+    LOG_VERBOSE(camera, "Cannot set the bitrate to %u.", to);
+    goto put;
+  }
+
+  LOG_INFO(camera, "Bitrate changed from %ukbps to %ukbps: %s.", from / 1000, to / 1000, reason);
+
+  pthread_mutex_lock(&bitrate_lock);
+  memmove(&bitrate.decisions[1], &bitrate.decisions[0], sizeof(bitrate.decisions) - sizeof(bitrate.decisions[0]));
+  bitrate.decisions[0].time_us = now_us;
+  bitrate.decisions[0].from = from;
+  bitrate.decisions[0].to = to;
+  snprintf(bitrate.decisions[0].reason, sizeof(bitrate.decisions[0].reason), "%s", reason);
+  if (bitrate.n_decisions < BITRATE_MAX_DECISIONS) {
+    bitrate.n_decisions++;
+  }
+  bitrate.current = to;
+  bitrate_changed_us = now_us;
+  pthread_mutex_unlock(&bitrate_lock);
+
+put:
+  output_locks_camera_put(&output_locks, camera);
+}
+
+static void *bitrate_thread(void *opaque)
+{
+  camera_options_t *options = malloc(sizeof(camera_options_t));
+
+  while (true) {
+    usleep(BITRATE_INTERVAL_US);
+    bitrate_update(options);
+  }
+
+  free(options);
+  return NULL;
+}
+
+int bitrate_server(bitrate_options_t *options)
+{
+  pthread_t thread;
+
+  if (options->disabled) {
+    return 0;
+  }
+
+  if (options->max && options->min > options->max) {
+    LOG_ERROR(NULL, "The bitrate range %u-%u is invalid.", options->min, options->max);
+  }
+
+  // the `video_bitrate` of the encoder options is read by the thread
+  bitrate.current = bitrate.target = bitrate.limit = options->max;
+  bitrate_options = options;
+
+  if (pthread_create(&thread, NULL, bitrate_thread, NULL) != 0) {
+    LOG_ERROR(NULL, "Cannot start the bitrate thread.");
+  }
+  pthread_detach(thread);
+
+  options->running = true;
+  return 0;
+
+error:
+  return -1;
+}
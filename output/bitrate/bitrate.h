@@ -0,0 +1,47 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define BITRATE_MAX_PEERS 16
+#define BITRATE_MAX_DECISIONS 8
+#define BITRATE_NAME_LENGTH 32
+#define BITRATE_REASON_LENGTH 64
+
+typedef struct bitrate_options_s {
+  bool running;
+  bool disabled;
+  unsigned min;
+  unsigned max;
+} bitrate_options_t;
+
+// The last feedback of a WebRTC or RTSP receiver
+typedef struct bitrate_peer_s {
+  char name[BITRATE_NAME_LENGTH];
+  uint64_t updated_us;
+  uint64_t estimated_us;
+  unsigned estimate; // REMB, in bps
+  float loss; // from the receiver reports
+  unsigned jitter; // in ms
+} bitrate_peer_t;
+
+typedef struct bitrate_decision_s {
+  uint64_t time_us;
+  unsigned from, to;
+  char reason[BITRATE_REASON_LENGTH];
+} bitrate_decision_t;
+
+typedef struct bitrate_status_s {
+  unsigned current, target, limit;
+  int n_peers;
+  bitrate_peer_t peers[BITRATE_MAX_PEERS];
+  int n_decisions;
+  bitrate_decision_t decisions[BITRATE_MAX_DECISIONS]; // the newest first
+} bitrate_status_t;
+
+// Bitrate
+void bitrate_report_estimate(const char *peer, unsigned bps);
+void bitrate_report_loss(const char *peer, float loss, unsigned jitter);
+bool bitrate_set_limit(unsigned bps);
+bool bitrate_status(bitrate_status_t *status);
+int bitrate_server(bitrate_options_t *options);
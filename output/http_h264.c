@@ -31,8 +31,8 @@ int http_video_buf_part(buffer_lock_t *buf_lock, buffer_t *buf, int frame, http_
 
   if (!status->had_key_frame) {
     if (!status->requested_key_frame) {
-      device_video_force_key(buf->buf_list->dev);
-      status->requested_key_frame = true;
+      // retried on the next frame when rate-limited
+      status->requested_key_frame = device_video_force_key(buf->buf_list->dev) == 0;
     }
     return 0;
   }
@@ -41,6 +41,15 @@ int http_video_buf_part(buffer_lock_t *buf_lock, buffer_t *buf, int frame, http_
     fputs(VIDEO_HEADER, status->stream);
     status->wrote_header = true;
   }
+  if (buf->flags.needs_h264_params) {
+    mux_h264_params_t *params = &buf->buf_list->h264_params;
+    static const uint8_t start_code[] = { 0, 0, 0, 1 };
+
+    fwrite(start_code, sizeof(start_code), 1, status->stream);
+    fwrite(params->sps, params->sps_size, 1, status->stream);
+    fwrite(start_code, sizeof(start_code), 1, status->stream);
+    fwrite(params->pps, params->pps_size, 1, status->stream);
+  }
   if (!fwrite(buf->start, buf->used, 1, status->stream)) {
     return -1;
   }
@@ -49,10 +58,15 @@ int http_video_buf_part(buffer_lock_t *buf_lock, buffer_t *buf, int frame, http_
 }
 
 void http_h264_video(http_worker_t *worker, FILE *stream)
+{
+  http_h264_video_from(worker, stream, http_video_lock(worker));
+}
+
+void http_h264_video_from(http_worker_t *worker, FILE *stream, buffer_lock_t *buf_lock)
 {
   http_video_status_t status = { stream };
 
-  int n = buffer_lock_write_loop(&video_lock, 0, 0, (buffer_write_fn)http_video_buf_part, &status);
+  int n = buffer_lock_write_loop(buf_lock, 0, 0, (buffer_write_fn)http_video_buf_part, &status);
 
   if (status.wrote_header) {
     return;
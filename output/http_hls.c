@@ -1,22 +1,34 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <inttypes.h>
 
 #include "output.h"
 #include "util/opts/log.h"
 #include "util/http/http.h"
+#include "util/mux/fmp4.h"
 #include "device/buffer.h"
 #include "device/buffer_lock.h"
 #include "device/buffer_list.h"
+#include "device/buffer_h264.h"
 #include "device/device.h"
 
-static const char *const CONTENT_TYPE = "application/x-mpegURL";
+#define HLS_PART_TARGET_US (500 * 1000)
+#define HLS_SEGMENT_TARGET_US (2 * 1000 * 1000)
+#define HLS_SEGMENTS 8 // in the ring, the playlist lists one less
+#define HLS_MAX_PARTS 32
+#define HLS_PLAYLIST_PART_SEGMENTS 2 // the complete segments listed with their parts
+#define HLS_BLOCK_TIMEOUT_MS 6000
+#define HLS_IDLE_TIMEOUT_US (30 * 1000 * 1000)
 
-static const char *const STREAM_M3U8 = 
-  "#EXTM3U\r\n" \
-  "#EXT-X-TARGETDURATION:1\r\n" \
-  "#EXT-X-VERSION:4\r\n" \
-  "#EXTINF:1.0,\r\n" \
-  "video.mp4?ts=%zu\r\n";
+static const char *const CONTENT_TYPE = "application/vnd.apple.mpegurl";
+
+static const char *const CHUNK_HEADER =
+  "HTTP/1.1 200 OK\r\n"
+  "Access-Control-Allow-Origin: *\r\n"
+  "Cache-Control: max-age=%d\r\n"
+  "Content-Type: video/mp4\r\n"
+  "Content-Length: %zu\r\n"
+  "\r\n";
 
 static const char *const LOCATION_REDIRECT =
   "HTTP/1.0 307 Temporary Redirect\r\n"
@@ -25,10 +37,535 @@ static const char *const LOCATION_REDIRECT =
   "Location: %s?%s\r\n"
   "\r\n";
 
+// The muxed data shared by the clients
+typedef struct hls_chunk_s {
+  int refs;
+  unsigned id;
+  uint64_t duration_us;
+  bool independent;
+  mux_buf_t buf;
+} hls_chunk_t;
+
+typedef struct hls_segment_s {
+  unsigned msn;
+  hls_chunk_t *init;
+  hls_chunk_t *parts[HLS_MAX_PARTS];
+  int n_parts;
+  uint64_t duration_us;
+  bool complete;
+  bool discontinuity;
+} hls_segment_t;
+
+typedef struct hls_stream_s {
+  const char *name;
+  buffer_lock_t *buf_lock;
+  char query[16]; // the `&res=` of the rendition
+
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+  bool running;
+  uint64_t last_request_us;
+
+  hls_chunk_t *init;
+  unsigned next_init_id;
+  hls_segment_t segments[HLS_SEGMENTS]; // by `msn % HLS_SEGMENTS`
+  hls_segment_t *segment; // in progress
+  unsigned next_msn;
+  bool discontinuity;
+
+  // used by the segmenter thread only
+  fmp4_t mp4;
+  mux_buf_t prev; // the payloads of `prev_nals`
+  buffer_nal_t prev_nals[MUX_H264_MAX_NALS];
+  int n_prev_nals;
+  uint64_t prev_time_us;
+  bool prev_keyframe;
+} hls_stream_t;
+
+static hls_stream_t hls_streams[MAX_OUTPUT_LOCKS * (1 + MAX_OUTPUT_RENDITIONS)];
+static pthread_mutex_t hls_streams_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static hls_chunk_t *hls_chunk_use(hls_chunk_t *chunk)
+{
+  if (chunk) {
+    chunk->refs++;
+  }
+  return chunk;
+}
+
+static void hls_chunk_release(hls_chunk_t *chunk)
+{
+  if (chunk && --chunk->refs == 0) {
+    mux_buf_free(&chunk->buf);
+    free(chunk);
+  }
+}
+
+static void hls_segment_clear(hls_segment_t *segment)
+{
+  hls_chunk_release(segment->init);
+  for (int i = 0; i < segment->n_parts; i++) {
+    hls_chunk_release(segment->parts[i]);
+  }
+  *segment = (hls_segment_t){0};
+}
+
+static hls_segment_t *hls_stream_find_segment(hls_stream_t *hls, unsigned msn)
+{
+  hls_segment_t *segment = &hls->segments[msn % HLS_SEGMENTS];
+
+  if (!segment->n_parts || segment->msn != msn)
+    return NULL;
+
+  return segment;
+}
+
+// Moves the pending samples into a new part, called with the lock held
+static void hls_stream_publish_part(hls_stream_t *hls)
+{
+  if (!hls->mp4.n_samples) {
+    return;
+  }
+
+  if (!hls->segment) {
+    hls->segment = &hls->segments[hls->next_msn % HLS_SEGMENTS];
+    hls_segment_clear(hls->segment);
+    hls->segment->msn = hls->next_msn++;
+    hls->segment->init = hls_chunk_use(hls->init);
+    hls->segment->discontinuity = hls->discontinuity;
+    hls->discontinuity = false;
+  }
+
+  hls_chunk_t *part = calloc(1, sizeof(hls_chunk_t));
+  part->refs = 1;
+  part->independent = hls->mp4.samples[0].keyframe;
+  part->duration_us = fmp4_duration(&hls->mp4) * 1000 * 1000 / FMP4_TIMESCALE;
+  fmp4_write_fragment(&hls->mp4, &part->buf);
+
+  hls->segment->parts[hls->segment->n_parts++] = part;
+  hls->segment->duration_us += part->duration_us;
+
+  if (hls->segment->n_parts == HLS_MAX_PARTS) {
+    hls->segment->complete = true;
+    hls->segment = NULL;
+  }
+
+  pthread_cond_broadcast(&hls->cond);
+}
+
+static void hls_stream_complete_segment(hls_stream_t *hls)
+{
+  hls_stream_publish_part(hls);
+
+  if (hls->segment) {
+    hls->segment->complete = true;
+    hls->segment = NULL;
+    pthread_cond_broadcast(&hls->cond);
+  }
+}
+
+static void hls_stream_set_init(hls_stream_t *hls, buffer_t *buf, mux_h264_params_t *params)
+{
+  hls_chunk_t *init = calloc(1, sizeof(hls_chunk_t));
+  init->refs = 1;
+  init->id = hls->next_init_id++;
+
+  hls->mp4.params = *params;
+  hls->mp4.width = buf->buf_list->fmt.width;
+  hls->mp4.height = buf->buf_list->fmt.height;
+  fmp4_write_init(&hls->mp4, &init->buf);
+
+  hls->discontinuity = hls->init != NULL;
+  hls_chunk_release(hls->init);
+  hls->init = init;
+
+  LOG_VERBOSE(hls, "New init segment %u for %ux%u.", init->id, hls->mp4.width, hls->mp4.height);
+}
+
+// Adds the previous frame, as its duration is known now
+static void hls_stream_add_prev(hls_stream_t *hls, buffer_t *buf, bool new_init)
+{
+  mux_h264_nal_t nals[MUX_H264_MAX_NALS];
+  int n_nals = hls->n_prev_nals;
+  for (int i = 0; i < n_nals; i++) {
+    nals[i] = (mux_h264_nal_t){ hls->prev.data + hls->prev_nals[i].offset, hls->prev_nals[i].size, hls->prev_nals[i].type };
+  }
+
+  int64_t duration_us = MAX((int64_t)(buf->captured_time_us - hls->prev_time_us), 1);
+  uint64_t duration = duration_us * FMP4_TIMESCALE / 1000 / 1000;
+  uint64_t part_target = (uint64_t)HLS_PART_TARGET_US * FMP4_TIMESCALE / 1000 / 1000;
+
+  pthread_mutex_lock(&hls->lock);
+
+  if (hls->mp4.n_samples && fmp4_duration(&hls->mp4) + duration > part_target) {
+    hls_stream_publish_part(hls);
+  }
+
+  if (!fmp4_add_sample(&hls->mp4, nals, n_nals, duration, hls->prev_keyframe)) {
+    hls_stream_publish_part(hls);
+    fmp4_add_sample(&hls->mp4, nals, n_nals, duration, hls->prev_keyframe);
+  }
+
+  uint64_t segment_us = (hls->segment ? hls->segment->duration_us : 0) +
+    fmp4_duration(&hls->mp4) * 1000 * 1000 / FMP4_TIMESCALE;
+
+  // the segments start with the key frames
+  if (buf->flags.is_keyframe && (new_init || segment_us >= HLS_SEGMENT_TARGET_US)) {
+    hls_stream_complete_segment(hls);
+  } else if (fmp4_duration(&hls->mp4) >= part_target) {
+    hls_stream_publish_part(hls);
+  }
+
+  pthread_mutex_unlock(&hls->lock);
+}
+
+static int hls_stream_buf_part(buffer_lock_t *buf_lock, buffer_t *buf, int frame, hls_stream_t *hls)
+{
+  uint64_t now_us = get_monotonic_time_us(NULL, NULL);
+  bool idle;
+
+  pthread_mutex_lock(&hls->lock);
+  idle = now_us - hls->last_request_us > HLS_IDLE_TIMEOUT_US;
+  pthread_mutex_unlock(&hls->lock);
+
+  if (idle) {
+    return -1;
+  }
+
+  if (!hls->prev.size && !buf->flags.is_keyframe) {
+    return 0;
+  }
+
+  mux_h264_nal_t nals[MUX_H264_MAX_NALS];
+  int n_nals = buffer_h264_nals(buf, nals, MUX_H264_MAX_NALS);
+  mux_h264_params_t params = {0};
+  bool new_init = false;
+
+  if (!n_nals) {
+    return 0;
+  }
+
+  if (buf->flags.is_keyframe) {
+    new_init = mux_h264_params(&params, nals, n_nals) && (!hls->init ||
+      params.sps_size != hls->mp4.params.sps_size || memcmp(params.sps, hls->mp4.params.sps, params.sps_size) ||
+      params.pps_size != hls->mp4.params.pps_size || memcmp(params.pps, hls->mp4.params.pps, params.pps_size));
+
+    if (!hls->init && !new_init) {
+      LOG_DEBUG(hls, "The key frame has no SPS/PPS.");
+      return 0;
+    }
+  }
+
+  if (hls->prev.size) {
+    hls_stream_add_prev(hls, buf, new_init);
+  }
+
+  if (new_init) {
+    pthread_mutex_lock(&hls->lock);
+    hls_stream_set_init(hls, buf, &params);
+    pthread_mutex_unlock(&hls->lock);
+  }
+
+  mux_buf_reset(&hls->prev);
+  for (int i = 0; i < n_nals; i++) {
+    hls->prev_nals[i] = (buffer_nal_t){ hls->prev.size, nals[i].size, nals[i].type };
+    mux_buf_write(&hls->prev, nals[i].data, nals[i].size);
+  }
+  hls->n_prev_nals = n_nals;
+  hls->prev_time_us = buf->captured_time_us;
+  hls->prev_keyframe = buf->flags.is_keyframe;
+  return 1;
+}
+
+static void *hls_stream_thread(void *opaque)
+{
+  hls_stream_t *hls = opaque;
+
+  LOG_INFO(hls, "Segmenter started.");
+
+  while (true) {
+    int frames = buffer_lock_write_loop(hls->buf_lock, 0, 0, (buffer_write_fn)hls_stream_buf_part, hls);
+
+    pthread_mutex_lock(&hls->lock);
+    bool idle = get_monotonic_time_us(NULL, NULL) - hls->last_request_us > HLS_IDLE_TIMEOUT_US;
+    pthread_mutex_unlock(&hls->lock);
+
+    if (idle || frames == 0) {
+      break;
+    }
+
+    // the stream was interrupted, continue with the next key frame
+    mux_buf_reset(&hls->prev);
+  }
+
+  pthread_mutex_lock(&hls->lock);
+  hls_stream_complete_segment(hls);
+  for (int i = 0; i < HLS_SEGMENTS; i++) {
+    hls_segment_clear(&hls->segments[i]);
+  }
+  hls_chunk_release(hls->init);
+  hls->init = NULL;
+  hls->running = false;
+  fmp4_free(&hls->mp4);
+  mux_buf_free(&hls->prev);
+  pthread_cond_broadcast(&hls->cond);
+  pthread_mutex_unlock(&hls->lock);
+
+  LOG_INFO(hls, "Segmenter stopped.");
+  return NULL;
+}
+
+// Returns the segmenter of the camera, started on the first request
+static hls_stream_t *hls_stream_get(http_worker_t *worker)
+{
+  buffer_lock_t *buf_lock = http_video_lock(worker);
+  char *res = http_get_param(worker, HTTP_RES_PARAM);
+  hls_stream_t *hls = NULL;
+
+  pthread_mutex_lock(&hls_streams_lock);
+  for (int i = 0; i < ARRAY_SIZE(hls_streams) && !hls; i++) {
+    if (hls_streams[i].buf_lock == buf_lock) {
+      hls = &hls_streams[i];
+    } else if (!hls_streams[i].buf_lock) {
+      hls = &hls_streams[i];
+      hls->name = "HLS";
+      hls->buf_lock = buf_lock;
+      if (res && buf_lock != http_output_locks(worker)->video && strspn(res, "0123456789low") == strlen(res)) {
+        snprintf(hls->query, sizeof(hls->query), "&" HTTP_RES_PARAM "=%.8s", res);
+      }
+      pthread_mutex_init(&hls->lock, NULL);
+      pthread_cond_init(&hls->cond, NULL);
+    }
+  }
+  pthread_mutex_unlock(&hls_streams_lock);
+  free(res);
+
+  if (!hls) {
+    return NULL;
+  }
+
+  pthread_mutex_lock(&hls->lock);
+  hls->last_request_us = get_monotonic_time_us(NULL, NULL);
+
+  if (!hls->running) {
+    pthread_t thread;
+
+    hls->segment = NULL;
+    hls->discontinuity = false;
+
+    if (pthread_create(&thread, NULL, hls_stream_thread, hls) == 0) {
+      pthread_detach(thread);
+      hls->running = true;
+    }
+  }
+  pthread_mutex_unlock(&hls->lock);
+
+  return hls;
+}
+
+// Waits with the lock held, returns false on the timeout
+static bool hls_stream_wait(hls_stream_t *hls, struct timespec *deadline)
+{
+  return hls->running && pthread_cond_timedwait(&hls->cond, &hls->lock, deadline) == 0;
+}
+
+static bool hls_stream_has_part(hls_stream_t *hls, unsigned msn, int part)
+{
+  hls_segment_t *segment = hls_stream_find_segment(hls, msn);
+
+  if (!segment) {
+    return hls->next_msn > msn + 1; // evicted
+  } else if (part < 0) {
+    return segment->complete;
+  }
+
+  return segment->complete || part < segment->n_parts;
+}
+
+static void hls_stream_write_parts(hls_stream_t *hls, hls_segment_t *segment, FILE *stream)
+{
+  for (int i = 0; i < segment->n_parts; i++) {
+    fprintf(stream, "#EXT-X-PART:DURATION=%.3f,URI=\"video.hls?msn=%u&part=%d%s\"%s\r\n",
+      segment->parts[i]->duration_us / 1000000.0f, segment->msn, i, hls->query,
+      segment->parts[i]->independent ? ",INDEPENDENT=YES" : "");
+  }
+}
+
+// Called with the lock held
+static void hls_stream_write_playlist(hls_stream_t *hls, FILE *stream)
+{
+  unsigned first_msn = hls->next_msn > HLS_SEGMENTS - 1 ? hls->next_msn - (HLS_SEGMENTS - 1) : 0;
+  uint64_t target_us = HLS_SEGMENT_TARGET_US;
+  hls_chunk_t *init = NULL;
+
+  while (first_msn < hls->next_msn && !hls_stream_find_segment(hls, first_msn))
+    first_msn++;
+
+  for (unsigned msn = first_msn; msn < hls->next_msn; msn++) {
+    hls_segment_t *segment = hls_stream_find_segment(hls, msn);
+    if (segment) {
+      target_us = MAX(target_us, segment->duration_us);
+    }
+  }
+
+  fprintf(stream, "#EXTM3U\r\n");
+  fprintf(stream, "#EXT-X-VERSION:9\r\n");
+  fprintf(stream, "#EXT-X-TARGETDURATION:%u\r\n", (unsigned)((target_us + 999999) / 1000000));
+  fprintf(stream, "#EXT-X-SERVER-CONTROL:CAN-BLOCK-RELOAD=YES,PART-HOLD-BACK=%.3f\r\n", 3 * HLS_PART_TARGET_US / 1000000.0f);
+  fprintf(stream, "#EXT-X-PART-INF:PART-TARGET=%.3f\r\n", HLS_PART_TARGET_US / 1000000.0f);
+  fprintf(stream, "#EXT-X-MEDIA-SEQUENCE:%u\r\n", first_msn);
+
+  for (unsigned msn = first_msn; msn < hls->next_msn; msn++) {
+    hls_segment_t *segment = hls_stream_find_segment(hls, msn);
+    if (!segment)
+      continue;
+
+    if (segment->discontinuity && msn != first_msn) {
+      fprintf(stream, "#EXT-X-DISCONTINUITY\r\n");
+    }
+    if (segment->init != init) {
+      init = segment->init;
+      fprintf(stream, "#EXT-X-MAP:URI=\"video.hls?init=%u%s\"\r\n", init->id, hls->query);
+    }
+    if (!segment->complete || msn + HLS_PLAYLIST_PART_SEGMENTS >= hls->next_msn) {
+      hls_stream_write_parts(hls, segment, stream);
+    }
+    if (segment->complete) {
+      fprintf(stream, "#EXTINF:%.3f,\r\n", segment->duration_us / 1000000.0f);
+      fprintf(stream, "video.hls?msn=%u%s\r\n", msn, hls->query);
+    }
+  }
+
+  if (hls->segment) {
+    fprintf(stream, "#EXT-X-PRELOAD-HINT:TYPE=PART,URI=\"video.hls?msn=%u&part=%d%s\"\r\n",
+      hls->segment->msn, hls->segment->n_parts, hls->query);
+  } else {
+    fprintf(stream, "#EXT-X-PRELOAD-HINT:TYPE=PART,URI=\"video.hls?msn=%u&part=0%s\"\r\n",
+      hls->next_msn, hls->query);
+  }
+}
+
+static int http_get_param_int(http_worker_t *worker, const char *key, int default_value)
+{
+  char *param = http_get_param(worker, key);
+  int value = param ? atoi(param) : default_value;
+  free(param);
+  return value;
+}
+
 void http_m3u8_video(struct http_worker_s *worker, FILE *stream)
 {
-  uint64_t ts = get_monotonic_time_us(NULL, NULL) / 1000 / 1000;
-  http_write_responsef(stream, "200 OK", CONTENT_TYPE, STREAM_M3U8, ts);
+  hls_stream_t *hls = hls_stream_get(worker);
+  int msn = http_get_param_int(worker, "_HLS_msn", -1);
+  int part = http_get_param_int(worker, "_HLS_part", -1);
+  struct timespec deadline;
+  char *playlist = NULL;
+  size_t playlist_size = 0;
+
+  if (!hls) {
+    http_500(stream, NULL);
+    fprintf(stream, "Too many streams.\n");
+    return;
+  }
+
+  get_time_us(CLOCK_REALTIME, &deadline, NULL, HLS_BLOCK_TIMEOUT_MS * 1000LL);
+
+  pthread_mutex_lock(&hls->lock);
+
+  // the playlist needs the first complete segment
+  while (!hls_stream_has_part(hls, hls->next_msn > 0 ? hls->next_msn - 1 : 0, -1) && hls_stream_wait(hls, &deadline));
+
+  // the blocking playlist reload, not waiting for more than two segments after the last one
+  bool too_far = msn >= 0 && hls->next_msn > 0 && (unsigned)msn > hls->next_msn + 1;
+  while (msn >= 0 && !too_far && !hls_stream_has_part(hls, msn, part) && hls_stream_wait(hls, &deadline));
+
+  if (hls->next_msn > 0 && !too_far) {
+    FILE *memstream = open_memstream(&playlist, &playlist_size);
+    hls_stream_write_playlist(hls, memstream);
+    fclose(memstream);
+  }
+  pthread_mutex_unlock(&hls->lock);
+
+  if (too_far) {
+    http_400(stream, "The _HLS_msn is too far ahead.\n");
+    return;
+  }
+
+  if (!playlist) {
+    http_500(stream, NULL);
+    fprintf(stream, "No frames.\n");
+    return;
+  }
+
+  http_write_response(stream, "200 OK", CONTENT_TYPE, playlist, playlist_size);
+  free(playlist);
+}
+
+// Serves the `init`, the whole segment (`msn`) or its `part`
+void http_hls_video(struct http_worker_s *worker, FILE *stream)
+{
+  hls_stream_t *hls = hls_stream_get(worker);
+  int init_id = http_get_param_int(worker, "init", -1);
+  int msn = http_get_param_int(worker, "msn", -1);
+  int part = http_get_param_int(worker, "part", -1);
+  hls_chunk_t *chunks[HLS_MAX_PARTS];
+  int n_chunks = 0;
+  struct timespec deadline;
+
+  if (!hls || (init_id < 0 && msn < 0)) {
+    http_404(stream, NULL);
+    return;
+  }
+
+  get_time_us(CLOCK_REALTIME, &deadline, NULL, HLS_BLOCK_TIMEOUT_MS * 1000LL);
+
+  pthread_mutex_lock(&hls->lock);
+  if (init_id >= 0) {
+    if (hls->init && hls->init->id == init_id) {
+      chunks[n_chunks++] = hls_chunk_use(hls->init);
+    }
+    for (int i = 0; !n_chunks && i < HLS_SEGMENTS; i++) {
+      if (hls->segments[i].init && hls->segments[i].init->id == init_id) {
+        chunks[n_chunks++] = hls_chunk_use(hls->segments[i].init);
+      }
+    }
+  } else {
+    // the preload hints wait for the part to be muxed
+    while (!hls_stream_has_part(hls, msn, part) && hls_stream_wait(hls, &deadline));
+
+    hls_segment_t *segment = hls_stream_find_segment(hls, msn);
+    if (segment && part >= 0 && part < segment->n_parts) {
+      chunks[n_chunks++] = hls_chunk_use(segment->parts[part]);
+    } else if (segment && part < 0 && segment->complete) {
+      for (int i = 0; i < segment->n_parts; i++) {
+        chunks[n_chunks++] = hls_chunk_use(segment->parts[i]);
+      }
+    }
+  }
+  pthread_mutex_unlock(&hls->lock);
+
+  if (!n_chunks) {
+    http_404(stream, NULL);
+    fprintf(stream, "Not found.\n");
+    return;
+  }
+
+  size_t size = 0;
+  for (int i = 0; i < n_chunks; i++) {
+    size += chunks[i]->buf.size;
+  }
+
+  // the muxed data never changes
+  fprintf(stream, CHUNK_HEADER, HLS_SEGMENTS * HLS_SEGMENT_TARGET_US / 1000 / 1000, size);
+  for (int i = 0; i < n_chunks; i++) {
+    fwrite(chunks[i]->buf.data, 1, chunks[i]->buf.size, stream);
+  }
+
+  pthread_mutex_lock(&hls->lock);
+  for (int i = 0; i < n_chunks; i++) {
+    hls_chunk_release(chunks[i]);
+  }
+  pthread_mutex_unlock(&hls->lock);
 }
 
 void http_detect_video(struct http_worker_s *worker, FILE *stream)
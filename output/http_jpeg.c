@@ -1,5 +1,6 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <inttypes.h>
 
 #include "output.h"
 #include "util/http/http.h"
@@ -20,10 +21,27 @@ static const char *const STREAM_HEADER = "HTTP/1.0 200 OK\r\n"
                                          "Content-Type: multipart/x-mixed-replace;boundary=" PART_BOUNDARY "\r\n"
                                          "\r\n"
                                          "--" PART_BOUNDARY "\r\n";
-static const char *const STREAM_PART = "Content-Type: " CONTENT_TYPE "\r\n" CONTENT_LENGTH ": %u\r\n\r\n";
+static const char *const STREAM_PART = "Content-Type: " CONTENT_TYPE "\r\n" CONTENT_LENGTH ": %zu\r\n";
 static const char *const STREAM_BOUNDARY = "\r\n"
                                            "--" PART_BOUNDARY "\r\n";
 
+// The `captured_time_us` is monotonic, so it is mapped to the wall clock
+static int http_write_frame_headers(FILE *stream, buffer_t *buf)
+{
+  uint64_t now_us = get_monotonic_time_us(NULL, NULL);
+  uint64_t age_us = now_us > buf->captured_time_us ? now_us - buf->captured_time_us : 0;
+  uint64_t timestamp_us = get_time_us(CLOCK_REALTIME, NULL, NULL, 0) - age_us;
+
+  return fprintf(stream,
+    "X-Timestamp: %" PRIu64 ".%06" PRIu64 "\r\n"
+    "X-Frame-Seq: %u\r\n"
+    "X-Capture-Age-Ms: %.1f\r\n"
+    "\r\n",
+    timestamp_us / 1000000, timestamp_us % 1000000,
+    buf->frame_seq,
+    age_us / 1000.0f);
+}
+
 typedef struct
 {
   FILE *stream;
@@ -40,12 +58,17 @@ int http_snapshot_buf_part(buffer_lock_t *buf_lock, buffer_t *buf, int frame, ht
   fprintf(snapshot->stream, "HTTP/1.1 200 OK\r\n");
   fprintf(snapshot->stream, "Content-Type: image/jpeg\r\n");
   fprintf(snapshot->stream, "Content-Length: %zu\r\n", buf->used);
-  fprintf(snapshot->stream, "\r\n");
+  http_write_frame_headers(snapshot->stream, buf);
   fwrite(buf->start, buf->used, 1, snapshot->stream);
   return 1;
 }
 
 void http_snapshot(http_worker_t *worker, FILE *stream)
+{
+  http_snapshot_from(worker, stream, http_output_locks(worker)->snapshot);
+}
+
+void http_snapshot_from(http_worker_t *worker, FILE *stream, buffer_lock_t *buf_lock)
 {
   int max_delay_value = SNAPSHOT_DEFAULT_DELAY_PARAM;
 
@@ -61,7 +84,7 @@ void http_snapshot(http_worker_t *worker, FILE *stream)
     .start_time_us = get_monotonic_time_us(NULL, NULL) - max_delay_value * 1000
   };
 
-  int n = buffer_lock_write_loop(&snapshot_lock, 1, SNAPSHOT_TIMEOUT_MS,
+  int n = buffer_lock_write_loop(buf_lock, 1, SNAPSHOT_TIMEOUT_MS,
     (buffer_write_fn)http_snapshot_buf_part, &snapshot);
 
   if (n <= 0) {
@@ -78,19 +101,28 @@ int http_stream_buf_part(buffer_lock_t *buf_lock, buffer_t *buf, int frame, FILE
   if (!fprintf(stream, STREAM_PART, buf->used)) {
     return -1;
   }
+  if (!http_write_frame_headers(stream, buf)) {
+    return -1;
+  }
   if (!fwrite(buf->start, buf->used, 1, stream)) {
     return -1;
   }
   if (!fputs(STREAM_BOUNDARY, stream)) {
     return -1;
   }
+  fflush(stream);
 
   return 1;
 }
 
 void http_stream(http_worker_t *worker, FILE *stream)
 {
-  int n = buffer_lock_write_loop(&stream_lock, 0, 0, (buffer_write_fn)http_stream_buf_part, stream);
+  http_stream_from(worker, stream, http_output_locks(worker)->stream);
+}
+
+void http_stream_from(http_worker_t *worker, FILE *stream, buffer_lock_t *buf_lock)
+{
+  int n = buffer_lock_write_loop(buf_lock, 0, 0, (buffer_write_fn)http_stream_buf_part, stream);
 
   if (n == 0) {
     http_500(stream, NULL);
@@ -0,0 +1,392 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "output.h"
+#include "util/opts/log.h"
+#include "util/http/http.h"
+#include "util/mux/fmp4.h"
+#include "util/mux/mkv.h"
+#include "device/buffer.h"
+#include "device/buffer_lock.h"
+#include "device/buffer_list.h"
+#include "device/buffer_h264.h"
+#include "device/device.h"
+
+#define HTTP_MUX_FORMATS 2
+#define HTTP_MUX_CHUNKS 64 // the frames kept for the slow and the new clients
+#define HTTP_MUX_WAIT_MS DEFAULT_BUFFER_LOCK_GET_TIMEOUT
+#define HTTP_MUX_DEFAULT_DURATION_US (1000 * 1000 / 30)
+
+static const char *const VIDEO_HEADER =
+  "HTTP/1.0 200 OK\r\n"
+  "Access-Control-Allow-Origin: *\r\n"
+  "Connection: close\r\n"
+  "Content-Type: %s\r\n"
+  "\r\n";
+
+typedef struct http_mux_s http_mux_t;
+
+typedef struct http_mux_format_s {
+  const char *name;
+  const char *content_type;
+  void (*write_init)(http_mux_t *mux, mux_buf_t *buf);
+  void (*write_frame)(http_mux_t *mux, buffer_t *buf, mux_h264_nal_t *nals, int n_nals, mux_iov_t *iov);
+} http_mux_format_t;
+
+// The init segment or a single muxed frame
+typedef struct http_mux_chunk_s {
+  int refs;
+  bool keyframe;
+  mux_buf_t buf;
+} http_mux_chunk_t;
+
+// A muxer shared by all clients of the same camera and container format
+typedef struct http_mux_s {
+  const char *name;
+  const http_mux_format_t *format;
+  buffer_lock_t *buf_lock;
+
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+  bool running;
+  bool stopping; // the last client left, the muxer thread is cleaning up
+  int clients;
+
+  http_mux_chunk_t *init;
+  http_mux_chunk_t *chunks[HTTP_MUX_CHUNKS]; // by `seq % HTTP_MUX_CHUNKS`
+  int next_seq;
+
+  // used by the muxer thread only
+  bool requested_key_frame;
+  mux_h264_params_t params;
+  unsigned width, height;
+  uint64_t start_time_us;
+  uint64_t last_time_us;
+  mux_iov_t iov;
+  fmp4_t mp4;
+  mkv_t mkv;
+} http_mux_t;
+
+static void http_mux_mp4_write_init(http_mux_t *mux, mux_buf_t *buf)
+{
+  mux->mp4 = (fmp4_t){
+    .width = mux->width,
+    .height = mux->height,
+    .params = mux->params,
+  };
+  fmp4_write_init(&mux->mp4, buf);
+}
+
+static void http_mux_mp4_write_frame(http_mux_t *mux, buffer_t *buf, mux_h264_nal_t *nals, int n_nals, mux_iov_t *iov)
+{
+  // the duration is not known yet, so the last frame interval is used
+  uint64_t duration_us = buf->captured_time_us > mux->last_time_us ?
+    buf->captured_time_us - mux->last_time_us : HTTP_MUX_DEFAULT_DURATION_US;
+
+  fmp4_write_frame(&mux->mp4, nals, n_nals,
+    (buf->captured_time_us - mux->start_time_us) * FMP4_TIMESCALE / 1000 / 1000,
+    duration_us * FMP4_TIMESCALE / 1000 / 1000,
+    buf->flags.is_keyframe, iov);
+}
+
+static void http_mux_mkv_write_init(http_mux_t *mux, mux_buf_t *buf)
+{
+  mux->mkv = (mkv_t){
+    .width = mux->width,
+    .height = mux->height,
+    .params = mux->params,
+  };
+  mkv_write_init(&mux->mkv, buf);
+}
+
+static void http_mux_mkv_write_frame(http_mux_t *mux, buffer_t *buf, mux_h264_nal_t *nals, int n_nals, mux_iov_t *iov)
+{
+  mkv_write_frame(&mux->mkv, nals, n_nals,
+    (buf->captured_time_us - mux->start_time_us) / 1000,
+    buf->flags.is_keyframe, iov);
+}
+
+static const http_mux_format_t http_mux_mp4 = {
+  .name = "mp4",
+  .content_type = "video/mp4",
+  .write_init = http_mux_mp4_write_init,
+  .write_frame = http_mux_mp4_write_frame,
+};
+
+static const http_mux_format_t http_mux_mkv = {
+  .name = "matroska",
+  .content_type = "video/mp4",
+  .write_init = http_mux_mkv_write_init,
+  .write_frame = http_mux_mkv_write_frame,
+};
+
+static http_mux_t http_muxers[MAX_OUTPUT_LOCKS * (1 + MAX_OUTPUT_RENDITIONS) * HTTP_MUX_FORMATS];
+static pthread_mutex_t http_muxers_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static http_mux_chunk_t *http_mux_chunk_use(http_mux_chunk_t *chunk)
+{
+  if (chunk) {
+    chunk->refs++;
+  }
+  return chunk;
+}
+
+static void http_mux_chunk_release(http_mux_chunk_t *chunk)
+{
+  if (chunk && --chunk->refs == 0) {
+    mux_buf_free(&chunk->buf);
+    free(chunk);
+  }
+}
+
+static http_mux_chunk_t *http_mux_chunk_new(bool keyframe)
+{
+  http_mux_chunk_t *chunk = calloc(1, sizeof(http_mux_chunk_t));
+  chunk->refs = 1;
+  chunk->keyframe = keyframe;
+  return chunk;
+}
+
+static int http_mux_buf_part(buffer_lock_t *buf_lock, buffer_t *buf, int frame, http_mux_t *mux)
+{
+  pthread_mutex_lock(&mux->lock);
+  int clients = mux->clients;
+  mux->stopping = !clients;
+  pthread_mutex_unlock(&mux->lock);
+
+  if (!clients) {
+    return -1;
+  }
+
+  mux_h264_nal_t nals[MUX_H264_MAX_NALS];
+  int n_nals = buffer_h264_nals(buf, nals, MUX_H264_MAX_NALS);
+  http_mux_chunk_t *init = NULL;
+  mux_h264_params_t params = {0};
+
+  if (!n_nals) {
+    return 0;
+  }
+
+  if (buf->flags.is_keyframe && mux_h264_params(&params, nals, n_nals) &&
+    (!mux->init || memcmp(&params, &mux->params, sizeof(params)))) {
+    if (mux->init) {
+      LOG_INFO(mux, "The stream parameters changed, restarting the clients.");
+    }
+
+    mux->params = params;
+    mux->width = buf->buf_list->fmt.width;
+    mux->height = buf->buf_list->fmt.height;
+    mux->start_time_us = buf->captured_time_us;
+    mux->last_time_us = buf->captured_time_us;
+
+    init = http_mux_chunk_new(false);
+    mux->format->write_init(mux, &init->buf);
+  } else if (!mux->init) {
+    if (!mux->requested_key_frame) {
+      mux->requested_key_frame = device_video_force_key(buf->buf_list->dev) == 0;
+    }
+    return 0;
+  }
+
+  // the ring outlives the encoded buffer, so the frame is copied once for all clients
+  http_mux_chunk_t *chunk = http_mux_chunk_new(buf->flags.is_keyframe);
+  mux->format->write_frame(mux, buf, nals, n_nals, &mux->iov);
+  mux_iov_gather(&mux->iov, &chunk->buf);
+  mux->last_time_us = buf->captured_time_us;
+
+  pthread_mutex_lock(&mux->lock);
+  if (init) {
+    http_mux_chunk_release(mux->init);
+    mux->init = init;
+  }
+  http_mux_chunk_release(mux->chunks[mux->next_seq % HTTP_MUX_CHUNKS]);
+  mux->chunks[mux->next_seq++ % HTTP_MUX_CHUNKS] = chunk;
+  pthread_cond_broadcast(&mux->cond);
+  pthread_mutex_unlock(&mux->lock);
+
+  return 1;
+}
+
+static void *http_mux_thread(void *opaque)
+{
+  http_mux_t *mux = opaque;
+
+  mux->requested_key_frame = false;
+
+  LOG_INFO(mux, "Muxer started.");
+
+  int n = buffer_lock_write_loop(
+    mux->buf_lock,
+    0,
+    0,
+    (buffer_write_fn)http_mux_buf_part,
+    mux);
+  mux_iov_free(&mux->iov);
+
+  pthread_mutex_lock(&mux->lock);
+  http_mux_chunk_release(mux->init);
+  mux->init = NULL;
+  for (int i = 0; i < HTTP_MUX_CHUNKS; i++) {
+    http_mux_chunk_release(mux->chunks[i]);
+    mux->chunks[i] = NULL;
+  }
+  mux->running = false;
+  mux->stopping = false;
+  pthread_cond_broadcast(&mux->cond);
+  pthread_mutex_unlock(&mux->lock);
+
+  LOG_INFO(mux, "Muxer stopped after %d frames.", n);
+  return NULL;
+}
+
+// Registers the client in the muxer of the camera, started by the first one
+static http_mux_t *http_mux_get(http_worker_t *worker, const http_mux_format_t *format)
+{
+  buffer_lock_t *buf_lock = http_video_lock(worker);
+  http_mux_t *mux = NULL;
+
+  pthread_mutex_lock(&http_muxers_lock);
+  for (int i = 0; i < ARRAY_SIZE(http_muxers) && !mux; i++) {
+    if (http_muxers[i].buf_lock == buf_lock && http_muxers[i].format == format) {
+      mux = &http_muxers[i];
+    } else if (!http_muxers[i].buf_lock) {
+      mux = &http_muxers[i];
+      mux->name = format->name;
+      mux->format = format;
+      mux->buf_lock = buf_lock;
+      pthread_mutex_init(&mux->lock, NULL);
+      pthread_cond_init(&mux->cond, NULL);
+    }
+  }
+  pthread_mutex_unlock(&http_muxers_lock);
+
+  if (!mux) {
+    return NULL;
+  }
+
+  pthread_mutex_lock(&mux->lock);
+  mux->clients++;
+
+  // the stopping muxer would not see this client, so a new one is started
+  while (mux->running && mux->stopping) {
+    pthread_cond_wait(&mux->cond, &mux->lock);
+  }
+
+  if (!mux->running) {
+    pthread_t thread;
+
+    mux->next_seq = 0;
+
+    if (pthread_create(&thread, NULL, http_mux_thread, mux) == 0) {
+      pthread_detach(thread);
+      mux->running = true;
+    }
+  }
+  pthread_mutex_unlock(&mux->lock);
+
+  return mux;
+}
+
+// Returns the next chunk to send, the client joins at the last key frame
+static http_mux_chunk_t *http_mux_next(http_mux_t *mux, http_mux_chunk_t *init, int *seq)
+{
+  http_mux_chunk_t *chunk = NULL;
+  struct timespec deadline;
+
+  get_time_us(CLOCK_REALTIME, &deadline, NULL, HTTP_MUX_WAIT_MS * 1000LL);
+
+  pthread_mutex_lock(&mux->lock);
+  while (mux->running && mux->init == init && !chunk) {
+    int first_seq = mux->next_seq > HTTP_MUX_CHUNKS ? mux->next_seq - HTTP_MUX_CHUNKS : 0;
+
+    // the new or too slow client
+    if (*seq < first_seq) {
+      *seq = -1;
+      for (int i = mux->next_seq; i-- > first_seq && *seq < 0; ) {
+        if (mux->chunks[i % HTTP_MUX_CHUNKS]->keyframe) {
+          *seq = i;
+        }
+      }
+    }
+
+    if (*seq >= 0 && *seq < mux->next_seq) {
+      chunk = http_mux_chunk_use(mux->chunks[*seq % HTTP_MUX_CHUNKS]);
+      (*seq)++;
+    } else if (pthread_cond_timedwait(&mux->cond, &mux->lock, &deadline) != 0) {
+      break;
+    }
+  }
+  pthread_mutex_unlock(&mux->lock);
+
+  return chunk;
+}
+
+static void http_mux_video(http_worker_t *worker, FILE *stream, const http_mux_format_t *format)
+{
+  http_mux_t *mux = http_mux_get(worker, format);
+  http_mux_chunk_t *init = NULL;
+  http_mux_chunk_t *chunk = NULL;
+  struct timespec deadline;
+  int seq = -1;
+  int frames = 0;
+
+  if (!mux) {
+    http_500(stream, NULL);
+    fprintf(stream, "Too many streams.\n");
+    return;
+  }
+
+  get_time_us(CLOCK_REALTIME, &deadline, NULL, HTTP_MUX_WAIT_MS * 1000LL);
+
+  pthread_mutex_lock(&mux->lock);
+  while (mux->running && !mux->init && pthread_cond_timedwait(&mux->cond, &mux->lock, &deadline) == 0);
+  init = http_mux_chunk_use(mux->init);
+  pthread_mutex_unlock(&mux->lock);
+
+  if (!init) {
+    goto error;
+  }
+
+  // the init segment is written once the first frame is there
+  while ((chunk = http_mux_next(mux, init, &seq)) != NULL) {
+    if (!frames) {
+      fprintf(stream, VIDEO_HEADER, format->content_type);
+      fwrite(init->buf.data, 1, init->buf.size, stream);
+    }
+
+    fwrite(chunk->buf.data, 1, chunk->buf.size, stream);
+    fflush(stream);
+    frames++;
+
+    pthread_mutex_lock(&mux->lock);
+    http_mux_chunk_release(chunk);
+    pthread_mutex_unlock(&mux->lock);
+
+    if (ferror(stream)) {
+      break;
+    }
+  }
+
+error:
+  pthread_mutex_lock(&mux->lock);
+  http_mux_chunk_release(init);
+  mux->clients--;
+  pthread_mutex_unlock(&mux->lock);
+
+  if (frames) {
+    return;
+  }
+
+  http_500(stream, NULL);
+  fprintf(stream, "No frames.\n");
+}
+
+void http_mkv_video(http_worker_t *worker, FILE *stream)
+{
+  http_mux_video(worker, stream, &http_mux_mkv);
+}
+
+void http_mp4_video(http_worker_t *worker, FILE *stream)
+{
+  http_mux_video(worker, stream, &http_mux_mp4);
+}
@@ -0,0 +1,289 @@
+#include "output/motion/motion.h"
+#include "output/output.h"
+#include "output/bitrate/bitrate.h"
+#include "device/buffer.h"
+#include "device/buffer_list.h"
+#include "device/buffer_lock.h"
+#include "device/buffer_luma.h"
+#include "device/camera/camera.h"
+#include "device/device.h"
+#include "util/http/http.h"
+#include "util/opts/log.h"
+
+#include <stdlib.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#define MOTION_BLOCKS_X 8
+#define MOTION_BLOCKS_Y 6
+#define MOTION_BLOCKS (MOTION_BLOCKS_X * MOTION_BLOCKS_Y)
+#define MOTION_RESET_US (1000 * 1000)
+#define MOTION_KEEPALIVE_MS 10000
+#define MOTION_RECONFIGURE_TIMEOUT_MS 1000
+
+static const char *const EVENTS_HEADER =
+  "HTTP/1.0 200 OK\r\n"
+  "Access-Control-Allow-Origin: *\r\n"
+  "Connection: close\r\n"
+  "Cache-Control: no-cache\r\n"
+  "Content-Type: text/event-stream\r\n"
+  "\r\n";
+
+typedef struct motion_s {
+  const char *name;
+  output_locks_t *locks;
+
+  // used by the motion thread only
+  buffer_luma_t frames[2];
+  int current;
+  bool has_previous;
+  uint64_t previous_time_us;
+  uint8_t changed[BUFFER_LUMA_MAX_CELLS];
+
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+  unsigned seq;
+  float score;
+  uint8_t blocks[MOTION_BLOCKS]; // the changed cells in %
+  bool active;
+  unsigned events;
+  uint64_t last_motion_us;
+} motion_t;
+
+static motion_options_t *motion_options;
+static motion_t *motions[MAX_OUTPUT_LOCKS];
+
+static void motion_set_bitrate(motion_t *motion, bool active)
+{
+  unsigned bitrate = active ? motion_options->bitrate : motion_options->idle_bitrate;
+  char value[32];
+
+  if (!motion_options->bitrate || !motion_options->idle_bitrate) {
+    return;
+  }
+
+  // the adaptive bitrate stays under the motion bitrate
+  if (motion->locks == &output_locks && bitrate_set_limit(bitrate)) {
+    return;
+  }
+
+  camera_t *camera = output_locks_camera_get(motion->locks);
+  if (!camera) {
+    return;
+  }
+
+  // applied by the camera thread, and kept when the encoder is re-opened
+  camera_options_t *options = malloc(sizeof(camera_options_t));
+  camera_get_options(camera, options);
+  snprintf(value, sizeof(value), "%u", bitrate);
+  if (camera_set_output_option(&options->video, "video_bitrate", value) < 0 ||
+    camera_reconfigure(camera, options, MOTION_RECONFIGURE_TIMEOUT_MS) < 0) {
+    LOG_VERBOSE(motion, "Cannot set the bitrate to %u.", bitrate);
+  }
+
+  free(options);
+  output_locks_camera_put(motion->locks, camera);
+}
+
+// Updates the score and the blocks, and starts or stops the motion event
+static void motion_update(motion_t *motion, uint64_t time_us, int n_changed, buffer_luma_t *frame)
+{
+  int block_cells[MOTION_BLOCKS] = {0}, block_changed[MOTION_BLOCKS] = {0};
+  bool started = false, stopped = false;
+
+  for (int cy = 0; cy < frame->cells_y; cy++) {
+    for (int cx = 0; cx < frame->cells_x; cx++) {
+      int block = cy * MOTION_BLOCKS_Y / frame->cells_y * MOTION_BLOCKS_X + cx * MOTION_BLOCKS_X / frame->cells_x;
+      block_cells[block]++;
+      block_changed[block] += motion->changed[cy * frame->cells_x + cx] ? 1 : 0;
+    }
+  }
+
+  pthread_mutex_lock(&motion->lock);
+  motion->score = 100.0f * n_changed / (frame->cells_x * frame->cells_y);
+  for (int i = 0; i < MOTION_BLOCKS; i++) {
+    motion->blocks[i] = block_cells[i] ? 100 * block_changed[i] / block_cells[i] : 0;
+  }
+
+  if (n_changed && motion->score >= motion_options->min_score) {
+    motion->last_motion_us = time_us;
+    if (!motion->active) {
+      motion->active = started = true;
+      motion->events++;
+    }
+  } else if (motion->active && time_us - motion->last_motion_us > motion_options->hold_s * 1000LL * 1000LL) {
+    motion->active = false;
+    stopped = true;
+  }
+
+  motion->seq++;
+  pthread_cond_broadcast(&motion->cond);
+  pthread_mutex_unlock(&motion->lock);
+
+  if (started || stopped) {
+    LOG_INFO(motion, "Motion %s, score=%.1f%%.", started ? "started" : "stopped", motion->score);
+    motion_set_bitrate(motion, started);
+  }
+}
+
+static int motion_buf_part(buffer_lock_t *buf_lock, buffer_t *buf, int frame, motion_t *motion)
+{
+  buffer_luma_t *current = &motion->frames[motion->current];
+  buffer_luma_t *previous = &motion->frames[!motion->current];
+
+  if (!buffer_luma_downsample(buf, current)) {
+    return 0;
+  }
+
+  // the comparison restarts after the gap or the resolution change
+  if (motion->has_previous && buf->captured_time_us - motion->previous_time_us < MOTION_RESET_US) {
+    int n_changed = buffer_luma_diff(current, previous, motion_options->threshold, motion->changed);
+    if (n_changed >= 0) {
+      motion_update(motion, buf->captured_time_us, n_changed, current);
+    }
+  }
+
+  motion->has_previous = true;
+  motion->previous_time_us = buf->captured_time_us;
+  motion->current = !motion->current;
+  return 1;
+}
+
+// The analysis runs on the frames of the motion lock, so the links loop
+// only replaces its buffer, dropping the frames over the `fps`
+static void *motion_thread(void *opaque)
+{
+  motion_t *motion = opaque;
+
+  while (true) {
+    if (motion->locks->motion->buf_list) {
+      buffer_lock_write_loop(motion->locks->motion, 0, 0, (buffer_write_fn)motion_buf_part, motion);
+    }
+
+    motion->has_previous = false;
+    sleep(1);
+  }
+
+  return NULL;
+}
+
+int motion_server(motion_options_t *options)
+{
+  pthread_t thread;
+
+  motion_options = options;
+
+  for (int i = 0; i < MAX_OUTPUT_LOCKS; i++) {
+    output_locks_t *locks = output_locks_get(i);
+    if (!locks) {
+      continue;
+    }
+
+    motion_t *motion = calloc(1, sizeof(motion_t));
+    motion->name = locks->name ? locks->name : "camera";
+    motion->locks = locks;
+    pthread_mutex_init(&motion->lock, NULL);
+    pthread_cond_init(&motion->cond, NULL);
+
+    if (options->fps > 0) {
+      locks->motion->frame_interval_ms = 1000 / options->fps;
+    }
+
+    if (pthread_create(&thread, NULL, motion_thread, motion) != 0) {
+      LOG_ERROR(motion, "Cannot start the motion thread.");
+    }
+    pthread_detach(thread);
+
+    motions[i] = motion;
+  }
+
+  options->running = true;
+  return 0;
+
+error:
+  return -1;
+}
+
+static motion_t *motion_find(output_locks_t *locks)
+{
+  for (int i = 0; i < MAX_OUTPUT_LOCKS; i++) {
+    if (motions[i] && motions[i]->locks == locks) {
+      return motions[i];
+    }
+  }
+
+  return NULL;
+}
+
+bool motion_is_active(output_locks_t *locks)
+{
+  motion_t *motion = motion_find(locks);
+  bool active = false;
+
+  if (motion) {
+    pthread_mutex_lock(&motion->lock);
+    active = motion->active;
+    pthread_mutex_unlock(&motion->lock);
+  }
+
+  return active;
+}
+
+// Sends the `start`, `stop` and `score` events of every analysed frame
+void http_motion_events(http_worker_t *worker, FILE *stream)
+{
+  motion_t *motion = motion_find(http_output_locks(worker));
+  unsigned seq = 0;
+  bool active = false;
+
+  if (!motion || !motion->locks->motion->buf_list) {
+    http_404(stream, "The motion detection is disabled.\r\n");
+    return;
+  }
+
+  fputs(EVENTS_HEADER, stream);
+  fflush(stream);
+
+  pthread_mutex_lock(&motion->lock);
+  seq = motion->seq;
+  active = motion->active;
+
+  while (true) {
+    struct timespec timeout;
+    get_time_us(CLOCK_REALTIME, &timeout, NULL, MOTION_KEEPALIVE_MS * 1000LL);
+
+    if (seq == motion->seq &&
+      pthread_cond_timedwait(&motion->cond, &motion->lock, &timeout) == ETIMEDOUT) {
+      pthread_mutex_unlock(&motion->lock);
+      if (fputs(": keep-alive\n\n", stream) < 0 || fflush(stream) < 0) {
+        return;
+      }
+      pthread_mutex_lock(&motion->lock);
+      continue;
+    }
+    if (seq == motion->seq) {
+      continue;
+    }
+
+    const char *event = motion->active == active ? "score" : motion->active ? "start" : "stop";
+    char blocks[MOTION_BLOCKS * 4 + 1];
+    int n = 0;
+
+    for (int i = 0; i < MOTION_BLOCKS; i++) {
+      n += sprintf(blocks + n, "%s%u", i ? "," : "", motion->blocks[i]);
+    }
+
+    seq = motion->seq;
+    active = motion->active;
+    float score = motion->score;
+    unsigned events = motion->events;
+    pthread_mutex_unlock(&motion->lock);
+
+    if (fprintf(stream, "event: %s\ndata: {\"active\":%s,\"score\":%.2f,\"events\":%u,\"blocks_x\":%d,\"blocks\":[%s]}\n\n",
+      event, active ? "true" : "false", score, events, MOTION_BLOCKS_X, blocks) < 0 || fflush(stream) < 0) {
+      return;
+    }
+
+    pthread_mutex_lock(&motion->lock);
+  }
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <stdio.h>
+#include <stdbool.h>
+
+typedef struct http_worker_s http_worker_t;
+typedef struct output_locks_s output_locks_t;
+
+typedef struct motion_options_s {
+  bool running;
+  unsigned fps;
+  unsigned threshold;
+  float min_score;
+  unsigned hold_s;
+  unsigned bitrate;
+  unsigned idle_bitrate;
+} motion_options_t;
+
+// Motion
+void http_motion_events(http_worker_t *worker, FILE *stream);
+bool motion_is_active(output_locks_t *locks);
+int motion_server(motion_options_t *options);
@@ -1,5 +1,324 @@
+#include "util/http/http.h"
 #include "device/buffer_lock.h"
+#include "output/output.h"
+#include "util/opts/log.h"
+#include "util/opts/fourcc.h"
+#include "device/camera/camera.h"
+
+#include <limits.h>
 
 DEFINE_BUFFER_LOCK(snapshot_lock, 0);
 DEFINE_BUFFER_LOCK(stream_lock, 0);
-DEFINE_BUFFER_LOCK(video_lock, 0);
+DEFINE_BUFFER_LOCK2(video_lock, 0, true);
+DEFINE_BUFFER_LOCK(motion_lock, 0);
+DEFINE_BUFFER_LOCK2(video1_lock, 0, true);
+DEFINE_BUFFER_LOCK2(video2_lock, 0, true);
+
+output_locks_t output_locks = {
+  .snapshot = &snapshot_lock,
+  .stream = &stream_lock,
+  .video = &video_lock,
+  .motion = &motion_lock,
+  .renditions = { &video1_lock, &video2_lock },
+  .camera_lock = PTHREAD_MUTEX_INITIALIZER,
+  .camera_cond = PTHREAD_COND_INITIALIZER,
+};
+
+static output_locks_t *all_output_locks[MAX_OUTPUT_LOCKS] = {
+  &output_locks
+};
+static int n_output_locks = 1;
+
+static const char *output_locks_name(const char *name, const char *lock)
+{
+  char *buf = NULL;
+  if (asprintf(&buf, "%s:%s", name, lock) < 0)
+    return NULL;
+  return buf;
+}
+
+output_locks_t *output_locks_new(const char *name)
+{
+  if (output_locks_find(name)) {
+    LOG_INFO(NULL, "The camera '%s' is already defined.", name);
+    return NULL;
+  }
+
+  if (n_output_locks >= MAX_OUTPUT_LOCKS) {
+    LOG_INFO(NULL, "Too many cameras. Maximum is %d.", MAX_OUTPUT_LOCKS);
+    return NULL;
+  }
+
+  output_locks_t *locks = calloc(1, sizeof(output_locks_t));
+  locks->name = strdup(name);
+  pthread_mutex_init(&locks->camera_lock, NULL);
+  pthread_cond_init(&locks->camera_cond, NULL);
+  locks->snapshot = calloc(1, sizeof(buffer_lock_t));
+  locks->stream = calloc(1, sizeof(buffer_lock_t));
+  locks->video = calloc(1, sizeof(buffer_lock_t));
+  locks->motion = calloc(1, sizeof(buffer_lock_t));
+
+  buffer_lock_init(locks->snapshot, output_locks_name(name, "snapshot_lock"), 0);
+  buffer_lock_init(locks->stream, output_locks_name(name, "stream_lock"), 0);
+  buffer_lock_init(locks->video, output_locks_name(name, "video_lock"), 0);
+  buffer_lock_init(locks->motion, output_locks_name(name, "motion_lock"), 0);
+  locks->video->gop_cache = true;
+
+  for (int i = 0; i < MAX_OUTPUT_RENDITIONS; i++) {
+    char lock_name[32];
+    sprintf(lock_name, "video%d_lock", i + 1);
+    locks->renditions[i] = calloc(1, sizeof(buffer_lock_t));
+    buffer_lock_init(locks->renditions[i], output_locks_name(name, lock_name), 0);
+    locks->renditions[i]->gop_cache = true;
+  }
+
+  ARRAY_APPEND(all_output_locks, n_output_locks, locks);
+  return locks;
+}
+
+output_locks_t *output_locks_find(const char *name)
+{
+  for (int i = 0; i < n_output_locks; i++) {
+    if (all_output_locks[i]->name && !strcmp(all_output_locks[i]->name, name)) {
+      return all_output_locks[i];
+    }
+  }
+
+  return NULL;
+}
+
+output_locks_t *output_locks_get(int index)
+{
+  if (index < 0 || index >= n_output_locks)
+    return NULL;
+
+  return all_output_locks[index];
+}
+
+output_locks_t *http_output_locks(http_worker_t *worker)
+{
+  if (worker && worker->context) {
+    return worker->context;
+  }
+
+  return &output_locks;
+}
+
+// The running camera, not closed until given back with `output_locks_camera_put()`
+camera_t *output_locks_camera_get(output_locks_t *locks)
+{
+  pthread_mutex_lock(&locks->camera_lock);
+  camera_t *camera = locks->camera;
+  if (camera) {
+    locks->camera_refs++;
+  }
+  pthread_mutex_unlock(&locks->camera_lock);
+  return camera;
+}
+
+void output_locks_camera_put(output_locks_t *locks, camera_t *camera)
+{
+  if (!camera) {
+    return;
+  }
+
+  pthread_mutex_lock(&locks->camera_lock);
+  locks->camera_refs--;
+  pthread_cond_broadcast(&locks->camera_cond);
+  pthread_mutex_unlock(&locks->camera_lock);
+}
+
+// Publishes the running camera, or waits for its users before it is closed
+void output_locks_set_camera(output_locks_t *locks, camera_t *camera)
+{
+  // not running yet, so its options are not changed meanwhile
+  output_locks_set_videos(locks, camera ? &camera->options : NULL);
+
+  pthread_mutex_lock(&locks->camera_lock);
+  locks->camera = camera;
+  while (!camera && locks->camera_refs > 0) {
+    pthread_cond_wait(&locks->camera_cond, &locks->camera_lock);
+  }
+  pthread_mutex_unlock(&locks->camera_lock);
+}
+
+// Keeps the main video first, then the configured renditions,
+// so they are selected without copying the camera options
+void output_locks_set_videos(output_locks_t *locks, camera_options_t *options)
+{
+  pthread_mutex_lock(&locks->camera_lock);
+  locks->n_videos = 0;
+
+  if (options) {
+    locks->videos[locks->n_videos] = locks->video;
+    locks->video_heights[locks->n_videos] = options->video.height;
+    locks->video_bitrates[locks->n_videos++] = camera_output_bitrate(&options->video);
+
+    for (int i = 0; i < MAX_OUTPUT_RENDITIONS; i++) {
+      if (options->renditions[i].height) {
+        locks->videos[locks->n_videos] = locks->renditions[i];
+        locks->video_heights[locks->n_videos] = options->renditions[i].height;
+        locks->video_bitrates[locks->n_videos++] = camera_output_bitrate(&options->renditions[i]);
+      }
+    }
+  }
+
+  pthread_mutex_unlock(&locks->camera_lock);
+}
+
+static int output_locks_videos(output_locks_t *locks, buffer_lock_t *buf_locks[], unsigned heights[], unsigned bitrates[])
+{
+  pthread_mutex_lock(&locks->camera_lock);
+  int n = locks->n_videos;
+  memcpy(buf_locks, locks->videos, n * sizeof(*buf_locks));
+  memcpy(heights, locks->video_heights, n * sizeof(*heights));
+  memcpy(bitrates, locks->video_bitrates, n * sizeof(*bitrates));
+  pthread_mutex_unlock(&locks->camera_lock);
+  return n;
+}
+
+// Selects the rendition for `high`, `low`, or the highest one not above the given height
+buffer_lock_t *output_locks_video(output_locks_t *locks, const char *res)
+{
+  buffer_lock_t *buf_locks[1 + MAX_OUTPUT_RENDITIONS];
+  unsigned heights[1 + MAX_OUTPUT_RENDITIONS];
+  unsigned bitrates[1 + MAX_OUTPUT_RENDITIONS];
+  int best = -1, lowest = 0;
+
+  if (!res || !strcmp(res, "high")) {
+    return locks->video;
+  }
+
+  int n = output_locks_videos(locks, buf_locks, heights, bitrates);
+  if (!n) {
+    return locks->video;
+  }
+
+  unsigned height = strcmp(res, "low") ? strtoul(res, NULL, 10) : 0;
+
+  for (int i = 0; i < n; i++) {
+    if (heights[i] < heights[lowest]) {
+      lowest = i;
+    }
+    if (heights[i] <= height && (best < 0 || heights[i] > heights[best])) {
+      best = i;
+    }
+  }
+
+  return buf_locks[best >= 0 ? best : lowest];
+}
+
+// Selects the highest rendition not above the given bitrate, or the lowest one
+buffer_lock_t *output_locks_video_for_bitrate(output_locks_t *locks, unsigned bitrate)
+{
+  buffer_lock_t *buf_locks[1 + MAX_OUTPUT_RENDITIONS];
+  unsigned heights[1 + MAX_OUTPUT_RENDITIONS];
+  unsigned bitrates[1 + MAX_OUTPUT_RENDITIONS];
+  int n = output_locks_videos(locks, buf_locks, heights, bitrates);
+  int best = -1, lowest = 0;
+
+  if (!n) {
+    return locks->video;
+  }
+
+  for (int i = 0; i < n; i++) {
+    if (!bitrates[i]) {
+      bitrates[i] = UINT_MAX;
+    }
+
+    if (bitrates[i] < bitrates[lowest]) {
+      lowest = i;
+    }
+    if (bitrates[i] <= bitrate && (best < 0 || bitrates[i] > bitrates[best])) {
+      best = i;
+    }
+  }
+
+  return buf_locks[best >= 0 ? best : lowest];
+}
+
+unsigned output_locks_video_bitrate(output_locks_t *locks, buffer_lock_t *buf_lock)
+{
+  buffer_lock_t *buf_locks[1 + MAX_OUTPUT_RENDITIONS];
+  unsigned heights[1 + MAX_OUTPUT_RENDITIONS];
+  unsigned bitrates[1 + MAX_OUTPUT_RENDITIONS];
+  int n = output_locks_videos(locks, buf_locks, heights, bitrates);
+
+  for (int i = 0; i < n; i++) {
+    if (buf_locks[i] == buf_lock) {
+      return bitrates[i];
+    }
+  }
+
+  return 0;
+}
+
+buffer_lock_t *http_video_lock(http_worker_t *worker)
+{
+  char *res = http_get_param(worker, HTTP_RES_PARAM);
+  buffer_lock_t *buf_lock = output_locks_video(http_output_locks(worker), res);
+  free(res);
+  return buf_lock;
+}
+
+// Allocates the lock of the declared output once, kept over the reconnects
+buffer_lock_t *output_locks_extra(output_locks_t *locks, int index, const char *name, bool gop_cache)
+{
+  if (!locks->extra[index]) {
+    char *lock_name = NULL;
+    bool has_name = locks->name && locks->name[0];
+
+    if (asprintf(&lock_name, "%s%s%s_lock", has_name ? locks->name : "", has_name ? ":" : "", name) < 0)
+      return NULL;
+
+    buffer_lock_t *buf_lock = calloc(1, sizeof(buffer_lock_t));
+    buffer_lock_init(buf_lock, lock_name, 0);
+    buf_lock->gop_cache = gop_cache;
+    locks->extra[index] = buf_lock;
+  }
+
+  return locks->extra[index];
+}
+
+// Serves the declared outputs of the camera at their paths
+void http_output(http_worker_t *worker, FILE *stream)
+{
+  output_locks_t *locks = http_output_locks(worker);
+  camera_t *camera = output_locks_camera_get(locks);
+  buffer_lock_t *buf_lock = NULL;
+  unsigned format = 0;
+
+  if (camera) {
+    camera_options_t *options = malloc(sizeof(camera_options_t));
+    camera_get_options(camera, options);
+    output_locks_camera_put(locks, camera);
+
+    for (int i = 0; i < MAX_OUTPUT_EXTRA; i++) {
+      if (!options->extra[i].name[0] || !locks->extra[i] || strcmp(worker->request_uri, options->extra[i].path))
+        continue;
+
+      buf_lock = locks->extra[i];
+      format = options->extra[i].format;
+      break;
+    }
+
+    free(options);
+  }
+
+  // served without the camera, as it might reconnect meanwhile
+  switch (buf_lock ? format : 0) {
+  case V4L2_PIX_FMT_JPEG:
+    http_snapshot_from(worker, stream, buf_lock);
+    return;
+
+  case V4L2_PIX_FMT_MJPEG:
+    http_stream_from(worker, stream, buf_lock);
+    return;
+
+  case V4L2_PIX_FMT_H264:
+    http_h264_video_from(worker, stream, buf_lock);
+    return;
+  }
+
+  http_404(stream, "Not found.");
+}
@@ -1,27 +1,82 @@
 #pragma once
 
 #include <stdbool.h>
+#include <pthread.h>
 
 struct http_worker_s;
 struct buffer_s;
+struct camera_s;
+struct camera_options_s;
+
+#define MAX_OUTPUT_LOCKS 4
+#define MAX_OUTPUT_RENDITIONS 2
+#define MAX_OUTPUT_EXTRA 4
 
 extern struct buffer_lock_s snapshot_lock;
 extern struct buffer_lock_s stream_lock;
 extern struct buffer_lock_s video_lock;
+extern struct buffer_lock_s motion_lock;
+extern struct buffer_lock_s video1_lock;
+extern struct buffer_lock_s video2_lock;
+
+// The buffer locks of a single camera, served under `/cam/<name>/`
+typedef struct output_locks_s {
+  const char *name;
+  struct buffer_lock_s *snapshot;
+  struct buffer_lock_s *stream;
+  struct buffer_lock_s *video;
+  struct buffer_lock_s *motion; // the low resolution YUV
+  struct buffer_lock_s *renditions[MAX_OUTPUT_RENDITIONS]; // the lower resolution H264
+  struct buffer_lock_s *extra[MAX_OUTPUT_EXTRA]; // the declared outputs, allocated by the camera
+  struct camera_s *camera; // set while the camera is running, see `output_locks_camera_get()`
+  pthread_mutex_t camera_lock;
+  pthread_cond_t camera_cond;
+  int camera_refs;
+  // the main video and the configured renditions, kept by the camera under the `camera_lock`
+  struct buffer_lock_s *videos[1 + MAX_OUTPUT_RENDITIONS];
+  unsigned video_heights[1 + MAX_OUTPUT_RENDITIONS];
+  unsigned video_bitrates[1 + MAX_OUTPUT_RENDITIONS];
+  int n_videos;
+} output_locks_t;
+
+extern output_locks_t output_locks;
+
+output_locks_t *output_locks_new(const char *name);
+output_locks_t *output_locks_find(const char *name);
+output_locks_t *output_locks_get(int index);
+output_locks_t *http_output_locks(struct http_worker_s *worker);
+struct camera_s *output_locks_camera_get(output_locks_t *locks);
+void output_locks_camera_put(output_locks_t *locks, struct camera_s *camera);
+void output_locks_set_camera(output_locks_t *locks, struct camera_s *camera);
+void output_locks_set_videos(output_locks_t *locks, struct camera_options_s *options);
+
+// Renditions
+struct buffer_lock_s *output_locks_video(output_locks_t *locks, const char *res);
+struct buffer_lock_s *output_locks_video_for_bitrate(output_locks_t *locks, unsigned bitrate);
+unsigned output_locks_video_bitrate(output_locks_t *locks, struct buffer_lock_s *buf_lock);
+struct buffer_lock_s *http_video_lock(struct http_worker_s *worker);
+
+// Declared outputs
+struct buffer_lock_s *output_locks_extra(output_locks_t *locks, int index, const char *name, bool gop_cache);
+void http_output(struct http_worker_s *worker, FILE *stream);
 
 // M-JPEG
 void http_snapshot(struct http_worker_s *worker, FILE *stream);
 void http_stream(struct http_worker_s *worker, FILE *stream);
+void http_snapshot_from(struct http_worker_s *worker, FILE *stream, struct buffer_lock_s *buf_lock);
+void http_stream_from(struct http_worker_s *worker, FILE *stream, struct buffer_lock_s *buf_lock);
 void http_option(struct http_worker_s *worker, FILE *stream);
 
 // H264
 void http_h264_video(struct http_worker_s *worker, FILE *stream);
+void http_h264_video_from(struct http_worker_s *worker, FILE *stream, struct buffer_lock_s *buf_lock);
 void http_mkv_video(struct http_worker_s *worker, FILE *stream);
 void http_mp4_video(struct http_worker_s *worker, FILE *stream);
 void http_mov_video(struct http_worker_s *worker, FILE *stream);
 
 // HLS
 void http_m3u8_video(struct http_worker_s *worker, FILE *stream);
+void http_hls_video(struct http_worker_s *worker, FILE *stream);
 void http_detect_video(struct http_worker_s *worker, FILE *stream);
 
-#define HTTP_LOW_RES_PARAM "res=low"
+#define HTTP_RES_PARAM "res"
@@ -0,0 +1,140 @@
+#include "output/record/record.h"
+#include "output/record/record_ring.h"
+#include "output/output.h"
+#include "util/http/http.h"
+#include "util/mux/fmp4.h"
+#include "util/opts/log.h"
+
+#include <stdlib.h>
+
+#define CLIP_DEFAULT_DURATION_US (1000 * 1000 / 30)
+
+static const char *const CLIP_HEADER =
+  "HTTP/1.0 200 OK\r\n"
+  "Access-Control-Allow-Origin: *\r\n"
+  "Connection: close\r\n"
+  "Content-Type: video/mp4\r\n"
+  "Content-Disposition: attachment; filename=\"%s-%s.mp4\"\r\n"
+  "\r\n";
+
+// Parses the `30s`, `2m` or `500ms`, the seconds by default
+static uint64_t clip_parse_duration_us(const char *value)
+{
+  char *end = NULL;
+  double duration = strtod(value, &end);
+
+  if (!strcmp(end, "ms")) {
+    duration /= 1000;
+  } else if (!strcmp(end, "m")) {
+    duration *= 60;
+  } else if (end[0] && strcmp(end, "s")) {
+    return 0;
+  }
+
+  return duration > 0 ? duration * 1000 * 1000 : 0;
+}
+
+// Writes the frames as the fragments of whole GOPs,
+// and releases them as soon as they are sent
+static int clip_write(FILE *stream, record_ring_t *ring, record_frame_t **frames, int n_frames)
+{
+  fmp4_t mp4 = {0};
+  mux_buf_t buf = {0};
+  mux_h264_nal_t nals[MUX_H264_MAX_NALS];
+  int n_nals = record_frame_nals(frames[0], nals);
+  int sent = 0, ret = -1;
+
+  mp4.width = frames[0]->width;
+  mp4.height = frames[0]->height;
+  if (!mux_h264_params(&mp4.params, nals, n_nals)) {
+    goto error;
+  }
+
+  fmp4_write_init(&mp4, &buf);
+
+  for (int i = 0; i < n_frames; i++) {
+    bool last = i + 1 == n_frames;
+    uint64_t duration_us = !last && frames[i + 1]->captured_time_us > frames[i]->captured_time_us ?
+      frames[i + 1]->captured_time_us - frames[i]->captured_time_us : CLIP_DEFAULT_DURATION_US;
+    uint32_t duration = duration_us * FMP4_TIMESCALE / 1000 / 1000;
+
+    n_nals = record_frame_nals(frames[i], nals);
+    if (!fmp4_add_sample(&mp4, nals, n_nals, duration, frames[i]->keyframe)) {
+      fmp4_write_fragment(&mp4, &buf);
+      fmp4_add_sample(&mp4, nals, n_nals, duration, frames[i]->keyframe);
+    }
+
+    if (!last && !frames[i + 1]->keyframe) {
+      continue;
+    }
+
+    fmp4_write_fragment(&mp4, &buf);
+    if (!fwrite(buf.data, buf.size, 1, stream)) {
+      goto error;
+    }
+    mux_buf_reset(&buf);
+
+    record_ring_release(ring, frames + sent, i + 1 - sent);
+    sent = i + 1;
+  }
+
+  ret = 0;
+
+error:
+  record_ring_release(ring, frames + sent, n_frames - sent);
+  mux_buf_free(&buf);
+  fmp4_free(&mp4);
+  return ret;
+}
+
+// Sends the last `?last=30s` from the memory as a fragmented MP4
+void http_clip(http_worker_t *worker, FILE *stream)
+{
+  output_locks_t *locks = http_output_locks(worker);
+  record_ring_t *ring = record_find_ring(locks);
+  char *last = http_get_param(worker, "last");
+  record_frame_t **frames = NULL;
+  uint64_t last_us = last ? clip_parse_duration_us(last) : 0;
+  int n_frames = 0;
+  char name[64];
+
+  if (!ring || !ring->max_duration_us) {
+    http_404(stream, "The clips are disabled.\r\n");
+    goto cleanup;
+  }
+
+  if (last && !last_us) {
+    http_400(stream, "The last is invalid.\r\n");
+    goto cleanup;
+  }
+
+  // the ring holds no more, and the clock might be younger than that after the boot
+  if (!last_us || last_us > ring->max_duration_us) {
+    last_us = ring->max_duration_us;
+  }
+  uint64_t now_us = get_monotonic_time_us(NULL, NULL);
+
+  frames = calloc(RECORD_RING_MAX_FRAMES, sizeof(record_frame_t*));
+  n_frames = record_ring_get(ring, now_us > last_us ? now_us - last_us : 0,
+    frames, RECORD_RING_MAX_FRAMES);
+  if (!n_frames) {
+    http_404(stream, "No frames.\r\n");
+    goto cleanup;
+  }
+
+  time_t start = record_frame_time(frames[0]);
+  strftime(name, sizeof(name), "%Y%m%d-%H%M%S", localtime(&start));
+  fprintf(stream, CLIP_HEADER, locks->name ? locks->name : "camera", name);
+
+  if (clip_write(stream, ring, frames, n_frames) < 0) {
+    LOG_VERBOSE(ring, "The clip of %d frames was interrupted.", n_frames);
+  }
+  n_frames = 0;
+
+cleanup:
+  if (n_frames) {
+    record_ring_release(ring, frames, n_frames);
+  }
+  free(frames);
+  free(last);
+}
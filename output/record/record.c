@@ -0,0 +1,539 @@
+#include "output/record/record.h"
+#include "output/record/record_ring.h"
+#include "output/motion/motion.h"
+#include "output/output.h"
+#include "device/buffer.h"
+#include "device/buffer_lock.h"
+#include "util/http/http.h"
+#include "util/mux/fmp4.h"
+#include "util/opts/log.h"
+
+#include <stdlib.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#define RECORD_DIRECT_ALIGN 4096
+#define RECORD_WRITE_BUFFER (1024 * 1024) // a multiple of `RECORD_DIRECT_ALIGN`
+#define RECORD_MAX_QUEUED_BYTES (32 * 1024 * 1024)
+#define RECORD_MAX_SEGMENTS 4096
+#define RECORD_DEFAULT_DURATION_US (1000 * 1000 / 30)
+
+typedef enum {
+  RECORD_OPEN,
+  RECORD_INIT, // the `ftyp` and `moov` of the segment
+  RECORD_WRITE,
+  RECORD_CLOSE
+} record_op_t;
+
+// The file operation for the writer thread
+typedef struct record_chunk_s {
+  struct record_chunk_s *next;
+  record_op_t op;
+  char *path;
+  mux_buf_t buf;
+} record_chunk_t;
+
+typedef struct record_s {
+  const char *name;
+  output_locks_t *locks;
+  record_ring_t ring; // the pre-roll and the clips
+
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+  bool active;
+  record_chunk_t *head, **tail;
+  size_t queued_bytes;
+  unsigned dropped;
+  bool dropping; // until the next key frame
+  unsigned segments;
+  uint64_t written_bytes;
+  char segment[PATH_MAX];
+
+  // used by the muxer thread only
+  bool recording;
+  uint64_t segment_start_us;
+  uint64_t last_time_us;
+  fmp4_t mp4;
+  mux_iov_t iov;
+  record_frame_t *frames[RECORD_RING_MAX_FRAMES];
+
+  // used by the writer thread only
+  int fd;
+  bool direct;
+  uint8_t *write_buf;
+  size_t write_size;
+} record_t;
+
+static record_options_t *record_options;
+static record_t *records[MAX_OUTPUT_LOCKS];
+
+// Only the fragments are dropped on overflow: the segment has to stay
+// playable, so the dropping continues until the next key frame
+static void record_enqueue(record_t *rec, record_op_t op, char *path, mux_buf_t *buf, bool keyframe)
+{
+  record_chunk_t *chunk = calloc(1, sizeof(record_chunk_t));
+  chunk->op = op;
+  chunk->path = path;
+  if (buf) {
+    chunk->buf = *buf;
+  }
+
+  pthread_mutex_lock(&rec->lock);
+  if (op == RECORD_WRITE && (keyframe || !rec->dropping)) {
+    rec->dropping = rec->queued_bytes + chunk->buf.size > RECORD_MAX_QUEUED_BYTES;
+  }
+
+  if (op == RECORD_WRITE && rec->dropping) {
+    // the fragments carry their decode time, so the segment only has a gap
+    rec->dropped++;
+    pthread_mutex_unlock(&rec->lock);
+    mux_buf_free(&chunk->buf);
+    free(chunk);
+    return;
+  }
+
+  rec->queued_bytes += chunk->buf.size;
+  *rec->tail = chunk;
+  rec->tail = &chunk->next;
+  pthread_cond_signal(&rec->cond);
+  pthread_mutex_unlock(&rec->lock);
+}
+
+static void record_open_segment(record_t *rec, record_frame_t *frame, mux_h264_params_t *params)
+{
+  time_t start = record_frame_time(frame);
+  char name[64];
+  char *path = NULL;
+  mux_buf_t init = {0};
+
+  strftime(name, sizeof(name), "%Y%m%d-%H%M%S", localtime(&start));
+  if (asprintf(&path, "%s/%s-%s.mp4", record_options->path, rec->name, name) < 0) {
+    return;
+  }
+
+  rec->mp4 = (fmp4_t){
+    .width = frame->width,
+    .height = frame->height,
+    .params = *params,
+  };
+  fmp4_write_init(&rec->mp4, &init);
+
+  record_enqueue(rec, RECORD_OPEN, path, NULL, false);
+  record_enqueue(rec, RECORD_INIT, NULL, &init, false);
+
+  rec->recording = true;
+  rec->segment_start_us = frame->captured_time_us;
+  rec->last_time_us = frame->captured_time_us;
+}
+
+static void record_close_segment(record_t *rec)
+{
+  if (!rec->recording) {
+    return;
+  }
+
+  record_enqueue(rec, RECORD_CLOSE, NULL, NULL, false);
+  rec->recording = false;
+}
+
+// Writes the frame as a fragment, the segments start at the key frames
+static void record_write_frame(record_t *rec, record_frame_t *frame)
+{
+  mux_h264_nal_t nals[MUX_H264_MAX_NALS];
+  int n_nals = record_frame_nals(frame, nals);
+
+  if (frame->keyframe && (!rec->recording ||
+    frame->captured_time_us - rec->segment_start_us >= record_options->segment_s * 1000LL * 1000LL)) {
+    mux_h264_params_t params = {0};
+
+    if (mux_h264_params(&params, nals, n_nals)) {
+      record_close_segment(rec);
+      record_open_segment(rec, frame, &params);
+    }
+  }
+
+  if (!rec->recording) {
+    return;
+  }
+
+  uint64_t duration_us = frame->captured_time_us > rec->last_time_us ?
+    frame->captured_time_us - rec->last_time_us : RECORD_DEFAULT_DURATION_US;
+  mux_buf_t buf = {0};
+
+  fmp4_write_frame(&rec->mp4, nals, n_nals,
+    (frame->captured_time_us - rec->segment_start_us) * FMP4_TIMESCALE / 1000 / 1000,
+    duration_us * FMP4_TIMESCALE / 1000 / 1000,
+    frame->keyframe, &rec->iov);
+  mux_iov_gather(&rec->iov, &buf);
+  record_enqueue(rec, RECORD_WRITE, NULL, &buf, frame->keyframe);
+
+  rec->last_time_us = frame->captured_time_us;
+}
+
+static int record_buf_part(buffer_lock_t *buf_lock, buffer_t *buf, int frame, record_t *rec)
+{
+  record_frame_t *current = record_frame_new(buf);
+  if (!current) {
+    return 0;
+  }
+
+  record_ring_push(&rec->ring, current);
+
+  pthread_mutex_lock(&rec->lock);
+  bool active = rec->active;
+  pthread_mutex_unlock(&rec->lock);
+
+  if (active && record_options->motion) {
+    active = motion_is_active(rec->locks);
+  }
+
+  if (!active) {
+    record_close_segment(rec);
+  } else if (rec->recording) {
+    record_write_frame(rec, current);
+  } else {
+    // the recording starts with the pre-roll, that ends with the current frame
+    uint64_t since_us = current->captured_time_us - record_options->preroll_s * 1000LL * 1000LL;
+    int n_frames = record_ring_get(&rec->ring, since_us, rec->frames, RECORD_RING_MAX_FRAMES);
+
+    for (int i = 0; i < n_frames; i++) {
+      record_write_frame(rec, rec->frames[i]);
+    }
+    record_ring_release(&rec->ring, rec->frames, n_frames);
+  }
+
+  record_ring_release(&rec->ring, &current, 1);
+  return 1;
+}
+
+static void *record_muxer_thread(void *opaque)
+{
+  record_t *rec = opaque;
+
+  while (true) {
+    int frames = buffer_lock_write_loop(rec->locks->video, 0, 0, (buffer_write_fn)record_buf_part, rec);
+
+    // the stream was interrupted
+    record_close_segment(rec);
+    record_ring_clear(&rec->ring);
+
+    if (frames == 0) {
+      sleep(1);
+    }
+  }
+
+  return NULL;
+}
+
+static void record_file_open(record_t *rec, const char *path)
+{
+  rec->direct = record_options->direct_io;
+  rec->write_size = 0;
+  rec->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC | (rec->direct ? O_DIRECT : 0), 0644);
+
+  if (rec->fd < 0 && rec->direct && errno == EINVAL) {
+    LOG_VERBOSE(rec, "The O_DIRECT is not supported for %s.", path);
+    rec->direct = false;
+    rec->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  }
+
+  if (rec->fd < 0) {
+    LOG_INFO(rec, "Cannot open %s: %s.", path, strerror(errno));
+    return;
+  }
+
+  LOG_INFO(rec, "Recording to %s.", path);
+
+  pthread_mutex_lock(&rec->lock);
+  snprintf(rec->segment, sizeof(rec->segment), "%s", path);
+  rec->segments++;
+  pthread_mutex_unlock(&rec->lock);
+}
+
+static bool record_file_flush(record_t *rec, size_t size)
+{
+  if (rec->fd < 0 || !size) {
+    return true;
+  }
+
+  ssize_t ret = write(rec->fd, rec->write_buf, size);
+  if (ret != size) {
+    LOG_INFO(rec, "Cannot write %s: %s.", rec->segment, ret < 0 ? strerror(errno) : "short write");
+    close(rec->fd);
+    rec->fd = -1;
+    return false;
+  }
+
+  memmove(rec->write_buf, rec->write_buf + size, rec->write_size - size);
+  rec->write_size -= size;
+
+  pthread_mutex_lock(&rec->lock);
+  rec->written_bytes += size;
+  pthread_mutex_unlock(&rec->lock);
+  return true;
+}
+
+// Buffers the data in the aligned blocks, as required by the O_DIRECT
+static void record_file_write(record_t *rec, const uint8_t *data, size_t size)
+{
+  while (size > 0 && rec->fd >= 0) {
+    size_t n = MIN(size, RECORD_WRITE_BUFFER - rec->write_size);
+    memcpy(rec->write_buf + rec->write_size, data, n);
+    rec->write_size += n;
+    data += n;
+    size -= n;
+
+    if (rec->write_size == RECORD_WRITE_BUFFER) {
+      record_file_flush(rec, RECORD_WRITE_BUFFER);
+    }
+  }
+}
+
+static void record_file_close(record_t *rec)
+{
+  if (rec->fd < 0) {
+    return;
+  }
+
+  // the unaligned tail is written without the O_DIRECT
+  if (record_file_flush(rec, rec->write_size / RECORD_DIRECT_ALIGN * RECORD_DIRECT_ALIGN) && rec->direct) {
+    fcntl(rec->fd, F_SETFL, fcntl(rec->fd, F_GETFL) & ~O_DIRECT);
+  }
+  record_file_flush(rec, rec->write_size);
+
+  if (rec->fd >= 0) {
+    close(rec->fd);
+    rec->fd = -1;
+  }
+  rec->write_size = 0;
+}
+
+typedef struct record_segment_s {
+  char *name;
+  off_t size;
+} record_segment_t;
+
+static int record_compare_segments(const void *a, const void *b)
+{
+  return strcmp(((record_segment_t*)a)->name, ((record_segment_t*)b)->name);
+}
+
+// Removes the oldest segments of the camera over the `max_mb`
+static void record_retention(record_t *rec)
+{
+  record_segment_t *segments = NULL;
+  int n_segments = 0;
+  uint64_t total = 0;
+  size_t prefix = strlen(rec->name);
+  DIR *dir = NULL;
+  struct dirent *entry;
+  struct stat st;
+
+  if (!record_options->max_mb) {
+    return;
+  }
+
+  dir = opendir(record_options->path);
+  segments = calloc(RECORD_MAX_SEGMENTS, sizeof(record_segment_t));
+  if (!dir || !segments) {
+    goto cleanup;
+  }
+
+  while ((entry = readdir(dir)) != NULL && n_segments < RECORD_MAX_SEGMENTS) {
+    size_t len = strlen(entry->d_name);
+
+    if (strncmp(entry->d_name, rec->name, prefix) || entry->d_name[prefix] != '-' ||
+      len < 4 || strcmp(entry->d_name + len - 4, ".mp4")) {
+      continue;
+    }
+    if (fstatat(dirfd(dir), entry->d_name, &st, 0) < 0) {
+      continue;
+    }
+
+    segments[n_segments].name = strdup(entry->d_name);
+    segments[n_segments].size = st.st_size;
+    total += st.st_size;
+    n_segments++;
+  }
+
+  qsort(segments, n_segments, sizeof(record_segment_t), record_compare_segments);
+
+  // the names sort by time, the last one is being written
+  for (int i = 0; i < n_segments - 1 && total > record_options->max_mb * 1024ULL * 1024ULL; i++) {
+    if (unlinkat(dirfd(dir), segments[i].name, 0) == 0) {
+      LOG_INFO(rec, "Removed %s/%s.", record_options->path, segments[i].name);
+      total -= segments[i].size;
+    }
+  }
+
+cleanup:
+  for (int i = 0; i < n_segments; i++) {
+    free(segments[i].name);
+  }
+  free(segments);
+  if (dir) {
+    closedir(dir);
+  }
+}
+
+static void *record_writer_thread(void *opaque)
+{
+  record_t *rec = opaque;
+
+  while (true) {
+    pthread_mutex_lock(&rec->lock);
+    while (!rec->head) {
+      pthread_cond_wait(&rec->cond, &rec->lock);
+    }
+    record_chunk_t *chunk = rec->head;
+    rec->head = chunk->next;
+    if (!rec->head) {
+      rec->tail = &rec->head;
+    }
+    rec->queued_bytes -= chunk->buf.size;
+    pthread_mutex_unlock(&rec->lock);
+
+    switch (chunk->op) {
+    case RECORD_OPEN:
+      record_file_close(rec);
+      record_file_open(rec, chunk->path);
+      break;
+
+    case RECORD_INIT:
+    case RECORD_WRITE:
+      record_file_write(rec, chunk->buf.data, chunk->buf.size);
+      break;
+
+    case RECORD_CLOSE:
+      record_file_close(rec);
+      record_retention(rec);
+      break;
+    }
+
+    mux_buf_free(&chunk->buf);
+    free(chunk->path);
+    free(chunk);
+  }
+
+  return NULL;
+}
+
+static int record_start(output_locks_t *locks, int index)
+{
+  pthread_t thread;
+  record_t *rec = calloc(1, sizeof(record_t));
+
+  rec->name = locks->name ? locks->name : "camera";
+  rec->locks = locks;
+  rec->ring.name = rec->name;
+  rec->ring.max_bytes = record_options->memory_mb * 1024ULL * 1024ULL;
+  rec->ring.max_duration_us = MAX(record_options->preroll_s, record_options->clip_s) * 1000LL * 1000LL;
+  pthread_mutex_init(&rec->ring.lock, NULL);
+  pthread_mutex_init(&rec->lock, NULL);
+  pthread_cond_init(&rec->cond, NULL);
+  rec->active = record_options->path[0] && !record_options->paused;
+  rec->tail = &rec->head;
+  rec->fd = -1;
+
+  if (record_options->path[0]) {
+    if (posix_memalign((void**)&rec->write_buf, RECORD_DIRECT_ALIGN, RECORD_WRITE_BUFFER) != 0) {
+      LOG_ERROR(rec, "Cannot allocate the write buffer.");
+    }
+
+    if (pthread_create(&thread, NULL, record_writer_thread, rec) != 0) {
+      LOG_ERROR(rec, "Cannot start the writer thread.");
+    }
+    pthread_detach(thread);
+  }
+
+  if (pthread_create(&thread, NULL, record_muxer_thread, rec) != 0) {
+    LOG_ERROR(rec, "Cannot start the muxer thread.");
+  }
+  pthread_detach(thread);
+
+  records[index] = rec;
+  return 0;
+
+error:
+  return -1;
+}
+
+int record_server(record_options_t *options)
+{
+  record_options = options;
+
+  if (!options->path[0] && !options->clip_s) {
+    return 0;
+  }
+
+  if (options->path[0] && mkdir(options->path, 0755) < 0 && errno != EEXIST) {
+    LOG_ERROR(NULL, "Cannot create %s: %s.", options->path, strerror(errno));
+  }
+
+  for (int i = 0; i < MAX_OUTPUT_LOCKS; i++) {
+    output_locks_t *locks = output_locks_get(i);
+
+    if (locks && record_start(locks, i) < 0) {
+      goto error;
+    }
+  }
+
+  options->running = true;
+  return 0;
+
+error:
+  return -1;
+}
+
+static record_t *record_find(output_locks_t *locks)
+{
+  for (int i = 0; i < MAX_OUTPUT_LOCKS; i++) {
+    if (records[i] && records[i]->locks == locks) {
+      return records[i];
+    }
+  }
+
+  return NULL;
+}
+
+record_ring_t *record_find_ring(output_locks_t *locks)
+{
+  record_t *rec = record_find(locks);
+
+  return rec ? &rec->ring : NULL;
+}
+
+// Shows the recording of the camera, and pauses or resumes it with `?active=0|1`
+void http_record(http_worker_t *worker, FILE *stream)
+{
+  record_t *rec = record_find(http_output_locks(worker));
+  char *active = http_get_param(worker, "active");
+
+  if (!rec || !record_options->path[0]) {
+    http_404(stream, "The recording is disabled.\r\n");
+    goto cleanup;
+  }
+
+  pthread_mutex_lock(&rec->lock);
+  if (active) {
+    rec->active = atoi(active) != 0;
+  }
+  http_write_responsef(stream, "200 OK", "text/plain",
+    "active: %d\r\n"
+    "segment: %s\r\n"
+    "segments: %u\r\n"
+    "written_mb: %.1f\r\n"
+    "queued_mb: %.1f\r\n"
+    "dropped: %u\r\n",
+    rec->active, rec->segment, rec->segments,
+    rec->written_bytes / 1024.0f / 1024.0f,
+    rec->queued_bytes / 1024.0f / 1024.0f,
+    rec->dropped);
+  pthread_mutex_unlock(&rec->lock);
+
+cleanup:
+  free(active);
+}
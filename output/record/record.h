@@ -0,0 +1,31 @@
+#pragma once
+
+#include <stdio.h>
+#include <stdbool.h>
+
+#define RECORD_OPTIONS_LENGTH 256
+
+typedef struct http_worker_s http_worker_t;
+typedef struct output_locks_s output_locks_t;
+typedef struct record_ring_s record_ring_t;
+
+typedef struct record_options_s {
+  bool running;
+  char path[RECORD_OPTIONS_LENGTH];
+  unsigned segment_s;
+  unsigned preroll_s;
+  unsigned max_mb;
+  unsigned clip_s;
+  unsigned memory_mb;
+  bool direct_io;
+  bool paused;
+  bool motion;
+} record_options_t;
+
+// Recording
+void http_record(http_worker_t *worker, FILE *stream);
+int record_server(record_options_t *options);
+record_ring_t *record_find_ring(output_locks_t *locks);
+
+// Clips
+void http_clip(http_worker_t *worker, FILE *stream);
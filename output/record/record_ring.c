@@ -0,0 +1,169 @@
+#include "output/record/record_ring.h"
+#include "device/buffer_h264.h"
+#include "device/buffer_list.h"
+#include "util/opts/log.h"
+
+#include <stdlib.h>
+
+// Copies the NALs of the frame, with the re-inserted parameter sets
+record_frame_t *record_frame_new(buffer_t *buf)
+{
+  mux_h264_nal_t nals[MUX_H264_MAX_NALS];
+  int n_nals = buffer_h264_nals(buf, nals, MUX_H264_MAX_NALS);
+  size_t size = 0;
+
+  if (!n_nals) {
+    return NULL;
+  }
+
+  for (int i = 0; i < n_nals; i++) {
+    size += nals[i].size;
+  }
+
+  record_frame_t *frame = malloc(sizeof(record_frame_t) + size);
+  if (!frame) {
+    return NULL;
+  }
+
+  frame->refs = 1;
+  frame->captured_time_us = buf->captured_time_us;
+  frame->width = buf->buf_list->fmt.width;
+  frame->height = buf->buf_list->fmt.height;
+  frame->keyframe = buf->flags.is_keyframe;
+  frame->n_nals = n_nals;
+  frame->size = 0;
+
+  for (int i = 0; i < n_nals; i++) {
+    frame->nals[i] = (buffer_nal_t){ frame->size, nals[i].size, nals[i].type };
+    memcpy(frame->data + frame->size, nals[i].data, nals[i].size);
+    frame->size += nals[i].size;
+  }
+
+  return frame;
+}
+
+int record_frame_nals(record_frame_t *frame, mux_h264_nal_t *nals)
+{
+  for (int i = 0; i < frame->n_nals; i++) {
+    nals[i] = (mux_h264_nal_t){ frame->data + frame->nals[i].offset, frame->nals[i].size, frame->nals[i].type };
+  }
+  return frame->n_nals;
+}
+
+// Returns the wall clock time of the capture
+time_t record_frame_time(record_frame_t *frame)
+{
+  uint64_t age_us = get_monotonic_time_us(NULL, NULL) - frame->captured_time_us;
+
+  return time(NULL) - age_us / 1000 / 1000;
+}
+
+static void record_frame_release(record_frame_t *frame)
+{
+  if (frame && --frame->refs == 0) {
+    free(frame);
+  }
+}
+
+static record_frame_t *record_ring_at(record_ring_t *ring, int i)
+{
+  return ring->frames[(ring->first + i) % RECORD_RING_MAX_FRAMES];
+}
+
+static void record_ring_evict(record_ring_t *ring, int n_frames)
+{
+  for (int i = 0; i < n_frames; i++) {
+    record_frame_t *frame = record_ring_at(ring, 0);
+    ring->bytes -= frame->size;
+    record_frame_release(frame);
+    ring->first = (ring->first + 1) % RECORD_RING_MAX_FRAMES;
+    ring->n_frames--;
+  }
+}
+
+// Returns the index of the next key frame, or all frames when there's none
+static int record_ring_next_key(record_ring_t *ring)
+{
+  for (int i = 1; i < ring->n_frames; i++) {
+    if (record_ring_at(ring, i)->keyframe) {
+      return i;
+    }
+  }
+  return ring->n_frames;
+}
+
+// Adds the frame and evicts the oldest GOPs over the limits,
+// keeping the last `max_duration_us` whole
+void record_ring_push(record_ring_t *ring, record_frame_t *frame)
+{
+  pthread_mutex_lock(&ring->lock);
+
+  if (!ring->n_frames && !frame->keyframe) {
+    goto unlock;
+  }
+
+  if (ring->n_frames == RECORD_RING_MAX_FRAMES) {
+    record_ring_evict(ring, record_ring_next_key(ring));
+  }
+
+  frame->refs++;
+  ring->frames[(ring->first + ring->n_frames++) % RECORD_RING_MAX_FRAMES] = frame;
+  ring->bytes += frame->size;
+
+  while (ring->n_frames > 1) {
+    int next_key = record_ring_next_key(ring);
+
+    if (ring->bytes > ring->max_bytes) {
+      LOG_DEBUG(ring, "Evicting %d frames over %zu bytes.", next_key, ring->max_bytes);
+    } else if (next_key < ring->n_frames &&
+      frame->captured_time_us - record_ring_at(ring, next_key)->captured_time_us >= ring->max_duration_us) {
+      // the next GOP covers the duration alone
+    } else {
+      break;
+    }
+
+    record_ring_evict(ring, next_key);
+  }
+
+unlock:
+  pthread_mutex_unlock(&ring->lock);
+}
+
+// Returns the frames since the last key frame before `since_us`,
+// the caller releases them with `record_ring_release`
+int record_ring_get(record_ring_t *ring, uint64_t since_us, record_frame_t **frames, int max_frames)
+{
+  int start = 0, n_frames = 0;
+
+  pthread_mutex_lock(&ring->lock);
+  for (int i = 0; i < ring->n_frames; i++) {
+    record_frame_t *frame = record_ring_at(ring, i);
+    if (frame->keyframe && frame->captured_time_us <= since_us) {
+      start = i;
+    }
+  }
+
+  for (int i = start; i < ring->n_frames && n_frames < max_frames; i++) {
+    frames[n_frames] = record_ring_at(ring, i);
+    frames[n_frames++]->refs++;
+  }
+  pthread_mutex_unlock(&ring->lock);
+
+  return n_frames;
+}
+
+void record_ring_release(record_ring_t *ring, record_frame_t **frames, int n_frames)
+{
+  pthread_mutex_lock(&ring->lock);
+  for (int i = 0; i < n_frames; i++) {
+    record_frame_release(frames[i]);
+  }
+  pthread_mutex_unlock(&ring->lock);
+}
+
+void record_ring_clear(record_ring_t *ring)
+{
+  pthread_mutex_lock(&ring->lock);
+  record_ring_evict(ring, ring->n_frames);
+  pthread_mutex_unlock(&ring->lock);
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <pthread.h>
+#include <time.h>
+
+#include "device/buffer.h"
+#include "util/mux/mux.h"
+
+#define RECORD_RING_MAX_FRAMES 4096
+
+// A copy of the H264 access unit, shared by the readers of the ring
+typedef struct record_frame_s {
+  int refs;
+  uint64_t captured_time_us;
+  unsigned width, height;
+  bool keyframe;
+  buffer_nal_t nals[MUX_H264_MAX_NALS];
+  int n_nals;
+  size_t size;
+  uint8_t data[];
+} record_frame_t;
+
+// The recent frames, starting with a key frame
+typedef struct record_ring_s {
+  const char *name;
+  size_t max_bytes;
+  uint64_t max_duration_us;
+
+  pthread_mutex_t lock;
+  record_frame_t *frames[RECORD_RING_MAX_FRAMES]; // by `(first + i) % RECORD_RING_MAX_FRAMES`
+  int first, n_frames;
+  size_t bytes;
+} record_ring_t;
+
+record_frame_t *record_frame_new(buffer_t *buf);
+int record_frame_nals(record_frame_t *frame, mux_h264_nal_t *nals);
+time_t record_frame_time(record_frame_t *frame);
+
+void record_ring_push(record_ring_t *ring, record_frame_t *frame);
+int record_ring_get(record_ring_t *ring, uint64_t since_us, record_frame_t **frames, int max_frames);
+void record_ring_release(record_ring_t *ring, record_frame_t **frames, int n_frames);
+void record_ring_clear(record_ring_t *ring);
@@ -4,11 +4,13 @@ extern "C" {
 #include "device/buffer.h"
 #include "device/buffer_list.h"
 #include "device/buffer_lock.h"
+#include "device/buffer_h264.h"
 #include "device/device.h"
 #include "util/opts/log.h"
 #include "util/opts/fourcc.h"
 #include "util/opts/control.h"
 #include "output/output.h"
+#include "output/bitrate/bitrate.h"
 #include "rtsp.h"
 
 };
@@ -30,11 +32,12 @@ extern "C" {
 #include <atomic>
 #include <chrono>
 #include <set>
+#include <sys/time.h>
 
 #include <BasicUsageEnvironment.hh>
 #include <RTSPServerSupportingHTTPStreaming.hh>
 #include <OnDemandServerMediaSubsession.hh>
-#include <H264VideoStreamFramer.hh>
+#include <H264VideoStreamDiscreteFramer.hh>
 #include <H264VideoRTPSink.hh>
 
 static pthread_t rtsp_thread;
@@ -47,14 +50,15 @@ static const char *stream_name = "stream.h264";
 class DynamicH264Stream : public FramedSource
 {
 public:
-  DynamicH264Stream(UsageEnvironment& env)
-    : FramedSource(env)
+  DynamicH264Stream(UsageEnvironment& env, buffer_lock_t *buf_lock)
+    : FramedSource(env), buf_lock(buf_lock)
   {
     had_key_frame = false;
     running = false;
     requested_key_frame = false;
     locked_buf = NULL;
-    locked_buf_offset = 0;
+    locked_nal = 0;
+    n_locked_nals = 0;
   }
 
   void doGetNextFrame()
@@ -96,14 +100,22 @@ public:
       return;
     }
 
+    // overflowed or unindexed frames have nothing to send, and cannot start the stream
+    int nals = buffer_h264_nals(buf, locked_nals, MUX_H264_MAX_NALS);
+    if (!nals) {
+      if (rtsp_options) {
+        rtsp_options->dropped++;
+      }
+      return;
+    }
+
     if (!had_key_frame) {
       had_key_frame = buf->flags.is_keyframe;
     }
 
     if (!had_key_frame) {
       if (!requested_key_frame) {
-        device_video_force_key(buf->buf_list->dev);
-        requested_key_frame = true;
+        requested_key_frame = device_video_force_key(buf->buf_list->dev) == 0;
       }
       if (rtsp_options) {
         rtsp_options->dropped++;
@@ -112,10 +124,11 @@ public:
     }
 
     rtsp_options->frames++;
-    set_buffer(buf);
+    set_buffer(buf, nals);
   }
 
-  void set_buffer(buffer_t *buf)
+  // the `nals` are already indexed into `locked_nals`
+  void set_buffer(buffer_t *buf, int nals = 0)
   {
     std::unique_lock lk(lock);
 
@@ -125,7 +138,12 @@ public:
     }
 
     locked_buf = buf;
-    locked_buf_offset = 0;
+    locked_nal = 0;
+    n_locked_nals = buf ? nals : 0;
+
+    if (buf) {
+      gettimeofday(&locked_time, NULL);
+    }
     buffer_use(buf);
   }
 
@@ -139,53 +157,88 @@ public:
     if (!isCurrentlyAwaitingData())
       return false;
 
-    if (locked_buf->used - locked_buf_offset > fMaxSize) {
-      fNumTruncatedBytes = locked_buf->used - fMaxSize - locked_buf_offset;
+    // the discrete framer gets a single NAL from the dequeue index at a time
+    mux_h264_nal_t *nal = &locked_nals[locked_nal++];
+
+    if (nal->size > fMaxSize) {
+      fNumTruncatedBytes = nal->size - fMaxSize;
       fFrameSize = fMaxSize;
     } else {
       fNumTruncatedBytes = 0;
-      fFrameSize = locked_buf->used - locked_buf_offset;
+      fFrameSize = nal->size;
     }
 
-    memcpy(fTo, (char*)locked_buf->start + locked_buf_offset, fFrameSize);
-    locked_buf_offset += fFrameSize;
+    memcpy(fTo, nal->data, fFrameSize);
+    fPresentationTime = locked_time;
 
-    if (locked_buf->used == locked_buf_offset) {
+    if (locked_nal >= n_locked_nals) {
       set_buffer(NULL);
-    } else if (rtsp_options->allow_truncated) {
+    } else if (fNumTruncatedBytes && rtsp_options->allow_truncated) {
       rtsp_options->truncated++;
       set_buffer(NULL);
     }
     return true;
   }
 
+  buffer_lock_t *buf_lock;
   Boolean running;
   Boolean had_key_frame;
   Boolean requested_key_frame;
 
   std::recursive_mutex lock;
   buffer_t *locked_buf;
-  unsigned locked_buf_offset;
+  mux_h264_nal_t locked_nals[MUX_H264_MAX_NALS];
+  int n_locked_nals;
+  int locked_nal;
+  struct timeval locked_time;
 };
 
+#define RTP_CLOCK_RATE_KHZ 90
+
+// Passes the loss of every receiver of the sink to the bitrate controller
+static void rtsp_receiver_report(void *clientData)
+{
+  RTPSink *sink = (RTPSink *)clientData;
+  RTPTransmissionStatsDB::Iterator it(sink->transmissionStatsDB());
+  RTPTransmissionStats *stats;
+  char peer[32];
+
+  while ((stats = it.next()) != NULL) {
+    snprintf(peer, sizeof(peer), "rtsp-%08x", stats->SSRC());
+    bitrate_report_loss(peer, stats->packetLossRatio() / 256.0f, stats->jitter() / RTP_CLOCK_RATE_KHZ);
+  }
+}
+
 class DynamicH264VideoFileServerMediaSubsession : public OnDemandServerMediaSubsession
 {
 public:
-  DynamicH264VideoFileServerMediaSubsession(UsageEnvironment& env, Boolean reuseFirstSource)
-    : OnDemandServerMediaSubsession(env, reuseFirstSource)
+  DynamicH264VideoFileServerMediaSubsession(UsageEnvironment& env, Boolean reuseFirstSource, buffer_lock_t *buf_lock)
+    : OnDemandServerMediaSubsession(env, reuseFirstSource), buf_lock(buf_lock)
   {
   }
 
   virtual FramedSource* createNewStreamSource(unsigned clientSessionId, unsigned& estBitrate)
   {
-    estBitrate = 500; // kbps, estimate
-    return H264VideoStreamFramer::createNew(envir(), new DynamicH264Stream(envir()));
+    unsigned bitrate = output_locks_video_bitrate(&output_locks, buf_lock);
+    estBitrate = bitrate ? bitrate / 1000 : 500; // kbps, estimate
+    return H264VideoStreamDiscreteFramer::createNew(envir(), new DynamicH264Stream(envir(), buf_lock));
   }
 
   virtual RTPSink* createNewRTPSink(Groupsock* rtpGroupsock, unsigned char rtpPayloadTypeIfDynamic, FramedSource* /*inputSource*/)
   {
     return H264VideoRTPSink::createNew(envir(), rtpGroupsock, rtpPayloadTypeIfDynamic);
   }
+
+  virtual RTCPInstance* createRTCP(Groupsock* RTCPgs, unsigned totSessionBW, unsigned char const* cname, RTPSink* sink)
+  {
+    RTCPInstance *rtcp = OnDemandServerMediaSubsession::createRTCP(RTCPgs, totSessionBW, cname, sink);
+    if (rtcp && sink) {
+      rtcp->setRRHandler(rtsp_receiver_report, sink);
+    }
+    return rtcp;
+  }
+
+  buffer_lock_t *buf_lock;
 };
 
 class DynamicRTSPServer: public RTSPServerSupportingHTTPStreaming
@@ -214,9 +267,25 @@ protected:
   }
 
 protected: // redefined virtual functions
+  // The `stream.h264?res=<height>|low` selects the rendition of the first camera,
+  // the other cameras have no RTSP stream
   virtual ServerMediaSession* lookupServerMediaSession(char const* streamName, Boolean isFirstLookupInSession)
   {
-    if (strcmp(streamName, stream_name) == 0) {
+    std::string name(streamName), res;
+    size_t query = name.find('?');
+
+    if (query != std::string::npos) {
+      size_t pos = name.find(HTTP_RES_PARAM "=", query);
+      if (pos != std::string::npos) {
+        pos += strlen(HTTP_RES_PARAM "=");
+        res = name.substr(pos, name.find('&', pos) - pos);
+      }
+      name.resize(query);
+    }
+
+    buffer_lock_t *buf_lock = output_locks_video(&output_locks, res.empty() ? NULL : res.c_str());
+
+    if (name == stream_name) {
       LOG_INFO(NULL, "Requesting %s stream...", streamName);
     } else {
       LOG_INFO(NULL, "No stream available: '%s'", streamName);
@@ -235,7 +304,7 @@ protected: // redefined virtual functions
     sms = ServerMediaSession::createNew(envir(), streamName, streamName, "streamed by the LIVE555 Media Server");;
     OutPacketBuffer::maxSize = 2000000; // allow for some possibly large H.264 frames
 
-    auto subsession = new DynamicH264VideoFileServerMediaSubsession(envir(), false);
+    auto subsession = new DynamicH264VideoFileServerMediaSubsession(envir(), false, buf_lock);
     sms->addSubsession(subsession);
     addServerMediaSession(sms);
     return sms;
@@ -270,14 +339,19 @@ static void *rtsp_server_thread(void *opaque)
 static bool rtsp_h264_needs_buffer(buffer_lock_t *buf_lock)
 {
   std::unique_lock lk(rtsp_streams_lock);
-  return rtsp_streams.size() > 0;
+  for (auto *stream : rtsp_streams) {
+    if (stream->buf_lock == buf_lock)
+      return true;
+  }
+  return false;
 }
 
 static void rtsp_h264_capture(buffer_lock_t *buf_lock, buffer_t *buf)
 {
   std::unique_lock lk(rtsp_streams_lock);
   for (auto *stream : rtsp_streams) {
-    stream->receive_buf(buf);
+    if (stream->buf_lock == buf_lock)
+      stream->receive_buf(buf);
   }
 }
 
@@ -316,6 +390,11 @@ extern "C" int rtsp_server(rtsp_options_t *options)
   buffer_lock_register_check_streaming(&video_lock, rtsp_h264_needs_buffer);
   buffer_lock_register_notify_buffer(&video_lock, rtsp_h264_capture);
 
+  for (int i = 0; i < MAX_OUTPUT_RENDITIONS; i++) {
+    buffer_lock_register_check_streaming(output_locks.renditions[i], rtsp_h264_needs_buffer);
+    buffer_lock_register_notify_buffer(output_locks.renditions[i], rtsp_h264_capture);
+  }
+
   pthread_create(&rtsp_thread, NULL, rtsp_server_thread, env);
   options->running = true;
   return 0;
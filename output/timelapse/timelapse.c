@@ -0,0 +1,516 @@
+#include "output/timelapse/timelapse.h"
+#include "output/output.h"
+#include "device/buffer.h"
+#include "device/buffer_lock.h"
+#include "util/http/http.h"
+#include "util/opts/log.h"
+
+#include <stdlib.h>
+#include <limits.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/stat.h>
+
+#define TIMELAPSE_SHOT_TIMEOUT_MS 3000
+#define TIMELAPSE_SHOT_RETRIES 3
+#define TIMELAPSE_MAX_FRAMES 65535 // the limit of the ZIP without the ZIP64
+
+static const char *const ZIP_HEADER =
+  "HTTP/1.0 200 OK\r\n"
+  "Access-Control-Allow-Origin: *\r\n"
+  "Connection: close\r\n"
+  "Content-Type: application/zip\r\n"
+  "Content-Length: %zu\r\n"
+  "Content-Disposition: attachment; filename=\"%s.zip\"\r\n"
+  "\r\n";
+
+// The JPEG of a single shot
+typedef struct timelapse_frame_s {
+  int refs;
+  unsigned index;
+  time_t time;
+  uint32_t crc;
+  size_t size;
+  uint8_t data[];
+} timelapse_frame_t;
+
+typedef struct timelapse_s {
+  const char *name;
+  output_locks_t *locks;
+
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+  bool active;
+  bool assemble;
+  char session[64];
+  unsigned interval_s;
+  uint64_t next_shot_us;
+  unsigned triggers;
+  unsigned shots;
+  unsigned failed;
+  unsigned dropped;
+
+  // the shots kept for the ZIP
+  timelapse_frame_t *frames[TIMELAPSE_MAX_FRAMES];
+  int n_frames;
+  size_t bytes;
+} timelapse_t;
+
+typedef struct timelapse_shot_s {
+  uint64_t start_time_us;
+  timelapse_frame_t *frame;
+} timelapse_shot_t;
+
+static timelapse_options_t *timelapse_options;
+static timelapse_t *timelapses[MAX_OUTPUT_LOCKS];
+
+static uint32_t timelapse_crc32(const uint8_t *data, size_t size)
+{
+  uint32_t crc = 0xFFFFFFFF;
+
+  for (size_t i = 0; i < size; i++) {
+    crc ^= data[i];
+    for (int bit = 0; bit < 8; bit++) {
+      crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+    }
+  }
+
+  return ~crc;
+}
+
+static void timelapse_frame_release(timelapse_frame_t *frame)
+{
+  if (frame && --frame->refs == 0) {
+    free(frame);
+  }
+}
+
+static int timelapse_buf_part(buffer_lock_t *buf_lock, buffer_t *buf, int frame, timelapse_shot_t *shot)
+{
+  // the frames captured before the trigger
+  if (buf->captured_time_us < shot->start_time_us) {
+    return 0;
+  }
+
+  shot->frame = malloc(sizeof(timelapse_frame_t) + buf->used);
+  if (!shot->frame) {
+    return -1;
+  }
+
+  shot->frame->refs = 1;
+  shot->frame->size = buf->used;
+  memcpy(shot->frame->data, buf->start, buf->used);
+  return 1;
+}
+
+// The snapshot output is used only for the duration of the shot,
+// so it can be closed as idle between the shots
+static timelapse_frame_t *timelapse_capture(timelapse_t *tl)
+{
+  timelapse_shot_t shot = {
+    .start_time_us = get_monotonic_time_us(NULL, NULL)
+  };
+
+  // the closed output needs time to be reopened
+  for (int i = 0; i < TIMELAPSE_SHOT_RETRIES && !shot.frame; i++) {
+    buffer_lock_write_loop(tl->locks->snapshot, 1, TIMELAPSE_SHOT_TIMEOUT_MS,
+      (buffer_write_fn)timelapse_buf_part, &shot);
+  }
+
+  if (shot.frame) {
+    shot.frame->time = time(NULL);
+    shot.frame->crc = timelapse_crc32(shot.frame->data, shot.frame->size);
+  }
+  return shot.frame;
+}
+
+static int timelapse_write_file(const char *path, const void *data, size_t size, const char *mode)
+{
+  FILE *fp = fopen(path, mode);
+  if (!fp) {
+    return -1;
+  }
+
+  int ret = size && !fwrite(data, size, 1, fp) ? -1 : 0;
+  if (fclose(fp) < 0) {
+    ret = -1;
+  }
+  return ret;
+}
+
+static void timelapse_save(timelapse_t *tl, const char *session, timelapse_frame_t *frame)
+{
+  char path[PATH_MAX];
+
+  if (timelapse_options->path[0]) {
+    snprintf(path, sizeof(path), "%s/%s", timelapse_options->path, session);
+    mkdir(path, 0755);
+
+    snprintf(path, sizeof(path), "%s/%s/%05u.jpg", timelapse_options->path, session, frame->index);
+    if (timelapse_write_file(path, frame->data, frame->size, "wb") < 0) {
+      LOG_INFO(tl, "Cannot write %s: %s.", path, strerror(errno));
+    }
+  }
+
+  if (!timelapse_options->zip) {
+    return;
+  }
+
+  pthread_mutex_lock(&tl->lock);
+  if (tl->n_frames >= TIMELAPSE_MAX_FRAMES ||
+    tl->bytes + frame->size > timelapse_options->memory_mb * 1024ULL * 1024ULL) {
+    tl->dropped++;
+  } else {
+    frame->refs++;
+    tl->frames[tl->n_frames++] = frame;
+    tl->bytes += frame->size;
+  }
+  pthread_mutex_unlock(&tl->lock);
+}
+
+// Concatenates the shots into the `<session>.mjpeg`
+static void timelapse_assemble(timelapse_t *tl, const char *session, unsigned shots)
+{
+  char path[PATH_MAX], mjpeg[PATH_MAX];
+  unsigned written = 0;
+
+  snprintf(mjpeg, sizeof(mjpeg), "%s/%s.mjpeg", timelapse_options->path, session);
+  if (timelapse_write_file(mjpeg, NULL, 0, "wb") < 0) {
+    LOG_INFO(tl, "Cannot write %s: %s.", mjpeg, strerror(errno));
+    return;
+  }
+
+  for (unsigned i = 1; i <= shots; i++) {
+    snprintf(path, sizeof(path), "%s/%s/%05u.jpg", timelapse_options->path, session, i);
+
+    FILE *fp = fopen(path, "rb");
+    if (!fp) {
+      continue;
+    }
+
+    struct stat st;
+    uint8_t *data = NULL;
+    if (fstat(fileno(fp), &st) == 0 && (data = malloc(st.st_size)) != NULL &&
+      fread(data, st.st_size, 1, fp) == 1 &&
+      timelapse_write_file(mjpeg, data, st.st_size, "ab") == 0) {
+      written++;
+    }
+    free(data);
+    fclose(fp);
+  }
+
+  LOG_INFO(tl, "Assembled %u of %u shots into %s.", written, shots, mjpeg);
+}
+
+static void *timelapse_thread(void *opaque)
+{
+  timelapse_t *tl = opaque;
+  char session[sizeof(tl->session)];
+
+  pthread_mutex_lock(&tl->lock);
+
+  while (true) {
+    uint64_t now_us = get_monotonic_time_us(NULL, NULL);
+    bool scheduled = tl->active && tl->interval_s && now_us >= tl->next_shot_us;
+
+    if (tl->assemble) {
+      unsigned shots = tl->shots;
+      strcpy(session, tl->session);
+      tl->assemble = false;
+      pthread_mutex_unlock(&tl->lock);
+      timelapse_assemble(tl, session, shots);
+      pthread_mutex_lock(&tl->lock);
+      continue;
+    }
+
+    if (!tl->triggers && !scheduled) {
+      if (tl->active && tl->interval_s) {
+        struct timespec deadline;
+        uint64_t wait_us = tl->next_shot_us - now_us;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec += (deadline.tv_nsec / 1000 + wait_us) / 1000 / 1000;
+        deadline.tv_nsec = (deadline.tv_nsec / 1000 + wait_us) % (1000 * 1000) * 1000;
+        pthread_cond_timedwait(&tl->cond, &tl->lock, &deadline);
+      } else {
+        pthread_cond_wait(&tl->cond, &tl->lock);
+      }
+      continue;
+    }
+
+    tl->triggers = 0;
+    if (tl->interval_s) {
+      tl->next_shot_us = now_us + tl->interval_s * 1000LL * 1000LL;
+    }
+    strcpy(session, tl->session);
+    pthread_mutex_unlock(&tl->lock);
+
+    timelapse_frame_t *frame = timelapse_capture(tl);
+
+    pthread_mutex_lock(&tl->lock);
+    if (!frame) {
+      tl->failed++;
+      LOG_INFO(tl, "Cannot capture the shot.");
+      continue;
+    }
+    if (!tl->active || strcmp(session, tl->session)) {
+      timelapse_frame_release(frame);
+      continue;
+    }
+    frame->index = ++tl->shots;
+    pthread_mutex_unlock(&tl->lock);
+
+    timelapse_save(tl, session, frame);
+
+    pthread_mutex_lock(&tl->lock);
+    timelapse_frame_release(frame);
+  }
+
+  return NULL;
+}
+
+static void timelapse_start(timelapse_t *tl, unsigned interval_s)
+{
+  time_t now = time(NULL);
+  char date[32];
+
+  strftime(date, sizeof(date), "%Y%m%d-%H%M%S", localtime(&now));
+  snprintf(tl->session, sizeof(tl->session), "%s-%s", tl->name, date);
+
+  for (int i = 0; i < tl->n_frames; i++) {
+    timelapse_frame_release(tl->frames[i]);
+  }
+  tl->n_frames = 0;
+  tl->bytes = 0;
+
+  tl->active = true;
+  tl->interval_s = interval_s;
+  tl->next_shot_us = get_monotonic_time_us(NULL, NULL);
+  tl->shots = 0;
+  tl->failed = 0;
+  tl->dropped = 0;
+
+  LOG_INFO(tl, "Started %s, every %us.", tl->session, interval_s);
+}
+
+int timelapse_server(timelapse_options_t *options)
+{
+  pthread_t thread;
+
+  timelapse_options = options;
+
+  if (!options->path[0] && !options->zip) {
+    return 0;
+  }
+
+  if (options->path[0] && mkdir(options->path, 0755) < 0 && errno != EEXIST) {
+    LOG_ERROR(NULL, "Cannot create %s: %s.", options->path, strerror(errno));
+  }
+
+  for (int i = 0; i < MAX_OUTPUT_LOCKS; i++) {
+    output_locks_t *locks = output_locks_get(i);
+    if (!locks) {
+      continue;
+    }
+
+    timelapse_t *tl = calloc(1, sizeof(timelapse_t));
+    tl->name = locks->name ? locks->name : "camera";
+    tl->locks = locks;
+    pthread_mutex_init(&tl->lock, NULL);
+    pthread_cond_init(&tl->cond, NULL);
+
+    if (pthread_create(&thread, NULL, timelapse_thread, tl) != 0) {
+      LOG_ERROR(tl, "Cannot start the timelapse thread.");
+    }
+    pthread_detach(thread);
+
+    timelapses[i] = tl;
+  }
+
+  options->running = true;
+  return 0;
+
+error:
+  return -1;
+}
+
+static timelapse_t *timelapse_find(output_locks_t *locks)
+{
+  for (int i = 0; i < MAX_OUTPUT_LOCKS; i++) {
+    if (timelapses[i] && timelapses[i]->locks == locks) {
+      return timelapses[i];
+    }
+  }
+
+  return NULL;
+}
+
+// Controls the timelapse with `?start=1[&interval=10]`, `?shot=1` and `?stop=1`
+void http_timelapse(http_worker_t *worker, FILE *stream)
+{
+  timelapse_t *tl = timelapse_find(http_output_locks(worker));
+  char *start = http_get_param(worker, "start");
+  char *interval = http_get_param(worker, "interval");
+  char *shot = http_get_param(worker, "shot");
+  char *stop = http_get_param(worker, "stop");
+
+  if (!tl) {
+    http_404(stream, "The timelapse is disabled.\r\n");
+    goto cleanup;
+  }
+
+  pthread_mutex_lock(&tl->lock);
+  if (start && atoi(start)) {
+    timelapse_start(tl, interval ? atoi(interval) : timelapse_options->interval_s);
+  }
+  if (shot && atoi(shot) && !tl->active) {
+    pthread_mutex_unlock(&tl->lock);
+    http_400(stream, "The timelapse is not started.\r\n");
+    goto cleanup;
+  }
+  if (shot && atoi(shot)) {
+    tl->triggers++;
+  }
+  if (stop && atoi(stop) && tl->active) {
+    tl->active = false;
+    tl->assemble = timelapse_options->mjpeg && timelapse_options->path[0];
+    LOG_INFO(tl, "Stopped %s after %u shots.", tl->session, tl->shots);
+  }
+  pthread_cond_signal(&tl->cond);
+
+  http_write_responsef(stream, "200 OK", "text/plain",
+    "active: %d\r\n"
+    "session: %s\r\n"
+    "interval_s: %u\r\n"
+    "shots: %u\r\n"
+    "failed: %u\r\n"
+    "zip_frames: %d\r\n"
+    "zip_mb: %.1f\r\n"
+    "dropped: %u\r\n",
+    tl->active, tl->session, tl->interval_s, tl->shots, tl->failed,
+    tl->n_frames, tl->bytes / 1024.0f / 1024.0f, tl->dropped);
+  pthread_mutex_unlock(&tl->lock);
+
+cleanup:
+  free(start);
+  free(interval);
+  free(shot);
+  free(stop);
+}
+
+static void zip_u16(uint8_t **ptr, uint16_t value)
+{
+  *(*ptr)++ = value;
+  *(*ptr)++ = value >> 8;
+}
+
+static void zip_u32(uint8_t **ptr, uint32_t value)
+{
+  zip_u16(ptr, value);
+  zip_u16(ptr, value >> 16);
+}
+
+// Writes the ZIP header of the stored file, the `central` one has the `offset`
+static size_t zip_write_header(uint8_t *buf, timelapse_frame_t *frame, bool central, uint32_t offset)
+{
+  struct tm tm;
+  char name[16];
+  uint8_t *ptr = buf;
+
+  localtime_r(&frame->time, &tm);
+  snprintf(name, sizeof(name), "%05u.jpg", frame->index);
+
+  zip_u32(&ptr, central ? 0x02014b50 : 0x04034b50);
+  if (central) {
+    zip_u16(&ptr, 20); // version made by
+  }
+  zip_u16(&ptr, 20); // version needed
+  zip_u16(&ptr, 0); // flags
+  zip_u16(&ptr, 0); // stored
+  zip_u16(&ptr, tm.tm_hour << 11 | tm.tm_min << 5 | tm.tm_sec / 2);
+  zip_u16(&ptr, (tm.tm_year - 80) << 9 | (tm.tm_mon + 1) << 5 | tm.tm_mday);
+  zip_u32(&ptr, frame->crc);
+  zip_u32(&ptr, frame->size);
+  zip_u32(&ptr, frame->size);
+  zip_u16(&ptr, strlen(name));
+  zip_u16(&ptr, 0); // extra
+  if (central) {
+    zip_u16(&ptr, 0); // comment
+    zip_u16(&ptr, 0); // disk
+    zip_u16(&ptr, 0); // internal attributes
+    zip_u32(&ptr, 0); // external attributes
+    zip_u32(&ptr, offset);
+  }
+  memcpy(ptr, name, strlen(name));
+  return ptr - buf + strlen(name);
+}
+
+// Sends the shots kept in the memory as the ZIP of the JPEGs
+void http_timelapse_zip(http_worker_t *worker, FILE *stream)
+{
+  timelapse_t *tl = timelapse_find(http_output_locks(worker));
+  timelapse_frame_t **frames = NULL;
+  char session[sizeof(tl->session)];
+  uint8_t header[64];
+  size_t size = 22, offset = 0, central_size = 0;
+  int n_frames = 0;
+
+  if (!tl || !timelapse_options->zip) {
+    http_404(stream, "The timelapse ZIP is disabled.\r\n");
+    return;
+  }
+
+  frames = calloc(TIMELAPSE_MAX_FRAMES, sizeof(timelapse_frame_t*));
+
+  pthread_mutex_lock(&tl->lock);
+  for (n_frames = 0; n_frames < tl->n_frames; n_frames++) {
+    frames[n_frames] = tl->frames[n_frames];
+    frames[n_frames]->refs++;
+  }
+  strcpy(session, tl->session);
+  pthread_mutex_unlock(&tl->lock);
+
+  if (!n_frames) {
+    http_404(stream, "No shots.\r\n");
+    goto cleanup;
+  }
+
+  for (int i = 0; i < n_frames; i++) {
+    size += 2 * zip_write_header(header, frames[i], false, 0) + 16 + frames[i]->size;
+  }
+  fprintf(stream, ZIP_HEADER, size, session);
+
+  for (int i = 0; i < n_frames; i++) {
+    size_t n = zip_write_header(header, frames[i], false, 0);
+    if (!fwrite(header, n, 1, stream) || !fwrite(frames[i]->data, frames[i]->size, 1, stream)) {
+      goto cleanup;
+    }
+  }
+
+  for (int i = 0; i < n_frames; i++) {
+    size_t n = zip_write_header(header, frames[i], true, offset);
+    if (!fwrite(header, n, 1, stream)) {
+      goto cleanup;
+    }
+    offset += n - 16 + frames[i]->size;
+    central_size += n;
+  }
+
+  uint8_t *ptr = header;
+  zip_u32(&ptr, 0x06054b50);
+  zip_u16(&ptr, 0); // disk
+  zip_u16(&ptr, 0); // central directory disk
+  zip_u16(&ptr, n_frames);
+  zip_u16(&ptr, n_frames);
+  zip_u32(&ptr, central_size);
+  zip_u32(&ptr, offset);
+  zip_u16(&ptr, 0); // comment
+  fwrite(header, ptr - header, 1, stream);
+
+cleanup:
+  pthread_mutex_lock(&tl->lock);
+  for (int i = 0; i < n_frames; i++) {
+    timelapse_frame_release(frames[i]);
+  }
+  pthread_mutex_unlock(&tl->lock);
+  free(frames);
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <stdio.h>
+#include <stdbool.h>
+
+#define TIMELAPSE_OPTIONS_LENGTH 256
+
+typedef struct http_worker_s http_worker_t;
+
+typedef struct timelapse_options_s {
+  bool running;
+  char path[TIMELAPSE_OPTIONS_LENGTH];
+  unsigned interval_s;
+  bool zip;
+  unsigned memory_mb;
+  bool mjpeg;
+} timelapse_options_t;
+
+// Timelapse
+void http_timelapse(http_worker_t *worker, FILE *stream);
+void http_timelapse_zip(http_worker_t *worker, FILE *stream);
+int timelapse_server(timelapse_options_t *options);
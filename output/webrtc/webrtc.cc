@@ -3,13 +3,16 @@ extern "C" {
 #include "device/buffer.h"
 #include "device/buffer_list.h"
 #include "device/buffer_lock.h"
+#include "device/buffer_h264.h"
 #include "device/device.h"
 #include "output/output.h"
+#include "output/bitrate/bitrate.h"
 #include "util/http/http.h"
 #include "util/opts/log.h"
 #include "util/opts/fourcc.h"
 #include "util/opts/control.h"
 #include "util/opts/opts.h"
+#include "util/mux/rtp.h"
 #include "device/buffer.h"
 };
 
@@ -18,10 +21,17 @@ extern "C" {
 
 #define DEFAULT_PING_INTERVAL_US        (1 * 1000 * 1000)
 #define DEFAULT_PONG_INTERVAL_US        (30 * 1000 * 1000)
+#define DEFAULT_BITRATE_KBPS            1000
+#define RTP_CLOCK_RATE_KHZ              90
+#define RENDITION_SWITCH_INTERVAL_US    (5 * 1000 * 1000)
+#define RENDITION_HEADROOM              0.9
 
 #ifdef USE_LIBDATACHANNEL
 
 #include <inttypes.h>
+#include <climits>
+#include <cstring>
+#include <arpa/inet.h>
 #include <string>
 #include <memory>
 #include <optional>
@@ -29,9 +39,11 @@ extern "C" {
 #include <atomic>
 #include <chrono>
 #include <set>
+#include <vector>
 #include <rtc/peerconnection.hpp>
+#include <rtc/mediahandler.hpp>
 #include <rtc/rtcpsrreporter.hpp>
-#include <rtc/h264rtppacketizer.hpp>
+#include <rtc/rtppacketizationconfig.hpp>
 #include <rtc/rtcpnackresponder.hpp>
 
 #include "third_party/magic_enum/include/magic_enum.hpp"
@@ -54,10 +66,18 @@ static rtc::Configuration webrtc_configuration = {
 std::shared_ptr<Client> webrtc_find_client(std::string id);
 void webrtc_remove_client(const std::shared_ptr<Client> &client, const char *reason);
 
+// The REMB of the peer, shared by its RTCP handler and the client
+struct PeerFeedback
+{
+  std::atomic<unsigned> estimate{0};
+  std::atomic<bool> main_video{true};
+};
+
 struct ClientTrackData
 {
   std::shared_ptr<rtc::Track> track;
 	std::shared_ptr<rtc::RtcpSrReporter> sender;
+  std::shared_ptr<PeerFeedback> feedback;
 
   void startStreaming()
   {
@@ -86,6 +106,28 @@ struct ClientTrackData
   }
 };
 
+// The RTP packets of a single frame, fragmented once for all the peers.
+// The peers write only their SSRC, sequence number and timestamp.
+struct RtpFrame
+{
+  rtp_frame_t rtp = {};
+  bool packetized = false;
+
+  ~RtpFrame()
+  {
+    rtp_frame_free(&rtp);
+  }
+
+  void packetize(buffer_t *buf)
+  {
+    mux_h264_nal_t nals[MUX_H264_MAX_NALS];
+    int n_nals = buffer_h264_nals(buf, nals, MUX_H264_MAX_NALS);
+
+    rtp_frame_h264(&rtp, webrtc_client_video_payload_type, nals, n_nals);
+    packetized = true;
+  }
+};
+
 class Client
 {
 public:
@@ -143,8 +185,39 @@ public:
     return true;
   }
 
-  bool wantsFrame() const
+  // Follows the REMB of the peer, unless it asked for the `res`.
+  // Called for every frame, so only the changed estimate is looked up.
+  void selectRendition()
   {
+    if (pinned_rendition || !video)
+      return;
+
+    unsigned estimate = video->feedback->estimate;
+    if (!estimate || estimate == rendition_estimate)
+      return;
+
+    uint64_t now_us = get_monotonic_time_us(NULL, NULL);
+    if (now_us - rendition_switched_us < RENDITION_SWITCH_INTERVAL_US)
+      return;
+
+    rendition_estimate = estimate;
+
+    buffer_lock_t *next = output_locks_video_for_bitrate(&output_locks, estimate * RENDITION_HEADROOM);
+    if (next == buf_lock)
+      return;
+
+    LOG_INFO(this, "Switching to '%s' for the estimated %ukbps.", next->name, estimate / 1000);
+    buf_lock = next;
+    had_key_frame = false;
+    requested_key_frame = false;
+    rendition_switched_us = now_us;
+    video->feedback->main_video = next == &video_lock;
+  }
+
+  bool wantsFrame(buffer_lock_t *frame_lock) const
+  {
+    if (frame_lock != buf_lock)
+      return false;
     if (!pc || !video)
       return false;
     if (pc->state() != rtc::PeerConnection::State::Connected)
@@ -152,7 +225,7 @@ public:
     return video->wantsFrame();
   }
 
-  void pushFrame(buffer_t *buf)
+  void pushFrame(buffer_t *buf, const RtpFrame &frame)
   {
     if (!video || !video->track) {
       return;
@@ -164,15 +237,23 @@ public:
 
     if (!had_key_frame) {
       if (!requested_key_frame) {
-        device_video_force_key(buf->buf_list->dev);
-        requested_key_frame = true;
+        requested_key_frame = device_video_force_key(buf->buf_list->dev) == 0;
       }
       return;
     }
 
-    rtc::binary data((std::byte*)buf->start, (std::byte*)buf->start + buf->used);
     video->sendTime();
-    video->track->send(data);
+
+    auto rtpConfig = video->sender->rtpConfig;
+
+    // the SR reporter and the NACK responder see the packets as sent
+    for (int i = 0; i < frame.rtp.n_packets; i++) {
+      const std::byte *data = (const std::byte*)frame.rtp.data.data + frame.rtp.packets[i].offset;
+      rtc::binary packet(data, data + frame.rtp.packets[i].size);
+
+      rtp_packet_header((uint8_t*)packet.data(), rtpConfig->sequenceNumber++, rtpConfig->timestamp, rtpConfig->ssrc);
+      video->track->send(std::move(packet));
+    }
   }
 
   void describePeerConnection(nlohmann::json &message)
@@ -213,6 +294,10 @@ public:
   bool has_set_sdp_answer = false;
   bool had_key_frame = false;
   bool requested_key_frame = false;
+  buffer_lock_t *buf_lock = &video_lock;
+  bool pinned_rendition = false;
+  unsigned rendition_estimate = 0;
+  uint64_t rendition_switched_us = 0;
   uint64_t last_ping_us = 0;
   uint64_t last_pong_us = 0;
   uint64_t deadline_us = 0;
@@ -237,21 +322,95 @@ void webrtc_remove_client(const std::shared_ptr<Client> &client, const char *rea
   LOG_INFO(client.get(), "Client removed: %s.", reason);
 }
 
-static std::shared_ptr<ClientTrackData> webrtc_add_video(const std::shared_ptr<rtc::PeerConnection> pc, const uint8_t payloadType, const uint32_t ssrc, const std::string cname, const std::string msid)
+// Passes the REMB and the receiver reports of the peer to the bitrate controller
+class RtcpFeedbackHandler : public rtc::MediaHandler
 {
+public:
+  RtcpFeedbackHandler(std::string peer, std::shared_ptr<PeerFeedback> feedback)
+    : peer(peer), feedback(feedback)
+  {
+  }
+
+  void incoming(rtc::message_vector &messages, const rtc::message_callback &send) override
+  {
+    for (const auto &message : messages) {
+      if (message->type == rtc::Message::Control) {
+        parseCompound(reinterpret_cast<const uint8_t*>(message->data()), message->size());
+      }
+    }
+  }
+
+private:
+  static uint32_t read32(const uint8_t *data)
+  {
+    return (data[0] << 24) | (data[1] << 16) | (data[2] << 8) | data[3];
+  }
+
+  void parseCompound(const uint8_t *data, size_t size)
+  {
+    while (size >= 8) {
+      uint8_t count = data[0] & 0x1F;
+      uint8_t type = data[1];
+      size_t length = (((data[2] << 8) | data[3]) + 1) * 4;
+      if (length > size)
+        break;
+
+      if (type == 200 && length >= 28) { // SR
+        parseReportBlocks(data + 28, length - 28, count);
+      } else if (type == 201) { // RR
+        parseReportBlocks(data + 8, length - 8, count);
+      } else if (type == 206 && count == 15 && length >= 20 && !memcmp(data + 12, "REMB", 4)) {
+        uint8_t exp = data[17] >> 2;
+        uint64_t mantissa = ((data[17] & 0x3) << 16) | (data[18] << 8) | data[19];
+        uint64_t bps = mantissa << exp;
+        feedback->estimate = bps < UINT_MAX ? bps : UINT_MAX;
+
+        // the peers of the renditions do not limit the main encoder
+        if (feedback->main_video) {
+          bitrate_report_estimate(peer.c_str(), feedback->estimate);
+        }
+      }
+
+      data += length;
+      size -= length;
+    }
+  }
+
+  void parseReportBlocks(const uint8_t *data, size_t size, int count)
+  {
+    // the peer receives only the single video SSRC
+    if (count < 1 || size < 24)
+      return;
+
+    float loss = data[4] / 256.0f;
+    unsigned jitter_ms = read32(data + 12) / RTP_CLOCK_RATE_KHZ;
+    if (feedback->main_video) {
+      bitrate_report_loss(peer.c_str(), loss, jitter_ms);
+    }
+  }
+
+  std::string peer;
+  std::shared_ptr<PeerFeedback> feedback;
+};
+
+static std::shared_ptr<ClientTrackData> webrtc_add_video(const std::shared_ptr<rtc::PeerConnection> pc, const uint8_t payloadType, const uint32_t ssrc, const std::string cname, const std::string msid, const std::string peer)
+{
+  bitrate_status_t bitrate;
   auto video = rtc::Description::Video(cname, rtc::Description::Direction::SendOnly);
   video.addH264Codec(payloadType);
-  video.setBitrate(1000);
+  video.setBitrate(bitrate_status(&bitrate) && bitrate.limit ? bitrate.limit / 1000 : DEFAULT_BITRATE_KBPS);
   video.addSSRC(ssrc, cname, msid, cname);
   auto track = pc->addTrack(video);
-  auto rtpConfig = std::make_shared<rtc::RtpPacketizationConfig>(ssrc, cname, payloadType, rtc::H264RtpPacketizer::ClockRate);
-  auto packetizer = std::make_shared<rtc::H264RtpPacketizer>(rtc::H264RtpPacketizer::Separator::LongStartSequence, rtpConfig);
+  auto rtpConfig = std::make_shared<rtc::RtpPacketizationConfig>(ssrc, cname, payloadType, RTP_CLOCK_RATE_KHZ * 1000);
+  // the frames are sent as the RTP packets of `RtpFrame`, without the packetizer
   auto srReporter = std::make_shared<rtc::RtcpSrReporter>(rtpConfig);
-  packetizer->addToChain(srReporter);
   auto nackResponder = std::make_shared<rtc::RtcpNackResponder>();
-  packetizer->addToChain(nackResponder);
-  track->setMediaHandler(packetizer);
-  return std::shared_ptr<ClientTrackData>(new ClientTrackData{track, srReporter});
+  srReporter->addToChain(nackResponder);
+  auto feedback = std::make_shared<PeerFeedback>();
+  auto feedbackHandler = std::make_shared<RtcpFeedbackHandler>(peer, feedback);
+  srReporter->addToChain(feedbackHandler);
+  track->setMediaHandler(srReporter);
+  return std::shared_ptr<ClientTrackData>(new ClientTrackData{track, srReporter, feedback});
 }
 
 static void webrtc_parse_ice_servers(rtc::Configuration &config, const nlohmann::json &message)
@@ -382,11 +541,26 @@ static std::shared_ptr<Client> webrtc_peer_connection(rtc::Configuration config,
   return client;
 }
 
+// The `?res=` pins the rendition, otherwise it follows the REMB.
+// Only the first camera is streamed, `/cam/<name>/webrtc` is not dispatched.
+static void webrtc_select_rendition(const std::shared_ptr<Client> &client, http_worker_t *worker)
+{
+  char *res = http_get_param(worker, HTTP_RES_PARAM);
+
+  if (res) {
+    client->buf_lock = output_locks_video(&output_locks, res);
+    client->pinned_rendition = true;
+    client->video->feedback->main_video = client->buf_lock == &video_lock;
+  }
+
+  free(res);
+}
+
 static bool webrtc_h264_needs_buffer(buffer_lock_t *buf_lock)
 {
   std::unique_lock lk(webrtc_clients_lock);
   for (auto client : webrtc_clients) {
-    if (client->wantsFrame())
+    if (client->wantsFrame(buf_lock))
       return true;
   }
 
@@ -396,11 +570,16 @@ static bool webrtc_h264_needs_buffer(buffer_lock_t *buf_lock)
 static void webrtc_h264_capture(buffer_lock_t *buf_lock, buffer_t *buf)
 {
   std::set<std::shared_ptr<Client> > lost_clients;
+  RtpFrame frame;
 
   std::unique_lock lk(webrtc_clients_lock);
   for (auto client : webrtc_clients) {
-    if (client->wantsFrame())
-      client->pushFrame(buf);
+    client->selectRendition();
+    if (client->wantsFrame(buf_lock)) {
+      if (!frame.packetized)
+        frame.packetize(buf);
+      client->pushFrame(buf, frame);
+    }
     if (!client->keepAlive())
       lost_clients.insert(client);
   }
@@ -416,7 +595,8 @@ static void http_webrtc_request(http_worker_t *worker, FILE *stream, const nlohm
   auto client = webrtc_peer_connection(webrtc_configuration, message);
   LOG_INFO(client.get(), "Stream requested.");
 
-  client->video = webrtc_add_video(client->pc, webrtc_client_video_payload_type, rand(), "video", "stream");
+  client->video = webrtc_add_video(client->pc, webrtc_client_video_payload_type, rand(), "video", "stream", client->id);
+  webrtc_select_rendition(client, worker);
 
   try {
     {
@@ -489,7 +669,8 @@ static void http_webrtc_offer(http_worker_t *worker, FILE *stream, const nlohman
   LOG_VERBOSE(client.get(), "Remote SDP Offer: %s", std::string(message["sdp"]).c_str());
 
   try {
-    client->video = webrtc_add_video(client->pc, webrtc_client_video_payload_type, rand(), "video", "stream");
+    client->video = webrtc_add_video(client->pc, webrtc_client_video_payload_type, rand(), "video", "stream", client->id);
+    webrtc_select_rendition(client, worker);
 
     {
       std::unique_lock lock(client->lock);
@@ -591,6 +772,11 @@ extern "C" int webrtc_server(webrtc_options_t *options)
   buffer_lock_register_check_streaming(&video_lock, webrtc_h264_needs_buffer);
   buffer_lock_register_notify_buffer(&video_lock, webrtc_h264_capture);
 
+  for (int i = 0; i < MAX_OUTPUT_RENDITIONS; i++) {
+    buffer_lock_register_check_streaming(output_locks.renditions[i], webrtc_h264_needs_buffer);
+    buffer_lock_register_notify_buffer(output_locks.renditions[i], webrtc_h264_capture);
+  }
+
   options->running = true;
   return 0;
 }
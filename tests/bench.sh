@@ -0,0 +1,197 @@
+#!/bin/bash
+
+if [[ "$1" == "-h" ]] || [[ "$1" == "--help" ]]; then
+  echo "usage: $0 [output.json] [scenario-filter]"
+  echo
+  echo "Runs the benchmark scenarios against the dummy camera and writes the results to output.json."
+  echo
+  echo "environment:"
+  echo "  BENCH_DURATION=10                      seconds to measure each scenario"
+  echo "  BENCH_PORT=18080                       HTTP port to use"
+  echo "  BENCH_DUMMY_OPTIONS='delay_ms=10;...'  emulated M2M device options"
+  echo
+  echo "examples:"
+  echo "  $0"
+  echo "  $0 bench.json 'jpeg-stream-*'"
+  exit 1
+fi
+
+SCRIPT_DIR=$( cd -- "$( dirname -- "${BASH_SOURCE[0]}" )" &> /dev/null && pwd )
+cd "$SCRIPT_DIR/.."
+
+OUTPUT="${1:-bench.json}"
+FILTER="${2:-*}"
+DURATION="${BENCH_DURATION:-10}"
+PORT="${BENCH_PORT:-18080}"
+DUMMY_OPTIONS="${BENCH_DUMMY_OPTIONS:-delay_ms=10;jitter_ms=2;max_inflight=2}"
+URL="http://127.0.0.1:$PORT"
+CLK_TCK=$(getconf CLK_TCK)
+
+set -eo pipefail
+
+for tool in curl jq; do
+  if ! which "$tool" &>/dev/null; then
+    echo "$0: $tool is required."
+    exit 1
+  fi
+done
+
+# <name> <input> <endpoint> <status-output> <clients>
+SCENARIOS=(
+  "jpeg-stream-1      capture.jpeg   /stream      stream    1"
+  "jpeg-stream-10     capture.jpeg   /stream      stream    10"
+  "jpeg-stream-100    capture.jpeg   /stream      stream    100"
+  "jpeg-snapshot-10   capture.jpeg   /snapshot    snapshot  10"
+  "jpeg-h264-1        capture.jpeg   /video.h264  video     1"
+  "jpeg-mkv-1         capture.jpeg   /video.mkv   video     1"
+  "h264-stream-1      capture.h264   /stream      stream    1"
+  "h264-stream-10     capture.h264   /stream      stream    10"
+  "h264-h264-1        capture.h264   /video.h264  video     1"
+  "yuv420-stream-1    capture.yuv420 /stream      stream    1"
+  "yuv420-stream-10   capture.yuv420 /stream      stream    10"
+  "yuv420-snapshot-10 capture.yuv420 /snapshot    snapshot  10"
+  "yuv420-h264-1      capture.yuv420 /video.h264  video     1"
+)
+
+input_options() {
+  case "$1" in
+    *.jpeg) echo "--camera-format=JPEG --camera-width=1920 --camera-height=1080" ;;
+    *.yuv420) echo "--camera-format=YUV420 --camera-width=1920 --camera-height=1080" ;;
+    *.h264) echo "--camera-format=H264 --camera-width=1920 --camera-height=1080" ;;
+  esac
+}
+
+# prints `<utime+stime ticks> <VmRSS kB> <VmHWM kB>`
+process_usage() {
+  local ticks=$(awk '{ print $14 + $15 }' "/proc/$1/stat")
+  local rss=$(awk '/^VmRSS:/ { print $2 }' "/proc/$1/status")
+  local hwm=$(awk '/^VmHWM:/ { print $2 }' "/proc/$1/status")
+  echo "$ticks ${rss:-0} ${hwm:-0}"
+}
+
+wait_ready() {
+  for i in $(seq 100); do
+    curl -sf -o /dev/null --max-time 1 "$URL/status" && return 0
+    kill -0 "$1" 2>/dev/null || return 1
+    sleep 0.1
+  done
+  return 1
+}
+
+run_scenario() {
+  local name="$1" input="$2" endpoint="$3" lock="$4" clients="$5"
+  local log="/tmp/bench-$name.log"
+  local clients_json="/tmp/bench-$name.json"
+
+  ./camera-streamer \
+    --camera-type=dummy \
+    --camera-path="$SCRIPT_DIR/$input" \
+    --camera-snapshot.height=1080 \
+    --camera-dummy.options="$DUMMY_OPTIONS" \
+    --http-port="$PORT" \
+    --http-maxcons=$((clients + 4)) \
+    --log-stats=1 \
+    $(input_options "$input") \
+    &> "$log" &
+  local pid=$!
+
+  if ! wait_ready "$pid"; then
+    kill "$pid" 2>/dev/null || true
+    wait "$pid" 2>/dev/null || true
+    jq -n --arg name "$name" --arg log "$log" \
+      '{name: $name, status: "failed", error: "camera-streamer did not start", log: $log}'
+    return
+  fi
+
+  local http_code=$(curl -s -o /dev/null --max-time 1 -w '%{http_code}' "$URL$endpoint" || true)
+  if [[ "$http_code" != "200" ]]; then
+    kill "$pid"
+    wait "$pid" 2>/dev/null || true
+    jq -n --arg name "$name" --arg endpoint "$endpoint" --arg code "$http_code" \
+      '{name: $name, status: "skipped", error: "\($endpoint) returned \($code)"}'
+    return
+  fi
+
+  local status_before=$(curl -s "$URL/status")
+  local usage_before=($(process_usage "$pid"))
+  local start_ns=$(date +%s%N)
+
+  ./stream-bench \
+    --bench-url="$URL$endpoint" \
+    --bench-clients="$clients" \
+    --bench-duration="$DURATION" \
+    --bench-json=1 \
+    > "$clients_json" 2>> "$log"
+
+  local elapsed_ns=$(($(date +%s%N) - start_ns))
+  local usage_after=($(process_usage "$pid"))
+  local status_after=$(curl -s "$URL/status")
+
+  kill "$pid"
+  wait "$pid" 2>/dev/null || true
+
+  jq -n \
+    --arg name "$name" \
+    --arg input "$input" \
+    --arg endpoint "$endpoint" \
+    --arg lock "$lock" \
+    --argjson clients "$clients" \
+    --argjson elapsed "$(awk "BEGIN { print $elapsed_ns / 1e9 }")" \
+    --argjson cpu "$(awk "BEGIN { print (${usage_after[0]} - ${usage_before[0]}) / $CLK_TCK }")" \
+    --argjson rss_kb "${usage_after[1]}" \
+    --argjson rss_peak_kb "${usage_after[2]}" \
+    --argjson before "$status_before" \
+    --argjson after "$status_after" \
+    --slurpfile client "$clients_json" \
+    '($before.outputs[$lock]) as $b |
+     ($after.outputs[$lock]) as $a |
+     ($a.frames - $b.frames) as $frames |
+     ($a.dropped - $b.dropped) as $dropped |
+     {
+       name: $name,
+       status: "ok",
+       input: $input,
+       endpoint: $endpoint,
+       clients: $clients,
+       duration_s: $elapsed,
+       frames: $frames,
+       fps: ($frames / $elapsed),
+       dropped: $dropped,
+       drop_rate: (if $frames + $dropped > 0 then $dropped / ($frames + $dropped) else 0 end),
+       latency_p50_ms: $a.latency.p50_ms,
+       latency_p99_ms: $a.latency.p99_ms,
+       latency_max_ms: $a.latency.max_ms,
+       cpu_s: $cpu,
+       cpu_percent: ($cpu * 100 / $elapsed),
+       rss_kb: $rss_kb,
+       rss_peak_kb: $rss_peak_kb,
+       client_fps: ($client[0].total.fps / $clients),
+       client_bytes_per_s: ($client[0].total.bytes_per_s / $clients),
+       client_missed: $client[0].total.missed,
+       client_errors: $client[0].total.errors,
+       client_latency_p99_ms: $client[0].total.latency_p99_ms,
+       client_gaps_ms: $client[0].total.gaps_ms
+     }'
+}
+
+results=()
+
+for scenario in "${SCENARIOS[@]}"; do
+  read -r name input endpoint lock clients <<< "$scenario"
+  [[ "$name" == $FILTER ]] || continue
+
+  echo "$0: running $name: $clients client(s) of $endpoint for ${DURATION}s..." >&2
+  result=$(run_scenario "$name" "$input" "$endpoint" "$lock" "$clients")
+  echo "$result" | jq -c . >&2
+  results+=("$result")
+done
+
+printf '%s\n' "${results[@]}" | jq -s \
+  --arg revision "$(git rev-parse --short HEAD 2>/dev/null)" \
+  --arg date "$(date -u +%Y-%m-%dT%H:%M:%SZ)" \
+  --argjson duration "$DURATION" \
+  --arg dummy_options "$DUMMY_OPTIONS" \
+  '{revision: $revision, date: $date, duration_s: $duration, dummy_options: $dummy_options, scenarios: .}' \
+  > "$OUTPUT"
+
+echo "$0: results written to $OUTPUT" >&2
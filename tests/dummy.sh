@@ -8,6 +8,7 @@ if [[ $# -lt 1 ]]; then
   echo "  $0 tests/capture.jpeg --video-height=720"
   echo "  $0 tests/capture.jpeg --snapshot-height=720 --video-height=480"
   echo "  $0 tests/capture.h264"
+  echo "  $0 tests/capture.jpeg --camera-dummy.options='delay_ms=20;jitter_ms=5;max_inflight=2'"
   exit 1
 fi
 
@@ -130,6 +130,49 @@ char *http_get_param(http_worker_t *worker, const char *key)
   return param;
 }
 
+// Finds the method for the `request_uri` and executes it.
+// Can be called again after rewriting the `request_uri`.
+bool http_dispatch(http_worker_t *worker, FILE *stream)
+{
+  http_method_t *current_method = NULL;
+
+  for (int i = 0; worker->methods[i].method; i++) {
+    http_method_t *method = &worker->methods[i];
+
+    if (strcmp(worker->request_method, method->method))
+      continue;
+
+    const char *params = strstr(method->uri, "?");
+
+    if (params) {
+      // match request_uri and params
+      if (strncmp(worker->request_uri, method->uri, params - method->uri))
+        continue;
+      if (!strstr(worker->request_params, params+1))
+        continue;
+    } else if (method->uri[0] == '*') {
+      if (strstr(worker->request_uri, method->uri + 1) != worker->request_uri)
+        continue;
+    } else {
+      if (strcmp(worker->request_uri, method->uri))
+        continue;
+    }
+
+    current_method = method;
+    break;
+  }
+
+  if (!current_method) {
+    return false;
+  }
+
+  http_method_t *parent_method = worker->current_method;
+  worker->current_method = current_method;
+  current_method->func(worker, stream);
+  worker->current_method = parent_method;
+  return true;
+}
+
 static void http_process(http_worker_t *worker, FILE *stream)
 {
   // Read headers
@@ -183,38 +226,11 @@ static void http_process(http_worker_t *worker, FILE *stream)
   }
 
   worker->current_method = NULL;
-
-  for (int i = 0; worker->methods[i].method; i++) {
-    http_method_t *method = &worker->methods[i];
-
-    if (strcmp(worker->request_method, method->method))
-      continue;
-
-    const char *params = strstr(method->uri, "?");
-
-    if (params) {
-      // match request_uri and params
-      if (strncmp(worker->request_uri, method->uri, params - method->uri))
-        continue;
-      if (!strstr(worker->request_params, params+1))
-        continue;
-    } else if (method->uri[0] == '*') {
-      if (strstr(worker->request_uri, method->uri + 1) != worker->request_uri)
-        continue;
-    } else {
-      if (strcmp(worker->request_uri, method->uri))
-        continue;
-    }
-
-    worker->current_method = &worker->methods[i];
-    break;
-  }
+  worker->context = NULL;
 
   LOG_INFO(worker, "Request '%s' '%s' '%s'", worker->request_method, worker->request_uri, worker->request_params);
 
-  if (worker->current_method) {
-    worker->current_method->func(worker, stream);
-    worker->current_method = NULL;
+  if (http_dispatch(worker, stream)) {
     return;
   }
 
@@ -53,9 +53,11 @@ typedef struct http_worker_s {
   char *request_version;
 
   http_method_t *current_method;
+  void *context; // set by the handlers dispatching sub-paths, reset for each request
 } http_worker_t;
 
 int http_server(http_server_options_t *options, http_method_t *methods);
+bool http_dispatch(http_worker_t *worker, FILE *stream);
 void http_content(http_worker_t *worker, FILE *stream);
 void http_write_response(FILE *stream, const char *status, const char *content_type, const char *body, unsigned content_length);
 void http_write_responsef(FILE *stream, const char *status, const char *content_type, const char *fmt, ...);
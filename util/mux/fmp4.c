@@ -0,0 +1,290 @@
+#include "util/mux/fmp4.h"
+#include "util/opts/log.h"
+
+#define FMP4_SAMPLE_FLAGS_KEY 0x02000000 // depends on no other
+#define FMP4_SAMPLE_FLAGS_NON_KEY 0x01010000 // depends on others, non sync
+
+static const uint32_t fmp4_matrix[] = {
+  0x00010000, 0, 0, 0, 0x00010000, 0, 0, 0, 0x40000000
+};
+
+static size_t fmp4_box(mux_buf_t *buf, const char *type)
+{
+  size_t offset = buf->size;
+  mux_buf_u32(buf, 0);
+  mux_buf_write(buf, type, 4);
+  return offset;
+}
+
+static size_t fmp4_full_box(mux_buf_t *buf, const char *type, uint8_t version, uint32_t flags)
+{
+  size_t offset = fmp4_box(buf, type);
+  mux_buf_u32(buf, (version << 24) | flags);
+  return offset;
+}
+
+static void fmp4_end_box(mux_buf_t *buf, size_t offset)
+{
+  mux_buf_put_u32(buf, offset, buf->size - offset);
+}
+
+static void fmp4_write_matrix(mux_buf_t *buf)
+{
+  for (int i = 0; i < 9; i++) {
+    mux_buf_u32(buf, fmp4_matrix[i]);
+  }
+}
+
+static void fmp4_write_avc1(fmp4_t *mp4, mux_buf_t *buf)
+{
+  size_t avc1 = fmp4_box(buf, "avc1");
+  mux_buf_zero(buf, 6);
+  mux_buf_u16(buf, 1); // data_reference_index
+  mux_buf_zero(buf, 16);
+  mux_buf_u16(buf, mp4->width);
+  mux_buf_u16(buf, mp4->height);
+  mux_buf_u32(buf, 0x00480000); // 72 dpi
+  mux_buf_u32(buf, 0x00480000);
+  mux_buf_u32(buf, 0);
+  mux_buf_u16(buf, 1); // frame_count
+  mux_buf_zero(buf, 32); // compressorname
+  mux_buf_u16(buf, 0x0018); // depth
+  mux_buf_u16(buf, 0xFFFF);
+
+  size_t avcc = fmp4_box(buf, "avcC");
+  mux_h264_write_avcc(&mp4->params, buf);
+  fmp4_end_box(buf, avcc);
+
+  fmp4_end_box(buf, avc1);
+}
+
+static void fmp4_write_stbl(fmp4_t *mp4, mux_buf_t *buf)
+{
+  size_t stbl = fmp4_box(buf, "stbl");
+
+  size_t stsd = fmp4_full_box(buf, "stsd", 0, 0);
+  mux_buf_u32(buf, 1);
+  fmp4_write_avc1(mp4, buf);
+  fmp4_end_box(buf, stsd);
+
+  // the samples are in the fragments
+  const char *empty[] = { "stts", "stsc", "stco" };
+  for (int i = 0; i < 3; i++) {
+    size_t box = fmp4_full_box(buf, empty[i], 0, 0);
+    mux_buf_u32(buf, 0);
+    fmp4_end_box(buf, box);
+  }
+
+  size_t stsz = fmp4_full_box(buf, "stsz", 0, 0);
+  mux_buf_u32(buf, 0);
+  mux_buf_u32(buf, 0);
+  fmp4_end_box(buf, stsz);
+
+  fmp4_end_box(buf, stbl);
+}
+
+// Writes the `ftyp` and `moov` of the parsed `params`
+void fmp4_write_init(fmp4_t *mp4, mux_buf_t *buf)
+{
+  size_t ftyp = fmp4_box(buf, "ftyp");
+  mux_buf_write(buf, "iso5", 4);
+  mux_buf_u32(buf, 512);
+  mux_buf_write(buf, "iso5iso6avc1mp41", 16);
+  fmp4_end_box(buf, ftyp);
+
+  size_t moov = fmp4_box(buf, "moov");
+
+  size_t mvhd = fmp4_full_box(buf, "mvhd", 0, 0);
+  mux_buf_u32(buf, 0); // creation_time
+  mux_buf_u32(buf, 0); // modification_time
+  mux_buf_u32(buf, FMP4_TIMESCALE);
+  mux_buf_u32(buf, 0); // duration
+  mux_buf_u32(buf, 0x00010000); // rate
+  mux_buf_u16(buf, 0x0100); // volume
+  mux_buf_zero(buf, 10);
+  fmp4_write_matrix(buf);
+  mux_buf_zero(buf, 24);
+  mux_buf_u32(buf, 2); // next_track_ID
+  fmp4_end_box(buf, mvhd);
+
+  size_t trak = fmp4_box(buf, "trak");
+
+  size_t tkhd = fmp4_full_box(buf, "tkhd", 0, 3); // enabled, in movie
+  mux_buf_u32(buf, 0);
+  mux_buf_u32(buf, 0);
+  mux_buf_u32(buf, 1); // track_ID
+  mux_buf_u32(buf, 0);
+  mux_buf_u32(buf, 0); // duration
+  mux_buf_zero(buf, 8);
+  mux_buf_u16(buf, 0); // layer
+  mux_buf_u16(buf, 0); // alternate_group
+  mux_buf_u16(buf, 0); // volume
+  mux_buf_u16(buf, 0);
+  fmp4_write_matrix(buf);
+  mux_buf_u32(buf, mp4->width << 16);
+  mux_buf_u32(buf, mp4->height << 16);
+  fmp4_end_box(buf, tkhd);
+
+  size_t mdia = fmp4_box(buf, "mdia");
+
+  size_t mdhd = fmp4_full_box(buf, "mdhd", 0, 0);
+  mux_buf_u32(buf, 0);
+  mux_buf_u32(buf, 0);
+  mux_buf_u32(buf, FMP4_TIMESCALE);
+  mux_buf_u32(buf, 0);
+  mux_buf_u16(buf, 0x55C4); // und
+  mux_buf_u16(buf, 0);
+  fmp4_end_box(buf, mdhd);
+
+  size_t hdlr = fmp4_full_box(buf, "hdlr", 0, 0);
+  mux_buf_u32(buf, 0);
+  mux_buf_write(buf, "vide", 4);
+  mux_buf_zero(buf, 12);
+  mux_buf_write(buf, "VideoHandler", 13);
+  fmp4_end_box(buf, hdlr);
+
+  size_t minf = fmp4_box(buf, "minf");
+
+  size_t vmhd = fmp4_full_box(buf, "vmhd", 0, 1);
+  mux_buf_zero(buf, 8);
+  fmp4_end_box(buf, vmhd);
+
+  size_t dinf = fmp4_box(buf, "dinf");
+  size_t dref = fmp4_full_box(buf, "dref", 0, 0);
+  mux_buf_u32(buf, 1);
+  size_t url = fmp4_full_box(buf, "url ", 0, 1); // self-contained
+  fmp4_end_box(buf, url);
+  fmp4_end_box(buf, dref);
+  fmp4_end_box(buf, dinf);
+
+  fmp4_write_stbl(mp4, buf);
+
+  fmp4_end_box(buf, minf);
+  fmp4_end_box(buf, mdia);
+  fmp4_end_box(buf, trak);
+
+  size_t mvex = fmp4_box(buf, "mvex");
+  size_t trex = fmp4_full_box(buf, "trex", 0, 0);
+  mux_buf_u32(buf, 1); // track_ID
+  mux_buf_u32(buf, 1); // default_sample_description_index
+  mux_buf_u32(buf, 0);
+  mux_buf_u32(buf, 0);
+  mux_buf_u32(buf, 0);
+  fmp4_end_box(buf, trex);
+  fmp4_end_box(buf, mvex);
+
+  fmp4_end_box(buf, moov);
+}
+
+// Appends the frame to the pending fragment as the length prefixed NALs,
+// the parameter sets are in the `avcC`
+bool fmp4_add_sample(fmp4_t *mp4, mux_h264_nal_t *nals, int n_nals, uint32_t duration, bool keyframe)
+{
+  if (mp4->n_samples >= FMP4_MAX_SAMPLES) {
+    return false;
+  }
+
+  fmp4_sample_t *sample = &mp4->samples[mp4->n_samples++];
+  sample->offset = mp4->mdat.size;
+  sample->duration = duration;
+  sample->keyframe = keyframe;
+
+  for (int i = 0; i < n_nals; i++) {
+    switch (nals[i].type) {
+    case MUX_H264_NAL_SPS:
+    case MUX_H264_NAL_PPS:
+    case MUX_H264_NAL_AUD:
+      continue;
+    }
+
+    mux_buf_u32(&mp4->mdat, nals[i].size);
+    mux_buf_write(&mp4->mdat, nals[i].data, nals[i].size);
+  }
+
+  sample->size = mp4->mdat.size - sample->offset;
+  return true;
+}
+
+uint64_t fmp4_duration(fmp4_t *mp4)
+{
+  uint64_t duration = 0;
+
+  for (int i = 0; i < mp4->n_samples; i++) {
+    duration += mp4->samples[i].duration;
+  }
+
+  return duration;
+}
+
+// Writes the `moof` and the `mdat` header of the `samples`
+static void fmp4_write_moof(fmp4_t *mp4, mux_buf_t *buf, uint64_t decode_time, fmp4_sample_t *samples, int n_samples, size_t mdat_size)
+{
+  size_t moof = fmp4_box(buf, "moof");
+
+  size_t mfhd = fmp4_full_box(buf, "mfhd", 0, 0);
+  mux_buf_u32(buf, ++mp4->sequence);
+  fmp4_end_box(buf, mfhd);
+
+  size_t traf = fmp4_box(buf, "traf");
+
+  size_t tfhd = fmp4_full_box(buf, "tfhd", 0, 0x020000); // default-base-is-moof
+  mux_buf_u32(buf, 1);
+  fmp4_end_box(buf, tfhd);
+
+  size_t tfdt = fmp4_full_box(buf, "tfdt", 1, 0);
+  mux_buf_u64(buf, decode_time);
+  fmp4_end_box(buf, tfdt);
+
+  // data-offset, duration, size and flags of each sample
+  size_t trun = fmp4_full_box(buf, "trun", 0, 0x000701);
+  mux_buf_u32(buf, n_samples);
+  size_t data_offset = buf->size;
+  mux_buf_u32(buf, 0);
+  for (int i = 0; i < n_samples; i++) {
+    mux_buf_u32(buf, samples[i].duration);
+    mux_buf_u32(buf, samples[i].size);
+    mux_buf_u32(buf, samples[i].keyframe ? FMP4_SAMPLE_FLAGS_KEY : FMP4_SAMPLE_FLAGS_NON_KEY);
+  }
+  fmp4_end_box(buf, trun);
+
+  fmp4_end_box(buf, traf);
+  fmp4_end_box(buf, moof);
+
+  mux_buf_put_u32(buf, data_offset, buf->size - moof + 8);
+
+  mux_buf_u32(buf, 8 + mdat_size);
+  mux_buf_write(buf, "mdat", 4);
+}
+
+// Writes the `moof` and `mdat` of the pending samples
+void fmp4_write_fragment(fmp4_t *mp4, mux_buf_t *buf)
+{
+  fmp4_write_moof(mp4, buf, mp4->decode_time, mp4->samples, mp4->n_samples, mp4->mdat.size);
+  mux_buf_write(buf, mp4->mdat.data, mp4->mdat.size);
+
+  mp4->decode_time += fmp4_duration(mp4);
+  mp4->n_samples = 0;
+  mux_buf_reset(&mp4->mdat);
+}
+
+// Writes the frame as a fragment of a single sample at the `decode_time`,
+// the `iov` references the NALs in place
+void fmp4_write_frame(fmp4_t *mp4, mux_h264_nal_t *nals, int n_nals, uint64_t decode_time, uint32_t duration, bool keyframe, mux_iov_t *iov)
+{
+  fmp4_sample_t sample = {
+    .size = mux_h264_sample_size(nals, n_nals),
+    .duration = duration,
+    .keyframe = keyframe,
+  };
+
+  mux_iov_reset(iov);
+  fmp4_write_moof(mp4, &iov->header, decode_time, &sample, 1, sample.size);
+  mux_iov_add(iov, iov->header.data, iov->header.size);
+  mux_iov_add_h264(iov, nals, n_nals);
+}
+
+void fmp4_free(fmp4_t *mp4)
+{
+  mux_buf_free(&mp4->mdat);
+  mp4->n_samples = 0;
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include "util/mux/mux.h"
+
+#define FMP4_TIMESCALE 90000
+#define FMP4_MAX_SAMPLES 128
+
+typedef struct fmp4_sample_s {
+  uint32_t offset; // in the `mdat`
+  uint32_t size;
+  uint32_t duration;
+  bool keyframe;
+} fmp4_sample_t;
+
+// Fragmented MP4 of a single H264 track
+typedef struct fmp4_s {
+  unsigned width, height;
+  mux_h264_params_t params;
+  uint32_t sequence;
+
+  // the pending fragment
+  uint64_t decode_time;
+  fmp4_sample_t samples[FMP4_MAX_SAMPLES];
+  int n_samples;
+  mux_buf_t mdat;
+} fmp4_t;
+
+void fmp4_write_init(fmp4_t *mp4, mux_buf_t *buf);
+bool fmp4_add_sample(fmp4_t *mp4, mux_h264_nal_t *nals, int n_nals, uint32_t duration, bool keyframe);
+uint64_t fmp4_duration(fmp4_t *mp4);
+void fmp4_write_fragment(fmp4_t *mp4, mux_buf_t *buf);
+void fmp4_write_frame(fmp4_t *mp4, mux_h264_nal_t *nals, int n_nals, uint64_t decode_time, uint32_t duration, bool keyframe, mux_iov_t *iov);
+void fmp4_free(fmp4_t *mp4);
@@ -0,0 +1,158 @@
+#include "util/mux/mkv.h"
+#include "util/opts/log.h"
+
+#define MKV_ID_EBML 0x1A45DFA3
+#define MKV_ID_EBML_VERSION 0x4286
+#define MKV_ID_EBML_READ_VERSION 0x42F7
+#define MKV_ID_EBML_MAX_ID_LENGTH 0x42F2
+#define MKV_ID_EBML_MAX_SIZE_LENGTH 0x42F3
+#define MKV_ID_DOC_TYPE 0x4282
+#define MKV_ID_DOC_TYPE_VERSION 0x4287
+#define MKV_ID_DOC_TYPE_READ_VERSION 0x4285
+#define MKV_ID_SEGMENT 0x18538067
+#define MKV_ID_INFO 0x1549A966
+#define MKV_ID_TIMESTAMP_SCALE 0x2AD7B1
+#define MKV_ID_MUXING_APP 0x4D80
+#define MKV_ID_WRITING_APP 0x5741
+#define MKV_ID_TRACKS 0x1654AE6B
+#define MKV_ID_TRACK_ENTRY 0xAE
+#define MKV_ID_TRACK_NUMBER 0xD7
+#define MKV_ID_TRACK_UID 0x73C5
+#define MKV_ID_TRACK_TYPE 0x83
+#define MKV_ID_FLAG_LACING 0x9C
+#define MKV_ID_CODEC_ID 0x86
+#define MKV_ID_CODEC_PRIVATE 0x63A2
+#define MKV_ID_VIDEO 0xE0
+#define MKV_ID_PIXEL_WIDTH 0xB0
+#define MKV_ID_PIXEL_HEIGHT 0xBA
+#define MKV_ID_CLUSTER 0x1F43B675
+#define MKV_ID_TIMESTAMP 0xE7
+#define MKV_ID_SIMPLE_BLOCK 0xA3
+
+#define MKV_UNKNOWN_SIZE 0x01FFFFFFFFFFFFFFULL
+#define MKV_TRACK_VIDEO 1
+#define MKV_SIMPLE_BLOCK_KEY 0x80
+
+static void mkv_id(mux_buf_t *buf, uint32_t id)
+{
+  for (int shift = 24; shift >= 0; shift -= 8) {
+    if (id >> shift || !shift) {
+      mux_buf_u8(buf, id >> shift);
+    }
+  }
+}
+
+// Opens the element with the 8 bytes size, written by `mkv_end`
+static size_t mkv_start(mux_buf_t *buf, uint32_t id)
+{
+  mkv_id(buf, id);
+  size_t offset = buf->size;
+  mux_buf_u64(buf, MKV_UNKNOWN_SIZE);
+  return offset;
+}
+
+static void mkv_end(mux_buf_t *buf, size_t offset)
+{
+  uint64_t size = buf->size - offset - 8;
+
+  mux_buf_put_u32(buf, offset, 0x01000000 | (size >> 32));
+  mux_buf_put_u32(buf, offset + 4, size);
+}
+
+static void mkv_uint(mux_buf_t *buf, uint32_t id, uint64_t value)
+{
+  int n = 1;
+  while (n < 8 && value >> (n * 8))
+    n++;
+
+  mkv_id(buf, id);
+  mux_buf_u8(buf, 0x80 | n);
+  for (int i = n - 1; i >= 0; i--) {
+    mux_buf_u8(buf, value >> (i * 8));
+  }
+}
+
+static void mkv_binary(mux_buf_t *buf, uint32_t id, const void *data, size_t size)
+{
+  size_t offset = mkv_start(buf, id);
+  mux_buf_write(buf, data, size);
+  mkv_end(buf, offset);
+}
+
+static void mkv_string(mux_buf_t *buf, uint32_t id, const char *value)
+{
+  mkv_binary(buf, id, value, strlen(value));
+}
+
+// Writes the EBML header, the start of the live segment and its track
+void mkv_write_init(mkv_t *mkv, mux_buf_t *buf)
+{
+  size_t ebml = mkv_start(buf, MKV_ID_EBML);
+  mkv_uint(buf, MKV_ID_EBML_VERSION, 1);
+  mkv_uint(buf, MKV_ID_EBML_READ_VERSION, 1);
+  mkv_uint(buf, MKV_ID_EBML_MAX_ID_LENGTH, 4);
+  mkv_uint(buf, MKV_ID_EBML_MAX_SIZE_LENGTH, 8);
+  mkv_string(buf, MKV_ID_DOC_TYPE, "matroska");
+  mkv_uint(buf, MKV_ID_DOC_TYPE_VERSION, 4);
+  mkv_uint(buf, MKV_ID_DOC_TYPE_READ_VERSION, 2);
+  mkv_end(buf, ebml);
+
+  // the segment never ends
+  mkv_id(buf, MKV_ID_SEGMENT);
+  mux_buf_u64(buf, MKV_UNKNOWN_SIZE);
+
+  size_t info = mkv_start(buf, MKV_ID_INFO);
+  mkv_uint(buf, MKV_ID_TIMESTAMP_SCALE, MKV_TIMESCALE_NS);
+  mkv_string(buf, MKV_ID_MUXING_APP, "camera-streamer");
+  mkv_string(buf, MKV_ID_WRITING_APP, "camera-streamer");
+  mkv_end(buf, info);
+
+  size_t tracks = mkv_start(buf, MKV_ID_TRACKS);
+  size_t track = mkv_start(buf, MKV_ID_TRACK_ENTRY);
+  mkv_uint(buf, MKV_ID_TRACK_NUMBER, 1);
+  mkv_uint(buf, MKV_ID_TRACK_UID, 1);
+  mkv_uint(buf, MKV_ID_TRACK_TYPE, MKV_TRACK_VIDEO);
+  mkv_uint(buf, MKV_ID_FLAG_LACING, 0);
+  mkv_string(buf, MKV_ID_CODEC_ID, "V_MPEG4/ISO/AVC");
+
+  size_t codec_private = mkv_start(buf, MKV_ID_CODEC_PRIVATE);
+  mux_h264_write_avcc(&mkv->params, buf);
+  mkv_end(buf, codec_private);
+
+  size_t video = mkv_start(buf, MKV_ID_VIDEO);
+  mkv_uint(buf, MKV_ID_PIXEL_WIDTH, mkv->width);
+  mkv_uint(buf, MKV_ID_PIXEL_HEIGHT, mkv->height);
+  mkv_end(buf, video);
+
+  mkv_end(buf, track);
+  mkv_end(buf, tracks);
+
+  mkv->has_cluster = false;
+}
+
+// Writes the frame as a `SimpleBlock`, each key frame starts a new cluster,
+// so the stream can be joined there
+void mkv_write_frame(mkv_t *mkv, mux_h264_nal_t *nals, int n_nals, uint64_t time_ms, bool keyframe, mux_iov_t *iov)
+{
+  size_t size = mux_h264_sample_size(nals, n_nals);
+
+  mux_iov_reset(iov);
+
+  if (!mkv->has_cluster || keyframe || time_ms < mkv->cluster_time_ms ||
+    time_ms - mkv->cluster_time_ms > INT16_MAX) {
+    mkv_id(&iov->header, MKV_ID_CLUSTER);
+    mux_buf_u64(&iov->header, MKV_UNKNOWN_SIZE);
+    mkv_uint(&iov->header, MKV_ID_TIMESTAMP, time_ms);
+    mkv->cluster_time_ms = time_ms;
+    mkv->has_cluster = true;
+  }
+
+  mkv_id(&iov->header, MKV_ID_SIMPLE_BLOCK);
+  mux_buf_u64(&iov->header, 0x0100000000000000ULL | (size + 4));
+  mux_buf_u8(&iov->header, 0x80 | 1); // track number
+  mux_buf_u16(&iov->header, time_ms - mkv->cluster_time_ms);
+  mux_buf_u8(&iov->header, keyframe ? MKV_SIMPLE_BLOCK_KEY : 0);
+
+  mux_iov_add(iov, iov->header.data, iov->header.size);
+  mux_iov_add_h264(iov, nals, n_nals);
+}
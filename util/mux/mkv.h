@@ -0,0 +1,17 @@
+#pragma once
+
+#include "util/mux/mux.h"
+
+#define MKV_TIMESCALE_NS 1000000 // the timestamps are in ms
+
+// Live Matroska of a single H264 track, with the clusters of unknown size
+typedef struct mkv_s {
+  unsigned width, height;
+  mux_h264_params_t params;
+
+  bool has_cluster;
+  uint64_t cluster_time_ms;
+} mkv_t;
+
+void mkv_write_init(mkv_t *mkv, mux_buf_t *buf);
+void mkv_write_frame(mkv_t *mkv, mux_h264_nal_t *nals, int n_nals, uint64_t time_ms, bool keyframe, mux_iov_t *iov);
@@ -0,0 +1,220 @@
+#include "util/mux/mux.h"
+#include "util/opts/log.h"
+
+static void mux_buf_reserve(mux_buf_t *buf, size_t size)
+{
+  if (buf->size + size <= buf->alloc)
+    return;
+
+  size_t alloc = MAX(buf->alloc * 2, buf->size + size);
+  uint8_t *data = realloc(buf->data, alloc);
+  if (!data) {
+    LOG_PERROR(NULL, "Cannot allocate %zu bytes.", alloc);
+  }
+
+  buf->data = data;
+  buf->alloc = alloc;
+}
+
+void mux_buf_reset(mux_buf_t *buf)
+{
+  buf->size = 0;
+}
+
+void mux_buf_free(mux_buf_t *buf)
+{
+  free(buf->data);
+  *buf = (mux_buf_t){0};
+}
+
+void mux_buf_write(mux_buf_t *buf, const void *data, size_t size)
+{
+  mux_buf_reserve(buf, size);
+  memcpy(buf->data + buf->size, data, size);
+  buf->size += size;
+}
+
+void mux_buf_zero(mux_buf_t *buf, size_t size)
+{
+  mux_buf_reserve(buf, size);
+  memset(buf->data + buf->size, 0, size);
+  buf->size += size;
+}
+
+void mux_buf_u8(mux_buf_t *buf, uint8_t value)
+{
+  mux_buf_write(buf, &value, 1);
+}
+
+void mux_buf_u16(mux_buf_t *buf, uint16_t value)
+{
+  uint8_t data[] = { value >> 8, value };
+  mux_buf_write(buf, data, sizeof(data));
+}
+
+void mux_buf_u32(mux_buf_t *buf, uint32_t value)
+{
+  uint8_t data[] = { value >> 24, value >> 16, value >> 8, value };
+  mux_buf_write(buf, data, sizeof(data));
+}
+
+void mux_buf_u64(mux_buf_t *buf, uint64_t value)
+{
+  mux_buf_u32(buf, value >> 32);
+  mux_buf_u32(buf, value);
+}
+
+void mux_buf_put_u32(mux_buf_t *buf, size_t offset, uint32_t value)
+{
+  buf->data[offset + 0] = value >> 24;
+  buf->data[offset + 1] = value >> 16;
+  buf->data[offset + 2] = value >> 8;
+  buf->data[offset + 3] = value;
+}
+
+// Splits the Annex-B frame on the 3 and 4 byte start codes,
+// returns the count of all NALs, over `max_nals` if they did not fit
+int mux_h264_split(const void *data, size_t size, mux_h264_nal_t *nals, int max_nals)
+{
+  const uint8_t *p = data;
+  int n_nals = 0;
+  size_t start = 0;
+  bool found = false;
+
+  for (size_t i = 0; i + 2 < size; i++) {
+    if (p[i] != 0 || p[i + 1] != 0 || p[i + 2] != 1)
+      continue;
+
+    if (found && n_nals < max_nals) {
+      size_t end = i;
+      while (end > start && p[end - 1] == 0)
+        end--;
+      nals[n_nals++] = (mux_h264_nal_t){ p + start, end - start, p[start] & 0x1F };
+    } else if (found) {
+      n_nals++;
+    }
+
+    start = i + 3;
+    found = true;
+    i += 2;
+  }
+
+  if (found && start < size && n_nals < max_nals) {
+    nals[n_nals++] = (mux_h264_nal_t){ p + start, size - start, p[start] & 0x1F };
+  } else if (found && start < size) {
+    n_nals++;
+  }
+
+  return n_nals;
+}
+
+// Returns true when both the SPS and PPS were found
+bool mux_h264_params(mux_h264_params_t *params, mux_h264_nal_t *nals, int n_nals)
+{
+  bool has_sps = false, has_pps = false;
+
+  for (int i = 0; i < n_nals; i++) {
+    if (nals[i].type == MUX_H264_NAL_SPS && nals[i].size >= 4 && nals[i].size <= MUX_H264_MAX_SPS) {
+      memcpy(params->sps, nals[i].data, nals[i].size);
+      params->sps_size = nals[i].size;
+      has_sps = true;
+    } else if (nals[i].type == MUX_H264_NAL_PPS && nals[i].size <= MUX_H264_MAX_PPS) {
+      memcpy(params->pps, nals[i].data, nals[i].size);
+      params->pps_size = nals[i].size;
+      has_pps = true;
+    }
+  }
+
+  return has_sps && has_pps;
+}
+
+static bool mux_h264_is_sample_nal(mux_h264_nal_t *nal)
+{
+  switch (nal->type) {
+  case MUX_H264_NAL_SPS:
+  case MUX_H264_NAL_PPS:
+  case MUX_H264_NAL_AUD:
+    return false;
+
+  default:
+    return true;
+  }
+}
+
+// Writes the AVCDecoderConfigurationRecord with the 4 bytes NAL lengths
+void mux_h264_write_avcc(mux_h264_params_t *params, mux_buf_t *buf)
+{
+  mux_buf_u8(buf, 1);
+  mux_buf_u8(buf, params->sps[1]); // profile
+  mux_buf_u8(buf, params->sps[2]); // compatibility
+  mux_buf_u8(buf, params->sps[3]); // level
+  mux_buf_u8(buf, 0xFF); // 4 bytes NAL length
+  mux_buf_u8(buf, 0xE1); // 1 SPS
+  mux_buf_u16(buf, params->sps_size);
+  mux_buf_write(buf, params->sps, params->sps_size);
+  mux_buf_u8(buf, 1); // 1 PPS
+  mux_buf_u16(buf, params->pps_size);
+  mux_buf_write(buf, params->pps, params->pps_size);
+}
+
+// Returns the size of the length prefixed NALs, the parameter sets are in the `avcC`
+size_t mux_h264_sample_size(mux_h264_nal_t *nals, int n_nals)
+{
+  size_t size = 0;
+
+  for (int i = 0; i < n_nals; i++) {
+    if (mux_h264_is_sample_nal(&nals[i])) {
+      size += 4 + nals[i].size;
+    }
+  }
+
+  return size;
+}
+
+void mux_iov_reset(mux_iov_t *iov)
+{
+  mux_buf_reset(&iov->header);
+  iov->n_iov = 0;
+  iov->size = 0;
+}
+
+void mux_iov_free(mux_iov_t *iov)
+{
+  mux_buf_free(&iov->header);
+  iov->n_iov = 0;
+  iov->size = 0;
+}
+
+void mux_iov_add(mux_iov_t *iov, const void *data, size_t size)
+{
+  if (iov->n_iov >= MUX_MAX_IOV)
+    return;
+
+  iov->iov[iov->n_iov++] = (struct iovec){ (void*)data, size };
+  iov->size += size;
+}
+
+void mux_iov_add_h264(mux_iov_t *iov, mux_h264_nal_t *nals, int n_nals)
+{
+  for (int i = 0, n = 0; i < n_nals && n < MUX_H264_MAX_NALS; i++) {
+    if (!mux_h264_is_sample_nal(&nals[i])) {
+      continue;
+    }
+
+    uint8_t *length = iov->lengths[n++];
+    length[0] = nals[i].size >> 24;
+    length[1] = nals[i].size >> 16;
+    length[2] = nals[i].size >> 8;
+    length[3] = nals[i].size;
+    mux_iov_add(iov, length, 4);
+    mux_iov_add(iov, nals[i].data, nals[i].size);
+  }
+}
+
+// Copies the referenced data, when it has to outlive the encoded buffer
+void mux_iov_gather(mux_iov_t *iov, mux_buf_t *buf)
+{
+  for (int i = 0; i < iov->n_iov; i++) {
+    mux_buf_write(buf, iov->iov[i].iov_base, iov->iov[i].iov_len);
+  }
+}
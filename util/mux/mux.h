@@ -0,0 +1,69 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <sys/uio.h>
+
+#define MUX_H264_MAX_NALS 130 // the slices of a frame and the re-inserted SPS/PPS
+#define MUX_H264_MAX_SPS 256
+#define MUX_H264_MAX_PPS 64
+#define MUX_MAX_IOV (2 * MUX_H264_MAX_NALS + 1)
+
+#define MUX_H264_NAL_IDR 5
+#define MUX_H264_NAL_SEI 6
+#define MUX_H264_NAL_SPS 7
+#define MUX_H264_NAL_PPS 8
+#define MUX_H264_NAL_AUD 9
+
+// A growable buffer of the muxed data
+typedef struct mux_buf_s {
+  uint8_t *data;
+  size_t size;
+  size_t alloc;
+} mux_buf_t;
+
+void mux_buf_reset(mux_buf_t *buf);
+void mux_buf_free(mux_buf_t *buf);
+void mux_buf_write(mux_buf_t *buf, const void *data, size_t size);
+void mux_buf_zero(mux_buf_t *buf, size_t size);
+void mux_buf_u8(mux_buf_t *buf, uint8_t value);
+void mux_buf_u16(mux_buf_t *buf, uint16_t value);
+void mux_buf_u32(mux_buf_t *buf, uint32_t value);
+void mux_buf_u64(mux_buf_t *buf, uint64_t value);
+void mux_buf_put_u32(mux_buf_t *buf, size_t offset, uint32_t value);
+
+typedef struct mux_h264_nal_s {
+  const uint8_t *data; // without the start code
+  size_t size;
+  unsigned type;
+} mux_h264_nal_t;
+
+// The parameter sets of the H264 stream
+typedef struct mux_h264_params_s {
+  uint8_t sps[MUX_H264_MAX_SPS];
+  size_t sps_size;
+  uint8_t pps[MUX_H264_MAX_PPS];
+  size_t pps_size;
+} mux_h264_params_t;
+
+int mux_h264_split(const void *data, size_t size, mux_h264_nal_t *nals, int max_nals);
+bool mux_h264_params(mux_h264_params_t *params, mux_h264_nal_t *nals, int n_nals);
+void mux_h264_write_avcc(mux_h264_params_t *params, mux_buf_t *buf);
+size_t mux_h264_sample_size(mux_h264_nal_t *nals, int n_nals);
+
+// A muxed frame: the container `header` and the length prefixed NALs
+// referenced in place, without copying the encoded data
+typedef struct mux_iov_s {
+  mux_buf_t header;
+  uint8_t lengths[MUX_H264_MAX_NALS][4];
+  struct iovec iov[MUX_MAX_IOV];
+  int n_iov;
+  size_t size;
+} mux_iov_t;
+
+void mux_iov_reset(mux_iov_t *iov);
+void mux_iov_free(mux_iov_t *iov);
+void mux_iov_add(mux_iov_t *iov, const void *data, size_t size);
+void mux_iov_add_h264(mux_iov_t *iov, mux_h264_nal_t *nals, int n_nals);
+void mux_iov_gather(mux_iov_t *iov, mux_buf_t *buf);
@@ -0,0 +1,93 @@
+#include "util/mux/rtp.h"
+#include "util/opts/log.h"
+
+static void rtp_frame_add(rtp_frame_t *frame, uint8_t payload_type, const uint8_t *prefix, size_t prefix_size, const uint8_t *data, size_t size)
+{
+  if (frame->n_packets == frame->max_packets) {
+    int max_packets = MAX(frame->max_packets * 2, 16);
+    rtp_packet_t *packets = realloc(frame->packets, max_packets * sizeof(rtp_packet_t));
+    if (!packets) {
+      LOG_PERROR(NULL, "Cannot allocate %d packets.", max_packets);
+    }
+
+    frame->packets = packets;
+    frame->max_packets = max_packets;
+  }
+
+  rtp_packet_t *packet = &frame->packets[frame->n_packets++];
+  packet->offset = frame->data.size;
+
+  mux_buf_u8(&frame->data, 0x80); // version 2
+  mux_buf_u8(&frame->data, payload_type & 0x7F);
+  mux_buf_zero(&frame->data, RTP_HEADER_SIZE - 2);
+  if (prefix_size) {
+    mux_buf_write(&frame->data, prefix, prefix_size);
+  }
+  mux_buf_write(&frame->data, data, size);
+
+  packet->size = frame->data.size - packet->offset;
+}
+
+// Sends the NALs up to `RTP_MAX_PAYLOAD_SIZE` as they are,
+// and splits the bigger ones into the FU-A fragments
+void rtp_frame_h264(rtp_frame_t *frame, uint8_t payload_type, mux_h264_nal_t *nals, int n_nals)
+{
+  mux_buf_reset(&frame->data);
+  frame->n_packets = 0;
+
+  for (int i = 0; i < n_nals; i++) {
+    const uint8_t *data = nals[i].data;
+    size_t size = nals[i].size;
+
+    if (!size) {
+      continue;
+    } else if (size <= RTP_MAX_PAYLOAD_SIZE) {
+      rtp_frame_add(frame, payload_type, NULL, 0, data, size);
+      continue;
+    }
+
+    // the NAL header is split into the FU indicator and the FU header
+    uint8_t fu[2] = {
+      (data[0] & 0xE0) | RTP_H264_FU_A,
+      (data[0] & 0x1F) | 0x80 // start
+    };
+
+    for (size_t offset = 1; offset < size; ) {
+      size_t length = MIN(size - offset, RTP_MAX_PAYLOAD_SIZE - sizeof(fu));
+
+      if (offset + length == size) {
+        fu[1] |= 0x40; // end
+      }
+
+      rtp_frame_add(frame, payload_type, fu, sizeof(fu), data + offset, length);
+      fu[1] &= 0x1F;
+      offset += length;
+    }
+  }
+
+  // the marker ends the access unit
+  if (frame->n_packets > 0) {
+    frame->data.data[frame->packets[frame->n_packets - 1].offset + 1] |= 0x80;
+  }
+}
+
+void rtp_frame_free(rtp_frame_t *frame)
+{
+  mux_buf_free(&frame->data);
+  free(frame->packets);
+  *frame = (rtp_frame_t){0};
+}
+
+void rtp_packet_header(uint8_t *packet, uint16_t sequence, uint32_t timestamp, uint32_t ssrc)
+{
+  packet[2] = sequence >> 8;
+  packet[3] = sequence;
+  packet[4] = timestamp >> 24;
+  packet[5] = timestamp >> 16;
+  packet[6] = timestamp >> 8;
+  packet[7] = timestamp;
+  packet[8] = ssrc >> 24;
+  packet[9] = ssrc >> 16;
+  packet[10] = ssrc >> 8;
+  packet[11] = ssrc;
+}
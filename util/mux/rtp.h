@@ -0,0 +1,25 @@
+#pragma once
+
+#include "util/mux/mux.h"
+
+#define RTP_HEADER_SIZE 12
+#define RTP_MAX_PAYLOAD_SIZE 1200 // below the usual path MTU with SRTP
+#define RTP_H264_FU_A 28
+
+typedef struct rtp_packet_s {
+  size_t offset;
+  size_t size;
+} rtp_packet_t;
+
+// The RTP packets of a H264 frame (RFC 6184), fragmented once for all receivers,
+// the SSRC, sequence number and timestamp are written by `rtp_packet_header()`
+typedef struct rtp_frame_s {
+  mux_buf_t data; // the packets back to back
+  rtp_packet_t *packets;
+  int n_packets;
+  int max_packets;
+} rtp_frame_t;
+
+void rtp_frame_h264(rtp_frame_t *frame, uint8_t payload_type, mux_h264_nal_t *nals, int n_nals);
+void rtp_frame_free(rtp_frame_t *frame);
+void rtp_packet_header(uint8_t *packet, uint16_t sequence, uint32_t timestamp, uint32_t ssrc);
@@ -0,0 +1,3 @@
+#define GIT_VERSION ""
+#define GIT_REVISION "446622f"
+#define LIBCAMERA_USES_TRANSFORM